@@ -0,0 +1,39 @@
+QT       += core gui concurrent
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++17
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+TARGET = qt_graphics_editor
+
+include(../widgets/widgets.pri)
+
+SOURCES += \
+    ../src/allocationhooks.cpp \
+    ../src/autosave.cpp \
+    ../src/configdialog.cpp \
+    ../src/main.cpp \
+    ../src/mainwindow.cpp
+
+HEADERS += \
+    ../src/autosave.h \
+    ../src/configdialog.h \
+    ../src/mainwindow.h
+
+FORMS += \
+    ../ui/configdialog.ui \
+    ../ui/mainwindow.ui
+
+TRANSLATIONS += \
+    ../ts/qt_graphics_editor_zh_CN.ts
+CONFIG += lrelease
+CONFIG += embed_translations
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,20 @@
+QT       += core gui concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# 基准测试：只链接核心库，在合成场景上测量绘制、命中测试、文件读写和撤销/重做
+TARGET = qt_graphics_bench
+
+include(../core/core.pri)
+
+SOURCES += \
+    benchmarkrunner.cpp \
+    benchscene.cpp \
+    main.cpp \
+    scenegenerator.cpp
+
+HEADERS += \
+    benchmarkrunner.h \
+    benchscene.h \
+    scenegenerator.h
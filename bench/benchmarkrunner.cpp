@@ -0,0 +1,76 @@
+#include "benchmarkrunner.h"
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QVector>
+#include <algorithm>
+
+BenchmarkRunner::BenchmarkRunner(qint64 minTime, int minIterations, int maxIterations)
+    : m_minTime(minTime),
+      m_minIterations(qMax(1, minIterations)),
+      m_maxIterations(qMax(qMax(1, minIterations), maxIterations))
+{
+}
+
+void BenchmarkRunner::setFilter(const QRegularExpression &filter)
+{
+    m_filter = filter;
+}
+
+bool BenchmarkRunner::isSelected(const QString &name) const
+{
+    return m_filter.pattern().isEmpty() || m_filter.match(name).hasMatch();
+}
+
+void BenchmarkRunner::run(const QString &name, int shapes, int operations, const std::function<void()> &body,
+                          const std::function<void()> &cleanup)
+{
+    if (!isSelected(name)) return;
+
+    // 预热：填充缓存、分配线程池中的线程
+    body();
+    if (cleanup) cleanup();
+
+    QVector<qint64> samples;
+    qint64 total = 0;
+    QElapsedTimer timer;
+    while (samples.size() < m_maxIterations
+           && (samples.size() < m_minIterations || total < m_minTime * 1000000)) {
+        timer.start();
+        body();
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (cleanup) cleanup();
+        samples.append(elapsed);
+        total += elapsed;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const qint64 median = samples.at(samples.size() / 2);
+    const qint64 mean = total / samples.size();
+    const int ops = qMax(1, operations);
+
+    QJsonObject result;
+    result["name"] = name;
+    result["shapes"] = shapes;
+    result["iterations"] = samples.size();
+    result["operations"] = ops;
+    result["min_ns"] = samples.first();
+    result["median_ns"] = median;
+    result["mean_ns"] = mean;
+    result["median_ns_per_op"] = double(median) / ops;
+    m_results.append(result);
+
+    QTextStream out(stdout);
+    out << QString("%1 %2 %3 %4 %5\n")
+           .arg(name, -24)
+           .arg(shapes, 9)
+           .arg(QString::number(median / 1e6, 'f', 3), 12)
+           .arg(QString::number(double(median) / ops, 'f', 1), 14)
+           .arg(samples.size(), 6);
+    out.flush();
+}
+
+QJsonArray BenchmarkRunner::results() const
+{
+    return m_results;
+}
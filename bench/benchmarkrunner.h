@@ -0,0 +1,75 @@
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include <QJsonArray>
+#include <QRegularExpression>
+#include <QString>
+#include <functional>
+
+/**
+ * @file benchmarkrunner.h
+ * @brief 基准测试计时器的头文件
+ *
+ * 这个文件定义了BenchmarkRunner类，重复运行测量函数并汇总耗时。
+ */
+
+/**
+ * @class BenchmarkRunner
+ * @brief 重复测量并记录结果
+ *
+ * 每项测量先运行一次预热，然后重复运行，直到累计时间超过下限并且次数不少于最少次数，
+ * 或者次数达到上限。每次运行之后调用的清理函数不计入耗时。
+ * 结果按运行顺序保存为JSON数组，每项包含最小值、中位数和平均值（纳秒）。
+ */
+class BenchmarkRunner
+{
+public:
+    /**
+     * @brief BenchmarkRunner类的构造函数
+     * @param minTime 每项测量的最短累计时间（毫秒）
+     * @param minIterations 最少运行次数
+     * @param maxIterations 最多运行次数
+     */
+    BenchmarkRunner(qint64 minTime, int minIterations, int maxIterations);
+
+    /**
+     * @brief 设置只运行名称匹配的测量
+     * @param filter 正则表达式，为空时运行所有测量
+     */
+    void setFilter(const QRegularExpression &filter);
+
+    /**
+     * @brief 判断测量是否会运行
+     * @param name 测量名称
+     * @return 如果名称匹配过滤条件，返回true
+     *
+     * 准备工作开销较大的测量可以先检查，不运行时跳过准备。
+     */
+    bool isSelected(const QString &name) const;
+
+    /**
+     * @brief 运行一项测量
+     * @param name 测量名称
+     * @param shapes 场景中的图形数量
+     * @param operations 每次运行包含的操作数，用于计算每个操作的耗时
+     * @param body 被测量的函数
+     * @param cleanup 每次运行之后调用，不计入耗时，可以为空
+     */
+    void run(const QString &name, int shapes, int operations, const std::function<void()> &body,
+             const std::function<void()> &cleanup = std::function<void()>());
+
+    /**
+     * @brief 获取所有测量的结果
+     * @return JSON数组
+     */
+    QJsonArray results() const;
+
+private:
+    qint64 m_minTime;               ///< 每项测量的最短累计时间（毫秒）
+    int m_minIterations;            ///< 最少运行次数
+    int m_maxIterations;            ///< 最多运行次数
+    QRegularExpression m_filter;    ///< 测量名称的过滤条件
+    QJsonArray m_results;           ///< 测量结果
+};
+
+#endif // BENCHMARKRUNNER_H
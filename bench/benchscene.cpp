@@ -0,0 +1,32 @@
+#include "benchscene.h"
+#include "tilecache.h"
+#include <QPainter>
+#include <QtConcurrent>
+
+BenchScene::BenchScene(const QList<Shape *> &shapes)
+{
+    m_document.replaceShapes(shapes);
+}
+
+Document &BenchScene::document()
+{
+    return m_document;
+}
+
+QImage BenchScene::paint(const QRect &viewport)
+{
+    const QList<QPoint> tiles = TileCache::tilesIn(viewport);
+    m_document.prepareRender();
+    const QList<QImage> images = QtConcurrent::blockingMapped<QList<QImage>>(
+                tiles, [this](const QPoint &tile) {
+                    return m_document.renderTile(tile, Qt::white, 1.0);
+                });
+
+    QImage image(viewport.size(), QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    painter.translate(-viewport.topLeft());
+    for (int i = 0; i < tiles.size(); ++i) {
+        painter.drawImage(TileCache::tileRect(tiles[i]).topLeft(), images[i]);
+    }
+    return image;
+}
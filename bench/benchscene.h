@@ -0,0 +1,53 @@
+#ifndef BENCHSCENE_H
+#define BENCHSCENE_H
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include "document.h"
+
+class Shape;
+
+/**
+ * @file benchscene.h
+ * @brief 基准测试场景的头文件
+ *
+ * 这个文件定义了BenchScene类，在不需要窗口的环境中使用编辑器的文档模型。
+ */
+
+/**
+ * @class BenchScene
+ * @brief 不依赖窗口的测试场景
+ *
+ * 命中测试、图层、移动、删除和撤销/重做直接调用DrawingArea使用的Document，
+ * 测量的就是编辑器中运行的代码。这里只补充paint()，对应paintEvent()在瓦片缓存全部失效时的工作。
+ */
+class BenchScene
+{
+public:
+    /**
+     * @brief BenchScene类的构造函数
+     * @param shapes 按图层顺序排列的图形，所有权转移给场景
+     */
+    explicit BenchScene(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 获取场景的文档模型
+     */
+    Document &document();
+
+    /**
+     * @brief 绘制视图中的所有瓦片
+     * @param viewport 视图区域（场景坐标）
+     * @return 视图的图像
+     *
+     * 各瓦片在全局线程池中由Document::renderTile()并行绘制，然后复制到视图图像中，
+     * 与DrawingArea::renderTiles()相同。
+     */
+    QImage paint(const QRect &viewport);
+
+private:
+    Document m_document;   ///< 文档模型
+};
+
+#endif // BENCHSCENE_H
@@ -0,0 +1,210 @@
+#include "benchmarkrunner.h"
+#include "benchscene.h"
+#include "documentio.h"
+#include "scenegenerator.h"
+#include "shape.h"
+
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+
+namespace {
+// 与常见的全屏窗口大小相同
+const QSize kViewportSize(1920, 1080);
+// 每次命中测试运行的点数
+const int kHitTestPoints = 1024;
+
+// 每隔step个图形取一个，模拟用户选择的一部分图形
+QList<Shape *> everyNth(const QList<Shape *> &shapes, int step)
+{
+    QList<Shape *> result;
+    for (int i = 0; i < shapes.size(); i += step) {
+        result.append(shapes.at(i));
+    }
+    return result;
+}
+
+void runScene(BenchmarkRunner &runner, const SceneGenerator::Parameters &parameters, const QString &directory)
+{
+    const int count = parameters.count;
+    BenchScene scene(SceneGenerator::generate(parameters));
+    Document &document = scene.document();
+    const QRectF area = SceneGenerator::sceneRect(parameters);
+
+    // 绘制：视图位于场景中央，瓦片缓存全部失效
+    QRect viewport(QPoint(), kViewportSize);
+    viewport.moveCenter(area.center().toPoint());
+    runner.run("paint_viewport", count, 1, [&scene, viewport]() {
+        scene.paint(viewport);
+    });
+
+    // 命中测试：场景中均匀分布的点
+    QRandomGenerator random(parameters.seed + 1);
+    QVector<QPointF> points;
+    for (int i = 0; i < kHitTestPoints; ++i) {
+        points.append(QPointF(area.left() + area.width() * random.generateDouble(),
+                              area.top() + area.height() * random.generateDouble()));
+    }
+    int hits = 0;
+    runner.run("hit_test", count, points.size(), [&document, &points, &hits]() {
+        for (const QPointF &point : std::as_const(points)) {
+            if (document.shapeAt(point)) ++hits;
+        }
+    });
+
+    // 文件读写：保存的文件同时作为读取的输入
+    for (bool binary : {false, true}) {
+        const QString suffix = binary ? "binary" : "text";
+        const QString path = QString("%1/scene-%2.%3").arg(directory).arg(count).arg(binary ? "qgd" : "txt");
+        const QString saveName = "save_" + suffix;
+        const QString loadName = "load_" + suffix;
+        if (!runner.isSelected(saveName) && !runner.isSelected(loadName)) continue;
+
+        QString error;
+        auto save = [&document, &path, binary, &error]() {
+            DocumentIo::write(path, binary, document.store().snapshot(), &error, nullptr);
+        };
+        runner.run(saveName, count, count, save);
+        if (!QFile::exists(path)) save();
+
+        QList<Shape *> loaded;
+        runner.run(loadName, count, count, [&path, binary, &loaded, &error]() {
+            DocumentIo::read(path, binary, &loaded, &error, nullptr);
+        }, [&loaded]() {
+            qDeleteAll(loaded);
+            loaded.clear();
+        });
+        QFile::remove(path);
+    }
+
+    // 图层：把1%的图形移到最上层
+    const QList<Shape *> layerSelection = everyNth(document.store().shapes(), 100);
+    runner.run("layer_to_top", count, layerSelection.size(), [&document, &layerSelection]() {
+        document.moveShapesToTop(layerSelection);
+    });
+
+    // 撤销和重做：10%的图形一起移动或删除，每次运行撤销一次再重做一次
+    const QList<Shape *> bulkSelection = everyNth(document.store().shapes(), 10);
+    if (runner.isSelected("undo_redo_move")) {
+        document.moveShapes(bulkSelection, QPointF(1, 1));
+        runner.run("undo_redo_move", count, bulkSelection.size() * 2, [&document]() {
+            document.undo();
+            document.redo();
+        });
+    }
+    if (runner.isSelected("undo_redo_delete")) {
+        document.deleteShapes(bulkSelection);
+        runner.run("undo_redo_delete", count, bulkSelection.size() * 2, [&document]() {
+            document.undo();
+            document.redo();
+        });
+    }
+}
+}
+
+int main(int argc, char *argv[])
+{
+    // 只绘制到QImage，不需要窗口系统
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+    QGuiApplication::setApplicationName("qt_graphics_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("在合成场景上测量绘制、命中测试、文件读写、图层操作和撤销/重做的耗时");
+    parser.addHelpOption();
+    const QCommandLineOption sizesOption("sizes", "场景中的图形数量，用逗号分隔（默认1000,100000,1000000）",
+                                         "list", "1000,100000,1000000");
+    const QCommandLineOption outputOption(QStringList{"o", "output"}, "JSON结果文件（默认benchmark.json）",
+                                          "file", "benchmark.json");
+    const QCommandLineOption filterOption("filter", "只运行名称匹配正则表达式的测量", "regex");
+    const QCommandLineOption minTimeOption("min-time", "每项测量的最短累计时间（默认500毫秒）", "ms", "500");
+    const QCommandLineOption seedOption("seed", "随机种子（默认1）", "n", "1");
+    const QCommandLineOption overlapOption("overlap", "重叠度，平面上一点平均被多少个图形覆盖（默认2）",
+                                           "n", "2");
+    const QCommandLineOption minSizeOption("min-size", "图形的最小边长（默认4）", "n", "4");
+    const QCommandLineOption maxSizeOption("max-size", "图形的最大边长（默认64）", "n", "64");
+    const QCommandLineOption filledOption("filled-ratio", "填充图形所占的比例（默认0.5）", "r", "0.5");
+    const QCommandLineOption paletteOption("palette", "颜色种数（默认16）", "n", "16");
+    for (const QCommandLineOption &option : {sizesOption, outputOption, filterOption, minTimeOption, seedOption,
+                                             overlapOption, minSizeOption, maxSizeOption, filledOption,
+                                             paletteOption}) {
+        parser.addOption(option);
+    }
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    QList<int> sizes;
+    for (const QString &text : parser.value(sizesOption).split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const int size = text.trimmed().toInt(&ok);
+        if (!ok || size <= 0) {
+            err << "无效的图形数量：" << text << "\n";
+            return 2;
+        }
+        sizes.append(size);
+    }
+
+    SceneGenerator::Parameters parameters;
+    parameters.seed = parser.value(seedOption).toUInt();
+    parameters.overlap = parser.value(overlapOption).toDouble();
+    parameters.minSize = parser.value(minSizeOption).toDouble();
+    parameters.maxSize = parser.value(maxSizeOption).toDouble();
+    parameters.filledRatio = parser.value(filledOption).toDouble();
+    parameters.paletteSize = parser.value(paletteOption).toInt();
+
+    const QRegularExpression filter(parser.value(filterOption));
+    if (!filter.isValid()) {
+        err << "无效的正则表达式：" << filter.errorString() << "\n";
+        return 2;
+    }
+
+    QTemporaryDir directory;
+    if (!directory.isValid()) {
+        err << "无法创建临时目录\n";
+        return 2;
+    }
+
+    BenchmarkRunner runner(parser.value(minTimeOption).toLongLong(), 3, 1000);
+    runner.setFilter(filter);
+
+    QTextStream out(stdout);
+    out << QString("%1 %2 %3 %4 %5\n").arg("名称", -24).arg("图形数", 9).arg("中位数(ms)", 12)
+           .arg("每个操作(ns)", 14).arg("次数", 6);
+    out.flush();
+    for (int size : std::as_const(sizes)) {
+        parameters.count = size;
+        runScene(runner, parameters, directory.path());
+    }
+
+    QJsonObject root;
+    root["schema_version"] = 1;
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["qt_version"] = QString(qVersion());
+#ifdef QT_NO_DEBUG
+    root["build"] = QString("release");
+#else
+    root["build"] = QString("debug");
+#endif
+    root["threads"] = QThread::idealThreadCount();
+    root["viewport"] = QString("%1x%2").arg(kViewportSize.width()).arg(kViewportSize.height());
+    root["scene"] = SceneGenerator::toJson(parameters);
+    root["results"] = runner.results();
+
+    QFile file(parser.value(outputOption));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || file.write(QJsonDocument(root).toJson(QJsonDocument::Indented)) < 0) {
+        err << "无法写入结果文件：" << file.fileName() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "scenegenerator.h"
+#include "shapefactory.h"
+#include <QColor>
+#include <QRandomGenerator>
+#include <QVector>
+#include <QtMath>
+#include <cmath>
+
+namespace {
+// 对数均匀分布的边长的期望，用于估算场景面积
+double meanSize(double minSize, double maxSize)
+{
+    if (maxSize <= minSize) return minSize;
+    // s = exp(u)，u在[ln(min), ln(max)]上均匀分布
+    return (maxSize - minSize) / std::log(maxSize / minSize);
+}
+}
+
+QList<Shape *> SceneGenerator::generate(const Parameters &parameters)
+{
+    QRandomGenerator random(parameters.seed);
+
+    // 调色板也由种子决定
+    QVector<QColor> palette;
+    for (int i = 0; i < qMax(1, parameters.paletteSize); ++i) {
+        palette.append(QColor::fromRgb(random.bounded(256), random.bounded(256), random.bounded(256)));
+    }
+
+    const QRectF area = sceneRect(parameters);
+    const double minSize = qMax(1.0, parameters.minSize);
+    const double maxSize = qMax(minSize, parameters.maxSize);
+    const double logMin = std::log(minSize);
+    const double logMax = std::log(maxSize);
+
+    QList<Shape *> shapes;
+    shapes.reserve(parameters.count);
+    for (int i = 0; i < parameters.count; ++i) {
+        const bool ellipse = random.generateDouble() < parameters.ellipseRatio;
+        Shape *shape = ShapeFactory::createShape(ellipse ? Shape::Ellipse : Shape::Rectangle);
+        if (!shape) continue;
+
+        const double width = std::exp(logMin + (logMax - logMin) * random.generateDouble());
+        const double height = std::exp(logMin + (logMax - logMin) * random.generateDouble());
+        const double x = area.left() + area.width() * random.generateDouble();
+        const double y = area.top() + area.height() * random.generateDouble();
+        shape->setBoundingRect(QRectF(x, y, width, height));
+
+        shape->setColor(palette.at(random.bounded(palette.size())));
+        shape->setFillColor(palette.at(random.bounded(palette.size())));
+        shape->setFilled(random.generateDouble() < parameters.filledRatio);
+        shape->setLineWidth(1 + random.bounded(qMax(1, parameters.maxLineWidth)));
+        shapes.append(shape);
+    }
+    return shapes;
+}
+
+QRectF SceneGenerator::sceneRect(const Parameters &parameters)
+{
+    const double minSize = qMax(1.0, parameters.minSize);
+    const double maxSize = qMax(minSize, parameters.maxSize);
+    const double overlap = parameters.overlap > 0 ? parameters.overlap : 1.0;
+    // 宽和高相互独立，平均面积为边长期望的平方
+    const double mean = meanSize(minSize, maxSize);
+    const double side = std::sqrt(qMax(1, parameters.count) * mean * mean / overlap);
+    return QRectF(0, 0, side, side);
+}
+
+QJsonObject SceneGenerator::toJson(const Parameters &parameters)
+{
+    QJsonObject object;
+    object["seed"] = qint64(parameters.seed);
+    object["min_size"] = parameters.minSize;
+    object["max_size"] = parameters.maxSize;
+    object["overlap"] = parameters.overlap;
+    object["ellipse_ratio"] = parameters.ellipseRatio;
+    object["filled_ratio"] = parameters.filledRatio;
+    object["palette_size"] = parameters.paletteSize;
+    object["max_line_width"] = parameters.maxLineWidth;
+    return object;
+}
@@ -0,0 +1,65 @@
+#ifndef SCENEGENERATOR_H
+#define SCENEGENERATOR_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QRectF>
+
+class Shape;
+
+/**
+ * @file scenegenerator.h
+ * @brief 合成场景生成器的头文件
+ *
+ * 这个文件定义了SceneGenerator类，按参数生成可重复的随机场景，供基准测试使用。
+ */
+
+/**
+ * @class SceneGenerator
+ * @brief 可重复的合成场景
+ *
+ * 同样的参数和随机种子总是生成完全相同的图形（包括ID以外的所有属性），不同版本的测量结果可以直接比较。
+ * 场景的面积由图形数量、平均大小和重叠度决定：重叠度为平面上一点平均被多少个图形覆盖。
+ */
+class SceneGenerator
+{
+public:
+    /**
+     * @struct Parameters
+     * @brief 场景参数
+     */
+    struct Parameters {
+        int count = 1000;            ///< 图形数量
+        quint32 seed = 1;            ///< 随机种子
+        double minSize = 4.0;        ///< 图形的最小边长
+        double maxSize = 64.0;       ///< 图形的最大边长，边长在两者之间按对数均匀分布
+        double overlap = 2.0;        ///< 重叠度
+        double ellipseRatio = 0.5;   ///< 椭圆所占的比例，其余为矩形
+        double filledRatio = 0.5;    ///< 填充图形所占的比例
+        int paletteSize = 16;        ///< 颜色种数，决定样式表的大小
+        int maxLineWidth = 4;        ///< 最大线宽，线宽在1到这个值之间均匀分布
+    };
+
+    /**
+     * @brief 生成场景
+     * @param parameters 场景参数
+     * @return 按图层顺序排列的图形，由调用者负责释放
+     */
+    static QList<Shape *> generate(const Parameters &parameters);
+
+    /**
+     * @brief 计算场景所在的区域
+     * @param parameters 场景参数
+     * @return 所有图形的左上角都在这个正方形区域内
+     */
+    static QRectF sceneRect(const Parameters &parameters);
+
+    /**
+     * @brief 把参数转换为JSON对象，写入测量结果中
+     * @param parameters 场景参数
+     * @return JSON对象
+     */
+    static QJsonObject toJson(const Parameters &parameters);
+};
+
+#endif // SCENEGENERATOR_H
@@ -0,0 +1,14 @@
+# 链接核心库，供编辑器、命令行工具和基准测试使用
+QT += core gui concurrent
+
+INCLUDEPATH += $$PWD/../src
+DEPENDPATH += $$PWD/../src
+
+CORE_LIB_DIR = $$OUT_PWD/../core
+win32:CONFIG(release, debug|release): CORE_LIB_DIR = $$CORE_LIB_DIR/release
+else:win32:CONFIG(debug, debug|release): CORE_LIB_DIR = $$CORE_LIB_DIR/debug
+
+LIBS += -L$$CORE_LIB_DIR -lqt_graphics_core
+
+win32:!win32-g++: PRE_TARGETDEPS += $$CORE_LIB_DIR/qt_graphics_core.lib
+else: PRE_TARGETDEPS += $$CORE_LIB_DIR/libqt_graphics_core.a
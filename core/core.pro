@@ -0,0 +1,59 @@
+QT       += core gui concurrent
+
+TEMPLATE = lib
+CONFIG += staticlib c++17
+
+# 文档模型、撤销引擎、图形工厂、文件格式、空间索引和渲染，不依赖QtWidgets
+TARGET = qt_graphics_core
+
+SOURCES += \
+    ../src/binaryformat.cpp \
+    ../src/document.cpp \
+    ../src/documentio.cpp \
+    ../src/documentjournal.cpp \
+    ../src/documentrenderer.cpp \
+    ../src/ellipse.cpp \
+    ../src/hittester.cpp \
+    ../src/inputrecorder.cpp \
+    ../src/instrumentation.cpp \
+    ../src/ioprogress.cpp \
+    ../src/pageddocument.cpp \
+    ../src/rectangle.cpp \
+    ../src/shape.cpp \
+    ../src/shapefactory.cpp \
+    ../src/shapepool.cpp \
+    ../src/shapestore.cpp \
+    ../src/spatialindex.cpp \
+    ../src/textformat.cpp \
+    ../src/tilecache.cpp \
+    ../src/tracerecorder.cpp \
+    ../src/undobuffer.cpp \
+    ../src/undohistory.cpp \
+    ../src/undooperation.cpp
+
+HEADERS += \
+    ../src/binaryformat.h \
+    ../src/document.h \
+    ../src/documentio.h \
+    ../src/documentjournal.h \
+    ../src/documentrenderer.h \
+    ../src/ellipse.h \
+    ../src/hittester.h \
+    ../src/inputrecorder.h \
+    ../src/instrumentation.h \
+    ../src/ioprogress.h \
+    ../src/littleendian.h \
+    ../src/pagedcolumn.h \
+    ../src/pageddocument.h \
+    ../src/rectangle.h \
+    ../src/shape.h \
+    ../src/shapefactory.h \
+    ../src/shapepool.h \
+    ../src/shapestore.h \
+    ../src/spatialindex.h \
+    ../src/textformat.h \
+    ../src/tilecache.h \
+    ../src/tracerecorder.h \
+    ../src/undobuffer.h \
+    ../src/undohistory.h \
+    ../src/undooperation.h
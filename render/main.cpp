@@ -0,0 +1,157 @@
+#include "documentrenderer.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QPair>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+namespace {
+typedef QPair<QString, QString> Job;  // 输入文件和输出文件
+
+// 把--input的值展开为文件列表，目录中的文档按文件名排序
+QStringList expandInputs(const QStringList &values)
+{
+    QStringList files;
+    for (const QString &value : values) {
+        const QFileInfo info(value);
+        if (info.isDir()) {
+            const QFileInfoList entries = QDir(value).entryInfoList(
+                        QStringList{"*.txt", "*.qgd", "*.qgp"}, QDir::Files, QDir::Name);
+            for (const QFileInfo &entry : entries) {
+                files.append(entry.filePath());
+            }
+        } else {
+            files.append(value);
+        }
+    }
+    return files;
+}
+
+// 解析"宽x高"或单个数字（正方形）
+bool parseSize(const QString &text, QSize *size)
+{
+    static const QRegularExpression pattern("^(\\d+)(?:[xX](\\d+))?$");
+    const QRegularExpressionMatch match = pattern.match(text);
+    if (!match.hasMatch()) return false;
+
+    const int width = match.captured(1).toInt();
+    const int height = match.captured(2).isEmpty() ? width : match.captured(2).toInt();
+    if (width <= 0 || height <= 0) return false;
+    *size = QSize(width, height);
+    return true;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    // 不需要窗口系统，构建服务器上没有显示器也能运行
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+    QGuiApplication::setApplicationName("qt_graphics_render");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("把图形文件（.txt、.qgd、.qgp）渲染为图像");
+    parser.addHelpOption();
+    const QCommandLineOption inputOption(QStringList{"i", "input"},
+                                         "输入的图形文件或目录，可以指定多次", "path");
+    const QCommandLineOption outputOption(QStringList{"o", "output"},
+                                          "输出的图像文件（只有一个输入时）或目录", "path");
+    const QCommandLineOption sizeOption(QStringList{"s", "size"},
+                                        "图像大小，例如256x256，文档按比例缩放后居中；默认为文档的大小",
+                                        "WxH");
+    const QCommandLineOption scaleOption("scale", "设备像素比，图像的实际像素数为大小乘以这个值（默认1）",
+                                         "factor", "1");
+    const QCommandLineOption jobsOption(QStringList{"j", "jobs"}, "同时渲染的文件数（默认为处理器核数）", "n");
+    parser.addOption(inputOption);
+    parser.addOption(outputOption);
+    parser.addOption(sizeOption);
+    parser.addOption(scaleOption);
+    parser.addOption(jobsOption);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    const QStringList inputs = expandInputs(parser.values(inputOption));
+    const QString output = parser.value(outputOption);
+    if (inputs.isEmpty() || output.isEmpty()) {
+        err << "需要指定--input和--output\n";
+        return 2;
+    }
+
+    DocumentRenderer::Options options;
+    if (parser.isSet(sizeOption) && !parseSize(parser.value(sizeOption), &options.size)) {
+        err << "无效的图像大小：" << parser.value(sizeOption) << "\n";
+        return 2;
+    }
+    bool ok = false;
+    options.scale = parser.value(scaleOption).toDouble(&ok);
+    if (!ok || options.scale <= 0) {
+        err << "无效的缩放比例：" << parser.value(scaleOption) << "\n";
+        return 2;
+    }
+    int jobCount = QThread::idealThreadCount();
+    if (parser.isSet(jobsOption)) {
+        jobCount = parser.value(jobsOption).toInt(&ok);
+        if (!ok || jobCount <= 0) {
+            err << "无效的并行数：" << parser.value(jobsOption) << "\n";
+            return 2;
+        }
+    }
+
+    // 只有一个输入且输出不是已有的目录时，输出就是图像文件；否则每个输入在输出目录中生成同名的PNG
+    QList<Job> jobs;
+    const QFileInfo outputInfo(output);
+    if (inputs.size() == 1 && !outputInfo.isDir() && !outputInfo.suffix().isEmpty()) {
+        jobs.append(Job(inputs.first(), output));
+    } else {
+        const QDir dir(output);
+        if (!dir.mkpath(".")) {
+            err << "无法创建输出目录：" << output << "\n";
+            return 2;
+        }
+        for (const QString &input : inputs) {
+            jobs.append(Job(input, dir.filePath(QFileInfo(input).completeBaseName() + ".png")));
+        }
+    }
+
+    // 文件级的并行使用单独的线程池，文本文档在全局线程池中分段解析，两者不会互相等待
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobCount);
+
+    QElapsedTimer timer;
+    timer.start();
+    QFuture<DocumentRenderer::Result> future = QtConcurrent::mapped(&pool, jobs, [options](const Job &job) {
+        return DocumentRenderer::renderFile(job.first, job.second, options);
+    });
+
+    // 按输入的顺序逐个输出结果，前面的文件完成后立即显示
+    int failures = 0;
+    for (int i = 0; i < jobs.size(); ++i) {
+        const DocumentRenderer::Result result = future.resultAt(i);
+        if (!result.success) {
+            ++failures;
+            err << result.input << "：" << result.errorString << "\n";
+            err.flush();
+            continue;
+        }
+        const QString shapes = result.shapeCount < 0 ? QString("分页文档")
+                                                     : QString("%1 个图形").arg(result.shapeCount);
+        out << QString("%1 -> %2：%3，读取 %4 ms，绘制 %5 ms，写入 %6 ms\n")
+               .arg(result.input, result.output, shapes)
+               .arg(result.loadTime).arg(result.renderTime).arg(result.saveTime);
+        out.flush();
+    }
+    out << QString("共 %1 个文件，失败 %2 个，用时 %3 ms\n").arg(jobs.size()).arg(failures).arg(timer.elapsed());
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,285 @@
+#include "binaryformat.h"
+#include "drawingarea.h"
+#include "inputrecorder.h"
+#include "pageddocument.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QTextStream>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+// 把后台加载的文档放入绘图区域，等待加载完成
+bool loadDocument(DrawingArea *area, const QString &filename, QString *errorString)
+{
+    if (PagedDocument::isPagedFile(filename)) {
+        *errorString = "分页文档不支持重放";
+        return false;
+    }
+
+    bool success = false;
+    QEventLoop loop;
+    QObject::connect(area, &DrawingArea::fileOperationFinished, &loop,
+                     [&loop, &success, errorString](bool ok, const QString &error) {
+                         success = ok;
+                         *errorString = error;
+                         loop.quit();
+                     });
+    if (!area->startLoad(filename, BinaryFormat::isBinaryFile(filename))) {
+        *errorString = "无法开始加载";
+        return false;
+    }
+    loop.exec();
+    return success;
+}
+
+// 已排序的样本的百分位数
+qint64 percentile(const QVector<qint64> &sorted, double p)
+{
+    if (sorted.isEmpty()) return 0;
+    const int rank = qBound(0, int(p / 100.0 * sorted.size() + 0.5) - 1, int(sorted.size()) - 1);
+    return sorted.at(rank);
+}
+
+double toMs(qint64 nsecs)
+{
+    return nsecs / 1e6;
+}
+
+/**
+ * @brief 一次重放的结果
+ */
+struct Run {
+    QVector<qint64> latencies;   ///< 每个事件的延迟（纳秒）
+    qint64 total = 0;            ///< 总时间（纳秒）
+    int finalShapes = 0;         ///< 重放结束时的图形数
+};
+
+// 在新的绘图区域中重放一次。每个事件的延迟包括处理事件和完成由它引起的重绘。
+// 默认全速重放，前一个事件处理完立即送入下一个；paced为true时等到事件录制时的时刻再送入，
+// 总时间包括等待，处理跟不上录制的节奏时不再等待
+bool replayOnce(const QString &document, const QList<InputEvent> &events, bool paced, Run *run,
+                QString *errorString)
+{
+    DrawingArea area;
+    // 全速重放时合并鼠标移动的计时器来不及触发，关闭合并使每个移动都在它自己的事件中处理；
+    // 按录制时间重放时计时器在等待中正常触发，与实际使用时一样合并
+    area.setPointerCoalescing(paced);
+    area.show();
+    if (!document.isEmpty() && !loadDocument(&area, document, errorString)) {
+        return false;
+    }
+    QCoreApplication::processEvents();
+
+    run->latencies.reserve(events.size());
+    QElapsedTimer total;
+    total.start();
+    QElapsedTimer timer;
+    for (const InputEvent &event : events) {
+        const qint64 wait = paced ? event.time * 1000 - total.nsecsElapsed() : 0;
+        if (wait >= 1000000) {
+            QEventLoop loop;
+            QTimer::singleShot(int(wait / 1000000), Qt::PreciseTimer, &loop, &QEventLoop::quit);
+            loop.exec();
+        }
+        timer.start();
+        area.replay(event);
+        QCoreApplication::processEvents();
+        run->latencies.append(timer.nsecsElapsed());
+    }
+    run->total = total.nsecsElapsed();
+    run->finalShapes = area.snapshot().size();
+    return true;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    // 不需要窗口系统，构建服务器上没有显示器也能运行
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    QApplication::setApplicationName("qt_graphics_replay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("把录制的输入（.qgr）送入绘图区域，报告每个事件的延迟和总时间。\n"
+                                     "默认全速重放：不等待录制时的时间间隔，鼠标移动不按帧合并，每个移动事件都单独处理");
+    parser.addHelpOption();
+    parser.addPositionalArgument("session", "输入录制文件");
+    const QCommandLineOption documentOption(QStringList{"d", "document"},
+                                            "起始文档（默认为与录制文件同名的.qgd文件）", "file");
+    const QCommandLineOption repeatOption(QStringList{"r", "repeat"},
+                                          "重放次数，每个事件取各次的中位数（默认1）", "n", "1");
+    const QCommandLineOption outputOption(QStringList{"o", "output"}, "JSON结果文件", "file");
+    const QCommandLineOption slowestOption("slowest", "列出最慢的事件数（默认10）", "n", "10");
+    const QCommandLineOption pacedOption("paced", "按录制时的时间间隔送入事件，鼠标移动按帧合并（默认全速重放）");
+    parser.addOption(documentOption);
+    parser.addOption(repeatOption);
+    parser.addOption(outputOption);
+    parser.addOption(slowestOption);
+    parser.addOption(pacedOption);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    const QStringList positional = parser.positionalArguments();
+    if (positional.size() != 1) {
+        err << "需要指定一个输入录制文件\n";
+        return 2;
+    }
+    const QString session = positional.first();
+
+    QString document = parser.value(documentOption);
+    if (!parser.isSet(documentOption)) {
+        const QFileInfo info(session);
+        const QString candidate = info.dir().filePath(info.completeBaseName() + ".qgd");
+        if (QFile::exists(candidate)) {
+            document = candidate;
+        }
+    }
+
+    bool ok = false;
+    const int repeat = parser.value(repeatOption).toInt(&ok);
+    if (!ok || repeat <= 0) {
+        err << "无效的重放次数：" << parser.value(repeatOption) << "\n";
+        return 2;
+    }
+    const int slowest = parser.value(slowestOption).toInt(&ok);
+    if (!ok || slowest < 0) {
+        err << "无效的事件数：" << parser.value(slowestOption) << "\n";
+        return 2;
+    }
+
+    QList<InputEvent> events;
+    QString error;
+    if (!InputRecorder::read(session, &events, &error)) {
+        err << session << "：" << error << "\n";
+        return 1;
+    }
+
+    const bool paced = parser.isSet(pacedOption);
+    QList<Run> runs;
+    for (int i = 0; i < repeat; ++i) {
+        Run run;
+        if (!replayOnce(document, events, paced, &run, &error)) {
+            err << document << "：" << error << "\n";
+            return 1;
+        }
+        runs.append(run);
+    }
+
+    // 每个事件取各次重放的中位数，减少偶然的抖动
+    QVector<qint64> latencies(events.size());
+    for (int i = 0; i < events.size(); ++i) {
+        QVector<qint64> samples;
+        for (const Run &run : std::as_const(runs)) {
+            samples.append(run.latencies.at(i));
+        }
+        std::sort(samples.begin(), samples.end());
+        latencies[i] = samples.at(samples.size() / 2);
+    }
+    QVector<qint64> totals;
+    for (const Run &run : std::as_const(runs)) {
+        totals.append(run.total);
+    }
+    std::sort(totals.begin(), totals.end());
+    const qint64 total = totals.at(totals.size() / 2);
+
+    // 按事件类型汇总
+    QMap<QString, QVector<qint64>> byType;
+    for (int i = 0; i < events.size(); ++i) {
+        byType[events.at(i).name()].append(latencies.at(i));
+    }
+
+    out << QString("%1 个事件，%2重放 %3 次，总时间 %4 ms，结束时 %5 个图形\n")
+           .arg(events.size()).arg(paced ? "按录制时间" : "全速").arg(repeat).arg(toMs(total), 0, 'f', 1)
+           .arg(runs.first().finalShapes);
+    out << QString("%1 %2 %3 %4 %5 %6\n").arg("类型", -16).arg("次数", 8).arg("总计(ms)", 12)
+           .arg("中位数(ms)", 12).arg("p95(ms)", 10).arg("最大(ms)", 10);
+
+    QJsonArray typeResults;
+    for (auto it = byType.begin(); it != byType.end(); ++it) {
+        QVector<qint64> samples = it.value();
+        std::sort(samples.begin(), samples.end());
+        qint64 sum = 0;
+        for (qint64 sample : std::as_const(samples)) {
+            sum += sample;
+        }
+        out << QString("%1 %2 %3 %4 %5 %6\n").arg(it.key(), -16).arg(samples.size(), 8)
+               .arg(toMs(sum), 12, 'f', 2).arg(toMs(percentile(samples, 50)), 12, 'f', 3)
+               .arg(toMs(percentile(samples, 95)), 10, 'f', 3).arg(toMs(samples.last()), 10, 'f', 3);
+
+        QJsonObject result;
+        result["name"] = it.key();
+        result["count"] = samples.size();
+        result["total_ms"] = toMs(sum);
+        result["median_ms"] = toMs(percentile(samples, 50));
+        result["p95_ms"] = toMs(percentile(samples, 95));
+        result["max_ms"] = toMs(samples.last());
+        typeResults.append(result);
+    }
+
+    QVector<int> order(events.size());
+    for (int i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    const int listed = qMin(slowest, int(order.size()));
+    std::partial_sort(order.begin(), order.begin() + listed, order.end(), [&latencies](int a, int b) {
+        return latencies.at(a) > latencies.at(b);
+    });
+    if (listed > 0) {
+        out << "最慢的事件：\n";
+    }
+    for (int i = 0; i < listed; ++i) {
+        const InputEvent &event = events.at(order.at(i));
+        out << QString("  #%1 录制于 %2 s %3 %4 ms\n").arg(order.at(i)).arg(event.time / 1e6, 0, 'f', 3)
+               .arg(event.name(), -16).arg(toMs(latencies.at(order.at(i))), 0, 'f', 3);
+    }
+    out.flush();
+
+    if (parser.isSet(outputOption)) {
+        QJsonArray runTotals;
+        for (const Run &run : std::as_const(runs)) {
+            runTotals.append(toMs(run.total));
+        }
+        QJsonArray eventLatencies;
+        for (qint64 latency : std::as_const(latencies)) {
+            eventLatencies.append(latency / 1000);
+        }
+
+        QJsonObject root;
+        root["schema_version"] = 1;
+        root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+        root["qt_version"] = QString(qVersion());
+        root["session"] = session;
+        root["document"] = document;
+        root["events"] = int(events.size());
+        root["runs"] = repeat;
+        root["paced"] = paced;
+        root["total_ms"] = toMs(total);
+        root["run_totals_ms"] = runTotals;
+        root["final_shapes"] = runs.first().finalShapes;
+        root["by_type"] = typeResults;
+        root["latencies_us"] = eventLatencies;
+
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || file.write(QJsonDocument(root).toJson(QJsonDocument::Indented)) < 0) {
+            err << "无法写入结果文件：" << file.fileName() << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
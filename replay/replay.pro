@@ -0,0 +1,17 @@
+QT       += core gui concurrent widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# 输入重放工具：把录制的输入送入编辑器的绘图区域，在没有显示器的环境中测量延迟
+TARGET = qt_graphics_replay
+
+include(../widgets/widgets.pri)
+
+SOURCES += \
+    main.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
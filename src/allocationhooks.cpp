@@ -0,0 +1,57 @@
+#include "instrumentation.h"
+#include <cstdlib>
+#include <new>
+
+// 替换全局的operator new，统计每帧的内存分配次数（见Instrumentation::Allocations）。
+// 只链接到编辑器中；Qt容器通过malloc分配的内存不经过这里，不计入统计。
+
+void *operator new(std::size_t size)
+{
+    Instrumentation::countAllocation();
+    if (size == 0) size = 1;
+    while (true) {
+        if (void *p = std::malloc(size)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
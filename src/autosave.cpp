@@ -0,0 +1,146 @@
+#include "autosave.h"
+#include "drawingarea.h"
+#include "binaryformat.h"
+#include "tracerecorder.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+namespace {
+// 默认的自动保存间隔（分钟）
+const int kDefaultInterval = 2;
+
+QString lockPathOf(const QString &path)
+{
+    return path + ".lock";
+}
+}
+
+Autosave::Autosave(DrawingArea *drawingArea, QObject *parent)
+    : QObject(parent),
+      m_drawingArea(drawingArea),
+      m_interval(0),
+      m_savedRevision(drawingArea->revision()),
+      m_pendingRevision(0)
+{
+    const QDir dir(recoveryDirectory());
+    if (dir.mkpath(".")) {
+        m_path = dir.filePath(QString("autosave-%1.qgd").arg(QCoreApplication::applicationPid()));
+        m_lock.reset(new QLockFile(lockPathOf(m_path)));
+        // 锁在程序运行期间一直持有，只有进程不存在时才算失效
+        m_lock->setStaleLockTime(0);
+        if (!m_lock->tryLock(0)) {
+            m_lock.reset();
+            m_path.clear();
+        }
+    }
+
+    connect(&m_timer, &QTimer::timeout, this, &Autosave::autosaveNow);
+    connect(&m_watcher, &QFutureWatcher<bool>::finished, this, &Autosave::finishAutosave);
+    setInterval(kDefaultInterval);
+}
+
+Autosave::~Autosave()
+{
+    m_timer.stop();
+    m_watcher.waitForFinished();
+
+    // 正常退出时不留下恢复文件
+    if (!m_path.isEmpty()) {
+        QFile::remove(m_path);
+        m_lock->unlock();
+    }
+}
+
+void Autosave::setInterval(int minutes)
+{
+    m_interval = qMax(0, minutes);
+    if (m_interval == 0) {
+        m_timer.stop();
+    } else {
+        m_timer.start(m_interval * 60 * 1000);
+    }
+}
+
+int Autosave::interval() const
+{
+    return m_interval;
+}
+
+QStringList Autosave::recoverableFiles()
+{
+    QStringList files;
+    const QDir dir(recoveryDirectory());
+    const QFileInfoList entries = dir.entryInfoList(QStringList{"autosave-*.qgd"}, QDir::Files, QDir::Time);
+    for (const QFileInfo &entry : entries) {
+        // 能拿到锁说明写入这个文件的程序已经退出
+        QLockFile lock(lockPathOf(entry.absoluteFilePath()));
+        lock.setStaleLockTime(0);
+        if (lock.tryLock(0)) {
+            lock.unlock();
+            files.append(entry.absoluteFilePath());
+        }
+    }
+    return files;
+}
+
+void Autosave::removeRecoveryFile(const QString &path)
+{
+    QFile::remove(path);
+    QFile::remove(lockPathOf(path));
+}
+
+void Autosave::autosaveNow()
+{
+    if (m_path.isEmpty() || m_watcher.isRunning()) return;
+
+    const quint64 revision = m_drawingArea->revision();
+    if (revision == m_savedRevision) return;
+
+    // 文档已经保存过，恢复文件不再需要；分页文档的大部分图形只在原文件中，恢复文件无法代替它
+    if (!m_drawingArea->isModified() || m_drawingArea->isPagedDocument()) {
+        QFile::remove(m_path);
+        m_savedRevision = revision;
+        return;
+    }
+
+    // 快照只复制页指针，GUI线程的开销与文档大小无关
+    m_pendingRevision = revision;
+    const ShapeStore::Snapshot snapshot = m_drawingArea->snapshot();
+    const QString path = m_path;
+    m_watcher.setFuture(QtConcurrent::run([path, snapshot]() {
+        TraceScope trace("Autosave", "worker");
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+        if (!BinaryFormat::write(&file, snapshot)) {
+            file.cancelWriting();
+            return false;
+        }
+        return file.commit();
+    }));
+}
+
+void Autosave::finishAutosave()
+{
+    const bool success = m_watcher.result();
+    if (success) {
+        m_savedRevision = m_pendingRevision;
+    }
+    emit autosaved(success);
+}
+
+QString Autosave::recoveryDirectory()
+{
+    QString location = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    if (location.isEmpty()) {
+        location = QDir::tempPath();
+    }
+    return QDir(location).filePath("recovery");
+}
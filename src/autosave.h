@@ -0,0 +1,112 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTimer>
+
+class DrawingArea;
+class QLockFile;
+
+/**
+ * @file autosave.h
+ * @brief 自动保存类的头文件
+ *
+ * 这个文件定义了Autosave类，定期在后台把文档写入恢复文件，并在启动时查找上次崩溃留下的恢复文件。
+ */
+
+/**
+ * @class Autosave
+ * @brief 自动保存和崩溃恢复
+ *
+ * 每个运行中的程序在恢复目录中拥有一个以进程号命名的恢复文件（二进制格式）和一个锁文件。
+ * 正常退出时两者都被删除；程序崩溃后锁文件失效，下次启动时recoverableFiles()会找到遗留的恢复文件。
+ *
+ * 定时器触发时，如果文档的修订号变化，就创建文档快照并在全局线程池中写入恢复文件。
+ * GUI线程只复制快照的页指针，写入期间可以继续编辑，被修改的页才会复制。
+ * 分页文档（见PagedDocument）不自动保存。
+ */
+class Autosave : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Autosave类的构造函数
+     * @param drawingArea 需要自动保存的绘图区域
+     * @param parent 父对象
+     *
+     * 默认每2分钟保存一次。
+     */
+    explicit Autosave(DrawingArea *drawingArea, QObject *parent = nullptr);
+
+    /**
+     * @brief Autosave类的析构函数
+     *
+     * 等待正在进行的写入结束，然后删除恢复文件，表示程序正常退出。
+     */
+    ~Autosave() override;
+
+    /**
+     * @brief 设置自动保存的间隔
+     * @param minutes 分钟数，0表示关闭自动保存
+     */
+    void setInterval(int minutes);
+
+    /**
+     * @brief 获取自动保存的间隔
+     * @return 分钟数，0表示关闭自动保存
+     */
+    int interval() const;
+
+    /**
+     * @brief 查找已经退出的程序遗留的恢复文件
+     * @return 恢复文件的路径，最近修改的排在最前面
+     */
+    static QStringList recoverableFiles();
+
+    /**
+     * @brief 删除遗留的恢复文件及其锁文件
+     * @param path 恢复文件的路径
+     */
+    static void removeRecoveryFile(const QString &path);
+
+public slots:
+    /**
+     * @brief 文档有变化时立即开始一次自动保存
+     *
+     * 上一次自动保存还没有结束时什么也不做。
+     */
+    void autosaveNow();
+
+signals:
+    /**
+     * @brief 一次自动保存结束时发出的信号
+     * @param success 是否成功
+     */
+    void autosaved(bool success);
+
+private:
+    /**
+     * @brief 后台写入结束时在GUI线程中调用
+     */
+    void finishAutosave();
+
+    /**
+     * @brief 获取恢复文件所在的目录
+     */
+    static QString recoveryDirectory();
+
+    DrawingArea *m_drawingArea;            ///< 需要自动保存的绘图区域
+    QTimer m_timer;                        ///< 自动保存定时器
+    QFutureWatcher<bool> m_watcher;        ///< 监视后台写入
+    QScopedPointer<QLockFile> m_lock;      ///< 表示恢复文件属于正在运行的程序
+    QString m_path;                        ///< 本程序的恢复文件
+    int m_interval;                        ///< 自动保存的间隔（分钟）
+    quint64 m_savedRevision;               ///< 恢复文件中的文档修订号
+    quint64 m_pendingRevision;             ///< 正在写入的文档修订号
+};
+
+#endif // AUTOSAVE_H
@@ -0,0 +1,239 @@
+#include "binaryformat.h"
+#include "littleendian.h"
+#include "shapefactory.h"
+#include "ioprogress.h"
+#include <QFile>
+#include <cstring>
+
+namespace {
+// 第一个字节不是ASCII字符，\r\n和\x1a可以发现以文本方式传输造成的损坏
+const char kMagic[8] = { '\x89', 'Q', 'G', 'D', '\r', '\n', '\x1a', '\n' };
+
+const int kFileHeaderSize = 32;
+const int kChunkHeaderSize = 16;
+const int kStyleRecordSize = 16;
+const int kShapeRecordSize = 48;
+
+// 每个图形块最多包含的记录数，写入时不必一次性在内存中拼出整个文件
+const int kShapesPerChunk = 65536;
+
+const quint32 kStyleChunk = 0x4c595453;  // "STYL"
+const quint32 kShapeChunk = 0x50414853;  // "SHAP"
+
+const quint8 kFilledFlag = 0x1;
+
+bool writeChunk(QIODevice *device, quint32 tag, int recordSize, const QByteArray &records)
+{
+    char header[kChunkHeaderSize];
+    putU32(header, tag);
+    putU32(header + 4, quint32(recordSize));
+    putU64(header + 8, quint64(records.size() / recordSize));
+
+    const qint64 padding = paddedSize(records.size()) - records.size();
+    static const char zeros[8] = {};
+    return device->write(header, kChunkHeaderSize) == kChunkHeaderSize
+            && device->write(records) == records.size()
+            && (padding == 0 || device->write(zeros, padding) == padding);
+}
+
+bool fail(QString *errorString, const QString &message)
+{
+    if (errorString) *errorString = message;
+    return false;
+}
+
+bool canceled(const IoProgress *progress)
+{
+    return progress && progress->isCanceled();
+}
+}
+
+bool BinaryFormat::hasMagic(const char *data, qint64 size)
+{
+    return size >= qint64(sizeof(kMagic)) && std::memcmp(data, kMagic, sizeof(kMagic)) == 0;
+}
+
+bool BinaryFormat::isBinaryFile(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray head = file.read(sizeof(kMagic));
+    return hasMagic(head.constData(), head.size());
+}
+
+quint64 BinaryFormat::generationOf(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const QByteArray head = file.read(kFileHeaderSize);
+    if (head.size() < kFileHeaderSize || !hasMagic(head.constData(), head.size())) {
+        return 0;
+    }
+    return getU64(reinterpret_cast<const uchar *>(head.constData()) + 24);
+}
+
+bool BinaryFormat::write(QIODevice *device, const ShapeStore::Snapshot &snapshot,
+                         QString *errorString, IoProgress *progress, quint64 generation)
+{
+    const int shapeCount = snapshot.size();
+    const QVector<ShapeStore::Style> &styles = snapshot.styles;
+    if (progress) progress->setTotal(shapeCount);
+    const int shapeChunks = (shapeCount + kShapesPerChunk - 1) / kShapesPerChunk;
+
+    char header[kFileHeaderSize] = {};
+    std::memcpy(header, kMagic, sizeof(kMagic));
+    putU16(header + 8, MajorVersion);
+    putU16(header + 10, MinorVersion);
+    putU32(header + 12, quint32(1 + shapeChunks));
+    putU64(header + 16, quint64(shapeCount));
+    putU64(header + 24, generation);
+    if (device->write(header, kFileHeaderSize) != kFileHeaderSize) {
+        return fail(errorString, device->errorString());
+    }
+
+    // 样式表直接取自图形存储，图形记录中保存的就是存储里的样式表下标
+    QByteArray records(styles.size() * kStyleRecordSize, '\0');
+    char *out = records.data();
+    for (const ShapeStore::Style &style : styles) {
+        putU32(out, style.color);
+        putU32(out + 4, style.fillColor);
+        putU32(out + 8, quint32(style.lineWidth));
+        out += kStyleRecordSize;
+    }
+    if (!writeChunk(device, kStyleChunk, kStyleRecordSize, records)) {
+        return fail(errorString, device->errorString());
+    }
+
+    for (int first = 0; first < shapeCount; first += kShapesPerChunk) {
+        if (canceled(progress)) {
+            return fail(errorString, "操作已取消");
+        }
+
+        const int last = qMin(first + kShapesPerChunk, shapeCount);
+        records.fill('\0', (last - first) * kShapeRecordSize);
+        out = records.data();
+        for (int row = first; row < last; ++row) {
+            const ShapeStore::Record &record = snapshot.records.at(row);
+            const QRectF &rect = record.rect;
+            out[0] = char(record.type);
+            out[1] = char((record.flags & ShapeStore::Filled) ? kFilledFlag : 0);
+            putU32(out + 4, record.styleIndex);
+            putU32(out + 8, quint32(record.id));
+            putF64(out + 16, rect.x());
+            putF64(out + 24, rect.y());
+            putF64(out + 32, rect.width());
+            putF64(out + 40, rect.height());
+            out += kShapeRecordSize;
+        }
+        if (!writeChunk(device, kShapeChunk, kShapeRecordSize, records)) {
+            return fail(errorString, device->errorString());
+        }
+        if (progress) progress->add(last - first);
+    }
+    return true;
+}
+
+bool BinaryFormat::read(const QString &filename, QList<Shape *> *shapes, QString *errorString,
+                        IoProgress *progress)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(errorString, file.errorString());
+    }
+
+    // 映射失败时（例如某些网络文件系统）退回到一次性读入
+    const qint64 size = file.size();
+    if (uchar *data = file.map(0, size)) {
+        const bool ok = read(data, size, shapes, errorString, progress);
+        file.unmap(data);
+        return ok;
+    }
+    const QByteArray bytes = file.readAll();
+    return read(reinterpret_cast<const uchar *>(bytes.constData()), bytes.size(), shapes, errorString,
+                progress);
+}
+
+bool BinaryFormat::read(const uchar *data, qint64 size, QList<Shape *> *shapes, QString *errorString,
+                        IoProgress *progress)
+{
+    if (size < kFileHeaderSize || !hasMagic(reinterpret_cast<const char *>(data), size)) {
+        return fail(errorString, "不是有效的二进制图形文件");
+    }
+    if (getU16(data + 8) != MajorVersion) {
+        return fail(errorString, QString("不支持的文件版本 %1").arg(getU16(data + 8)));
+    }
+
+    const quint32 chunkCount = getU32(data + 12);
+    const quint64 shapeCount = getU64(data + 16);
+    if (progress) progress->setTotal(qint64(shapeCount));
+
+    QVector<ShapeStore::Style> styles;
+    QList<Shape *> loaded;
+    // 文件头中的数量只用于预分配，防止损坏的文件申请过多内存
+    loaded.reserve(int(qMin<quint64>(shapeCount, quint64(size / kShapeRecordSize))));
+
+    qint64 pos = kFileHeaderSize;
+    for (quint32 chunk = 0; chunk < chunkCount; ++chunk) {
+        if (size - pos < kChunkHeaderSize) {
+            qDeleteAll(loaded);
+            return fail(errorString, "文件不完整");
+        }
+        const quint32 tag = getU32(data + pos);
+        const quint32 recordSize = getU32(data + pos + 4);
+        const quint64 recordCount = getU64(data + pos + 8);
+        pos += kChunkHeaderSize;
+
+        if (recordSize == 0 || recordCount > quint64(size - pos) / recordSize) {
+            qDeleteAll(loaded);
+            return fail(errorString, "文件不完整");
+        }
+        const uchar *record = data + pos;
+        pos += paddedSize(qint64(recordSize * recordCount));
+
+        if (tag == kStyleChunk && recordSize >= quint32(kStyleRecordSize)) {
+            styles.resize(int(recordCount));
+            for (ShapeStore::Style &style : styles) {
+                style.color = getU32(record);
+                style.fillColor = getU32(record + 4);
+                style.lineWidth = int(getU32(record + 8));
+                record += recordSize;
+            }
+        } else if (tag == kShapeChunk && recordSize >= quint32(kShapeRecordSize)) {
+            if (canceled(progress)) {
+                qDeleteAll(loaded);
+                return fail(errorString, "操作已取消");
+            }
+            Shape::IdBatch ids;
+            for (quint64 i = 0; i < recordCount; ++i, record += recordSize) {
+                const quint32 styleIndex = getU32(record + 4);
+                if (styleIndex >= quint32(styles.size())) {
+                    qDeleteAll(loaded);
+                    return fail(errorString, "图形引用了不存在的样式");
+                }
+
+                // 未知的图形类型来自更新的版本，跳过
+                Shape *shape = ShapeFactory::createShape(Shape::ShapeType(record[0]));
+                if (!shape) continue;
+
+                const ShapeStore::Style &style = styles.at(int(styleIndex));
+                shape->setId(int(getU32(record + 8)));
+                shape->setBoundingRect(QRectF(getF64(record + 16), getF64(record + 24),
+                                              getF64(record + 32), getF64(record + 40)));
+                shape->setColor(QColor::fromRgba(style.color));
+                shape->setFillColor(QColor::fromRgba(style.fillColor));
+                shape->setLineWidth(style.lineWidth);
+                shape->setFilled(record[1] & kFilledFlag);
+                loaded.append(shape);
+            }
+            if (progress) progress->add(qint64(recordCount));
+        }
+        // 其他块来自更新的次版本，跳过
+    }
+
+    shapes->append(loaded);
+    return true;
+}
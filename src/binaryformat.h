@@ -0,0 +1,106 @@
+#ifndef BINARYFORMAT_H
+#define BINARYFORMAT_H
+
+#include <QList>
+#include <QString>
+#include "shapestore.h"
+
+class QIODevice;
+class IoProgress;
+class Shape;
+
+/**
+ * @file binaryformat.h
+ * @brief 二进制文档格式的头文件
+ *
+ * 这个文件定义了BinaryFormat类，读写带版本号的分块二进制文档。
+ *
+ * 文件结构（所有整数均为小端序）：
+ * - 文件头（32字节）：8字节魔数、主版本号、次版本号、块数量、图形总数、文档代号
+ * - 若干个块，每块以16字节的块头开始：4字节标记、记录大小、记录数量，
+ *   随后是定长记录，整个块补齐到8字节边界
+ *   - "STYL"：样式表，每条记录为线条颜色、填充颜色和线宽
+ *   - "SHAP"：图形，每条记录为类型、标志位、样式表下标、ID和边界矩形
+ *
+ * 记录大小写在块头中，次版本可以在记录末尾追加字段，旧的读取器会跳过不认识的字段；
+ * 不认识的块整体跳过。主版本号不同表示不兼容的修改。
+ *
+ * 文档代号（1.1版加入）在每次完整写入时随机生成，修改日志（见DocumentJournal）据此判断
+ * 自己是否属于这个文档。1.0版的文件中这个字段为0。
+ */
+
+/**
+ * @class BinaryFormat
+ * @brief 二进制文档的读写
+ *
+ * 读取时用QFile::map把整个文件映射到内存，直接从映射的字节中取出定长记录，
+ * 不需要逐行分割和解析文本。文本格式仍然保留，用于和其他工具交换数据。
+ *
+ * 读写都可以在后台线程中进行，通过IoProgress报告进度和响应取消。
+ */
+class BinaryFormat
+{
+public:
+    static const quint16 MajorVersion = 1;  ///< 主版本号
+    static const quint16 MinorVersion = 1;  ///< 次版本号
+
+    /**
+     * @brief 判断数据是否以二进制文档的魔数开头
+     * @param data 文件开头的数据
+     * @param size 数据长度
+     * @return 如果是二进制文档，返回true
+     */
+    static bool hasMagic(const char *data, qint64 size);
+
+    /**
+     * @brief 判断文件是否是二进制文档
+     * @param filename 文件名
+     * @return 如果文件以二进制文档的魔数开头，返回true
+     */
+    static bool isBinaryFile(const QString &filename);
+
+    /**
+     * @brief 读取文件头中的文档代号
+     * @param filename 文件名
+     * @return 文档代号，文件无效或没有代号时返回0
+     */
+    static quint64 generationOf(const QString &filename);
+
+    /**
+     * @brief 把快照中的所有图形写入设备
+     * @param device 已打开的输出设备
+     * @param snapshot 文档快照
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @param progress 进度（按图形计），可以为nullptr
+     * @param generation 写入文件头的文档代号
+     * @return 写入成功且未被取消时返回true
+     */
+    static bool write(QIODevice *device, const ShapeStore::Snapshot &snapshot,
+                      QString *errorString = nullptr, IoProgress *progress = nullptr,
+                      quint64 generation = 0);
+
+    /**
+     * @brief 从文件读取所有图形
+     * @param filename 文件名
+     * @param shapes 读取的图形按图层顺序追加到这里，由调用者负责释放
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @param progress 进度（按图形计），可以为nullptr
+     * @return 读取成功且未被取消时返回true，失败时不会追加任何图形
+     */
+    static bool read(const QString &filename, QList<Shape *> *shapes, QString *errorString = nullptr,
+                     IoProgress *progress = nullptr);
+
+    /**
+     * @brief 从内存中的文档数据读取所有图形
+     * @param data 文档数据
+     * @param size 数据长度
+     * @param shapes 读取的图形按图层顺序追加到这里，由调用者负责释放
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @param progress 进度（按图形计），可以为nullptr
+     * @return 读取成功且未被取消时返回true，失败时不会追加任何图形
+     */
+    static bool read(const uchar *data, qint64 size, QList<Shape *> *shapes, QString *errorString = nullptr,
+                     IoProgress *progress = nullptr);
+};
+
+#endif // BINARYFORMAT_H
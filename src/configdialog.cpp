@@ -6,8 +6,7 @@ ConfigDialog::ConfigDialog(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::ConfigDialog),
     m_color(Qt::black),
-    m_fillColor(Qt::white),
-    m_maxUndoSteps(50)
+    m_fillColor(Qt::white)
 {
     ui->setupUi(this);
 
@@ -15,9 +14,19 @@ ConfigDialog::ConfigDialog(QWidget *parent) :
     ui->lineWidthSpinBox->setRange(1, 20);
     ui->lineWidthSpinBox->setValue(2);
     
-    // 设置最大撤销步数的默认值
-    ui->maxUndoStepsSpinBox->setRange(1, 1000);
-    ui->maxUndoStepsSpinBox->setValue(50);
+    // 设置撤销历史内存上限的默认值
+    ui->undoMemorySpinBox->setRange(1, 4096);
+    ui->undoMemorySpinBox->setValue(64);
+    ui->undoSpillCheckBox->setChecked(false);
+    ui->journalCheckBox->setChecked(false);
+
+    // 设置自动保存间隔的默认值，0表示关闭
+    ui->autosaveSpinBox->setRange(0, 60);
+    ui->autosaveSpinBox->setValue(2);
+
+    // 设置分页文档页缓存容量的默认值
+    ui->pageCacheSpinBox->setRange(16, 16384);
+    ui->pageCacheSpinBox->setValue(256);
 
     // 更新颜色按钮显示
     on_colorButton_clicked();
@@ -51,16 +60,58 @@ int ConfigDialog::getLineWidth() const
     return ui->lineWidthSpinBox->value();
 }
 
-// 最大撤销步数设置
-void ConfigDialog::setMaxUndoSteps(int steps)
+// 撤销历史内存上限设置
+void ConfigDialog::setUndoMemoryLimit(int megabytes)
+{
+    ui->undoMemorySpinBox->setValue(megabytes);
+}
+
+int ConfigDialog::getUndoMemoryLimit() const
+{
+    return ui->undoMemorySpinBox->value();
+}
+
+void ConfigDialog::setUndoSpillEnabled(bool enabled)
+{
+    ui->undoSpillCheckBox->setChecked(enabled);
+}
+
+bool ConfigDialog::isUndoSpillEnabled() const
+{
+    return ui->undoSpillCheckBox->isChecked();
+}
+
+// 增量保存设置
+void ConfigDialog::setJournaledSaveEnabled(bool enabled)
+{
+    ui->journalCheckBox->setChecked(enabled);
+}
+
+bool ConfigDialog::isJournaledSaveEnabled() const
+{
+    return ui->journalCheckBox->isChecked();
+}
+
+// 自动保存设置
+void ConfigDialog::setAutosaveInterval(int minutes)
+{
+    ui->autosaveSpinBox->setValue(minutes);
+}
+
+int ConfigDialog::getAutosaveInterval() const
+{
+    return ui->autosaveSpinBox->value();
+}
+
+// 分页文档缓存设置
+void ConfigDialog::setPageCacheLimit(int megabytes)
 {
-    m_maxUndoSteps = steps;
-    ui->maxUndoStepsSpinBox->setValue(steps);
+    ui->pageCacheSpinBox->setValue(megabytes);
 }
 
-int ConfigDialog::getMaxUndoSteps() const
+int ConfigDialog::getPageCacheLimit() const
 {
-    return ui->maxUndoStepsSpinBox->value();
+    return ui->pageCacheSpinBox->value();
 }
 
 void ConfigDialog::setFilled(bool filled)
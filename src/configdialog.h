@@ -68,16 +68,64 @@ public:
     int getLineWidth() const;
 
     /**
-     * @brief 设置最大撤销步数
-     * @param steps 最大撤销步数
+     * @brief 设置撤销历史的内存上限
+     * @param megabytes 内存上限（MB）
      */
-    void setMaxUndoSteps(int steps);
+    void setUndoMemoryLimit(int megabytes);
     
     /**
-     * @brief 获取最大撤销步数
-     * @return 当前最大撤销步数
+     * @brief 获取撤销历史的内存上限
+     * @return 当前内存上限（MB）
      */
-    int getMaxUndoSteps() const;
+    int getUndoMemoryLimit() const;
+
+    /**
+     * @brief 设置是否把超出上限的撤销历史写入临时文件
+     * @param enabled 是否写入临时文件
+     */
+    void setUndoSpillEnabled(bool enabled);
+
+    /**
+     * @brief 获取是否把超出上限的撤销历史写入临时文件
+     * @return 当前是否写入临时文件
+     */
+    bool isUndoSpillEnabled() const;
+
+    /**
+     * @brief 设置是否以追加修改日志的方式保存二进制文档
+     * @param enabled 是否启用
+     */
+    void setJournaledSaveEnabled(bool enabled);
+
+    /**
+     * @brief 判断是否以追加修改日志的方式保存二进制文档
+     * @return 如果启用，返回true
+     */
+    bool isJournaledSaveEnabled() const;
+
+    /**
+     * @brief 设置自动保存的间隔
+     * @param minutes 分钟数，0表示关闭自动保存
+     */
+    void setAutosaveInterval(int minutes);
+
+    /**
+     * @brief 获取自动保存的间隔
+     * @return 分钟数，0表示关闭自动保存
+     */
+    int getAutosaveInterval() const;
+
+    /**
+     * @brief 设置分页文档的页缓存容量
+     * @param megabytes 容量（MB）
+     */
+    void setPageCacheLimit(int megabytes);
+
+    /**
+     * @brief 获取分页文档的页缓存容量
+     * @return 容量（MB）
+     */
+    int getPageCacheLimit() const;
 
     /**
      * @brief 设置是否填充
@@ -122,7 +170,6 @@ private:
     Ui::ConfigDialog *ui;        ///< UI对象，由Qt Designer生成
     QColor m_color;              ///< 当前线条颜色
     QColor m_fillColor;          ///< 当前填充颜色
-    int m_maxUndoSteps;          ///< 最大撤销步数
 };
 
 #endif // CONFIGDIALOG_H
\ No newline at end of file
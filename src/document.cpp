@@ -0,0 +1,760 @@
+#include "document.h"
+#include "hittester.h"
+#include "instrumentation.h"
+#include "tilecache.h"
+#include "tracerecorder.h"
+#include <QPainter>
+#include <QtMath>
+#include <algorithm>
+
+Document::Document(Instrumentation *instrumentation)
+    : m_transactionDepth(0),
+      m_instrumentation(instrumentation)
+{
+    m_history.setReleaseHandler([this](const Transaction &transaction, bool undone) {
+        releaseTransaction(transaction, undone);
+    });
+}
+
+Document::~Document()
+{
+    clear();
+}
+
+const ShapeStore &Document::store() const
+{
+    return m_store;
+}
+
+UndoHistory &Document::history()
+{
+    return m_history;
+}
+
+const UndoHistory &Document::history() const
+{
+    return m_history;
+}
+
+PagedDocument &Document::pagedDocument()
+{
+    return m_pagedDocument;
+}
+
+const PagedDocument &Document::pagedDocument() const
+{
+    return m_pagedDocument;
+}
+
+void Document::setChangeTracking(bool enabled)
+{
+    m_store.setChangeTracking(enabled);
+}
+
+ShapeStore::Changes Document::takeChanges()
+{
+    return m_store.takeChanges();
+}
+
+void Document::clear()
+{
+    // 先清空撤销/重做栈，释放只被事务引用的图形，包括已经写入临时文件的历史
+    m_history.clear();
+    m_pendingTransaction = Transaction();
+    m_transactionDepth = 0;
+
+    releasePagedCopies();
+    m_pagedZ.clear();
+    qDeleteAll(m_store.shapes());
+    m_store.clear();
+    m_spatialIndex.clear();
+    m_pagedDocument.close();
+}
+
+void Document::replaceShapes(const QList<Shape *> &shapes)
+{
+    clear();
+
+    m_store.reserve(shapes.size());
+    for (Shape *shape : shapes) {
+        m_store.append(shape);
+        syncShape(shape);
+    }
+}
+
+bool Document::contains(const Shape *shape) const
+{
+    return m_store.contains(shape) || m_pagedCopies.contains(const_cast<Shape *>(shape));
+}
+
+void Document::syncShape(Shape *shape)
+{
+    // 副本不在存储中，不能加入空间索引
+    if (!shape || m_pagedCopies.contains(shape)) return;
+
+    m_store.sync(shape);
+    m_spatialIndex.update(shape, shape->getStrokeBounds());
+}
+
+void Document::sortByZOrder(QList<Shape *> &shapes, bool topmostFirst) const
+{
+    // 分页图层在下（第一项为0），图层内按层序号排列；其他图形按行号排列
+    typedef QPair<int, qint64> Key;
+    QList<QPair<Key, Shape *>> ordered;
+    ordered.reserve(shapes.size());
+    for (Shape *shape : shapes) {
+        const auto copy = m_pagedCopies.constFind(shape);
+        if (copy != m_pagedCopies.constEnd()) {
+            ordered.append(qMakePair(Key(0, copy.value()), shape));
+            continue;
+        }
+        int row = m_store.indexOf(shape);
+        if (row >= 0) {
+            const auto taken = m_pagedZ.constFind(shape);
+            ordered.append(qMakePair(taken != m_pagedZ.constEnd() ? Key(0, taken.value()) : Key(1, row), shape));
+        }
+    }
+    std::sort(ordered.begin(), ordered.end(),
+              [topmostFirst](const QPair<Key, Shape *> &a, const QPair<Key, Shape *> &b) {
+                  return topmostFirst ? a.first > b.first : a.first < b.first;
+              });
+
+    shapes.clear();
+    for (const auto &entry : ordered) {
+        shapes.append(entry.second);
+    }
+}
+
+QVector<int> Document::rowsOf(const QList<Shape *> &shapes) const
+{
+    QVector<int> rows;
+    rows.reserve(shapes.size());
+    for (const Shape *shape : shapes) {
+        int row = m_store.indexOf(shape);
+        if (row >= 0) {
+            rows.append(row);
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+Shape *Document::shapeAt(const QPointF &pos) const
+{
+    ScopedTimer timer(m_instrumentation, Instrumentation::HitTestTime);
+
+    // 空间索引给出候选图形，再用存储中的边界数组批量测试
+    QVector<int> rows = rowsOf(m_spatialIndex.query(pos));
+    if (!m_pagedZ.isEmpty()) {
+        // 取出的图形在分页图层中，与页中的图形一起由pagedShapeAt()测试
+        rows.erase(std::remove_if(rows.begin(), rows.end(),
+                                  [this](int row) { return m_pagedZ.contains(m_store.at(row)); }),
+                   rows.end());
+    }
+    if (m_instrumentation) {
+        m_instrumentation->add(Instrumentation::HitTests);
+        m_instrumentation->add(Instrumentation::HitCandidates, rows.size());
+    }
+    int row = HitTester::topmost(m_store, rows, pos);
+    return row >= 0 ? m_store.at(row) : nullptr;
+}
+
+QList<Shape *> Document::shapesAt(const QPointF &pos) const
+{
+    const QVector<int> rows = HitTester::allHits(m_store, rowsOf(m_spatialIndex.query(pos)), pos);
+    QList<Shape *> result;
+    result.reserve(rows.size());
+    for (int row : rows) {
+        result.append(m_store.at(row));
+    }
+    return result;
+}
+
+QList<Shape *> Document::shapesIntersecting(const QRectF &rect) const
+{
+    const QVector<int> rows = HitTester::allHits(m_store, rowsOf(m_spatialIndex.query(rect)), rect);
+    QList<Shape *> result;
+    result.reserve(rows.size());
+    for (int row : rows) {
+        result.append(m_store.at(row));
+    }
+    return result;
+}
+
+Shape *Document::pagedShapeAt(const QPointF &pos)
+{
+    if (!m_pagedDocument.isOpen()) return nullptr;
+
+    // 取出的图形按原来的层序号与页中的图形比较
+    Shape *taken = nullptr;
+    qint64 takenZ = -1;
+    if (!m_pagedZ.isEmpty()) {
+        const QVector<int> rows = rowsOf(m_spatialIndex.query(pos));
+        for (int row : rows) {
+            Shape *shape = m_store.at(row);
+            const auto it = m_pagedZ.constFind(shape);
+            if (it != m_pagedZ.constEnd() && it.value() > takenZ && shape->contains(pos)) {
+                taken = shape;
+                takenZ = it.value();
+            }
+        }
+    }
+
+    qint64 z = -1;
+    Shape *copy = m_pagedDocument.shapeAt(pos, &z);
+    if (!copy || z < takenZ) {
+        delete copy;
+        return taken;
+    }
+
+    // 同一个图形只保留一个副本，重复点击时选择结果不变
+    for (auto it = m_pagedCopies.cbegin(); it != m_pagedCopies.cend(); ++it) {
+        if (it.value() == z) {
+            delete copy;
+            return it.key();
+        }
+    }
+    m_pagedCopies.insert(copy, z);
+    return copy;
+}
+
+QList<Shape *> Document::takePagedShapes(const QList<Shape *> &shapes)
+{
+    QList<Shape *> taken;
+    if (m_pagedCopies.isEmpty()) return taken;
+
+    beginTransaction();
+    for (Shape *shape : shapes) {
+        const auto it = m_pagedCopies.constFind(shape);
+        if (it == m_pagedCopies.constEnd()) continue;
+
+        const qint64 z = it.value();
+        if (!m_pagedDocument.take(z, shape->getBoundingRect())) continue;
+        m_pagedCopies.remove(shape);
+
+        // 追加到存储末尾，不移动其他行；绘制和保存时仍按原来的层序号排在分页图层中
+        const int row = m_store.size();
+        m_store.append(shape);
+        syncShape(shape);
+        m_pagedZ.insert(shape, z);
+
+        // 记录取出操作用于撤销，撤销时图形放回页中
+        Operation op;
+        op.type = Operation::TakeShape;
+        op.shape = shape;
+        op.oldIndex = row;
+        op.z = z;
+        addOperation(op);
+        taken.append(shape);
+    }
+    commitTransaction();
+    return taken;
+}
+
+void Document::releasePagedCopies()
+{
+    qDeleteAll(m_pagedCopies.keys());
+    m_pagedCopies.clear();
+}
+
+bool Document::saveToPagedFile(const QString &filename, QString *errorString)
+{
+    const ShapeStore::Snapshot snapshot = m_store.snapshot();
+    if (!m_pagedDocument.isOpen()) {
+        return PagedDocument::create(filename, snapshot, errorString);
+    }
+
+    // 取出的图形按原来的层序号写回，不会因为保存而移到最上层
+    QHash<int, qint64> takenZ;
+    for (auto it = m_pagedZ.cbegin(); it != m_pagedZ.cend(); ++it) {
+        const int row = m_store.indexOf(it.key());
+        if (row >= 0) {
+            takenZ.insert(row, it.value());
+        }
+    }
+    if (filename == m_pagedDocument.fileName()) {
+        return m_pagedDocument.save(snapshot, takenZ, errorString);
+    }
+    return m_pagedDocument.saveAs(filename, snapshot, takenZ, errorString);
+}
+
+void Document::prepareRender()
+{
+    m_store.refreshRows();
+}
+
+QImage Document::renderTile(const QPoint &tile, const QColor &background, qreal ratio,
+                            const QSet<const Shape *> &excluded) const
+{
+    TraceScope trace("Document::renderTile", "worker");
+    ScopedTimer timer(m_instrumentation, Instrumentation::TileRenderTime);
+    const QRect rect = TileCache::tileRect(tile);
+
+    QImage image(qCeil(rect.width() * ratio), qCeil(rect.height() * ratio),
+                 QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(ratio);
+    image.fill(background);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-rect.topLeft());
+
+    // 先用存储中的边界数组剔除，然后直接按存储中的列绘制，不访问Shape对象
+    const QRectF tileBounds(rect);
+    const QVector<int> rows = rowsOf(m_spatialIndex.query(tileBounds));
+    QVector<QPair<qint64, Shape *>> taken;
+    QVector<int> visible;
+    int culled = 0;
+    for (int row : rows) {
+        if (!m_store.strokeBoundsAt(row).intersects(tileBounds)) {
+            ++culled;
+            continue;
+        }
+        Shape *shape = m_store.at(row);
+        if (excluded.contains(shape)) continue;
+
+        const auto it = m_pagedZ.constFind(shape);
+        if (it != m_pagedZ.constEnd()) {
+            taken.append(qMakePair(it.value(), shape));
+        } else {
+            visible.append(row);
+        }
+    }
+
+    // 分页图层在最下面，页中的图形直接按记录绘制，取出的图形插在原来的层次
+    if (m_pagedDocument.isOpen()) {
+        m_pagedDocument.draw(&painter, tileBounds, taken);
+    }
+    m_store.drawRows(&painter, visible);
+
+    const int drawn = taken.size() + visible.size();
+    if (m_instrumentation) {
+        m_instrumentation->add(Instrumentation::ShapesDrawn, drawn);
+        m_instrumentation->add(Instrumentation::ShapesCulled, culled);
+    }
+    return image;
+}
+
+void Document::addShape(Shape *shape)
+{
+    if (!shape) return;
+
+    m_store.append(shape);
+    syncShape(shape);
+
+    // 记录添加操作用于撤销
+    Operation op;
+    op.type = Operation::AddShape;
+    op.shape = shape;
+    op.oldIndex = m_store.size() - 1;
+    addOperation(op);
+}
+
+void Document::deleteShapes(const QList<Shape *> &shapes)
+{
+    beginTransaction();
+    const QVector<int> rows = rowsOf(takeForEdit(shapes));
+
+    // 按行号从上到下记录，每个图形记录的下标不受之前删除的图形影响，
+    // 撤销时按相反顺序即可一次性插回原位置
+    QList<Shape *> removed;
+    removed.reserve(rows.size());
+    for (int i = rows.size() - 1; i >= 0; --i) {
+        Shape *shape = m_store.at(rows.at(i));
+        Operation op;
+        op.type = Operation::DeleteShape;
+        op.shape = shape;
+        op.oldIndex = rows.at(i);
+        addOperation(op);
+        removed.append(shape);
+    }
+    commitTransaction();
+
+    // 注意：这里不删除shape，留待撤销历史处理
+    removeShapes(removed);
+}
+
+void Document::moveShapes(const QList<Shape *> &shapes, const QPointF &offset)
+{
+    if (offset.isNull()) return;
+
+    // 所有图形的移动合并为一个撤销步骤，每个图形只记录平移量
+    beginTransaction();
+    const QList<Shape *> edited = takeForEdit(shapes);
+    for (Shape *shape : edited) {
+        shape->move(offset);
+        syncShape(shape);
+
+        Operation op;
+        op.type = Operation::MoveShape;
+        op.shape = shape;
+        op.offset = offset;
+        addOperation(op);
+    }
+    commitTransaction();
+}
+
+void Document::setShapeStyle(const QList<Shape *> &shapes, const Operation::Style &style)
+{
+    beginTransaction();
+    const QList<Shape *> edited = takeForEdit(shapes);
+    for (Shape *shape : edited) {
+        // 记录修改前后的样式用于撤销
+        Operation op;
+        op.type = Operation::ModifyShape;
+        op.shape = shape;
+        op.oldStyle = Operation::styleOf(shape);
+
+        Operation::applyStyle(shape, style);
+        syncShape(shape);
+
+        op.newStyle = Operation::styleOf(shape);
+        addOperation(op);
+    }
+    commitTransaction();
+}
+
+void Document::moveShapesUp(const QList<Shape *> &shapes)
+{
+    // 从上到下逐个移动，所有图层操作合并为一个撤销步骤；分页图层中的图形先离开分页图层
+    beginTransaction();
+    const QList<Shape *> edited = takeForEdit(shapes);
+    raiseShapes(edited);
+    const QVector<int> rows = rowsOf(edited);
+    for (int i = rows.size() - 1; i >= 0; --i) {
+        const int index = rows.at(i);
+        if (index < m_store.size() - 1) {
+            // 记录图层操作用于撤销
+            Operation op;
+            op.type = Operation::LayerChange;
+            op.shape = m_store.at(index);
+            op.oldIndex = index;
+            op.newIndex = index + 1;
+            addOperation(op);
+
+            m_store.swap(index, index + 1);
+        }
+    }
+    commitTransaction();
+}
+
+void Document::moveShapesDown(const QList<Shape *> &shapes)
+{
+    // 从下到上逐个移动，所有图层操作合并为一个撤销步骤；分页图层已经在最下面，其中的图形不移动
+    const QVector<int> rows = rowsOf(shapesAbovePagedLayer(shapes));
+    beginTransaction();
+    for (int index : rows) {
+        if (index > 0) {
+            // 记录图层操作用于撤销
+            Operation op;
+            op.type = Operation::LayerChange;
+            op.shape = m_store.at(index);
+            op.oldIndex = index;
+            op.newIndex = index - 1;
+            addOperation(op);
+
+            m_store.swap(index, index - 1);
+        }
+    }
+    commitTransaction();
+}
+
+void Document::moveShapesToTop(const QList<Shape *> &shapes)
+{
+    // 从上到下逐个移动到顶部，所有图层操作合并为一个撤销步骤；分页图层中的图形先离开分页图层
+    beginTransaction();
+    const QList<Shape *> edited = takeForEdit(shapes);
+    raiseShapes(edited);
+    const QVector<int> rows = rowsOf(edited);
+    int topIndex = m_store.size() - 1;
+    for (int i = rows.size() - 1; i >= 0; --i) {
+        const int index = rows.at(i);
+        if (index < topIndex) {
+            // 记录图层操作用于撤销
+            Operation op;
+            op.type = Operation::LayerChange;
+            op.shape = m_store.at(index);
+            op.oldIndex = index;
+            op.newIndex = topIndex;
+            addOperation(op);
+
+            m_store.move(index, topIndex);
+        }
+        topIndex--;
+    }
+    commitTransaction();
+}
+
+void Document::moveShapesToBottom(const QList<Shape *> &shapes)
+{
+    // 从下到上逐个移动到底部，所有图层操作合并为一个撤销步骤；分页图层已经在最下面，其中的图形不移动
+    const QVector<int> rows = rowsOf(shapesAbovePagedLayer(shapes));
+    beginTransaction();
+    int bottomIndex = 0;
+    for (int index : rows) {
+        if (index > bottomIndex) {
+            // 记录图层操作用于撤销
+            Operation op;
+            op.type = Operation::LayerChange;
+            op.shape = m_store.at(index);
+            op.oldIndex = index;
+            op.newIndex = bottomIndex;
+            addOperation(op);
+
+            m_store.move(index, bottomIndex);
+        }
+        bottomIndex++;
+    }
+    commitTransaction();
+}
+
+bool Document::canUndo() const
+{
+    return m_history.canUndo();
+}
+
+bool Document::canRedo() const
+{
+    return m_history.canRedo();
+}
+
+bool Document::undo()
+{
+    if (!m_history.canUndo()) return false;
+
+    TraceScope trace("Document::undo", "undo");
+    // 撤销可能把图形放回页中或再次取出，副本不再对应页中的图形
+    releasePagedCopies();
+    applyTransaction(m_history.undo(), true);
+    return true;
+}
+
+bool Document::redo()
+{
+    if (!m_history.canRedo()) return false;
+
+    TraceScope trace("Document::redo", "undo");
+    releasePagedCopies();
+    applyTransaction(m_history.redo(), false);
+    return true;
+}
+
+void Document::beginTransaction()
+{
+    ++m_transactionDepth;
+}
+
+void Document::commitTransaction()
+{
+    if (m_transactionDepth == 0) return;
+
+    if (--m_transactionDepth == 0 && m_pendingTransaction.count > 0) {
+        Transaction transaction = m_pendingTransaction;
+        m_pendingTransaction = Transaction();
+        m_history.push(transaction);
+    }
+}
+
+void Document::addOperation(const Operation &op)
+{
+    if (m_transactionDepth > 0) {
+        Operation::encode(m_pendingTransaction, op);
+        return;
+    }
+
+    Transaction transaction;
+    Operation::encode(transaction, op);
+    m_history.push(transaction);
+}
+
+void Document::applyTransaction(const Transaction &transaction, bool undo)
+{
+    const QList<Operation> operations = Operation::decode(transaction);
+    const int count = operations.size();
+    // 撤销时从最后一个操作开始处理
+    auto operationAt = [&operations, count, undo](int i) -> const Operation & {
+        return operations.at(undo ? count - 1 - i : i);
+    };
+
+    int i = 0;
+    while (i < count) {
+        const Operation &op = operationAt(i);
+
+        if (op.type == Operation::AddShape || op.type == Operation::DeleteShape) {
+            // 收集连续的同类操作批量处理
+            QList<Shape *> shapes;
+            QVector<int> rows;
+            bool ascending = true;
+            for (; i < count && operationAt(i).type == op.type; ++i) {
+                const Operation &next = operationAt(i);
+                if (!next.shape) continue;
+                if (next.oldIndex < 0 || (!rows.isEmpty() && next.oldIndex <= rows.last())) {
+                    ascending = false;
+                }
+                shapes.append(next.shape);
+                rows.append(next.oldIndex);
+            }
+
+            // 撤销添加和重做删除都是移除图形，延迟删除，让撤销/重做可以恢复
+            if ((op.type == Operation::AddShape) == undo) {
+                removeShapes(shapes);
+            } else if (ascending) {
+                // 下标递增时就是插入后的最终位置，可以一次插入
+                insertShapes(rows, shapes);
+            } else {
+                for (int k = 0; k < shapes.size(); ++k) {
+                    m_store.insert(rows.at(k), shapes.at(k));
+                    syncShape(shapes.at(k));
+                }
+            }
+            continue;
+        }
+
+        switch (op.type) {
+        case Operation::ModifyShape:
+            if (op.shape) {
+                Operation::applyStyle(op.shape, undo ? op.oldStyle : op.newStyle);
+                syncShape(op.shape);
+            }
+            break;
+
+        case Operation::MoveShape:
+            if (op.shape) {
+                op.shape->move(undo ? -op.offset : op.offset);
+                syncShape(op.shape);
+            }
+            break;
+
+        case Operation::ResizeShape:
+            if (op.shape) {
+                op.shape->setBoundingRect(undo ? op.oldRect : op.newRect);
+                syncShape(op.shape);
+            }
+            break;
+
+        case Operation::LayerChange:
+            // 撤销时恢复到原来的位置，重做时恢复到新的位置
+            if (op.shape) {
+                int currentIndex = m_store.indexOf(op.shape);
+                int targetIndex = undo ? op.oldIndex : op.newIndex;
+                if (currentIndex != -1 && targetIndex != -1) {
+                    // 确保目标索引在有效范围内
+                    targetIndex = qBound(0, targetIndex, m_store.size() - 1);
+                    if (currentIndex != targetIndex) {
+                        m_store.move(currentIndex, targetIndex);
+                    }
+                }
+            }
+            break;
+
+        case Operation::TakeShape:
+            // 撤销时图形按现在的数据放回页中，重做时再次取出
+            if (op.shape && undo) {
+                removeShapes(QList<Shape *>() << op.shape);
+                m_pagedZ.remove(op.shape);
+                m_pagedDocument.restore(op.shape, op.z);
+            } else if (op.shape && m_pagedDocument.take(op.z, op.shape->getBoundingRect())) {
+                m_store.insert(qBound(0, op.oldIndex, m_store.size()), op.shape);
+                syncShape(op.shape);
+                m_pagedZ.insert(op.shape, op.z);
+            }
+            break;
+
+        case Operation::RaiseShape:
+            if (op.shape) {
+                if (undo) {
+                    m_pagedZ.insert(op.shape, op.z);
+                } else {
+                    m_pagedZ.remove(op.shape);
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+        ++i;
+    }
+}
+
+void Document::releaseTransaction(const Transaction &transaction, bool undone)
+{
+    // 撤销栈中被删除的图形、重做栈中被撤销添加或取出的图形只被事务引用。
+    // 前者直接使用事务中的列表，丢弃溢出到磁盘的事务时不必读回记录
+    QList<Shape *> owned;
+    if (undone) {
+        const QList<Operation> operations = Operation::decode(transaction);
+        for (const Operation &op : operations) {
+            if (op.type == Operation::AddShape || op.type == Operation::TakeShape) {
+                owned.append(op.shape);
+            }
+        }
+    } else {
+        owned = QList<Shape *>(transaction.deletedShapes.cbegin(), transaction.deletedShapes.cend());
+    }
+    for (Shape *shape : std::as_const(owned)) {
+        if (shape && !m_store.contains(shape)) {
+            m_pagedZ.remove(shape);
+            delete shape;
+        }
+    }
+}
+
+QList<Shape *> Document::takeForEdit(const QList<Shape *> &shapes)
+{
+    takePagedShapes(shapes);
+
+    QList<Shape *> result;
+    result.reserve(shapes.size());
+    for (Shape *shape : shapes) {
+        if (m_store.contains(shape)) {
+            result.append(shape);
+        }
+    }
+    return result;
+}
+
+void Document::raiseShapes(const QList<Shape *> &shapes)
+{
+    if (m_pagedZ.isEmpty()) return;
+
+    for (Shape *shape : shapes) {
+        const auto it = m_pagedZ.constFind(shape);
+        if (it == m_pagedZ.constEnd()) continue;
+
+        // 图形留在存储中原来的行，之后按行号与其他图形一起排列
+        Operation op;
+        op.type = Operation::RaiseShape;
+        op.shape = shape;
+        op.z = it.value();
+        addOperation(op);
+        m_pagedZ.remove(shape);
+    }
+}
+
+QList<Shape *> Document::shapesAbovePagedLayer(const QList<Shape *> &shapes) const
+{
+    QList<Shape *> result;
+    for (Shape *shape : shapes) {
+        if (!m_pagedCopies.contains(shape) && !m_pagedZ.contains(shape)) {
+            result.append(shape);
+        }
+    }
+    return result;
+}
+
+void Document::insertShapes(const QVector<int> &rows, const QList<Shape *> &shapes)
+{
+    m_store.insertShapes(rows, shapes);
+    for (Shape *shape : shapes) {
+        m_spatialIndex.update(shape, shape->getStrokeBounds());
+    }
+}
+
+void Document::removeShapes(const QList<Shape *> &shapes)
+{
+    m_store.removeShapes(shapes);
+    for (Shape *shape : shapes) {
+        m_spatialIndex.remove(shape);
+    }
+}
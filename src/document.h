@@ -0,0 +1,400 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include <QColor>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QPointF>
+#include <QRectF>
+#include <QSet>
+#include "pageddocument.h"
+#include "shapestore.h"
+#include "spatialindex.h"
+#include "undohistory.h"
+#include "undooperation.h"
+
+class Instrumentation;
+class Shape;
+
+/**
+ * @file document.h
+ * @brief 文档模型的头文件
+ *
+ * 这个文件定义了Document类，把图形存储、空间索引和撤销历史组装成不依赖窗口的文档模型。
+ */
+
+/**
+ * @class Document
+ * @brief 文档模型
+ *
+ * 由ShapeStore、SpatialIndex、UndoHistory和可选的PagedDocument组成，负责：
+ * - 命中测试：空间索引给出候选图形，再由HitTester在存储的边界数组上测试
+ * - 编辑：添加、删除、平移、修改样式和图层操作，每次编辑记录为一个撤销步骤
+ * - 撤销/重做：按事务恢复图形，被撤销栈或重做栈独占的图形随事务一起释放
+ * - 绘制瓦片：可以在多个工作线程中同时调用
+ *
+ * 分页文档中的图形和从中取出的图形构成分页图层，绘制在其他图形之下，图层内按层序号排列。
+ * 选择分页文档中的图形只得到一个副本，第一次编辑时图形才从页中取出并加入存储，
+ * 取出本身是编辑的一部分，与编辑一起撤销，图形仍然按原来的层序号绘制和保存。
+ *
+ * DrawingArea在此之上处理选择、交互和重绘，基准测试直接使用这个类测量同样的代码。
+ * 文档拥有其中的所有图形，析构时一起释放。
+ */
+class Document
+{
+public:
+    /**
+     * @brief 撤销操作，见UndoOperation
+     */
+    typedef UndoOperation Operation;
+
+    /**
+     * @brief 撤销事务，见UndoTransaction
+     */
+    typedef UndoTransaction Transaction;
+
+    /**
+     * @brief Document类的构造函数
+     * @param instrumentation 累加命中测试和瓦片绘制计数的计数器，为nullptr时不统计
+     */
+    explicit Document(Instrumentation *instrumentation = nullptr);
+
+    /**
+     * @brief Document类的析构函数，释放所有图形
+     */
+    ~Document();
+
+    /**
+     * @brief 获取按图层顺序存放的图形
+     */
+    const ShapeStore &store() const;
+
+    /**
+     * @brief 获取撤销历史，用于设置内存上限和读取统计
+     */
+    UndoHistory &history();
+
+    /**
+     * @brief 获取撤销历史
+     */
+    const UndoHistory &history() const;
+
+    /**
+     * @brief 获取分页文档
+     *
+     * 打开的分页文档中的图形绘制在存储中的图形之下。
+     */
+    PagedDocument &pagedDocument();
+
+    /**
+     * @brief 获取分页文档
+     */
+    const PagedDocument &pagedDocument() const;
+
+    /**
+     * @brief 设置是否记录文档的变化，见ShapeStore::setChangeTracking()
+     * @param enabled 是否记录
+     */
+    void setChangeTracking(bool enabled);
+
+    /**
+     * @brief 取出上次取出以来文档的变化，见ShapeStore::takeChanges()
+     * @return 变化
+     */
+    ShapeStore::Changes takeChanges();
+
+    /**
+     * @brief 清除所有图形和撤销历史，关闭分页文档
+     */
+    void clear();
+
+    /**
+     * @brief 用新的图形替换文档中的所有图形
+     * @param shapes 按图层顺序排列的图形，所有权转移给文档
+     *
+     * 不记录撤销步骤，撤销历史被清空。
+     */
+    void replaceShapes(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 判断图形是否在文档中
+     * @param shape 图形
+     * @return 图形在存储中或者是分页图形的副本时返回true
+     */
+    bool contains(const Shape *shape) const;
+
+    /**
+     * @brief 同步图形在存储和空间索引中的数据
+     * @param shape 图形
+     *
+     * 图形被移动、调整大小、修改属性或改变选中状态后调用。
+     */
+    void syncShape(Shape *shape);
+
+    /**
+     * @brief 按绘制顺序排序图形
+     * @param shapes 图形列表，不在文档中的图形会被移除
+     * @param topmostFirst 为true时从上到下排列，否则从下到上排列
+     *
+     * 分页图层中的图形按层序号排在存储中的其他图形之下。
+     */
+    void sortByZOrder(QList<Shape *> &shapes, bool topmostFirst) const;
+
+    /**
+     * @brief 获取图形在存储中的行号
+     * @param shapes 图形，不在文档中的图形会被忽略
+     * @return 行号，从小到大（从下到上）排列
+     */
+    QVector<int> rowsOf(const QList<Shape *> &shapes) const;
+
+    /**
+     * @brief 获取指定位置最上层的图形
+     * @param pos 位置
+     * @return 包含该位置的最上层图形，如果没有，返回nullptr
+     *
+     * 不包括分页图层中的图形，它们由pagedShapeAt()测试。
+     */
+    Shape *shapeAt(const QPointF &pos) const;
+
+    /**
+     * @brief 获取包含指定点的所有图形
+     * @param pos 位置
+     * @return 图形列表，按图层顺序从上到下排列
+     */
+    QList<Shape *> shapesAt(const QPointF &pos) const;
+
+    /**
+     * @brief 获取与指定矩形区域相交的图形
+     * @param rect 矩形区域
+     * @return 图形列表，按图层顺序从上到下排列
+     */
+    QList<Shape *> shapesIntersecting(const QRectF &rect) const;
+
+    /**
+     * @brief 获取分页图层中包含指定点的最上层图形
+     * @param pos 位置
+     * @return 已取出的图形，或者页中图形的副本；如果没有，返回nullptr
+     *
+     * 不修改分页文档。副本归文档所有，编辑时才取出（见takePagedShapes()），
+     * 在releasePagedCopies()、撤销、重做或clear()时释放。
+     */
+    Shape *pagedShapeAt(const QPointF &pos);
+
+    /**
+     * @brief 把分页图形的副本从分页文档中取出，加入存储
+     * @param shapes 图形，其中不是副本的图形被忽略
+     * @return 取出的图形
+     *
+     * 每个图形的取出记录为一个撤销操作，在事务中调用时与之后的编辑合并为一个撤销步骤。
+     * 编辑函数会自动取出，只有调用者自己修改图形时（例如交互式调整大小）才需要直接调用。
+     */
+    QList<Shape *> takePagedShapes(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 释放没有取出的分页图形副本
+     *
+     * 调用之后pagedShapeAt()返回的副本不再有效。
+     */
+    void releasePagedCopies();
+
+    /**
+     * @brief 把文档写入分页文档
+     * @param filename 文件名
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @return 写入成功返回true
+     *
+     * 没有打开分页文档时新建；文件名与打开的分页文档相同时只写入变化的页，否则完整写入新文件。
+     * 取出的图形按原来的层序号写回。
+     */
+    bool saveToPagedFile(const QString &filename, QString *errorString = nullptr);
+
+    /**
+     * @brief 准备在工作线程中并行绘制瓦片
+     *
+     * 刷新图形存储中过期的句柄映射，之后各线程的查询都不需要逐行查找。
+     * 在GUI线程中、分派瓦片之前调用。
+     */
+    void prepareRender();
+
+    /**
+     * @brief 绘制一个瓦片
+     * @param tile 瓦片坐标，见TileCache
+     * @param background 背景色
+     * @param ratio 设备像素比
+     * @param excluded 不绘制的图形，例如正在交互的图形
+     * @return 包含该瓦片内的分页图形和存储中图形的图像
+     *
+     * 只读取文档数据，可以在工作线程中并行调用。并行调用之前先调用prepareRender()。
+     */
+    QImage renderTile(const QPoint &tile, const QColor &background, qreal ratio,
+                      const QSet<const Shape *> &excluded = QSet<const Shape *>()) const;
+
+    /**
+     * @brief 把图形添加到最上层
+     * @param shape 图形，所有权转移给文档
+     */
+    void addShape(Shape *shape);
+
+    /**
+     * @brief 删除图形
+     * @param shapes 图形
+     *
+     * 图形从文档中移除但不释放，由撤销历史负责释放。
+     */
+    void deleteShapes(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 平移图形
+     * @param shapes 图形
+     * @param offset 平移量
+     */
+    void moveShapes(const QList<Shape *> &shapes, const QPointF &offset);
+
+    /**
+     * @brief 修改图形的样式
+     * @param shapes 图形
+     * @param style 新的样式
+     */
+    void setShapeStyle(const QList<Shape *> &shapes, const Operation::Style &style);
+
+    /**
+     * @brief 把图形上移一层
+     * @param shapes 图形
+     */
+    void moveShapesUp(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 把图形下移一层
+     * @param shapes 图形
+     */
+    void moveShapesDown(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 把图形移到顶层
+     * @param shapes 图形
+     */
+    void moveShapesToTop(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 把图形移到底层
+     * @param shapes 图形
+     */
+    void moveShapesToBottom(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 判断是否可以撤销
+     */
+    bool canUndo() const;
+
+    /**
+     * @brief 判断是否可以重做
+     */
+    bool canRedo() const;
+
+    /**
+     * @brief 撤销上一个步骤
+     * @return 如果没有可以撤销的步骤，返回false
+     */
+    bool undo();
+
+    /**
+     * @brief 重做下一个步骤
+     * @return 如果没有可以重做的步骤，返回false
+     */
+    bool redo();
+
+    /**
+     * @brief 开始一个事务
+     *
+     * 在commitTransaction()之前添加的操作合并为一个撤销步骤。
+     * 事务可以嵌套，最外层的事务提交时才写入撤销栈。
+     */
+    void beginTransaction();
+
+    /**
+     * @brief 提交事务
+     *
+     * 如果事务中没有任何操作，则不产生撤销步骤。
+     */
+    void commitTransaction();
+
+    /**
+     * @brief 添加操作到撤销栈
+     * @param op 已经完成的操作
+     *
+     * 在事务中时操作被追加到当前事务，否则单独作为一个撤销步骤。
+     * 用于调用者自己修改图形的编辑，例如交互式调整大小。
+     */
+    void addOperation(const Operation &op);
+
+private:
+    Q_DISABLE_COPY(Document)
+
+    /**
+     * @brief 撤销或重做一个事务
+     * @param transaction 事务
+     * @param undo 为true时撤销，否则重做
+     *
+     * 撤销时按相反顺序处理各个操作，连续的添加或删除操作批量修改图形存储。
+     */
+    void applyTransaction(const Transaction &transaction, bool undo);
+
+    /**
+     * @brief 释放事务持有的图形
+     * @param transaction 被丢弃的事务
+     * @param undone 事务是否处于已撤销状态（来自重做栈）
+     *
+     * 撤销栈中被删除的图形、重做栈中被撤销添加的图形都不在文档中，由事务负责释放。
+     */
+    void releaseTransaction(const Transaction &transaction, bool undone);
+
+    /**
+     * @brief 开始编辑图形，在事务中调用
+     * @param shapes 图形
+     * @return 可以编辑的图形，即存储中的图形
+     *
+     * 其中的分页图形副本先从分页文档中取出。
+     */
+    QList<Shape *> takeForEdit(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 让取出的图形离开分页图层，之后按存储中的顺序绘制，在事务中调用
+     * @param shapes 图形
+     */
+    void raiseShapes(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 获取不在分页图层中的图形
+     * @param shapes 图形
+     * @return 存储中不属于分页图层的图形
+     */
+    QList<Shape *> shapesAbovePagedLayer(const QList<Shape *> &shapes) const;
+
+    /**
+     * @brief 一次插入多个图形
+     * @param rows 插入后各图形所在的行号，必须严格递增
+     * @param shapes 图形
+     */
+    void insertShapes(const QVector<int> &rows, const QList<Shape *> &shapes);
+
+    /**
+     * @brief 一次移除多个图形
+     * @param shapes 图形
+     *
+     * 图形从存储和空间索引中移除，但不释放。
+     */
+    void removeShapes(const QList<Shape *> &shapes);
+
+    ShapeStore m_store;                     ///< 按图层顺序存放的图形
+    SpatialIndex m_spatialIndex;            ///< 图形的空间索引，用于加速点击和区域查询
+    UndoHistory m_history;                  ///< 撤销/重做历史
+    Transaction m_pendingTransaction;       ///< 正在记录的事务
+    int m_transactionDepth;                 ///< 事务的嵌套层数
+    PagedDocument m_pagedDocument;          ///< 打开的分页文档，绘制在m_store中的图形之下
+    QHash<Shape *, qint64> m_pagedCopies;   ///< 选中而还没有取出的分页图形副本及其层序号
+    QHash<Shape *, qint64> m_pagedZ;        ///< 从分页文档中取出、仍在分页图层中的图形及其层序号
+    Instrumentation *m_instrumentation;     ///< 性能计数器，可以为nullptr
+};
+
+#endif // DOCUMENT_H
@@ -0,0 +1,101 @@
+#include "documentio.h"
+#include "binaryformat.h"
+#include "textformat.h"
+#include "tracerecorder.h"
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QSaveFile>
+
+bool DocumentIo::read(const QString &filename, bool binary, QList<Shape *> *shapes,
+                      QString *errorString, IoProgress *progress, DocumentJournal::State *journal)
+{
+    TraceScope trace("DocumentIo::read", "io");
+    if (!binary) {
+        TraceScope parse("TextFormat::read", "io");
+        return TextFormat::read(filename, shapes, errorString, progress);
+    }
+
+    QList<Shape *> loaded;
+    {
+        TraceScope parse("BinaryFormat::read", "io");
+        if (!BinaryFormat::read(filename, &loaded, errorString, progress)) {
+            return false;
+        }
+    }
+
+    // 重放上次完整保存之后追加的修改
+    DocumentJournal::State state;
+    state.generation = BinaryFormat::generationOf(filename);
+    state.documentSize = QFileInfo(filename).size();
+    if (!DocumentJournal::replay(filename, &state, &loaded, errorString, progress)) {
+        qDeleteAll(loaded);
+        return false;
+    }
+
+    if (journal) {
+        QVector<int> ids;
+        ids.reserve(loaded.size());
+        for (const Shape *shape : std::as_const(loaded)) {
+            ids.append(shape->getId());
+        }
+        if (DocumentJournal::hasUniqueIds(ids)) {
+            *journal = state;
+        }
+    }
+    shapes->append(loaded);
+    return true;
+}
+
+bool DocumentIo::write(const QString &filename, bool binary, const ShapeStore::Snapshot &snapshot,
+                       QString *errorString, IoProgress *progress, DocumentJournal::State *journal)
+{
+    TraceScope trace("DocumentIo::write", "io");
+
+    // 每次完整写入二进制文档都生成新的代号，0保留给没有代号的文档
+    const quint64 generation = binary ? QRandomGenerator::global()->generate64() | 1 : 0;
+
+    // 先写入临时文件，提交时再替换目标文件
+    QSaveFile file(filename);
+    if (!file.open(binary ? QIODevice::WriteOnly : QIODevice::WriteOnly | QIODevice::Text)) {
+        *errorString = file.errorString();
+        return false;
+    }
+
+    bool written;
+    {
+        TraceScope format(binary ? "BinaryFormat::write" : "TextFormat::write", "io");
+        written = binary ? BinaryFormat::write(&file, snapshot, errorString, progress, generation)
+                         : TextFormat::write(&file, snapshot, errorString, progress);
+    }
+    if (!written) {
+        file.cancelWriting();
+        return false;
+    }
+    {
+        // 提交时刷新并重命名临时文件，在慢速磁盘上可能占大部分时间
+        TraceScope commit("QSaveFile::commit", "io");
+        if (!file.commit()) {
+            *errorString = file.errorString();
+            return false;
+        }
+    }
+
+    if (binary) {
+        // 旧日志属于之前的代号，内容已经包含在新文档中
+        DocumentJournal::remove(filename);
+        QVector<int> ids;
+        if (journal) {
+            ids.reserve(snapshot.size());
+            for (int row = 0; row < snapshot.size(); ++row) {
+                ids.append(snapshot.records.at(row).id);
+            }
+        }
+        if (journal && DocumentJournal::hasUniqueIds(ids)) {
+            journal->generation = generation;
+            journal->documentSize = QFileInfo(filename).size();
+            journal->journalSize = 0;
+            journal->frames = 0;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef DOCUMENTIO_H
+#define DOCUMENTIO_H
+
+#include <QList>
+#include <QString>
+#include "shapestore.h"
+#include "documentjournal.h"
+
+class IoProgress;
+class Shape;
+
+/**
+ * @file documentio.h
+ * @brief 文档读写类的头文件
+ *
+ * 这个文件定义了DocumentIo类，按文档格式读写完整的文档，不依赖任何窗口。
+ */
+
+/**
+ * @class DocumentIo
+ * @brief 文本和二进制文档的完整读写
+ *
+ * 在TextFormat和BinaryFormat之上处理文件级的事务：写入经过QSaveFile，提交时才替换目标文件；
+ * 二进制文档读取后重放修改日志（见DocumentJournal），完整写入后删除旧的日志。
+ * 所有函数都可以在任意线程中调用。
+ */
+class DocumentIo
+{
+public:
+    /**
+     * @brief 读取文档
+     * @param filename 文件名
+     * @param binary 是否为二进制格式
+     * @param shapes 读取的图形追加到这里
+     * @param errorString 失败时的错误信息
+     * @param progress 进度，可以为nullptr
+     * @param journal 不为nullptr且文档可以追加日志时，返回文档及其日志的状态
+     * @return 读取成功返回true
+     *
+     * 二进制文档读取后会重放修改日志。
+     */
+    static bool read(const QString &filename, bool binary, QList<Shape *> *shapes,
+                     QString *errorString, IoProgress *progress,
+                     DocumentJournal::State *journal = nullptr);
+
+    /**
+     * @brief 写入文档快照
+     * @param filename 文件名
+     * @param binary 是否为二进制格式
+     * @param snapshot 文档快照
+     * @param errorString 失败时的错误信息
+     * @param progress 进度，可以为nullptr
+     * @param journal 不为nullptr且文档可以追加日志时，返回新文档的状态
+     * @return 写入成功返回true
+     *
+     * 完整写入二进制文档后，旧的修改日志随之删除。
+     */
+    static bool write(const QString &filename, bool binary, const ShapeStore::Snapshot &snapshot,
+                      QString *errorString, IoProgress *progress,
+                      DocumentJournal::State *journal = nullptr);
+};
+
+#endif // DOCUMENTIO_H
@@ -0,0 +1,310 @@
+#include "documentjournal.h"
+#include "littleendian.h"
+#include "shapefactory.h"
+#include "ioprogress.h"
+#include "tracerecorder.h"
+#include <QFile>
+#include <QSet>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char kMagic[8] = { '\x89', 'Q', 'G', 'J', '\r', '\n', '\x1a', '\n' };
+
+const quint16 kMajorVersion = 1;
+const quint16 kMinorVersion = 0;
+
+const int kHeaderSize = 32;
+const int kFrameHeaderSize = 24;
+const int kRecordSize = 56;
+
+const quint32 kFrameTag = 0x4d415246;  // "FRAM"
+
+const quint8 kFilledFlag = 0x1;
+
+bool fail(QString *errorString, const QString &message)
+{
+    if (errorString) *errorString = message;
+    return false;
+}
+
+bool canceled(const IoProgress *progress)
+{
+    return progress && progress->isCanceled();
+}
+
+QByteArray fileHeader(quint64 generation)
+{
+    QByteArray header(kHeaderSize, '\0');
+    char *out = header.data();
+    std::memcpy(out, kMagic, sizeof(kMagic));
+    putU16(out + 8, kMajorVersion);
+    putU16(out + 10, kMinorVersion);
+    putU64(out + 16, generation);
+    return header;
+}
+
+bool headerMatches(const uchar *data, qint64 size, quint64 generation)
+{
+    return size >= kHeaderSize && std::memcmp(data, kMagic, sizeof(kMagic)) == 0
+            && getU16(data + 8) == kMajorVersion && getU64(data + 16) == generation;
+}
+
+// 把快照中的一行编码为图形记录
+void putRecord(char *out, const ShapeStore::Snapshot &snapshot, int row)
+{
+    const ShapeStore::Record &record = snapshot.records.at(row);
+    const ShapeStore::Style &style = snapshot.styles.at(int(record.styleIndex));
+    const QRectF &rect = record.rect;
+    out[0] = char(record.type);
+    out[1] = char((record.flags & ShapeStore::Filled) ? kFilledFlag : 0);
+    putU32(out + 4, quint32(row));
+    putU32(out + 8, quint32(record.id));
+    putU32(out + 12, style.color);
+    putU32(out + 16, style.fillColor);
+    putU32(out + 20, quint32(style.lineWidth));
+    putF64(out + 24, rect.x());
+    putF64(out + 32, rect.y());
+    putF64(out + 40, rect.width());
+    putF64(out + 48, rect.height());
+}
+
+// 把图形记录中的属性写入图形
+void applyRecord(Shape *shape, const uchar *record)
+{
+    shape->setId(int(getU32(record + 8)));
+    shape->setColor(QColor::fromRgba(getU32(record + 12)));
+    shape->setFillColor(QColor::fromRgba(getU32(record + 16)));
+    shape->setLineWidth(int(getU32(record + 20)));
+    shape->setBoundingRect(QRectF(getF64(record + 24), getF64(record + 32),
+                                  getF64(record + 40), getF64(record + 48)));
+    shape->setFilled(record[1] & kFilledFlag);
+}
+
+// 应用一帧：先移除被删除和将要重新插入的图形，再按行号插入，最后更新属性
+void applyFrame(const uchar *payload, quint32 removeCount, quint32 insertCount, quint32 updateCount,
+                QList<Shape *> *shapes)
+{
+    const uchar *removes = payload;
+    const uchar *inserts = payload + paddedSize(qint64(removeCount) * 4);
+    const uchar *updates = inserts + qint64(insertCount) * kRecordSize;
+
+    if (removeCount > 0 || insertCount > 0) {
+        QSet<int> dropped;
+        dropped.reserve(int(removeCount + insertCount));
+        for (quint32 i = 0; i < removeCount; ++i) {
+            dropped.insert(int(getU32(removes + i * 4)));
+        }
+        for (quint32 i = 0; i < insertCount; ++i) {
+            dropped.insert(int(getU32(inserts + i * kRecordSize + 8)));
+        }
+
+        int out = 0;
+        for (int i = 0; i < shapes->size(); ++i) {
+            Shape *shape = shapes->at(i);
+            if (dropped.contains(shape->getId())) {
+                delete shape;
+            } else {
+                (*shapes)[out++] = shape;
+            }
+        }
+        shapes->resize(out);
+
+        if (insertCount > 0) {
+            QList<Shape *> merged;
+            merged.reserve(out + int(insertCount));
+            int source = 0;
+            for (quint32 i = 0; i < insertCount; ++i) {
+                const uchar *record = inserts + i * kRecordSize;
+                Shape *shape = ShapeFactory::createShape(Shape::ShapeType(record[0]));
+                if (!shape) continue;
+
+                const qsizetype row = getU32(record + 4);
+                while (merged.size() < row && source < shapes->size()) {
+                    merged.append(shapes->at(source++));
+                }
+                applyRecord(shape, record);
+                merged.append(shape);
+            }
+            while (source < shapes->size()) {
+                merged.append(shapes->at(source++));
+            }
+            shapes->swap(merged);
+        }
+    }
+
+    for (quint32 i = 0; i < updateCount; ++i) {
+        const uchar *record = updates + i * kRecordSize;
+        const qsizetype row = getU32(record + 4);
+        const int id = int(getU32(record + 8));
+
+        Shape *target = nullptr;
+        if (row < shapes->size() && shapes->at(row)->getId() == id) {
+            target = shapes->at(row);
+        } else {
+            for (Shape *shape : std::as_const(*shapes)) {
+                if (shape->getId() == id) {
+                    target = shape;
+                    break;
+                }
+            }
+        }
+        if (target && target->getType() == Shape::ShapeType(record[0])) {
+            applyRecord(target, record);
+        }
+    }
+}
+
+bool replayData(const uchar *data, qint64 size, DocumentJournal::State *state, QList<Shape *> *shapes,
+                QString *errorString, IoProgress *progress)
+{
+    // 不属于这个文档的日志（例如文档被其他程序完整重写过）直接忽略
+    if (!headerMatches(data, size, state->generation)) return true;
+    if (progress) progress->setTotal(size);
+
+    qint64 pos = kHeaderSize;
+    while (size - pos >= kFrameHeaderSize) {
+        const uchar *header = data + pos;
+        if (getU32(header) != kFrameTag) break;
+
+        const quint32 removeCount = getU32(header + 4);
+        const quint32 insertCount = getU32(header + 8);
+        const quint32 updateCount = getU32(header + 12);
+        const quint64 payloadSize = quint64(paddedSize(qint64(removeCount) * 4))
+                + (quint64(insertCount) + updateCount) * kRecordSize;
+        if (payloadSize > quint64(size - pos - kFrameHeaderSize)) break;
+
+        // 校验不通过说明这一帧没有完整写入，之后的内容都不可信
+        const uchar *payload = header + kFrameHeaderSize;
+        const QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char *>(payload),
+                                                         qsizetype(payloadSize));
+        if (qChecksum(bytes) != getU32(header + 16)) break;
+
+        if (canceled(progress)) {
+            return fail(errorString, "操作已取消");
+        }
+        applyFrame(payload, removeCount, insertCount, updateCount, shapes);
+
+        pos += kFrameHeaderSize + qint64(payloadSize);
+        state->journalSize = pos;
+        ++state->frames;
+        if (progress) progress->add(kFrameHeaderSize + qint64(payloadSize));
+    }
+    return true;
+}
+}
+
+QString DocumentJournal::journalPath(const QString &documentPath)
+{
+    return documentPath + ".journal";
+}
+
+qint64 DocumentJournal::frameSize(const ShapeStore::Changes &changes)
+{
+    return kFrameHeaderSize + paddedSize(qint64(changes.removedIds.size()) * 4)
+            + qint64(changes.placedRows.size() + changes.modifiedRows.size()) * kRecordSize;
+}
+
+bool DocumentJournal::append(const QString &documentPath, State *state, const ShapeStore::Snapshot &snapshot,
+                             const ShapeStore::Changes &changes, QString *errorString, IoProgress *progress)
+{
+    TraceScope trace("DocumentJournal::append", "io");
+    if (!state->isValid() || changes.rewrite) {
+        return fail(errorString, "文档需要完整保存");
+    }
+    if (changes.isEmpty()) return true;
+
+    const int removeCount = changes.removedIds.size();
+    const int insertCount = changes.placedRows.size();
+    const int updateCount = changes.modifiedRows.size();
+    if (progress) progress->setTotal(insertCount + updateCount);
+
+    QByteArray payload(paddedSize(qint64(removeCount) * 4) + qint64(insertCount + updateCount) * kRecordSize,
+                       '\0');
+    char *out = payload.data();
+    for (int i = 0; i < removeCount; ++i) {
+        putU32(out + i * 4, quint32(changes.removedIds.at(i)));
+    }
+    out += paddedSize(qint64(removeCount) * 4);
+    for (int row : changes.placedRows) {
+        putRecord(out, snapshot, row);
+        out += kRecordSize;
+    }
+    for (int row : changes.modifiedRows) {
+        putRecord(out, snapshot, row);
+        out += kRecordSize;
+    }
+
+    QByteArray frame(kFrameHeaderSize, '\0');
+    putU32(frame.data(), kFrameTag);
+    putU32(frame.data() + 4, quint32(removeCount));
+    putU32(frame.data() + 8, quint32(insertCount));
+    putU32(frame.data() + 12, quint32(updateCount));
+    putU32(frame.data() + 16, qChecksum(payload));
+    frame.append(payload);
+
+    if (canceled(progress)) {
+        return fail(errorString, "操作已取消");
+    }
+
+    QFile file(journalPath(documentPath));
+    if (!file.open(QIODevice::ReadWrite)) {
+        return fail(errorString, file.errorString());
+    }
+
+    qint64 pos = state->journalSize;
+    if (pos == 0) {
+        frame.prepend(fileHeader(state->generation));
+    } else {
+        // 日志必须仍是上次保存时的样子，否则追加的帧无法与之前的内容衔接
+        const QByteArray head = file.read(kHeaderSize);
+        if (file.size() < pos
+            || !headerMatches(reinterpret_cast<const uchar *>(head.constData()), head.size(), state->generation)) {
+            return fail(errorString, "修改日志已被其他程序改动");
+        }
+    }
+
+    // 截掉有效长度之后的残余数据（例如上次写入中途崩溃留下的半帧）
+    if (!file.seek(pos) || file.write(frame) != frame.size() || !file.resize(pos + frame.size())
+        || !file.flush()) {
+        return fail(errorString, file.errorString());
+    }
+
+    state->journalSize = pos + frame.size();
+    ++state->frames;
+    if (progress) progress->add(insertCount + updateCount);
+    return true;
+}
+
+bool DocumentJournal::replay(const QString &documentPath, State *state, QList<Shape *> *shapes,
+                             QString *errorString, IoProgress *progress)
+{
+    TraceScope trace("DocumentJournal::replay", "io");
+    state->journalSize = 0;
+    state->frames = 0;
+    if (!state->isValid()) return true;
+
+    QFile file(journalPath(documentPath));
+    if (!file.open(QIODevice::ReadOnly)) return true;
+
+    const qint64 size = file.size();
+    if (uchar *data = file.map(0, size)) {
+        const bool ok = replayData(data, size, state, shapes, errorString, progress);
+        file.unmap(data);
+        return ok;
+    }
+    const QByteArray bytes = file.readAll();
+    return replayData(reinterpret_cast<const uchar *>(bytes.constData()), bytes.size(), state, shapes,
+                      errorString, progress);
+}
+
+bool DocumentJournal::hasUniqueIds(QVector<int> ids)
+{
+    std::sort(ids.begin(), ids.end());
+    return std::adjacent_find(ids.cbegin(), ids.cend()) == ids.cend();
+}
+
+void DocumentJournal::remove(const QString &documentPath)
+{
+    QFile::remove(journalPath(documentPath));
+}
@@ -0,0 +1,113 @@
+#ifndef DOCUMENTJOURNAL_H
+#define DOCUMENTJOURNAL_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+#include "shapestore.h"
+
+class IoProgress;
+class Shape;
+
+/**
+ * @file documentjournal.h
+ * @brief 文档修改日志的头文件
+ *
+ * 这个文件定义了DocumentJournal类，把两次保存之间的修改追加到二进制文档旁边的日志文件中。
+ *
+ * 日志文件名为文档文件名加上".journal"，结构（所有整数均为小端序）：
+ * - 文件头（32字节）：8字节魔数、主版本号、次版本号、保留字段、所属文档的代号、保留字段
+ * - 若干帧，每次保存追加一帧。帧头（24字节）：标记、移除数量、插入数量、更新数量、校验和、保留字段，
+ *   随后依次是被移除的图形ID（补齐到8字节）、插入的图形记录和更新的图形记录
+ *
+ * 图形记录（56字节）包含类型、标志位、行号、ID、线条颜色、填充颜色、线宽和边界矩形。
+ * 插入记录的行号是图形在这一帧之后的文档中的位置；更新记录的行号用于快速定位，与ID不符时按ID查找。
+ */
+
+/**
+ * @class DocumentJournal
+ * @brief 二进制文档的修改日志
+ *
+ * 保存时只追加自上次保存以来的变化（见ShapeStore::Changes），耗时与修改的图形数量成正比，
+ * 与文档大小无关。读取文档时依次重放日志中的各帧；写入中途崩溃留下的不完整帧由长度和校验和发现，
+ * 连同之后的内容一起忽略。
+ *
+ * 日志依赖图形ID定位图形，只有ID互不相同的文档才能使用日志。
+ * 文档被完整重写后代号改变（见BinaryFormat），旧的日志随之失效。
+ */
+class DocumentJournal
+{
+public:
+    /**
+     * @struct State
+     * @brief 文档及其日志的状态
+     */
+    struct State {
+        quint64 generation = 0;   ///< 文档代号，0表示不能追加日志
+        qint64 documentSize = 0;  ///< 文档文件的大小
+        qint64 journalSize = 0;   ///< 日志中有效数据的长度，0表示还没有日志
+        int frames = 0;           ///< 日志中的帧数
+
+        /**
+         * @brief 判断是否可以追加日志
+         */
+        bool isValid() const { return generation != 0; }
+    };
+
+    /**
+     * @brief 获取文档对应的日志文件名
+     * @param documentPath 文档文件名
+     * @return 日志文件名
+     */
+    static QString journalPath(const QString &documentPath);
+
+    /**
+     * @brief 计算一组变化写入日志后占用的字节数
+     * @param changes 变化
+     * @return 字节数，用于判断是否应该改为完整保存
+     */
+    static qint64 frameSize(const ShapeStore::Changes &changes);
+
+    /**
+     * @brief 把一组变化作为一帧追加到日志
+     * @param documentPath 文档文件名
+     * @param state 文档及其日志的状态，成功后更新日志长度和帧数
+     * @param snapshot 与changes同时取得的文档快照，提供变化的图形的数据
+     * @param changes 自上次保存以来的变化，不能是需要完整保存的变化
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @param progress 进度（按图形计），可以为nullptr
+     * @return 写入成功且未被取消时返回true
+     *
+     * 帧写在state记录的有效长度之后，之前崩溃留下的残余数据被覆盖。
+     */
+    static bool append(const QString &documentPath, State *state, const ShapeStore::Snapshot &snapshot,
+                       const ShapeStore::Changes &changes, QString *errorString = nullptr,
+                       IoProgress *progress = nullptr);
+
+    /**
+     * @brief 把日志中的修改应用到刚读取的文档
+     * @param documentPath 文档文件名
+     * @param state 文档及其日志的状态，调用前需设置文档代号，返回后包含日志的有效长度和帧数
+     * @param shapes 文档中按图层顺序排列的图形，被移除和替换的图形会被释放
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @param progress 进度（按字节计），可以为nullptr
+     * @return 未被取消时返回true；没有日志或日志不属于这个文档时什么也不做
+     */
+    static bool replay(const QString &documentPath, State *state, QList<Shape *> *shapes,
+                       QString *errorString = nullptr, IoProgress *progress = nullptr);
+
+    /**
+     * @brief 判断图形ID是否互不相同
+     * @param ids 图形ID
+     * @return 如果没有重复的ID，返回true
+     */
+    static bool hasUniqueIds(QVector<int> ids);
+
+    /**
+     * @brief 删除文档对应的日志文件
+     * @param documentPath 文档文件名
+     */
+    static void remove(const QString &documentPath);
+};
+
+#endif // DOCUMENTJOURNAL_H
@@ -0,0 +1,139 @@
+#include "documentrenderer.h"
+#include "binaryformat.h"
+#include "documentio.h"
+#include "pageddocument.h"
+#include "shape.h"
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QtMath>
+
+namespace {
+// 分页文档整页流过缓存，不需要编辑器那样大的容量，并行渲染很多文件时内存占用保持有限
+const qint64 kPageCacheBudget = 32 * 1024 * 1024;
+
+DocumentRenderer::Result failed(DocumentRenderer::Result result, const QString &message)
+{
+    result.success = false;
+    result.errorString = message;
+    return result;
+}
+}
+
+DocumentRenderer::Result DocumentRenderer::renderFile(const QString &input, const QString &output,
+                                                      const Options &options)
+{
+    Result result;
+    result.input = input;
+    result.output = output;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QImage image;
+    if (PagedDocument::isPagedFile(input)) {
+        // 分页文档逐页读取并绘制，不会把整个文档读入内存
+        PagedDocument document;
+        QString error;
+        if (!document.open(input, &error)) {
+            return failed(result, error);
+        }
+        document.setCacheBudget(kPageCacheBudget);
+        result.shapeCount = -1;
+        result.loadTime = timer.restart();
+
+        const QRectF bounds = document.bounds();
+        double scale;
+        QPointF offset;
+        image = createImage(bounds, options, &scale, &offset);
+        if (image.isNull()) {
+            return failed(result, "图像太大，无法分配内存");
+        }
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.translate(offset);
+        painter.scale(scale, scale);
+        document.draw(&painter, bounds);
+    } else {
+        QList<Shape *> shapes;
+        QString error;
+        // 与编辑器打开文件时相同，二进制文档会重放修改日志
+        if (!DocumentIo::read(input, BinaryFormat::isBinaryFile(input), &shapes, &error, nullptr)) {
+            qDeleteAll(shapes);
+            return failed(result, error);
+        }
+        result.shapeCount = shapes.size();
+        result.loadTime = timer.restart();
+
+        image = render(shapes, options);
+        qDeleteAll(shapes);
+        if (image.isNull()) {
+            return failed(result, "图像太大，无法分配内存");
+        }
+    }
+    result.renderTime = timer.restart();
+
+    if (!image.save(output)) {
+        return failed(result, "无法写入图像文件");
+    }
+    result.saveTime = timer.elapsed();
+    result.success = true;
+    return result;
+}
+
+QImage DocumentRenderer::render(const QList<Shape *> &shapes, const Options &options)
+{
+    QRectF bounds;
+    for (const Shape *shape : shapes) {
+        bounds = bounds.united(shape->getStrokeBounds());
+    }
+
+    double scale;
+    QPointF offset;
+    QImage image = createImage(bounds, options, &scale, &offset);
+    if (image.isNull()) return image;
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(offset);
+    painter.scale(scale, scale);
+
+    // 缩略图中大部分图形只有几个像素，按绘制区域剔除没有意义，直接按图层顺序绘制
+    for (Shape *shape : shapes) {
+        shape->draw(&painter);
+    }
+    return image;
+}
+
+QImage DocumentRenderer::createImage(const QRectF &bounds, const Options &options,
+                                     double *painterScale, QPointF *painterOffset)
+{
+    // 空文档按1x1的区域处理，仍然输出指定大小的背景
+    const QRectF area = bounds.isEmpty() ? QRectF(bounds.topLeft(), QSizeF(1, 1)) : bounds;
+    const double ratio = options.scale > 0 ? options.scale : 1.0;
+
+    QSize size = options.size;
+    double scale = 1.0;
+    QPointF offset;
+    if (size.isValid() && !size.isEmpty()) {
+        // 按比例缩放到图像中并居中
+        scale = qMin(size.width() / area.width(), size.height() / area.height());
+        offset = QPointF((size.width() - area.width() * scale) / 2,
+                         (size.height() - area.height() * scale) / 2);
+    } else {
+        size = QSize(qCeil(area.width()), qCeil(area.height()));
+    }
+    *painterScale = scale;
+    *painterOffset = offset - area.topLeft() * scale;
+
+    const qint64 width = qCeil(size.width() * ratio);
+    const qint64 height = qCeil(size.height() * ratio);
+    if (width <= 0 || height <= 0 || width > 32767 || height > 32767) {
+        return QImage();
+    }
+
+    QImage image(int(width), int(height), QImage::Format_ARGB32_Premultiplied);
+    if (image.isNull()) return image;
+    image.setDevicePixelRatio(ratio);
+    image.fill(options.background);
+    return image;
+}
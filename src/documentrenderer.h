@@ -0,0 +1,85 @@
+#ifndef DOCUMENTRENDERER_H
+#define DOCUMENTRENDERER_H
+
+#include <QColor>
+#include <QImage>
+#include <QList>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+
+class Shape;
+
+/**
+ * @file documentrenderer.h
+ * @brief 文档渲染类的头文件
+ *
+ * 这个文件定义了DocumentRenderer类，不经过窗口把文档文件绘制为图像，供命令行渲染工具使用。
+ */
+
+/**
+ * @class DocumentRenderer
+ * @brief 把文档绘制为图像
+ *
+ * 按文件开头的魔数识别文本、二进制和分页格式，图形通过Shape::draw()绘制，结果与编辑器中显示的相同。
+ * 所有函数都可以在多个线程中同时调用。
+ */
+class DocumentRenderer
+{
+public:
+    /**
+     * @struct Options
+     * @brief 渲染参数
+     */
+    struct Options {
+        QSize size;                     ///< 图像大小（逻辑像素），文档按比例缩放后居中；无效时按文档边界的大小
+        double scale = 1.0;             ///< 设备像素比，图像的实际像素数为逻辑大小乘以这个值
+        QColor background = Qt::white;  ///< 背景颜色
+    };
+
+    /**
+     * @struct Result
+     * @brief 一个文件的渲染结果
+     */
+    struct Result {
+        QString input;              ///< 输入文件
+        QString output;             ///< 输出文件
+        bool success = false;       ///< 是否成功
+        QString errorString;        ///< 失败时的错误信息
+        qsizetype shapeCount = 0;   ///< 图形数量，分页文档为-1（图形只在绘制时读取）
+        qint64 loadTime = 0;        ///< 读取文件的时间（毫秒）
+        qint64 renderTime = 0;      ///< 绘制的时间（毫秒）
+        qint64 saveTime = 0;        ///< 写入图像的时间（毫秒）
+    };
+
+    /**
+     * @brief 读取文档并写入图像文件
+     * @param input 文档文件
+     * @param output 图像文件，格式由扩展名决定
+     * @param options 渲染参数
+     * @return 渲染结果，包括各阶段的耗时
+     */
+    static Result renderFile(const QString &input, const QString &output, const Options &options);
+
+    /**
+     * @brief 把图形绘制为图像
+     * @param shapes 按图层顺序排列的图形
+     * @param options 渲染参数
+     * @return 图像，内存不足时返回空图像
+     */
+    static QImage render(const QList<Shape *> &shapes, const Options &options);
+
+private:
+    /**
+     * @brief 创建填充了背景颜色的图像
+     * @param bounds 文档的描边边界
+     * @param options 渲染参数
+     * @param painterScale 文档坐标到逻辑像素的缩放比例
+     * @param painterOffset 缩放之后的平移量
+     * @return 图像，内存不足时返回空图像
+     */
+    static QImage createImage(const QRectF &bounds, const Options &options,
+                              double *painterScale, QPointF *painterOffset);
+};
+
+#endif // DOCUMENTRENDERER_H
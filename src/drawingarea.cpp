@@ -1,16 +1,53 @@
 #include "drawingarea.h"
 #include "shapefactory.h"
+#include "tracerecorder.h"
+#include <QCoreApplication>
 #include <QPainter>
 #include <QMouseEvent>
 #include <QKeyEvent>
-#include <QFile>
-#include <QTextStream>
+#include <QResizeEvent>
+#include <QWheelEvent>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QPainterPath>
+#include <QtMath>
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QFontDatabase>
+#include <QScreen>
 #include <algorithm>
+#include <optional>
+
+namespace {
+// 默认在日志超过文档大小的四分之一时改为完整保存
+const double kDefaultJournalCompactionRatio = 0.25;
+
+// 日志的帧数上限，避免打开文档时重放过多的帧
+const int kMaxJournalFrames = 4096;
+
+// 平移时保留窗口周围这么多个瓦片宽度内的瓦片，往回平移时不必重绘
+const int kTileCacheMargin = 2;
+
+// 绘制后延迟这么久刷新性能信息，连续绘制时也按这个间隔刷新
+const int kHudRefreshInterval = 200;
+
+// 无法获得屏幕刷新率时按每秒60帧合并鼠标移动
+const qreal kDefaultRefreshRate = 60.0;
+
+// 拖动预览的位图在窗口四周各多覆盖窗口大小的这一比例，拖动超出后重新绘制
+const qreal kDragSpriteMargin = 0.5;
+
+// 把字节数和纳秒数换算为MB/s
+QString formatThroughput(const Instrumentation::Throughput &throughput)
+{
+    if (throughput.nsecs <= 0) return QString("-");
+    return QString("%1 MB/s").arg(throughput.bytesPerSecond() / (1024 * 1024), 0, 'f', 1);
+}
+}
 
 DrawingArea::DrawingArea(QWidget *parent)
     : QWidget(parent),
+      m_document(&m_instrumentation),
       m_currentShapeType(Shape::Ellipse),
       m_editMode(Draw),
       m_currentColor(Qt::black),
@@ -19,23 +56,62 @@ DrawingArea::DrawingArea(QWidget *parent)
       m_currentFillColor(Qt::white),
       m_tempShape(nullptr),
       m_isDrawing(false),
+      m_isPanning(false),
       m_isMoving(false),
       m_isResizing(false),
       m_resizeHandle(-1),
-      m_maxUndoSteps(50)
+      m_dragPreview(false),
+      m_fileOperationRunning(false),
+      m_fileLoading(false),
+      m_cleanRevision(0),
+      m_journalEnabled(false),
+      m_journalCompactionRatio(kDefaultJournalCompactionRatio),
+      m_hudVisible(false),
+      m_pointerCoalescing(true),
+      m_pointerPending(false),
+      m_pendingPointerTime(0),
+      m_lastPointerUpdate(-1),
+      m_undisplayedInputTime(-1)
 {
+    m_fileProgressTimer.setInterval(100);
+    connect(&m_fileProgressTimer, &QTimer::timeout, this, [this]() {
+        emit fileOperationProgress(m_fileProgress.percent());
+    });
+    connect(&m_fileWatcher, &QFutureWatcher<FileResult>::finished, this, &DrawingArea::finishFileOperation);
+    m_hudTimer.setSingleShot(true);
+    m_hudTimer.setInterval(kHudRefreshInterval);
+    connect(&m_hudTimer, &QTimer::timeout, this, [this]() {
+        update(m_hudRect);
+    });
+    m_pointerTimer.setSingleShot(true);
+    m_pointerTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_pointerTimer, &QTimer::timeout, this, &DrawingArea::applyPointerMove);
+    m_pointerClock.start();
     setBackgroundRole(QPalette::Base);
-    setAutoFillBackground(true);
+    // 瓦片缓存已包含背景色并覆盖整个窗口，无需Qt预先填充背景
+    setAttribute(Qt::WA_OpaquePaintEvent);
     setMouseTracking(true);
 }
 
 DrawingArea::~DrawingArea()
 {
+    // 析构时不发出recordingStopped()信号
+    m_inputRecorder.stop();
+
+    // 加载直接取消；保存则等待完成，避免丢失用户要求保存的内容
+    if (m_fileOperationRunning) {
+        if (m_fileLoading) {
+            m_fileProgress.cancel();
+        }
+        m_fileWatcher.waitForFinished();
+        qDeleteAll(m_fileWatcher.result().shapes);
+    }
     clearAll();
 }
 
 void DrawingArea::setCurrentShapeType(Shape::ShapeType type)
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::SetShapeType, type);
     m_currentShapeType = type;
     m_editMode = Draw;
 }
@@ -47,6 +123,7 @@ Shape::ShapeType DrawingArea::getCurrentShapeType() const
 
 void DrawingArea::setEditMode(EditMode mode)
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::SetEditMode, mode);
     m_editMode = mode;
 }
 
@@ -57,6 +134,7 @@ DrawingArea::EditMode DrawingArea::getEditMode() const
 
 void DrawingArea::setCurrentColor(const QColor &color)
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::SetColor, color.rgba());
     m_currentColor = color;
     updateSelectedShapeProperties();
 }
@@ -68,6 +146,7 @@ QColor DrawingArea::getCurrentColor() const
 
 void DrawingArea::setCurrentLineWidth(int width)
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::SetLineWidth, width);
     m_currentLineWidth = width;
     updateSelectedShapeProperties();
 }
@@ -79,6 +158,7 @@ int DrawingArea::getCurrentLineWidth() const
 
 void DrawingArea::setCurrentFilled(bool filled)
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::SetFilled, filled);
     m_currentFilled = filled;
     updateSelectedShapeProperties();
 }
@@ -90,6 +170,7 @@ bool DrawingArea::getCurrentFilled() const
 
 void DrawingArea::setCurrentFillColor(const QColor &color)
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::SetFillColor, color.rgba());
     m_currentFillColor = color;
     updateSelectedShapeProperties();
 }
@@ -101,78 +182,243 @@ QColor DrawingArea::getCurrentFillColor() const
 
 void DrawingArea::clearAll()
 {
-    // 先清空撤销/重做栈并清理内存
-    clearUndoRedoStacks();
-    
-    // 然后清理当前图形
-    qDeleteAll(m_shapes);
-    m_shapes.clear();
+    // 录制只对开始时的文档有效
+    stopRecording();
+    m_pointerTimer.stop();
+    m_pointerPending = false;
+    m_undisplayedInputTime = -1;
+    endInteraction();
+
+    // 文档先清空撤销/重做栈，再释放当前图形
+    m_document.clear();
     m_selectedShapes.clear();
     delete m_tempShape;
     m_tempShape = nullptr;
-    update();
+    m_viewOrigin = QPoint();
+
+    // 旧文档的slab在图形释放时已经归还，这里再归还备用的空slab
+    ShapeFactory::releaseUnusedMemory();
+    m_cleanRevision = m_document.store().revision();
+    invalidateScene();
     emit selectionChanged();
 }
 
-void DrawingArea::clearUndoRedoStacks()
+bool DrawingArea::openPagedDocument(const QString &filename)
 {
-    // 清理撤销栈
-    for (const Operation &op : m_undoStack) {
-        if (op.type == DeleteShape && op.shape && !m_shapes.contains(op.shape)) {
-            delete op.shape;
-        }
-        if (op.oldShape) {
-            delete op.oldShape;
-        }
+    // 先在临时对象中检查文件，失败时不影响当前的图形
+    QString error;
+    PagedDocument probe;
+    if (!probe.open(filename, &error)) {
+        QMessageBox::warning(this, "错误", QString("无法读取文件：%1").arg(error));
+        return false;
     }
-    m_undoStack.clear();
-    
-    // 清理重做栈
-    clearRedoStack();
-}
+    probe.close();
 
-bool DrawingArea::saveToFile(const QString &filename)
-{
-    QFile file(filename);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QMessageBox::warning(this, "错误", "无法打开文件进行保存");
+    clearAll();
+    setJournalState(QString(), DocumentJournal::State());
+    if (!m_document.pagedDocument().open(filename, &error)) {
+        QMessageBox::warning(this, "错误", QString("无法读取文件：%1").arg(error));
         return false;
     }
 
-    QTextStream out(&file);
-    for (Shape *shape : m_shapes) {
-        out << shape->save() << "\n";
+    const QRectF bounds = m_document.pagedDocument().bounds();
+    if (!bounds.isNull()) {
+        m_viewOrigin = bounds.topLeft().toPoint();
     }
-
-    file.close();
+    m_cleanRevision = m_document.store().revision();
+    invalidateScene();
     return true;
 }
 
-bool DrawingArea::loadFromFile(const QString &filename)
+bool DrawingArea::saveToPagedFile(const QString &filename)
 {
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QMessageBox::warning(this, "错误", "无法打开文件进行读取");
+    QString error;
+    TraceScope trace("DrawingArea::saveToPagedFile", "io");
+    if (!m_document.saveToPagedFile(filename, &error)) {
+        QMessageBox::warning(this, "错误", QString("保存文件失败：%1").arg(error));
         return false;
     }
+    m_cleanRevision = m_document.store().revision();
+    return true;
+}
 
-    // 清空现有图形
-    clearAll();
+bool DrawingArea::isPagedDocument() const
+{
+    return m_document.pagedDocument().isOpen();
+}
 
-    QTextStream in(&file);
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-        if (!line.isEmpty()) {
-            Shape *shape = ShapeFactory::createShape(line);
-            if (shape) {
-                m_shapes.append(shape);
+void DrawingArea::setPageCacheBudget(qint64 bytes)
+{
+    m_document.pagedDocument().setCacheBudget(bytes);
+}
+
+qint64 DrawingArea::getPageCacheBudget() const
+{
+    return m_document.pagedDocument().cacheBudget();
+}
+
+bool DrawingArea::startLoad(const QString &filename, bool binary)
+{
+    if (m_fileOperationRunning) return false;
+
+    m_fileOperationRunning = true;
+    m_fileLoading = true;
+    m_fileProgress.reset();
+    IoProgress *progress = &m_fileProgress;
+    const bool journalEnabled = m_journalEnabled;
+    m_fileWatcher.setFuture(QtConcurrent::run([filename, binary, journalEnabled, progress]() {
+        QElapsedTimer timer;
+        timer.start();
+        FileResult result;
+        result.filename = filename;
+        result.success = DocumentIo::read(filename, binary, &result.shapes, &result.errorString, progress,
+                                      journalEnabled ? &result.journal : nullptr);
+        result.nsecs = timer.nsecsElapsed();
+        result.bytes = QFileInfo(filename).size();
+        return result;
+    }));
+    m_fileProgressTimer.start();
+    return true;
+}
+
+bool DrawingArea::startSave(const QString &filename, bool binary)
+{
+    if (m_fileOperationRunning) return false;
+
+    m_fileOperationRunning = true;
+    m_fileLoading = false;
+    m_fileProgress.reset();
+    IoProgress *progress = &m_fileProgress;
+    // 快照与文档隐式共享，之后的编辑只会复制被修改的列，不影响后台线程读取的数据
+    const ShapeStore::Snapshot snapshot = m_document.store().snapshot();
+
+    // 增量保存时取出与快照对应的变化；同一个文档的日志还不太大时只追加变化，否则完整保存，相当于压缩日志
+    ShapeStore::Changes changes;
+    bool appendJournal = false;
+    const bool journalEnabled = m_journalEnabled && binary;
+    if (m_journalEnabled) {
+        changes = m_document.takeChanges();
+        appendJournal = journalEnabled && filename == m_journalDocument && !changes.rewrite
+                && m_journalState.frames < kMaxJournalFrames
+                && m_journalState.journalSize + DocumentJournal::frameSize(changes)
+                   <= m_journalCompactionRatio * m_journalState.documentSize
+                && QFileInfo(filename).size() == m_journalState.documentSize;
+    }
+    const DocumentJournal::State journal = m_journalState;
+    const quint64 revision = m_document.store().revision();
+
+    m_fileWatcher.setFuture(QtConcurrent::run([filename, binary, snapshot, changes, appendJournal,
+                                               journalEnabled, journal, revision, progress]() {
+        QElapsedTimer timer;
+        timer.start();
+        FileResult result;
+        result.filename = filename;
+        result.revision = revision;
+        if (appendJournal) {
+            result.journal = journal;
+            result.success = DocumentJournal::append(filename, &result.journal, snapshot, changes,
+                                                     &result.errorString, progress);
+            if (result.success || progress->isCanceled()) {
+                // 追加日志时只写入了日志增长的部分
+                result.nsecs = timer.nsecsElapsed();
+                result.bytes = result.journal.journalSize - journal.journalSize;
+                return result;
             }
+            // 日志无法追加（例如被其他程序改动过）时改为完整保存
         }
+        result.journal = DocumentJournal::State();
+        result.success = DocumentIo::write(filename, binary, snapshot, &result.errorString, progress,
+                                       journalEnabled ? &result.journal : nullptr);
+        result.nsecs = timer.nsecsElapsed();
+        result.bytes = QFileInfo(filename).size();
+        return result;
+    }));
+    m_fileProgressTimer.start();
+    return true;
+}
+
+void DrawingArea::cancelFileOperation()
+{
+    if (m_fileOperationRunning) {
+        m_fileProgress.cancel();
     }
+}
 
-    file.close();
-    update();
-    return true;
+bool DrawingArea::isFileOperationRunning() const
+{
+    return m_fileOperationRunning;
+}
+
+ShapeStore::Snapshot DrawingArea::snapshot() const
+{
+    return m_document.store().snapshot();
+}
+
+quint64 DrawingArea::revision() const
+{
+    return m_document.store().revision();
+}
+
+bool DrawingArea::isModified() const
+{
+    return m_document.store().revision() != m_cleanRevision || m_document.pagedDocument().isModified();
+}
+
+void DrawingArea::setModified(bool modified)
+{
+    // 修订号达不到最大值，在下次保存之前总是不相等
+    m_cleanRevision = modified ? ~quint64(0) : m_document.store().revision();
+}
+
+void DrawingArea::finishFileOperation()
+{
+    TraceScope trace("DrawingArea::finishFileOperation", "io");
+    m_fileProgressTimer.stop();
+    m_fileOperationRunning = false;
+
+    const FileResult result = m_fileWatcher.result();
+    if (m_fileLoading && result.success) {
+        replaceShapes(result.shapes);
+    } else {
+        qDeleteAll(result.shapes);
+    }
+
+    if (result.success) {
+        setJournalState(result.filename, result.journal);
+        if (m_fileLoading) {
+            m_instrumentation.recordLoad(result.bytes, result.nsecs);
+        } else {
+            m_cleanRevision = result.revision;
+            m_instrumentation.recordSave(result.bytes, result.nsecs);
+        }
+    } else if (!m_fileLoading) {
+        // 这次保存取出的变化没有写入文件，下次只能完整保存
+        setJournalState(QString(), DocumentJournal::State());
+    }
+    emit fileOperationFinished(result.success, result.errorString);
+}
+
+void DrawingArea::setJournalState(const QString &filename, const DocumentJournal::State &state)
+{
+    if (m_journalEnabled && state.isValid()) {
+        m_journalDocument = filename;
+        m_journalState = state;
+    } else {
+        m_journalDocument.clear();
+        m_journalState = DocumentJournal::State();
+    }
+}
+
+void DrawingArea::replaceShapes(const QList<Shape *> &shapes)
+{
+    // 清空现有图形
+    clearAll();
+    m_document.replaceShapes(shapes);
+
+    // 新文档与文件一致，没有需要保存的变化
+    m_document.setChangeTracking(m_journalEnabled);
+    m_cleanRevision = m_document.store().revision();
+    invalidateScene();
 }
 
 QList<Shape *> DrawingArea::selectedShapes() const
@@ -182,181 +428,144 @@ QList<Shape *> DrawingArea::selectedShapes() const
 
 void DrawingArea::selectAll()
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::SelectAll);
     clearSelection();
-    m_selectedShapes = m_shapes;
+    m_selectedShapes = m_document.store().shapes();
     for (Shape *shape : m_selectedShapes) {
         shape->setSelected(true);
+        m_document.syncShape(shape);
     }
-    update();
+    invalidateScene();
     emit selectionChanged();
 }
 
 void DrawingArea::clearSelection()
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::ClearSelection);
     for (Shape *shape : m_selectedShapes) {
         shape->setSelected(false);
+        m_document.syncShape(shape);
     }
+    invalidateShapes(m_selectedShapes);
     m_selectedShapes.clear();
-    update();
+    m_document.releasePagedCopies();
     emit selectionChanged();
 }
 
 void DrawingArea::deleteSelectedShapes()
 {
-    for (Shape *shape : m_selectedShapes) {
-        // 记录删除操作用于撤销
-        Operation op;
-        op.type = DeleteShape;
-        op.shape = shape; // 存储原始指针用于撤销
-        op.oldIndex = m_shapes.indexOf(shape);
-        addOperation(op);
-        
-        m_shapes.removeOne(shape);
-        // 注意：这里不删除shape，留待撤销操作处理
-    }
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::DeleteSelection);
+    if (m_selectedShapes.isEmpty()) return;
+
+    endInteraction();
+
+    // 图形留待撤销历史释放
+    m_document.deleteShapes(m_selectedShapes);
+    invalidateShapes(m_selectedShapes);
     m_selectedShapes.clear(); // 确保选择列表被清空
-    update();
     emit selectionChanged();
 }
 
 // 图层操作函数
 void DrawingArea::moveSelectedShapesUp()
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::MoveUp);
     if (m_selectedShapes.isEmpty()) return;
 
-    // 对选中的图形按当前顺序进行排序（从大到小）
-    QList<int> indices;
-    for (Shape *shape : m_selectedShapes) {
-        indices.append(m_shapes.indexOf(shape));
-    }
-    std::sort(indices.begin(), indices.end(), std::greater<int>());
-
-    // 逐个移动图形
-    for (int index : indices) {
-        if (index < m_shapes.size() - 1) {
-            // 记录图层操作用于撤销
-            Operation op;
-            op.type = LayerChange;
-            op.shape = m_shapes[index];
-            op.oldIndex = index;
-            op.newIndex = index + 1;
-            addOperation(op);
-            
-            m_shapes.swapItemsAt(index, index + 1);
-        }
-    }
-
-    update();
+    // 所有图层操作合并为一个撤销步骤
+    m_document.moveShapesUp(m_selectedShapes);
+    invalidateShapes(m_selectedShapes);
 }
 
 void DrawingArea::moveSelectedShapesDown()
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::MoveDown);
     if (m_selectedShapes.isEmpty()) return;
 
-    // 对选中的图形按当前顺序进行排序（从小到大）
-    QList<int> indices;
-    for (Shape *shape : m_selectedShapes) {
-        indices.append(m_shapes.indexOf(shape));
-    }
-    std::sort(indices.begin(), indices.end());
-
-    // 逐个移动图形
-    for (int index : indices) {
-        if (index > 0) {
-            // 记录图层操作用于撤销
-            Operation op;
-            op.type = LayerChange;
-            op.shape = m_shapes[index];
-            op.oldIndex = index;
-            op.newIndex = index - 1;
-            addOperation(op);
-            
-            m_shapes.swapItemsAt(index, index - 1);
-        }
-    }
-
-    update();
+    // 所有图层操作合并为一个撤销步骤
+    m_document.moveShapesDown(m_selectedShapes);
+    invalidateShapes(m_selectedShapes);
 }
 
 void DrawingArea::moveSelectedShapesToTop()
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::MoveToTop);
     if (m_selectedShapes.isEmpty()) return;
 
-    // 对选中的图形按当前顺序进行排序（从大到小）
-    QList<int> indices;
-    for (Shape *shape : m_selectedShapes) {
-        indices.append(m_shapes.indexOf(shape));
-    }
-    std::sort(indices.begin(), indices.end(), std::greater<int>());
-
-    // 逐个移动图形到顶部
-    int topIndex = m_shapes.size() - 1;
-    for (int index : indices) {
-        if (index < topIndex) {
-            // 记录图层操作用于撤销
-            Operation op;
-            op.type = LayerChange;
-            op.shape = m_shapes[index];
-            op.oldIndex = index;
-            op.newIndex = topIndex;
-            addOperation(op);
-            
-            Shape *shape = m_shapes.takeAt(index);
-            m_shapes.append(shape);
-            topIndex--;
-        }
-    }
-
-    update();
+    // 所有图层操作合并为一个撤销步骤
+    m_document.moveShapesToTop(m_selectedShapes);
+    invalidateShapes(m_selectedShapes);
 }
 
 void DrawingArea::moveSelectedShapesToBottom()
 {
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::MoveToBottom);
     if (m_selectedShapes.isEmpty()) return;
 
-    // 对选中的图形按当前顺序进行排序（从小到大）
-    QList<int> indices;
-    for (Shape *shape : m_selectedShapes) {
-        indices.append(m_shapes.indexOf(shape));
-    }
-    std::sort(indices.begin(), indices.end());
-
-    // 逐个移动图形到底部
-    int bottomIndex = 0;
-    for (int index : indices) {
-        if (index > bottomIndex) {
-            // 记录图层操作用于撤销
-            Operation op;
-            op.type = LayerChange;
-            op.shape = m_shapes[index];
-            op.oldIndex = index;
-            op.newIndex = bottomIndex;
-            addOperation(op);
-            
-            Shape *shape = m_shapes.takeAt(index);
-            m_shapes.insert(bottomIndex, shape);
-            bottomIndex++;
-        }
-    }
-
-    update();
+    // 所有图层操作合并为一个撤销步骤
+    m_document.moveShapesToBottom(m_selectedShapes);
+    invalidateShapes(m_selectedShapes);
 }
 
 void DrawingArea::paintEvent(QPaintEvent *event)
 {
+    TraceScope trace("DrawingArea::paintEvent", "paint");
     QWidget::paintEvent(event);
 
+    // 只刷新性能信息的重绘不计入帧统计
+    const bool hudOnly = m_hudVisible && m_hudRect.contains(event->rect());
+    std::optional<FrameScope> frame;
+    if (!hudOnly) {
+        frame.emplace(&m_instrumentation);
+    }
+
     QPainter painter(this);
+    m_tileCache.setDevicePixelRatio(devicePixelRatioF());
+
+    // 瓦片和图形都使用场景坐标
+    painter.translate(-m_viewOrigin);
+
+    // 静态场景直接复制缓存的瓦片，缺失的瓦片先绘制再缓存
+    const QList<QPoint> tiles = TileCache::tilesIn(event->rect().translated(m_viewOrigin));
+    QList<QPoint> missingTiles;
+    for (const QPoint &tile : tiles) {
+        if (!m_tileCache.contains(tile)) {
+            missingTiles.append(tile);
+        }
+    }
+    renderTiles(missingTiles);
+    if (!hudOnly) {
+        m_instrumentation.add(Instrumentation::TilesRendered, missingTiles.size());
+        m_instrumentation.add(Instrumentation::TilesReused, tiles.size() - missingTiles.size());
+    }
+
+    for (const QPoint &tile : tiles) {
+        painter.drawImage(TileCache::tileRect(tile).topLeft(), m_tileCache.tile(tile));
+    }
+
     painter.setRenderHint(QPainter::Antialiasing);
 
-    // 绘制所有图形
-    for (Shape *shape : m_shapes) {
-        shape->draw(&painter);
+    // 正在移动或调整大小的图形不在瓦片中，绘制在静态场景之上
+    const QRegion region = event->region().translated(m_viewOrigin);
+    if (m_dragPreview) {
+        // 拖动时只需平移已绘制好的位图，包括选中框
+        updateDragSprite();
+        if (!m_dragSprite.isNull()) {
+            painter.drawImage(QPointF(m_dragSpriteRect.topLeft()) + m_dragOffset, m_dragSprite);
+        }
+    } else {
+        for (Shape *shape : std::as_const(m_activeShapes)) {
+            if (region.intersects(shape->getStrokeBounds().toAlignedRect())) {
+                shape->draw(&painter);
+            }
+        }
     }
 
     // 绘制选中图形的边框
     for (Shape *shape : m_selectedShapes) {
-        if (m_shapes.contains(shape)) { // 确保图形仍然存在
+        if (m_dragPreview && m_activeShapeSet.contains(shape)) continue;
+        if (m_document.contains(shape) // 确保图形仍然存在
+                && region.intersects(dirtyBounds(shape).toAlignedRect())) {
             shape->drawSelected(&painter);
         }
     }
@@ -365,19 +574,48 @@ void DrawingArea::paintEvent(QPaintEvent *event)
     if (m_isDrawing && m_tempShape) {
         drawRubberBand(&painter);
     }
+
+    // 性能信息固定在窗口左上角，显示上一帧的计数；绘制之后稍后再刷新一次，显示这一帧的计数
+    if (m_hudVisible) {
+        painter.resetTransform();
+        drawHud(&painter);
+        if (!hudOnly && !m_hudTimer.isActive()) {
+            m_hudTimer.start();
+        }
+    }
+
+    // 绘制结束时鼠标移动的结果已经画出，交给窗口系统显示的时间不计在内
+    if (!hudOnly && m_undisplayedInputTime >= 0) {
+        m_instrumentation.recordInputLatency(m_pointerClock.nsecsElapsed() - m_undisplayedInputTime);
+        m_undisplayedInputTime = -1;
+    }
 }
 
 void DrawingArea::mousePressEvent(QMouseEvent *event)
 {
-    m_lastMousePos = event->pos();
+    TraceScope trace("DrawingArea::mousePressEvent", "input");
+    InputRecorder::Scope input(&m_inputRecorder, event);
+    flushPointerMove();
+
+    // 中键拖动平移视图，不影响当前的编辑模式
+    if (event->button() == Qt::MiddleButton) {
+        m_isPanning = true;
+        m_panLastPos = event->pos();
+        setCursor(Qt::ClosedHandCursor);
+        return;
+    }
+
+    const QPointF pos = toScene(event->pos());
+    m_lastMousePos = pos;
 
     switch (m_editMode) {
     case Draw:
         if (event->button() == Qt::LeftButton) {
             m_isDrawing = true;
-            m_startPoint = event->pos();
-            m_endPoint = event->pos();
+            m_startPoint = pos;
+            m_endPoint = pos;
             updateTempShape();
+            invalidateRect(rubberBandBounds());
         }
         break;
 
@@ -386,31 +624,20 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
             if (event->modifiers() != Qt::ControlModifier) {
                 clearSelection();
             }
-            selectShapeAt(event->pos());
+            selectShapeAt(pos);
         }
         break;
 
     case Move:
         if (event->button() == Qt::LeftButton) {
             m_isMoving = false;
-            m_moveStartPositions.clear();
-            
+
+            if (m_selectedShapes.isEmpty()) {
+                clearSelection();
+                selectShapeAt(pos);
+            }
             if (!m_selectedShapes.isEmpty()) {
-                // 记录移动开始时的状态，用于撤销
-                for (Shape *shape : m_selectedShapes) {
-                    m_moveStartPositions[shape] = cloneShape(shape);
-                }
                 m_isMoving = true;
-            } else {
-                clearSelection();
-                selectShapeAt(event->pos());
-                if (!m_selectedShapes.isEmpty()) {
-                    // 记录移动开始时的状态，用于撤销
-                    for (Shape *shape : m_selectedShapes) {
-                        m_moveStartPositions[shape] = cloneShape(shape);
-                    }
-                    m_isMoving = true;
-                }
             }
         }
         break;
@@ -419,29 +646,28 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
         if (event->button() == Qt::LeftButton) {
             m_isResizing = false;
             m_resizeHandle = -1;
-            m_resizeStartShape = nullptr;
             
             if (!m_selectedShapes.isEmpty() && m_selectedShapes.size() == 1) {
                 Shape *shape = m_selectedShapes.first();
                 if (shape) {
-                    m_resizeHandle = getResizeHandle(event->pos(), shape);
+                    m_resizeHandle = getResizeHandle(pos, shape);
                     if (m_resizeHandle != -1) {
                         m_isResizing = true;
-                        // 记录调整大小开始时的状态，用于撤销
-                        m_resizeStartShape = cloneShape(shape);
+                        // 记录调整大小开始时的矩形，用于撤销
+                        m_resizeStartRect = shape->getBoundingRect();
                     }
                 }
             } else {
                 clearSelection();
-                selectShapeAt(event->pos());
+                selectShapeAt(pos);
                 if (m_selectedShapes.size() == 1) {
                     Shape *shape = m_selectedShapes.first();
                     if (shape) {
-                        m_resizeHandle = getResizeHandle(event->pos(), shape);
+                        m_resizeHandle = getResizeHandle(pos, shape);
                         if (m_resizeHandle != -1) {
                             m_isResizing = true;
-                            // 记录调整大小开始时的状态，用于撤销
-                            m_resizeStartShape = cloneShape(shape);
+                            // 记录调整大小开始时的矩形，用于撤销
+                            m_resizeStartRect = shape->getBoundingRect();
                         }
                     }
                 }
@@ -450,48 +676,125 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
         break;
     }
 
-    update();
+    // 开始移动或调整大小时，把被操作的图形从静态场景中分离出来
+    if (m_isMoving || m_isResizing) {
+        beginInteraction(m_selectedShapes);
+    }
+    if (m_isMoving) {
+        beginDragPreview();
+    }
 }
 
 void DrawingArea::mouseMoveEvent(QMouseEvent *event)
 {
-    QPointF delta = event->pos() - m_lastMousePos;
-    m_lastMousePos = event->pos();
+    TraceScope trace("DrawingArea::mouseMoveEvent", "input");
+    InputRecorder::Scope input(&m_inputRecorder, event);
+    m_instrumentation.add(Instrumentation::PointerEvents);
+
+    // 高回报率的鼠标和数位板每帧会送来多个事件，只保留最新的位置
+    const qint64 now = m_pointerClock.nsecsElapsed();
+    if (!m_pointerPending) {
+        m_pointerPending = true;
+        m_pendingPointerTime = now;
+    }
+    m_pendingPointerPos = event->pos();
+
+    // 距上次应用已超过一帧时立即应用，慢速移动不增加延迟；否则等到下一帧
+    const qint64 wait = m_lastPointerUpdate < 0 ? 0 : m_lastPointerUpdate + framePeriod() - now;
+    if (!m_pointerCoalescing || wait <= 0) {
+        m_pointerTimer.stop();
+        applyPointerMove();
+    } else if (!m_pointerTimer.isActive()) {
+        m_pointerTimer.start(int((wait + 999999) / 1000000));
+    }
+}
 
-    switch (m_editMode) {
-    case Draw:
-        if (m_isDrawing) {
-            m_endPoint = event->pos();
-            updateTempShape();
-            update();
-        }
-        break;
-    case Select:
-        // 选择模式下的鼠标移动不需要特殊处理
-        break;
-    case Move:
-        if (m_isMoving && !m_selectedShapes.isEmpty()) {
-            moveSelectedShapes(delta);
-            update();
+qint64 DrawingArea::framePeriod() const
+{
+    const QScreen *currentScreen = screen();
+    const qreal rate = currentScreen && currentScreen->refreshRate() > 0
+            ? currentScreen->refreshRate() : kDefaultRefreshRate;
+    return qint64(1e9 / rate);
+}
+
+void DrawingArea::flushPointerMove()
+{
+    if (m_pointerPending) {
+        m_pointerTimer.stop();
+        applyPointerMove();
+    }
+}
+
+void DrawingArea::applyPointerMove()
+{
+    if (!m_pointerPending) return;
+
+    TraceScope trace("DrawingArea::applyPointerMove", "input");
+    m_instrumentation.add(Instrumentation::PointerUpdates);
+    m_pointerPending = false;
+    m_lastPointerUpdate = m_pointerClock.nsecsElapsed();
+
+    // 改变了显示内容的移动在下次绘制结束时计算延迟
+    bool changed = false;
+    const QPoint widgetPos = m_pendingPointerPos;
+
+    if (m_isPanning) {
+        if (widgetPos != m_panLastPos) {
+            scrollView(m_panLastPos - widgetPos);
+            m_panLastPos = widgetPos;
+            changed = true;
         }
-        break;
+    } else {
+        const QPointF pos = toScene(widgetPos);
+        QPointF delta = pos - m_lastMousePos;
+        m_lastMousePos = pos;
+
+        switch (m_editMode) {
+        case Draw:
+            if (m_isDrawing) {
+                // 重绘橡皮筋的旧位置和新位置
+                invalidateRect(rubberBandBounds());
+                m_endPoint = pos;
+                updateTempShape();
+                invalidateRect(rubberBandBounds());
+                changed = true;
+            }
+            break;
+        case Select:
+            // 选择模式下的鼠标移动不需要特殊处理
+            break;
+        case Move:
+            if (m_isMoving && !m_selectedShapes.isEmpty()) {
+                moveSelectedShapes(delta);
+                changed = true;
+            }
+            break;
 
-    case Resize:
-        if (m_isResizing && m_selectedShapes.size() == 1 && m_resizeHandle != -1) {
-            Shape *shape = m_selectedShapes.first();
-            if (shape) {
-                resizeSelectedShape(event->pos());
-                update();
+        case Resize:
+            if (m_isResizing && m_selectedShapes.size() == 1 && m_resizeHandle != -1) {
+                Shape *shape = m_selectedShapes.first();
+                if (shape) {
+                    resizeSelectedShape(pos);
+                    changed = true;
+                }
             }
+            break;
         }
-        break;
+
+        updateCursor(pos);
+    }
+
+    if (changed && m_undisplayedInputTime < 0) {
+        m_undisplayedInputTime = m_pendingPointerTime;
     }
+}
 
-    // 更新鼠标光标
+void DrawingArea::updateCursor(const QPointF &pos)
+{
     if (m_editMode == Resize && !m_selectedShapes.isEmpty() && m_selectedShapes.size() == 1) {
         Shape *shape = m_selectedShapes.first();
         if (shape) {
-            int handle = getResizeHandle(event->pos(), shape);
+            int handle = getResizeHandle(pos, shape);
             switch (handle) {
             case 0: // 左上
             case 3: // 右下
@@ -515,37 +818,33 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
 
 void DrawingArea::mouseReleaseEvent(QMouseEvent *event)
 {
-    // 处理移动操作的撤销记录
-    if (m_isMoving && !m_moveStartPositions.isEmpty()) {
-        for (auto it = m_moveStartPositions.constBegin(); it != m_moveStartPositions.constEnd(); ++it) {
-            Shape *shape = it.key();
-            Shape *oldShape = it.value();
-            if (shape && oldShape) {
-                Operation op;
-                op.type = MoveShape;
-                op.shape = shape;
-                op.oldShape = oldShape;
-                op.oldIndex = m_shapes.indexOf(shape);
-                addOperation(op);
-            }
+    TraceScope trace("DrawingArea::mouseReleaseEvent", "input");
+    InputRecorder::Scope input(&m_inputRecorder, event);
+    flushPointerMove();
+
+    if (event->button() == Qt::MiddleButton) {
+        if (m_isPanning) {
+            m_isPanning = false;
+            setCursor(Qt::ArrowCursor);
         }
-        m_moveStartPositions.clear();
+        return;
     }
 
     // 处理调整大小操作的撤销记录
-    if (m_isResizing && m_resizeStartShape && m_selectedShapes.size() == 1) {
+    if (m_isResizing && m_selectedShapes.size() == 1) {
         Shape *shape = m_selectedShapes.first();
-        if (shape) {
+        if (shape && shape->getBoundingRect() != m_resizeStartRect) {
             Operation op;
-            op.type = ResizeShape;
+            op.type = Operation::ResizeShape;
             op.shape = shape;
-            op.oldShape = m_resizeStartShape;
-            addOperation(op);
+            op.oldRect = m_resizeStartRect;
+            op.newRect = shape->getBoundingRect();
+            m_document.addOperation(op);
         }
-        m_resizeStartShape = nullptr;
     }
 
-    // 重置移动和调整大小状态
+    // 重置移动和调整大小状态，拖动的平移量在这里应用到图形并记录撤销
+    endInteraction();
     m_isMoving = false;
     m_isResizing = false;
     m_resizeHandle = -1;
@@ -564,24 +863,19 @@ void DrawingArea::mouseReleaseEvent(QMouseEvent *event)
                     m_tempShape->setFilled(m_currentFilled);
                     m_tempShape->setFillColor(m_currentFillColor);
 
-                    m_shapes.append(m_tempShape);
-                    
-                    // 记录添加操作用于撤销
-                    Operation op;
-                    op.type = AddShape;
-                    op.shape = m_tempShape;
-                    op.oldIndex = m_shapes.size() - 1;
-                    addOperation(op);
-                    
+                    // 加入文档并记录添加操作用于撤销
+                    m_document.addShape(m_tempShape);
+
                     // 自动选择新创建的图形
                     clearSelection();
                     m_selectedShapes.append(m_tempShape);
+                    invalidateShape(m_tempShape);
                 } else {
                     // 如果图形太小，删除它
                     delete m_tempShape;
                 }
                 m_tempShape = nullptr;
-                update();
+                invalidateRect(rubberBandBounds());
                 emit selectionChanged();
             }
         }
@@ -602,6 +896,10 @@ void DrawingArea::mouseReleaseEvent(QMouseEvent *event)
 
 void DrawingArea::keyPressEvent(QKeyEvent *event)
 {
+    TraceScope trace("DrawingArea::keyPressEvent", "input");
+    InputRecorder::Scope input(&m_inputRecorder, event);
+    flushPointerMove();
+
     if (event->key() == Qt::Key_Delete && !m_selectedShapes.isEmpty()) {
         deleteSelectedShapes();
     } else if (event->key() == Qt::Key_Escape) {
@@ -609,13 +907,122 @@ void DrawingArea::keyPressEvent(QKeyEvent *event)
             m_isDrawing = false;
             delete m_tempShape;
             m_tempShape = nullptr;
-            update();
+            invalidateRect(rubberBandBounds());
         } else {
             clearSelection();
         }
     }
 }
 
+void DrawingArea::wheelEvent(QWheelEvent *event)
+{
+    TraceScope trace("DrawingArea::wheelEvent", "input");
+    InputRecorder::Scope input(&m_inputRecorder, event);
+    // 尚未应用的鼠标位置按滚动前的视图换算
+    flushPointerMove();
+
+    // 触控板给出像素距离，鼠标滚轮每格120，对应60像素
+    QPoint delta = event->pixelDelta();
+    if (delta.isNull()) {
+        delta = event->angleDelta() / 2;
+    }
+    if ((event->modifiers() & Qt::ShiftModifier) && delta.x() == 0) {
+        delta = QPoint(delta.y(), 0);
+    }
+    scrollView(-delta);
+    event->accept();
+}
+
+void DrawingArea::resizeEvent(QResizeEvent *event)
+{
+    InputRecorder::Scope input(&m_inputRecorder, event);
+    QWidget::resizeEvent(event);
+    m_tileCache.trim(viewRect());
+}
+
+QPointF DrawingArea::toScene(const QPointF &pos) const
+{
+    return pos + QPointF(m_viewOrigin);
+}
+
+QRect DrawingArea::viewRect() const
+{
+    return QRect(m_viewOrigin, size());
+}
+
+void DrawingArea::scrollView(const QPoint &delta)
+{
+    if (delta.isNull()) return;
+
+    m_viewOrigin += delta;
+
+    // 只保留窗口附近的瓦片，平移很大的文档时内存占用不会增长
+    const int margin = kTileCacheMargin * TileCache::TileSize;
+    m_tileCache.trim(viewRect().adjusted(-margin, -margin, margin, margin));
+    scroll(-delta.x(), -delta.y());
+    // scroll()会连同性能信息一起移动窗口内容
+    if (m_hudVisible) {
+        update(m_hudRect);
+    }
+}
+
+void DrawingArea::drawHud(QPainter *painter)
+{
+    const Instrumentation &stats = m_instrumentation;
+    const QStringList lines = {
+        QString("帧时间 %1 ms（p50 %2 / p95 %3 / p99 %4）")
+                .arg(stats.lastFrameTime() / 1e6, 0, 'f', 2)
+                .arg(stats.frameTimePercentile(50) / 1e6, 0, 'f', 1)
+                .arg(stats.frameTimePercentile(95) / 1e6, 0, 'f', 1)
+                .arg(stats.frameTimePercentile(99) / 1e6, 0, 'f', 1),
+        QString("图形 绘制 %1 / 剔除 %2")
+                .arg(stats.lastFrame(Instrumentation::ShapesDrawn))
+                .arg(stats.lastFrame(Instrumentation::ShapesCulled)),
+        QString("瓦片 重绘 %1（%2 ms）/ 复用 %3")
+                .arg(stats.lastFrame(Instrumentation::TilesRendered))
+                .arg(stats.lastFrame(Instrumentation::TileRenderTime) / 1e6, 0, 'f', 2)
+                .arg(stats.lastFrame(Instrumentation::TilesReused)),
+        QString("命中测试 %1 次，候选 %2 个（共 %3 / %4）")
+                .arg(stats.lastFrame(Instrumentation::HitTests))
+                .arg(stats.lastFrame(Instrumentation::HitCandidates))
+                .arg(stats.total(Instrumentation::HitTests))
+                .arg(stats.total(Instrumentation::HitCandidates)),
+        QString("鼠标移动 收到 %1 / 应用 %2，输入延迟 p50 %3 / p95 %4 ms")
+                .arg(stats.total(Instrumentation::PointerEvents))
+                .arg(stats.total(Instrumentation::PointerUpdates))
+                .arg(stats.inputLatencyPercentile(50) / 1e6, 0, 'f', 1)
+                .arg(stats.inputLatencyPercentile(95) / 1e6, 0, 'f', 1),
+        QString("内存分配 %1 次/帧").arg(stats.lastFrame(Instrumentation::Allocations)),
+        QString("撤销 压入 %1 / 移出 %2 / 内存 %3 KB")
+                .arg(m_document.history().pushCount())
+                .arg(m_document.history().evictedCount())
+                .arg(m_document.history().memoryUsage() / 1024),
+        QString("读取 %1，写入 %2").arg(formatThroughput(stats.lastLoad()), formatThroughput(stats.lastSave()))
+    };
+
+    painter->save();
+    painter->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    const QFontMetrics metrics = painter->fontMetrics();
+    int width = 0;
+    for (const QString &line : lines) {
+        width = qMax(width, metrics.horizontalAdvance(line));
+    }
+    const int margin = 6;
+    const QRect rect(8, 8, width + 2 * margin, int(lines.size()) * metrics.lineSpacing() + 2 * margin);
+
+    painter->fillRect(rect, QColor(0, 0, 0, 160));
+    painter->setPen(Qt::white);
+    int y = rect.top() + margin + metrics.ascent();
+    for (const QString &line : lines) {
+        painter->drawText(rect.left() + margin, y, line);
+        y += metrics.lineSpacing();
+    }
+    painter->restore();
+
+    // 内容变宽时下次刷新需要覆盖原来的区域
+    m_hudRect = m_hudRect.united(rect);
+}
+
 void DrawingArea::drawRubberBand(QPainter *painter)
 {
     painter->save();
@@ -669,10 +1076,15 @@ int DrawingArea::getResizeHandle(const QPointF &pos, const Shape *shape) const
 
 void DrawingArea::updateTempShape()
 {
-    delete m_tempShape;
-    m_tempShape = nullptr;
-
     QRectF rect = QRectF(m_startPoint, m_endPoint).normalized();
+
+    // 类型不变时复用临时图形，鼠标移动时无需反复创建
+    if (m_tempShape && m_tempShape->getType() == m_currentShapeType) {
+        m_tempShape->setBoundingRect(rect);
+        return;
+    }
+
+    delete m_tempShape;
     m_tempShape = ShapeFactory::createShape(m_currentShapeType);
     if (m_tempShape) {
         m_tempShape->setBoundingRect(rect);
@@ -681,26 +1093,221 @@ void DrawingArea::updateTempShape()
 
 void DrawingArea::selectShapeAt(const QPointF &pos)
 {
-    // 从后往前查找，优先选择上层图形
-    for (int i = m_shapes.size() - 1; i >= 0; --i) {
-        Shape *shape = m_shapes[i];
-        if (shape && shape->contains(pos)) {
-            m_selectedShapes.append(shape);
-            update();
-            emit selectionChanged();
-            return;
+    // 通过空间索引查找，优先选择上层图形
+    Shape *shape = shapeAt(pos);
+
+    // 分页图层中的图形只选择副本，页和撤销历史都不变，开始编辑时才取出
+    if (!shape) {
+        shape = m_document.pagedShapeAt(pos);
+    }
+    if (shape) {
+        m_selectedShapes.append(shape);
+        invalidateRect(dirtyBounds(shape));
+        emit selectionChanged();
+    }
+}
+
+Shape *DrawingArea::shapeAt(const QPointF &pos)
+{
+    return m_document.shapeAt(pos);
+}
+
+QList<Shape *> DrawingArea::shapesIntersecting(const QRectF &rect)
+{
+    return m_document.shapesIntersecting(rect);
+}
+
+QList<Shape *> DrawingArea::shapesAt(const QPointF &pos)
+{
+    return m_document.shapesAt(pos);
+}
+
+QRectF DrawingArea::dirtyBounds(const Shape *shape) const
+{
+    // 选中时的虚线框和控制点最多超出边界矩形6像素
+    const qreal handleMargin = 6.0;
+    return shape->getStrokeBounds().united(
+                shape->getBoundingRect().normalized().adjusted(
+                    -handleMargin, -handleMargin, handleMargin, handleMargin));
+}
+
+QRectF DrawingArea::rubberBandBounds() const
+{
+    qreal margin = m_currentLineWidth / 2.0 + 1.0;
+    return QRectF(m_startPoint, m_endPoint).normalized().adjusted(-margin, -margin, margin, margin);
+}
+
+void DrawingArea::invalidateRect(const QRectF &rect)
+{
+    if (!rect.isNull()) {
+        update(rect.toAlignedRect().translated(-m_viewOrigin));
+    }
+}
+
+void DrawingArea::invalidateShapes(const QList<Shape *> &shapes)
+{
+    // 合并为一个矩形，避免大量小矩形使重绘区域过于复杂
+    QRectF dirty;
+    for (const Shape *shape : shapes) {
+        dirty = dirty.united(dirtyBounds(shape));
+        // 交互中的图形不在瓦片中，移动时无需使瓦片失效
+        if (!m_activeShapeSet.contains(shape)) {
+            m_tileCache.invalidate(shape->getStrokeBounds());
         }
     }
+    invalidateRect(dirty);
+}
+
+void DrawingArea::invalidateShape(Shape *shape)
+{
+    invalidateShapes(QList<Shape *>() << shape);
+}
+
+void DrawingArea::invalidateScene()
+{
+    m_tileCache.invalidateAll();
+    update();
+}
+
+void DrawingArea::beginInteraction(const QList<Shape *> &shapes)
+{
+    endInteraction();
+
+    // 先按静态图形处理，使其所在的瓦片失效，重绘时瓦片中将不再包含这些图形
+    invalidateShapes(shapes);
+
+    m_activeShapes = shapes;
+    m_document.sortByZOrder(m_activeShapes, false);
+    for (const Shape *shape : std::as_const(m_activeShapes)) {
+        m_activeShapeSet.insert(shape);
+    }
+
+    // 取出分页图形、移动或调整大小合并为一个撤销步骤；交互中没有修改时不产生撤销步骤
+    if (!m_activeShapes.isEmpty()) {
+        m_document.beginTransaction();
+    }
+}
+
+void DrawingArea::endInteraction()
+{
+    if (m_activeShapes.isEmpty()) return;
+
+    QList<Shape *> shapes = m_activeShapes;
+
+    // 拖动预览期间图形留在原处，现在一次移动到位，所有图形的移动合并为一个撤销步骤
+    if (m_dragPreview) {
+        invalidateRect(m_dragBounds.translated(m_dragOffset));
+        m_document.moveShapes(shapes, m_dragOffset);
+        m_dragPreview = false;
+        m_dragSprite = QImage();
+        m_dragSpriteRect = QRect();
+        m_dragBounds = QRectF();
+        m_dragOffset = QPointF();
+    }
+    m_document.commitTransaction();
+
+    m_activeShapes.clear();
+    m_activeShapeSet.clear();
+
+    // 图形重新并入静态场景，其当前所在的瓦片需要重新绘制
+    invalidateShapes(shapes);
+}
+
+void DrawingArea::beginDragPreview()
+{
+    if (m_activeShapes.isEmpty()) return;
+
+    m_dragBounds = QRectF();
+    for (const Shape *shape : std::as_const(m_activeShapes)) {
+        m_dragBounds = m_dragBounds.united(dirtyBounds(shape));
+    }
+    m_dragOffset = QPointF();
+    m_dragSprite = QImage();
+    m_dragSpriteRect = QRect();
+    m_dragPreview = true;
+}
+
+void DrawingArea::updateDragSprite()
+{
+    // 窗口中可能看到的部分，换算到拖动开始时的位置
+    const QRect bounds = m_dragBounds.toAlignedRect();
+    const QRect visible = viewRect().translated(-m_dragOffset.toPoint()) & bounds;
+    if (visible.isEmpty()) return;
+
+    const qreal ratio = m_tileCache.devicePixelRatio();
+    if (!m_dragSprite.isNull() && m_dragSprite.devicePixelRatio() == ratio
+            && m_dragSpriteRect.contains(visible)) {
+        return;
+    }
+
+    TraceScope trace("DrawingArea::updateDragSprite", "paint");
+    const int marginX = qCeil(width() * kDragSpriteMargin);
+    const int marginY = qCeil(height() * kDragSpriteMargin);
+    m_dragSpriteRect = visible.adjusted(-marginX, -marginY, marginX, marginY) & bounds;
+
+    m_dragSprite = QImage(qCeil(m_dragSpriteRect.width() * ratio), qCeil(m_dragSpriteRect.height() * ratio),
+                          QImage::Format_ARGB32_Premultiplied);
+    m_dragSprite.setDevicePixelRatio(ratio);
+    m_dragSprite.fill(Qt::transparent);
+
+    QPainter painter(&m_dragSprite);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-m_dragSpriteRect.topLeft());
+
+    // 拖动的就是选中的图形，与paintEvent()相同，先画图形，再在上面画选中框
+    const QRectF spriteBounds(m_dragSpriteRect);
+    int drawn = 0;
+    for (Shape *shape : std::as_const(m_activeShapes)) {
+        if (shape->getStrokeBounds().intersects(spriteBounds)) {
+            shape->draw(&painter);
+            ++drawn;
+        }
+    }
+    for (Shape *shape : std::as_const(m_activeShapes)) {
+        if (dirtyBounds(shape).intersects(spriteBounds)) {
+            shape->drawSelected(&painter);
+        }
+    }
+    m_instrumentation.add(Instrumentation::ShapesDrawn, drawn);
+}
+
+void DrawingArea::renderTiles(const QList<QPoint> &tiles)
+{
+    if (tiles.isEmpty()) return;
+
+    TraceScope trace("DrawingArea::renderTiles", "paint");
+
+    const QColor background = palette().color(QPalette::Base);
+    const qreal ratio = m_tileCache.devicePixelRatio();
+    m_document.prepareRender();
+
+    // 交互中的图形绘制在静态场景之上，不进入瓦片
+    if (tiles.size() == 1) {
+        m_tileCache.insert(tiles.first(), m_document.renderTile(tiles.first(), background, ratio, m_activeShapeSet));
+        return;
+    }
+
+    // 每个瓦片使用独立的QImage和QPainter，绘制期间GUI线程阻塞等待，文档不会被修改
+    const QList<QImage> images = QtConcurrent::blockingMapped<QList<QImage>>(
+                tiles, [this, background, ratio](const QPoint &tile) {
+                    return m_document.renderTile(tile, background, ratio, m_activeShapeSet);
+                });
+    for (int i = 0; i < tiles.size(); ++i) {
+        m_tileCache.insert(tiles[i], images[i]);
+    }
 }
 
 void DrawingArea::moveSelectedShapes(const QPointF &offset)
 {
-    if (m_selectedShapes.isEmpty()) return;
-    
-    for (Shape *shape : m_selectedShapes) {
-        shape->move(offset);
+    // 拖动时只移动位图，图形在endInteraction()时才移动；重绘位图移动前和移动后的区域
+    if (m_selectedShapes.isEmpty() || !m_dragPreview) return;
+
+    if (!offset.isNull()) {
+        takePagedShapes(m_activeShapes);
     }
-    update(); // 确保界面及时更新
+    invalidateRect(m_dragBounds.translated(m_dragOffset));
+    m_dragOffset += offset;
+    invalidateRect(m_dragBounds.translated(m_dragOffset));
 }
 
 void DrawingArea::resizeSelectedShape(const QPointF &pos)
@@ -737,252 +1344,292 @@ void DrawingArea::resizeSelectedShape(const QPointF &pos)
         return; // 不允许调整到太小的尺寸
     }
 
+    takePagedShapes(m_activeShapes);
+    invalidateShape(shape);
     shape->resize(normalizedRect);
+    m_document.syncShape(shape);
+    invalidateShape(shape);
 }
 
-void DrawingArea::updateSelectedShapeProperties()
+void DrawingArea::takePagedShapes(const QList<Shape *> &shapes)
 {
-    for (Shape *shape : m_selectedShapes) {
-        // 记录修改前的状态用于撤销
-        Operation op;
-        op.type = ModifyShape;
-        op.shape = shape;
-        op.oldShape = cloneShape(shape);
-        op.oldIndex = m_shapes.indexOf(shape);
-        addOperation(op);
-
-        shape->setColor(m_currentColor);
-        shape->setLineWidth(m_currentLineWidth);
-        shape->setFilled(m_currentFilled);
-        shape->setFillColor(m_currentFillColor);
+    // 交互中的图形不会被invalidateShapes()从瓦片中去掉，刚取出的图形要单独处理
+    const QList<Shape *> taken = m_document.takePagedShapes(shapes);
+    for (const Shape *shape : taken) {
+        m_tileCache.invalidate(shape->getStrokeBounds());
+        invalidateRect(dirtyBounds(shape));
     }
-    update();
 }
 
-// 设置最大撤销步数
-void DrawingArea::setMaxUndoSteps(int steps)
+void DrawingArea::updateSelectedShapeProperties()
 {
-    if (steps > 0) {
-        m_maxUndoSteps = steps;
-        // 如果当前撤销栈超过新的限制，移除多余的操作
-        while (m_undoStack.size() > m_maxUndoSteps) {
-            Operation oldOp = m_undoStack.takeFirst();
-            if (oldOp.type == DeleteShape && oldOp.shape && !m_shapes.contains(oldOp.shape)) {
-                delete oldOp.shape;
-            }
-            if (oldOp.oldShape) {
-                delete oldOp.oldShape;
-            }
-        }
+    if (m_selectedShapes.isEmpty()) return;
+
+    Operation::Style style;
+    style.color = m_currentColor;
+    style.lineWidth = m_currentLineWidth;
+    style.filled = m_currentFilled;
+    style.fillColor = m_currentFillColor;
+
+    // 线宽变化会改变描边范围，修改前后的区域都需要重绘
+    invalidateShapes(m_selectedShapes);
+    m_document.setShapeStyle(m_selectedShapes, style);
+    invalidateShapes(m_selectedShapes);
+}
+
+// 设置撤销历史的内存上限
+void DrawingArea::setUndoMemoryBudget(qint64 bytes)
+{
+    // 如果当前撤销历史超过新的上限，会立即移除最早的操作
+    m_document.history().setMemoryBudget(bytes);
+}
+
+qint64 DrawingArea::getUndoMemoryBudget() const
+{
+    return m_document.history().memoryBudget();
+}
+
+void DrawingArea::setUndoSpillEnabled(bool enabled)
+{
+    m_document.history().setSpillEnabled(enabled);
+}
+
+bool DrawingArea::isUndoSpillEnabled() const
+{
+    return m_document.history().isSpillEnabled();
+}
+
+// 增量保存设置
+void DrawingArea::setJournaledSaveEnabled(bool enabled)
+{
+    if (enabled == m_journalEnabled) return;
+
+    // 启用前的变化没有记录，第一次保存总是完整保存
+    m_journalEnabled = enabled;
+    m_document.setChangeTracking(enabled);
+    setJournalState(QString(), DocumentJournal::State());
+}
+
+bool DrawingArea::isJournaledSaveEnabled() const
+{
+    return m_journalEnabled;
+}
+
+void DrawingArea::setJournalCompactionRatio(double ratio)
+{
+    if (ratio > 0) {
+        m_journalCompactionRatio = ratio;
     }
 }
 
-int DrawingArea::getMaxUndoSteps() const
+double DrawingArea::getJournalCompactionRatio() const
 {
-    return m_maxUndoSteps;
+    return m_journalCompactionRatio;
 }
 
-// 撤销/重做相关方法
-bool DrawingArea::canUndo() const
+// 性能信息
+qint64 DrawingArea::getUndoPushCount() const
 {
-    return !m_undoStack.isEmpty();
+    return m_document.history().pushCount();
 }
 
-bool DrawingArea::canRedo() const
+qint64 DrawingArea::getUndoEvictedCount() const
 {
-    return !m_redoStack.isEmpty();
+    return m_document.history().evictedCount();
 }
 
-void DrawingArea::undo()
+const Instrumentation &DrawingArea::instrumentation() const
 {
-    if (m_undoStack.isEmpty()) return;
+    return m_instrumentation;
+}
 
-    Operation op = m_undoStack.takeLast();
-    m_redoStack.append(op);
+void DrawingArea::setHudVisible(bool visible)
+{
+    if (visible == m_hudVisible) return;
 
-    // 在撤销操作前清除当前选择，避免选择状态混乱
-    m_selectedShapes.clear();
+    m_hudVisible = visible;
+    if (!visible) {
+        m_hudTimer.stop();
+        update(m_hudRect);
+        m_hudRect = QRect();
+    } else {
+        update();
+    }
+}
 
-    switch (op.type) {
-    case AddShape:
-        // 撤销添加操作：删除图形
-        if (op.shape && m_shapes.contains(op.shape)) {
-            m_shapes.removeOne(op.shape);
-            // 延迟删除，让redo可以恢复
-        }
-        break;
+bool DrawingArea::isHudVisible() const
+{
+    return m_hudVisible;
+}
 
-    case DeleteShape:
-        // 撤销删除操作：重新添加图形
-        if (op.shape) {
-            if (op.oldIndex >= 0 && op.oldIndex < m_shapes.size()) {
-                m_shapes.insert(op.oldIndex, op.shape);
-            } else {
-                m_shapes.append(op.shape);
-            }
-            // 注意：撤销删除时不自动选择恢复的图形
-        }
-        break;
+void DrawingArea::setPointerCoalescing(bool enabled)
+{
+    m_pointerCoalescing = enabled;
+    if (!enabled) {
+        flushPointerMove();
+    }
+}
 
-    case ModifyShape:
-        // 撤销修改操作：恢复旧的属性
-        if (op.shape && op.oldShape) {
-            // 交换新旧图形的属性
-            QColor tempColor = op.shape->getColor();
-            int tempLineWidth = op.shape->getLineWidth();
-            bool tempFilled = op.shape->isFilled();
-            QColor tempFillColor = op.shape->getFillColor();
-            QRectF tempRect = op.shape->getBoundingRect();
-
-            op.shape->setColor(op.oldShape->getColor());
-            op.shape->setLineWidth(op.oldShape->getLineWidth());
-            op.shape->setFilled(op.oldShape->isFilled());
-            op.shape->setFillColor(op.oldShape->getFillColor());
-            op.shape->setBoundingRect(op.oldShape->getBoundingRect());
-
-            op.oldShape->setColor(tempColor);
-            op.oldShape->setLineWidth(tempLineWidth);
-            op.oldShape->setFilled(tempFilled);
-            op.oldShape->setFillColor(tempFillColor);
-            op.oldShape->setBoundingRect(tempRect);
-        }
-        break;
+bool DrawingArea::isPointerCoalescing() const
+{
+    return m_pointerCoalescing;
+}
 
-    case MoveShape:
-    case ResizeShape:
-    case LayerChange:
-        // 撤销移动、调整大小和图层操作：恢复到原来的位置
-        if (op.shape) {
-            int currentIndex = m_shapes.indexOf(op.shape);
-            if (currentIndex != -1 && op.oldIndex != -1) {
-                // 确保目标索引在有效范围内
-                int targetIndex = qBound(0, op.oldIndex, m_shapes.size());
-                if (currentIndex != targetIndex) {
-                    m_shapes.move(currentIndex, targetIndex);
-                }
-            }
-        }
-        break;
+// 输入录制和重放
+bool DrawingArea::startRecording(const QString &filename, QString *errorString)
+{
+    // 录制从没有选中图形的状态开始，与重放时刚打开的文档一致
+    endInteraction();
+    clearSelection();
+    if (!m_inputRecorder.start(filename, errorString)) {
+        return false;
     }
 
-    update();
-    emit selectionChanged();
+    // 先记录窗口大小、视图位置和绘图设置，重放时从相同的状态开始
+    InputEvent resizeEvent;
+    resizeEvent.type = InputEvent::Resize;
+    resizeEvent.size = size();
+    m_inputRecorder.record(resizeEvent);
+    InputEvent origin = InputEvent::fromCommand(InputEvent::SetViewOrigin);
+    origin.pos = m_viewOrigin;
+    m_inputRecorder.record(origin);
+    m_inputRecorder.record(InputEvent::fromCommand(InputEvent::SetShapeType, m_currentShapeType));
+    m_inputRecorder.record(InputEvent::fromCommand(InputEvent::SetEditMode, m_editMode));
+    m_inputRecorder.record(InputEvent::fromCommand(InputEvent::SetColor, m_currentColor.rgba()));
+    m_inputRecorder.record(InputEvent::fromCommand(InputEvent::SetLineWidth, m_currentLineWidth));
+    m_inputRecorder.record(InputEvent::fromCommand(InputEvent::SetFilled, m_currentFilled));
+    m_inputRecorder.record(InputEvent::fromCommand(InputEvent::SetFillColor, m_currentFillColor.rgba()));
+    return true;
 }
 
-void DrawingArea::redo()
+void DrawingArea::stopRecording()
 {
-    if (m_redoStack.isEmpty()) return;
+    if (!m_inputRecorder.isRecording()) return;
 
-    Operation op = m_redoStack.takeLast();
-    m_undoStack.append(op);
+    m_inputRecorder.stop();
+    emit recordingStopped();
+}
 
-    // 在重做操作前清除当前选择，避免选择状态混乱
-    m_selectedShapes.clear();
+bool DrawingArea::isRecording() const
+{
+    return m_inputRecorder.isRecording();
+}
 
-    switch (op.type) {
-    case AddShape:
-        // 重做添加操作：重新添加图形
-        if (op.shape) {
-            if (op.oldIndex >= 0 && op.oldIndex < m_shapes.size()) {
-                m_shapes.insert(op.oldIndex, op.shape);
-            } else {
-                m_shapes.append(op.shape);
-            }
+void DrawingArea::replay(const InputEvent &event)
+{
+    if (event.type == InputEvent::Resize) {
+        resize(event.size);
+        return;
+    }
+    if (event.type != InputEvent::Command) {
+        // 通过事件分发进入与真实输入相同的处理函数
+        if (std::unique_ptr<QEvent> qtEvent = event.toEvent()) {
+            QCoreApplication::sendEvent(this, qtEvent.get());
         }
-        break;
+        return;
+    }
 
-    case DeleteShape:
-        // 重做删除操作：从列表中移除但不删除（延迟删除）
-        if (op.shape && m_shapes.contains(op.shape)) {
-            m_shapes.removeOne(op.shape);
-        }
+    switch (event.command) {
+    case InputEvent::SetShapeType:
+        setCurrentShapeType(Shape::ShapeType(event.argument));
         break;
-
-    case ModifyShape:
-        // 重做修改操作：恢复新的属性
-        if (op.shape && op.oldShape) {
-            // 再次交换新旧图形的属性
-            QColor tempColor = op.shape->getColor();
-            int tempLineWidth = op.shape->getLineWidth();
-            bool tempFilled = op.shape->isFilled();
-            QColor tempFillColor = op.shape->getFillColor();
-            QRectF tempRect = op.shape->getBoundingRect();
-
-            op.shape->setColor(op.oldShape->getColor());
-            op.shape->setLineWidth(op.oldShape->getLineWidth());
-            op.shape->setFilled(op.oldShape->isFilled());
-            op.shape->setFillColor(op.oldShape->getFillColor());
-            op.shape->setBoundingRect(op.oldShape->getBoundingRect());
-
-            op.oldShape->setColor(tempColor);
-            op.oldShape->setLineWidth(tempLineWidth);
-            op.oldShape->setFilled(tempFilled);
-            op.oldShape->setFillColor(tempFillColor);
-            op.oldShape->setBoundingRect(tempRect);
-        }
+    case InputEvent::SetEditMode:
+        setEditMode(EditMode(event.argument));
         break;
-
-    case MoveShape:
-    case ResizeShape:
-    case LayerChange:
-        // 重做移动、调整大小和图层操作：恢复到新的位置
-        if (op.shape) {
-            int currentIndex = m_shapes.indexOf(op.shape);
-            if (currentIndex != -1 && op.newIndex != -1) {
-                // 确保目标索引在有效范围内
-                int targetIndex = qBound(0, op.newIndex, m_shapes.size());
-                if (currentIndex != targetIndex) {
-                    m_shapes.move(currentIndex, targetIndex);
-                }
-            }
-        }
+    case InputEvent::SetColor:
+        setCurrentColor(QColor::fromRgba(QRgb(event.argument)));
+        break;
+    case InputEvent::SetLineWidth:
+        setCurrentLineWidth(int(event.argument));
+        break;
+    case InputEvent::SetFilled:
+        setCurrentFilled(event.argument != 0);
+        break;
+    case InputEvent::SetFillColor:
+        setCurrentFillColor(QColor::fromRgba(QRgb(event.argument)));
+        break;
+    case InputEvent::SetViewOrigin:
+        scrollView(event.pos.toPoint() - m_viewOrigin);
+        break;
+    case InputEvent::Undo:
+        undo();
+        break;
+    case InputEvent::Redo:
+        redo();
+        break;
+    case InputEvent::DeleteSelection:
+        deleteSelectedShapes();
+        break;
+    case InputEvent::SelectAll:
+        selectAll();
+        break;
+    case InputEvent::ClearSelection:
+        clearSelection();
+        break;
+    case InputEvent::MoveUp:
+        moveSelectedShapesUp();
+        break;
+    case InputEvent::MoveDown:
+        moveSelectedShapesDown();
+        break;
+    case InputEvent::MoveToTop:
+        moveSelectedShapesToTop();
+        break;
+    case InputEvent::MoveToBottom:
+        moveSelectedShapesToBottom();
+        break;
+    default:
         break;
     }
+}
 
-    update();
-    emit selectionChanged();
+// 撤销/重做相关方法
+bool DrawingArea::canUndo() const
+{
+    return m_document.canUndo();
 }
 
-void DrawingArea::addOperation(const Operation &op)
+bool DrawingArea::canRedo() const
 {
-    m_undoStack.append(op);
-    if (m_undoStack.size() > m_maxUndoSteps) {
-        // 移除最早的操作
-        Operation oldOp = m_undoStack.takeFirst();
-        if (oldOp.type == DeleteShape && oldOp.shape && !m_shapes.contains(oldOp.shape)) {
-            delete oldOp.shape;
-        }
-        if (oldOp.oldShape) {
-            delete oldOp.oldShape;
-        }
-    }
-    clearRedoStack();
+    return m_document.canRedo();
 }
 
-Shape *DrawingArea::cloneShape(Shape *original)
+void DrawingArea::undo()
 {
-    if (!original) return nullptr;
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::Undo);
+    if (!m_document.canUndo()) return;
 
-    Shape *clone = ShapeFactory::createShape(original->getType());
-    if (clone) {
-        clone->setColor(original->getColor());
-        clone->setLineWidth(original->getLineWidth());
-        clone->setFilled(original->isFilled());
-        clone->setFillColor(original->getFillColor());
-        clone->setBoundingRect(original->getBoundingRect());
-    }
-    return clone;
+    // 拖动中的图形先移动到位，避免撤销历史在应用事务的途中改变
+    endInteraction();
+
+    // 在撤销操作前清除当前选择，避免选择状态混乱
+    m_selectedShapes.clear();
+    m_document.undo();
+    invalidateScene();
+    emit selectionChanged();
 }
 
-void DrawingArea::clearRedoStack()
+void DrawingArea::redo()
 {
-    for (const Operation &op : m_redoStack) {
-        if (op.type == DeleteShape && op.shape && !m_shapes.contains(op.shape)) {
-            delete op.shape;
-        }
-        if (op.oldShape) {
-            delete op.oldShape;
-        }
-    }
-    m_redoStack.clear();
-}
\ No newline at end of file
+    InputRecorder::Scope input(&m_inputRecorder, InputEvent::Redo);
+    if (!m_document.canRedo()) return;
+
+    // 拖动中的图形先移动到位，避免撤销历史在应用事务的途中改变
+    endInteraction();
+
+    // 在撤销操作前清除当前选择，避免选择状态混乱
+    m_selectedShapes.clear();
+    m_document.redo();
+    invalidateScene();
+    emit selectionChanged();
+}
+
+void DrawingArea::beginTransaction()
+{
+    m_document.beginTransaction();
+}
+
+void DrawingArea::commitTransaction()
+{
+    m_document.commitTransaction();
+}
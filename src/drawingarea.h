@@ -3,9 +3,20 @@
 
 #include <QWidget>
 #include <QList>
+#include <QSet>
 #include <QPointF>
 #include <QPainterPath>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QElapsedTimer>
 #include "shape.h"
+#include "document.h"
+#include "tilecache.h"
+#include "ioprogress.h"
+#include "documentjournal.h"
+#include "documentio.h"
+#include "instrumentation.h"
+#include "inputrecorder.h"
 
 /**
  * @file drawingarea.h
@@ -20,7 +31,7 @@
  * @brief 绘图区域类
  * 
  * 负责图形的绘制、用户交互（如选择、移动、创建图形等）。
- * 管理图形的集合、撤销/重做栈、编辑模式等。
+ * 图形、撤销/重做和命中测试由Document负责，这里管理选择、编辑模式、交互和重绘。
  */
 class DrawingArea : public QWidget
 {
@@ -41,33 +52,14 @@ public:
     };
     
     /**
-     * @enum OperationType
-     * @brief 操作类型枚举
-     * 
-     * 定义了用于撤销/重做系统的不同操作类型。
-     */
-    enum OperationType { 
-        AddShape,      ///< 添加图形操作
-        DeleteShape,   ///< 删除图形操作
-        ModifyShape,   ///< 修改图形操作
-        MoveShape,     ///< 移动图形操作
-        ResizeShape,   ///< 调整图形大小操作
-        LayerChange    ///< 图层变更操作
-    };
+     * @brief 撤销操作，见UndoOperation
+     */
+    typedef Document::Operation Operation;
 
     /**
-     * @struct Operation
-     * @brief 操作结构体
-     * 
-     * 用于存储撤销/重做系统的操作信息。
-     */
-    struct Operation {
-        OperationType type;    ///< 操作类型
-        Shape *shape;          ///< 操作涉及的图形
-        Shape *oldShape;       ///< 用于存储修改前的形状
-        int oldIndex;          ///< 用于存储移动前的索引
-        int newIndex;          ///< 用于存储移动后的索引
-    };
+     * @brief 撤销事务，见UndoTransaction
+     */
+    typedef Document::Transaction Transaction;
 
     /**
      * @brief DrawingArea类的构造函数
@@ -164,24 +156,134 @@ public:
     void clearAll();
     
     /**
-     * @brief 保存图形到文件
+     * @brief 打开分页文档
+     * @param filename 文件名
+     * @return 如果打开成功，返回true，否则返回false
+     *
+     * 只读取页目录，图形在滚动到窗口中时才从文件中读取（见PagedDocument）。
+     * 视图移动到文档的左上角。打开失败时保留当前的图形。
+     */
+    bool openPagedDocument(const QString &filename);
+
+    /**
+     * @brief 以分页格式保存文档
      * @param filename 文件名
      * @return 如果保存成功，返回true，否则返回false
+     *
+     * 打开的分页文档保存到原来的文件时只写回修改过的页，否则写入完整的分页文档。
      */
-    bool saveToFile(const QString &filename);
-    
+    bool saveToPagedFile(const QString &filename);
+
+    /**
+     * @brief 判断当前是否打开了分页文档
+     * @return 如果是，返回true
+     *
+     * 此时文档中只有被选择过和新绘制的图形是Shape对象，其余图形保存在分页文档中。
+     */
+    bool isPagedDocument() const;
+
     /**
-     * @brief 从文件加载图形
+     * @brief 设置分页文档的页缓存容量
+     * @param bytes 字节数
+     */
+    void setPageCacheBudget(qint64 bytes);
+
+    /**
+     * @brief 获取分页文档的页缓存容量
+     * @return 字节数
+     */
+    qint64 getPageCacheBudget() const;
+
+    /**
+     * @brief 在后台线程中从文件加载图形
      * @param filename 文件名
-     * @return 如果加载成功，返回true，否则返回false
+     * @param binary 为true时按二进制格式读取，否则按文本格式读取
+     * @return 如果已有文件操作正在进行，返回false
+     *
+     * 读取完成后在GUI线程中一次性替换当前的所有图形。
+     * 进度通过fileOperationProgress()报告，结束时发出fileOperationFinished()。
      */
-    bool loadFromFile(const QString &filename);
+    bool startLoad(const QString &filename, bool binary);
+
+    /**
+     * @brief 在后台线程中保存图形到文件
+     * @param filename 文件名
+     * @param binary 为true时按二进制格式写入，否则按文本格式写入
+     * @return 如果已有文件操作正在进行，返回false
+     *
+     * 保存的是调用时文档的快照，保存期间可以继续编辑。
+     * 写入先进入临时文件，成功后才替换目标文件，取消或失败时目标文件保持不变。
+     *
+     * 启用增量保存时，再次保存同一个二进制文档只把变化追加到修改日志（见DocumentJournal）；
+     * 日志超过文档大小的一定比例时改为完整保存，同时删除日志。
+     */
+    bool startSave(const QString &filename, bool binary);
+
+    /**
+     * @brief 请求取消正在进行的后台文件操作
+     */
+    void cancelFileOperation();
+
+    /**
+     * @brief 判断是否有后台文件操作正在进行
+     * @return 如果有，返回true
+     */
+    bool isFileOperationRunning() const;
+
+    /**
+     * @brief 创建当前文档的快照
+     * @return 快照，只复制页指针，可以交给其他线程读取
+     */
+    ShapeStore::Snapshot snapshot() const;
+
+    /**
+     * @brief 获取文档的修订号
+     * @return 文档内容每次改变时递增
+     */
+    quint64 revision() const;
+
+    /**
+     * @brief 判断文档自上次保存或加载以来是否被修改
+     * @return 如果有未保存的修改，返回true
+     */
+    bool isModified() const;
+
+    /**
+     * @brief 设置文档是否有未保存的修改
+     * @param modified 为false时把当前内容视为已保存
+     *
+     * 例如从恢复文件打开的文档还没有保存到任何地方，需要标记为已修改。
+     */
+    void setModified(bool modified);
 
     /**
      * @brief 获取选中的图形列表
      * @return 选中的图形列表
      */
     QList<Shape *> selectedShapes() const;
+
+    /**
+     * @brief 获取指定位置最上层的图形
+     * @param pos 位置
+     * @return 包含该位置的最上层图形，如果没有，返回nullptr
+     *
+     * 通过空间索引只检查该位置附近的候选图形。
+     */
+    Shape *shapeAt(const QPointF &pos);
+
+    /**
+     * @brief 获取与指定矩形区域相交的图形
+     * @param rect 矩形区域
+     * @return 相交的图形列表，按图层顺序从上到下排列
+     */
+    QList<Shape *> shapesIntersecting(const QRectF &rect);
+
+    /**
+     * @brief 获取包含指定点的所有图形
+     * @param pos 位置
+     * @return 包含该点的图形列表，按图层顺序从上到下排列
+     */
+    QList<Shape *> shapesAt(const QPointF &pos);
     
     /**
      * @brief 选择所有图形
@@ -241,16 +343,148 @@ public:
     void redo();
     
     /**
-     * @brief 设置最大撤销步数
-     * @param steps 最大撤销步数
+     * @brief 开始一个事务
+     *
+     * 在commitTransaction()之前添加的操作合并为一个撤销步骤。
+     * 事务可以嵌套，最外层的事务提交时才写入撤销栈。
      */
-    void setMaxUndoSteps(int steps);
-    
+    void beginTransaction();
+
+    /**
+     * @brief 提交事务
+     *
+     * 如果事务中没有任何操作，则不产生撤销步骤。
+     */
+    void commitTransaction();
+
+    /**
+     * @brief 设置撤销历史的内存上限
+     * @param bytes 字节数
+     *
+     * 超出上限时移除最早的撤销步骤。
+     */
+    void setUndoMemoryBudget(qint64 bytes);
+
+    /**
+     * @brief 获取撤销历史的内存上限
+     * @return 字节数
+     */
+    qint64 getUndoMemoryBudget() const;
+
     /**
-     * @brief 获取最大撤销步数
-     * @return 最大撤销步数
+     * @brief 设置是否把超出内存上限的撤销历史写入临时文件
+     * @param enabled 为true时写入临时文件，否则直接丢弃
      */
-    int getMaxUndoSteps() const;
+    void setUndoSpillEnabled(bool enabled);
+
+    /**
+     * @brief 判断是否把超出内存上限的撤销历史写入临时文件
+     * @return 如果启用，返回true
+     */
+    bool isUndoSpillEnabled() const;
+
+    /**
+     * @brief 设置是否以追加修改日志的方式保存二进制文档
+     * @param enabled 是否启用
+     *
+     * 启用后记录文档的变化，从下一次完整保存或加载二进制文档开始追加日志。
+     */
+    void setJournaledSaveEnabled(bool enabled);
+
+    /**
+     * @brief 判断是否以追加修改日志的方式保存二进制文档
+     * @return 如果启用，返回true
+     */
+    bool isJournaledSaveEnabled() const;
+
+    /**
+     * @brief 设置自动压缩修改日志的比例
+     * @param ratio 日志长度超过文档大小的这一比例时，下次保存改为完整保存
+     */
+    void setJournalCompactionRatio(double ratio);
+
+    /**
+     * @brief 获取自动压缩修改日志的比例
+     * @return 日志长度与文档大小之比的上限
+     */
+    double getJournalCompactionRatio() const;
+
+    /**
+     * @brief 获取撤销历史压入的事务总数
+     */
+    qint64 getUndoPushCount() const;
+
+    /**
+     * @brief 获取撤销历史因超出内存上限而移出内存的事务总数
+     */
+    qint64 getUndoEvictedCount() const;
+
+    /**
+     * @brief 获取绘制和命中测试的性能计数器
+     * @return 计数器，每次paintEvent()为一帧
+     */
+    const Instrumentation &instrumentation() const;
+
+    /**
+     * @brief 设置是否在左上角显示性能信息
+     * @param visible 是否显示
+     */
+    void setHudVisible(bool visible);
+
+    /**
+     * @brief 判断是否在左上角显示性能信息
+     * @return 如果显示，返回true
+     */
+    bool isHudVisible() const;
+
+    /**
+     * @brief 设置是否合并鼠标移动
+     * @param enabled 为true时同一帧内的多个鼠标移动只应用最新的位置（默认）；
+     *        为false时每个鼠标移动都立即应用
+     *
+     * 合并依靠计时器在下一帧应用移动，连续送入事件而不等待计时器时（例如全速重放录制的输入），
+     * 中间的移动都会被合并掉，只有松开鼠标时才应用最后的位置。这种情况下应关闭合并，
+     * 使每个移动事件的处理时间计入它自己的延迟。关闭时立即应用尚未应用的移动。
+     */
+    void setPointerCoalescing(bool enabled);
+
+    /**
+     * @brief 判断是否合并鼠标移动
+     * @return 如果合并，返回true
+     */
+    bool isPointerCoalescing() const;
+
+    /**
+     * @brief 开始录制输入
+     * @param filename 录制文件
+     * @param errorString 失败时的错误信息
+     * @return 成功返回true
+     *
+     * 录制鼠标、滚轮、按键、窗口大小改变和来自主窗口的命令（绘图设置、撤销/重做、
+     * 选择、删除和图层操作）。开始时取消选择，并先记录窗口大小、视图位置和绘图设置。
+     * 撤销到录制开始之前的操作无法重放。清除或替换文档时自动结束录制。
+     */
+    bool startRecording(const QString &filename, QString *errorString);
+
+    /**
+     * @brief 结束录制输入
+     */
+    void stopRecording();
+
+    /**
+     * @brief 判断是否正在录制输入
+     * @return 如果正在录制，返回true
+     */
+    bool isRecording() const;
+
+    /**
+     * @brief 重放一个录制的事件
+     * @param event 事件
+     *
+     * 鼠标、滚轮和按键事件通过Qt事件分发，命令调用对应的公有函数，与录制时的路径相同。
+     * 鼠标移动是否被合并由setPointerCoalescing()决定，不按录制时的时间间隔送入事件时应关闭合并。
+     */
+    void replay(const InputEvent &event);
 
 signals:
     /**
@@ -264,6 +498,24 @@ signals:
      */
     void selectionChanged();
 
+    /**
+     * @brief 后台文件操作的进度改变时发出的信号
+     * @param percent 完成的百分比
+     */
+    void fileOperationProgress(int percent);
+
+    /**
+     * @brief 后台文件操作结束时发出的信号
+     * @param success 是否成功
+     * @param errorString 失败时的错误信息
+     */
+    void fileOperationFinished(bool success, const QString &errorString);
+
+    /**
+     * @brief 输入录制结束时发出的信号
+     */
+    void recordingStopped();
+
 protected:
     /**
      * @brief 重写绘图事件
@@ -280,6 +532,8 @@ protected:
     /**
      * @brief 重写鼠标移动事件
      * @param event 鼠标事件
+     *
+     * 只记录最新的位置，每帧最多应用一次，见applyPointerMove()。
      */
     void mouseMoveEvent(QMouseEvent *event) override;
     
@@ -295,8 +549,24 @@ protected:
      */
     void keyPressEvent(QKeyEvent *event) override;
 
+    /**
+     * @brief 重写滚轮事件
+     * @param event 滚轮事件
+     *
+     * 滚轮平移视图，按住Shift时水平平移。
+     */
+    void wheelEvent(QWheelEvent *event) override;
+
+    /**
+     * @brief 重写窗口大小改变事件
+     * @param event 大小改变事件
+     *
+     * 丢弃窗口外的瓦片缓存。
+     */
+    void resizeEvent(QResizeEvent *event) override;
+
 private:
-    QList<Shape *> m_shapes;              ///< 图形列表
+    Document m_document;                  ///< 图形、空间索引、撤销历史和分页文档
     Shape::ShapeType m_currentShapeType;  ///< 当前要创建的图形类型
     EditMode m_editMode;                  ///< 当前编辑模式
     QColor m_currentColor;                ///< 当前颜色
@@ -310,21 +580,101 @@ private:
     QPointF m_endPoint;       ///< 绘制结束点
     bool m_isDrawing;         ///< 是否正在绘制
 
+    // 视图相关
+    QPoint m_viewOrigin;      ///< 窗口左上角对应的场景坐标
+    QPoint m_panLastPos;      ///< 中键拖动平移时上一次的鼠标位置（窗口坐标）
+    bool m_isPanning;         ///< 是否正在用中键拖动平移
+
     // 选择和编辑相关
     QList<Shape *> m_selectedShapes;    ///< 选中的图形列表
-    QPointF m_lastMousePos;             ///< 上一次鼠标位置
+    QPointF m_lastMousePos;             ///< 上一次鼠标位置（场景坐标）
     bool m_isMoving;                    ///< 是否正在移动
     bool m_isResizing;                  ///< 是否正在调整大小
     int m_resizeHandle;                 ///< 调整大小的控制点
     
-    // 用于优化撤销机制的临时状态存储
-    QHash<Shape *, Shape *> m_moveStartPositions;  ///< 移动开始时的图形状态
-    Shape *m_resizeStartShape;                     ///< 调整大小开始时的图形状态
+    // 用于记录撤销信息的临时状态
+    QRectF m_resizeStartRect;    ///< 调整大小开始时的矩形
 
-    // 撤销/重做相关
-    QList<Operation> m_undoStack;    ///< 撤销栈
-    QList<Operation> m_redoStack;    ///< 重做栈
-    int m_maxUndoSteps;              ///< 最大撤销步数
+    // 静态场景缓存
+    TileCache m_tileCache;                 ///< 已提交图形的瓦片缓存
+    QList<Shape *> m_activeShapes;         ///< 正在移动或调整大小的图形，按图层顺序从下到上排列
+    QSet<const Shape *> m_activeShapeSet;  ///< m_activeShapes的集合形式，用于快速判断
+
+    // 拖动预览
+    bool m_dragPreview;                    ///< 是否以位图预览正在移动的图形
+    QImage m_dragSprite;                   ///< 交互中的图形及其选中框的位图
+    QRect m_dragSpriteRect;                ///< 位图覆盖的区域（场景坐标，拖动开始时的位置）
+    QRectF m_dragBounds;                   ///< 交互中的图形及其选中框的总边界（拖动开始时的位置）
+    QPointF m_dragOffset;                  ///< 尚未应用到图形的平移量
+
+    /**
+     * @struct FileResult
+     * @brief 后台文件操作的结果
+     */
+    struct FileResult {
+        bool success = false;       ///< 是否成功
+        QString errorString;        ///< 失败时的错误信息
+        QList<Shape *> shapes;      ///< 加载的图形
+        QString filename;           ///< 文件名
+        quint64 revision = 0;       ///< 保存的快照对应的文档修订号
+        DocumentJournal::State journal;  ///< 操作完成后文档及其修改日志的状态
+        qint64 bytes = 0;           ///< 读写的字节数
+        qint64 nsecs = 0;           ///< 读写的耗时（纳秒）
+    };
+
+    // 后台文件操作相关
+    QFutureWatcher<FileResult> m_fileWatcher;  ///< 监视后台文件操作
+    IoProgress m_fileProgress;                 ///< 后台文件操作的进度
+    QTimer m_fileProgressTimer;                ///< 定时报告进度
+    bool m_fileOperationRunning;               ///< 是否有后台文件操作正在进行
+    bool m_fileLoading;                        ///< 正在进行的是否为加载
+    quint64 m_cleanRevision;                   ///< 文档与文件一致时的修订号
+
+    // 增量保存相关
+    bool m_journalEnabled;                  ///< 是否以追加修改日志的方式保存二进制文档
+    double m_journalCompactionRatio;        ///< 日志超过文档大小的这一比例时改为完整保存
+    QString m_journalDocument;              ///< 可以追加日志的文档，为空表示下次保存需要完整保存
+    DocumentJournal::State m_journalState;  ///< m_journalDocument及其日志的状态
+
+    // 性能信息
+    mutable Instrumentation m_instrumentation;  ///< 性能计数器，工作线程绘制瓦片时也会累加
+    bool m_hudVisible;                          ///< 是否显示性能信息
+    QRect m_hudRect;                            ///< 上次绘制性能信息的区域（窗口坐标）
+    QTimer m_hudTimer;                          ///< 绘制后延迟刷新性能信息
+
+    // 输入录制
+    InputRecorder m_inputRecorder;              ///< 输入事件的录制器
+
+    // 鼠标移动的合并
+    QTimer m_pointerTimer;                      ///< 到下一帧时应用尚未应用的鼠标移动
+    QElapsedTimer m_pointerClock;               ///< 计算帧间隔和输入延迟的时钟
+    bool m_pointerCoalescing;                   ///< 是否合并同一帧内的鼠标移动
+    bool m_pointerPending;                      ///< 是否有尚未应用的鼠标移动
+    QPoint m_pendingPointerPos;                 ///< 最新的鼠标位置（窗口坐标）
+    qint64 m_pendingPointerTime;                ///< 尚未应用的最早一次鼠标移动的时刻（纳秒）
+    qint64 m_lastPointerUpdate;                 ///< 上次应用鼠标移动的时刻（纳秒），-1表示还没有
+    qint64 m_undisplayedInputTime;              ///< 已应用但尚未绘制的最早一次鼠标移动的时刻，-1表示没有
+
+    /**
+     * @brief 把窗口坐标转换为场景坐标
+     * @param pos 窗口坐标
+     * @return 场景坐标，图形的坐标都是场景坐标
+     */
+    QPointF toScene(const QPointF &pos) const;
+
+    /**
+     * @brief 获取窗口覆盖的场景区域
+     * @return 场景坐标的矩形
+     */
+    QRect viewRect() const;
+
+    /**
+     * @brief 平移视图
+     * @param delta 视图移动的距离，正值表示向右下方移动
+     *
+     * 窗口中已有的内容直接滚动，只重绘新露出的部分，远离窗口的瓦片被丢弃。
+     */
+    void scrollView(const QPoint &delta);
 
     /**
      * @brief 绘制橡皮筋效果
@@ -350,12 +700,96 @@ private:
     /**
      * @brief 选择指定位置的图形
      * @param pos 位置
+     *
+     * 文档中没有图形包含该位置时，选择分页图层中最上层的图形。分页文档中的图形只选择副本，
+     * 开始编辑时才从页中取出（见Document::pagedShapeAt()）。
      */
     void selectShapeAt(const QPointF &pos);
     
+    /**
+     * @brief 获取图形需要重绘的区域
+     * @param shape 图形
+     * @return 包含描边和选中控制点的矩形
+     */
+    QRectF dirtyBounds(const Shape *shape) const;
+
+    /**
+     * @brief 获取橡皮筋图形需要重绘的区域
+     * @return 包含描边的矩形
+     */
+    QRectF rubberBandBounds() const;
+
+    /**
+     * @brief 标记矩形区域需要重绘
+     * @param rect 需要重绘的区域
+     */
+    void invalidateRect(const QRectF &rect);
+
+    /**
+     * @brief 标记多个图形所在的区域需要重绘
+     * @param shapes 图形列表
+     *
+     * 不在交互中的图形，其所在的瓦片缓存也会失效。
+     */
+    void invalidateShapes(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 标记单个图形所在的区域需要重绘
+     * @param shape 图形
+     */
+    void invalidateShape(Shape *shape);
+
+    /**
+     * @brief 使整个场景失效并重绘
+     *
+     * 用于加载、撤销等无法确定变化范围的操作。
+     */
+    void invalidateScene();
+
+    /**
+     * @brief 开始交互式编辑
+     * @param shapes 将要移动或调整大小的图形
+     *
+     * 这些图形从瓦片缓存中分离出来，交互期间每帧单独绘制在静态场景之上。
+     * 交互中的编辑合并为一个撤销步骤，在endInteraction()时提交。
+     */
+    void beginInteraction(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 结束交互式编辑
+     *
+     * 拖动预览期间的平移量在这里应用到图形并记录为一个撤销步骤，然后将交互中的图形重新并入瓦片缓存。
+     */
+    void endInteraction();
+
+    /**
+     * @brief 开始拖动预览，在beginInteraction()之后调用
+     *
+     * 交互中的图形连同选中框只绘制一次位图，拖动时绘制平移后的位图，
+     * 图形本身在endInteraction()时才移动。静态场景仍由瓦片缓存提供。
+     */
+    void beginDragPreview();
+
+    /**
+     * @brief 确保拖动预览的位图覆盖窗口中可见的部分
+     *
+     * 位图只覆盖窗口附近的区域，拖动或平移超出这个范围时重新绘制。
+     */
+    void updateDragSprite();
+
+    /**
+     * @brief 绘制缺失的瓦片并存入缓存
+     * @param tiles 缺失的瓦片坐标
+     *
+     * 多个瓦片在全局线程池中并行绘制，结果在GUI线程中存入缓存。
+     */
+    void renderTiles(const QList<QPoint> &tiles);
+
     /**
      * @brief 移动选中的图形
      * @param offset 偏移量
+     *
+     * 只累计拖动预览的平移量，图形在endInteraction()时才移动。
      */
     void moveSelectedShapes(const QPointF &offset);
     
@@ -364,6 +798,14 @@ private:
      * @param pos 鼠标位置
      */
     void resizeSelectedShape(const QPointF &pos);
+
+    /**
+     * @brief 交互中第一次修改图形时，把选中的分页图形从页中取出
+     * @param shapes 交互中的图形
+     *
+     * 取出之前页中的记录仍在瓦片中，取出后使这些瓦片失效。
+     */
+    void takePagedShapes(const QList<Shape *> &shapes);
     
     /**
      * @brief 更新选中图形的属性
@@ -373,27 +815,54 @@ private:
     void updateSelectedShapeProperties();
 
     /**
-     * @brief 添加操作到撤销栈
-     * @param op 操作
+     * @brief 用新的图形替换文档中的所有图形
+     * @param shapes 按图层顺序排列的图形，所有权转移给文档
      */
-    void addOperation(const Operation &op);
-    
+    void replaceShapes(const QList<Shape *> &shapes);
+
     /**
-     * @brief 克隆图形
-     * @param original 原始图形
-     * @return 克隆的图形
+     * @brief 获取一帧的时长，取窗口所在屏幕的刷新率
+     * @return 纳秒
      */
-    Shape *cloneShape(Shape *original);
-    
+    qint64 framePeriod() const;
+
     /**
-     * @brief 清空重做栈
+     * @brief 把最新的鼠标位置应用到文档
+     *
+     * 平移量按与上一次应用的位置之差计算，合并的各次移动之和与逐个处理时相同。
      */
-    void clearRedoStack();
-    
+    void applyPointerMove();
+
     /**
-     * @brief 清空撤销和重做栈
+     * @brief 立即应用尚未应用的鼠标移动
+     *
+     * 处理其他输入之前调用，使它们看到的状态与逐个处理鼠标移动时一致。
+     */
+    void flushPointerMove();
+
+    /**
+     * @brief 按编辑模式和鼠标下的控制点更新鼠标光标
+     * @param pos 鼠标位置（场景坐标）
+     */
+    void updateCursor(const QPointF &pos);
+
+    /**
+     * @brief 在窗口左上角绘制性能信息
+     * @param painter 画笔，使用窗口坐标
+     */
+    void drawHud(QPainter *painter);
+
+    /**
+     * @brief 后台文件操作结束时在GUI线程中调用
+     */
+    void finishFileOperation();
+
+    /**
+     * @brief 记录与当前文档内容一致的文件及其修改日志的状态
+     * @param filename 文件名
+     * @param state 文档及其日志的状态，无效时下次保存需要完整保存
      */
-    void clearUndoRedoStacks();
+    void setJournalState(const QString &filename, const DocumentJournal::State &state);
 };
 
 #endif // DRAWINGAREA_H
\ No newline at end of file
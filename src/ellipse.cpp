@@ -17,6 +17,29 @@ Ellipse::~Ellipse()
 {
 }
 
+void *Ellipse::operator new(size_t size)
+{
+    if (size != sizeof(Ellipse)) {
+        return ::operator new(size);
+    }
+    return pool().allocate();
+}
+
+void Ellipse::operator delete(void *ptr, size_t size)
+{
+    if (size != sizeof(Ellipse)) {
+        ::operator delete(ptr);
+        return;
+    }
+    pool().deallocate(ptr);
+}
+
+ShapePool &Ellipse::pool()
+{
+    static ShapePool pool(sizeof(Ellipse));
+    return pool;
+}
+
 void Ellipse::draw(QPainter *painter)
 {
     painter->save();
@@ -98,7 +121,15 @@ void Ellipse::load(const QString &data)
 
 bool Ellipse::contains(const QPointF &point) const
 {
-    return createPath().contains(point);
+    // 使用椭圆方程判断，写成乘法形式以避免半轴为0时除零
+    QRectF rect = m_boundingRect.normalized();
+    if (!rect.contains(point)) return false;
+
+    qreal rx = rect.width() / 2.0;
+    qreal ry = rect.height() / 2.0;
+    qreal dx = point.x() - rect.center().x();
+    qreal dy = point.y() - rect.center().y();
+    return dx * dx * ry * ry + dy * dy * rx * rx <= rx * rx * ry * ry;
 }
 
 QPainterPath Ellipse::createPath() const
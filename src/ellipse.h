@@ -2,6 +2,7 @@
 #define ELLIPSE_H
 
 #include "shape.h"
+#include "shapepool.h"
 
 /**
  * @file ellipse.h
@@ -77,6 +78,28 @@ public:
      */
     bool contains(const QPointF &point) const override;
 
+    /**
+     * @brief 从椭圆内存池分配对象
+     * @param size 对象大小
+     * @return 内存地址
+     *
+     * 派生类的对象大小不同，此时改用全局分配。
+     */
+    static void *operator new(size_t size);
+
+    /**
+     * @brief 把对象归还给椭圆内存池
+     * @param ptr 内存地址
+     * @param size 对象大小
+     */
+    static void operator delete(void *ptr, size_t size);
+
+    /**
+     * @brief 获取椭圆对象使用的内存池
+     * @return 内存池
+     */
+    static ShapePool &pool();
+
 private:
     /**
      * @brief 创建椭圆的路径
@@ -0,0 +1,200 @@
+#include "hittester.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HITTESTER_SSE2
+#endif
+
+namespace {
+// 每次打包测试的候选数量，打包缓冲区放在栈上
+const int kChunkSize = 64;
+
+// 从存储中按行号打包的一批候选图形
+struct Chunk {
+    float lefts[kChunkSize];
+    float tops[kChunkSize];
+    float rights[kChunkSize];
+    float bottoms[kChunkSize];
+    quint8 hits[kChunkSize];
+};
+
+void pack(const ShapeStore &store, const int *rows, int count, Chunk &chunk)
+{
+    const float *lefts = store.lefts();
+    const float *tops = store.tops();
+    const float *rights = store.rights();
+    const float *bottoms = store.bottoms();
+    for (int i = 0; i < count; ++i) {
+        const int row = rows[i];
+        chunk.lefts[i] = lefts[row];
+        chunk.tops[i] = tops[row];
+        chunk.rights[i] = rights[row];
+        chunk.bottoms[i] = bottoms[row];
+    }
+}
+
+// 判断相对圆心的偏移(dx, dy)是否落在半轴为(rx, ry)的椭圆内，
+// 写成乘法形式以避免半轴为0时除零
+inline bool insideEllipse(qreal dx, qreal dy, qreal rx, qreal ry)
+{
+    return dx * dx * ry * ry + dy * dy * rx * rx <= rx * rx * ry * ry;
+}
+
+// 精确测试，与Rectangle::contains()和Ellipse::contains()使用相同的qreal公式
+bool pointHit(const QRectF &rect, Shape::ShapeType type, const QPointF &point)
+{
+    if (!rect.contains(point)) return false;
+    if (type != Shape::Ellipse) return true;
+
+    const qreal rx = rect.width() / 2.0;
+    const qreal ry = rect.height() / 2.0;
+    return insideEllipse(point.x() - rect.center().x(), point.y() - rect.center().y(), rx, ry);
+}
+
+bool rectHit(const QRectF &rect, Shape::ShapeType type, const QRectF &query)
+{
+    if (rect.left() > query.right() || rect.right() < query.left()
+        || rect.top() > query.bottom() || rect.bottom() < query.top()) {
+        return false;
+    }
+    if (type != Shape::Ellipse) return true;
+
+    // 取矩形内离圆心最近的点进行测试
+    const QPointF center = rect.center();
+    const qreal nx = qMin(qMax(center.x(), query.left()), query.right());
+    const qreal ny = qMin(qMax(center.y(), query.top()), query.bottom());
+    return insideEllipse(nx - center.x(), ny - center.y(), rect.width() / 2.0, rect.height() / 2.0);
+}
+
+#if defined(HITTESTER_SSE2)
+inline void storeMask(int mask, int width, quint8 *hits)
+{
+    for (int j = 0; j < width; ++j) {
+        hits[j] = quint8((mask >> j) & 1);
+    }
+}
+#endif
+}
+
+int HitTester::topmost(const ShapeStore &store, const QVector<int> &rows, const QPointF &point)
+{
+    const float x = float(point.x());
+    const float y = float(point.y());
+
+    // 从最上层的一批开始测试，命中后即可返回
+    Chunk chunk;
+    for (int end = rows.size(); end > 0; end -= kChunkSize) {
+        const int begin = qMax(0, end - kChunkSize);
+        const int count = end - begin;
+        pack(store, rows.constData() + begin, count, chunk);
+        testPoint(chunk.lefts, chunk.tops, chunk.rights, chunk.bottoms, count, x, y, chunk.hits);
+        for (int i = count - 1; i >= 0; --i) {
+            const int row = rows.at(begin + i);
+            if (chunk.hits[i] && pointHit(store.boundsAt(row), store.typeAt(row), point)) {
+                return row;
+            }
+        }
+    }
+    return -1;
+}
+
+QVector<int> HitTester::allHits(const ShapeStore &store, const QVector<int> &rows, const QPointF &point)
+{
+    const float x = float(point.x());
+    const float y = float(point.y());
+
+    QVector<int> result;
+    Chunk chunk;
+    for (int end = rows.size(); end > 0; end -= kChunkSize) {
+        const int begin = qMax(0, end - kChunkSize);
+        const int count = end - begin;
+        pack(store, rows.constData() + begin, count, chunk);
+        testPoint(chunk.lefts, chunk.tops, chunk.rights, chunk.bottoms, count, x, y, chunk.hits);
+        for (int i = count - 1; i >= 0; --i) {
+            const int row = rows.at(begin + i);
+            if (chunk.hits[i] && pointHit(store.boundsAt(row), store.typeAt(row), point)) {
+                result.append(row);
+            }
+        }
+    }
+    return result;
+}
+
+QVector<int> HitTester::allHits(const ShapeStore &store, const QVector<int> &rows, const QRectF &rect)
+{
+    const QRectF query = rect.normalized();
+
+    QVector<int> result;
+    Chunk chunk;
+    for (int end = rows.size(); end > 0; end -= kChunkSize) {
+        const int begin = qMax(0, end - kChunkSize);
+        const int count = end - begin;
+        pack(store, rows.constData() + begin, count, chunk);
+        testRect(chunk.lefts, chunk.tops, chunk.rights, chunk.bottoms, count, query, chunk.hits);
+        for (int i = count - 1; i >= 0; --i) {
+            const int row = rows.at(begin + i);
+            if (chunk.hits[i] && rectHit(store.boundsAt(row), store.typeAt(row), query)) {
+                result.append(row);
+            }
+        }
+    }
+    return result;
+}
+
+void HitTester::testPoint(const float *lefts, const float *tops, const float *rights,
+                          const float *bottoms, int count, float x, float y, quint8 *hits)
+{
+    int i = 0;
+
+#if defined(HITTESTER_SSE2)
+    const __m128 px = _mm_set1_ps(x);
+    const __m128 py = _mm_set1_ps(y);
+    for (; i + 4 <= count; i += 4) {
+        __m128 l = _mm_loadu_ps(lefts + i);
+        __m128 t = _mm_loadu_ps(tops + i);
+        __m128 r = _mm_loadu_ps(rights + i);
+        __m128 b = _mm_loadu_ps(bottoms + i);
+
+        __m128 inBox = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(px, l), _mm_cmple_ps(px, r)),
+                                  _mm_and_ps(_mm_cmpge_ps(py, t), _mm_cmple_ps(py, b)));
+        storeMask(_mm_movemask_ps(inBox), 4, hits + i);
+    }
+#endif
+
+    // 剩余不足一批的图形逐个测试
+    for (; i < count; ++i) {
+        hits[i] = (x >= lefts[i] && x <= rights[i] && y >= tops[i] && y <= bottoms[i]) ? 1 : 0;
+    }
+}
+
+void HitTester::testRect(const float *lefts, const float *tops, const float *rights,
+                         const float *bottoms, int count, const QRectF &rect, quint8 *hits)
+{
+    const float ql = float(rect.left());
+    const float qt = float(rect.top());
+    const float qr = float(rect.right());
+    const float qb = float(rect.bottom());
+    int i = 0;
+
+#if defined(HITTESTER_SSE2)
+    const __m128 vl = _mm_set1_ps(ql);
+    const __m128 vt = _mm_set1_ps(qt);
+    const __m128 vr = _mm_set1_ps(qr);
+    const __m128 vb = _mm_set1_ps(qb);
+    for (; i + 4 <= count; i += 4) {
+        __m128 l = _mm_loadu_ps(lefts + i);
+        __m128 t = _mm_loadu_ps(tops + i);
+        __m128 r = _mm_loadu_ps(rights + i);
+        __m128 b = _mm_loadu_ps(bottoms + i);
+
+        __m128 overlap = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(l, vr), _mm_cmpge_ps(r, vl)),
+                                    _mm_and_ps(_mm_cmple_ps(t, vb), _mm_cmpge_ps(b, vt)));
+        storeMask(_mm_movemask_ps(overlap), 4, hits + i);
+    }
+#endif
+
+    // 剩余不足一批的图形逐个测试
+    for (; i < count; ++i) {
+        hits[i] = (lefts[i] <= qr && rights[i] >= ql && tops[i] <= qb && bottoms[i] >= qt) ? 1 : 0;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef HITTESTER_H
+#define HITTESTER_H
+
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+#include "shapestore.h"
+
+/**
+ * @file hittester.h
+ * @brief 批量点击测试类的头文件
+ *
+ * 这个文件定义了HitTester类，对一批图形同时进行点击测试。
+ * 测试直接使用边界矩形和椭圆参数的解析公式，不需要为每个图形构造QPainterPath。
+ */
+
+/**
+ * @class HitTester
+ * @brief 矩形和椭圆的批量点击测试
+ *
+ * 候选图形的边界被打包为连续的float数组，然后按批测试边界矩形：
+ * 支持SSE2时（x86-64上总是支持）每条指令测试4个图形，否则逐个测试。
+ * float按就近舍入是单调的，所以这一步不会漏掉命中的图形，只会多出边界附近的候选；
+ * 通过的候选再按存储中的qreal边界逐个精确测试，结果与Shape::contains()一致。
+ * 椭圆以边界矩形的内切椭圆计算，其他类型的图形按边界矩形计算。
+ *
+ * 候选行号必须从小到大排列（即按图层顺序从下到上）。
+ */
+class HitTester
+{
+public:
+    /**
+     * @brief 查找包含指定点的最上层图形
+     * @param store 图形存储
+     * @param rows 候选行号，从小到大排列
+     * @param point 测试点
+     * @return 命中的行号，如果没有命中，返回-1
+     */
+    static int topmost(const ShapeStore &store, const QVector<int> &rows, const QPointF &point);
+
+    /**
+     * @brief 查找所有包含指定点的图形
+     * @param store 图形存储
+     * @param rows 候选行号，从小到大排列
+     * @param point 测试点
+     * @return 命中的行号，从大到小（从上到下）排列
+     */
+    static QVector<int> allHits(const ShapeStore &store, const QVector<int> &rows, const QPointF &point);
+
+    /**
+     * @brief 查找所有与指定矩形相交的图形
+     * @param store 图形存储
+     * @param rows 候选行号，从小到大排列
+     * @param rect 测试矩形
+     * @return 命中的行号，从大到小（从上到下）排列
+     */
+    static QVector<int> allHits(const ShapeStore &store, const QVector<int> &rows, const QRectF &rect);
+
+    /**
+     * @brief 对连续数组中的边界矩形进行点测试
+     * @param lefts 左边界数组
+     * @param tops 上边界数组
+     * @param rights 右边界数组
+     * @param bottoms 下边界数组
+     * @param count 图形数量
+     * @param x 测试点的横坐标
+     * @param y 测试点的纵坐标
+     * @param hits 输出数组，点落在边界矩形内的位置写入1，否则写入0
+     */
+    static void testPoint(const float *lefts, const float *tops, const float *rights,
+                          const float *bottoms, int count, float x, float y, quint8 *hits);
+
+    /**
+     * @brief 对连续数组中的边界矩形进行矩形相交测试
+     * @param lefts 左边界数组
+     * @param tops 上边界数组
+     * @param rights 右边界数组
+     * @param bottoms 下边界数组
+     * @param count 图形数量
+     * @param rect 规范化的测试矩形
+     * @param hits 输出数组，边界矩形与测试矩形相交的位置写入1，否则写入0
+     */
+    static void testRect(const float *lefts, const float *tops, const float *rights,
+                         const float *bottoms, int count, const QRectF &rect, quint8 *hits);
+};
+
+#endif // HITTESTER_H
@@ -0,0 +1,362 @@
+#include "inputrecorder.h"
+#include "undobuffer.h"
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QResizeEvent>
+#include <QWheelEvent>
+#include <cstring>
+
+namespace {
+const char kMagic[8] = { '\x89', 'Q', 'G', 'R', '\r', '\n', '\x1a', '\n' };
+const quint32 kVersion = 1;
+
+// 缓冲的事件超过这么多字节时写入文件
+const int kFlushSize = 64 * 1024;
+
+// 修饰键占用Qt::KeyboardModifier的高位，右移后只需一个字节
+const int kModifierShift = 25;
+
+// 编码一个事件，不包括类型和时间戳之前的长度
+void encode(QByteArray *buffer, const InputEvent &event, qint64 delta)
+{
+    quintptr lastPointer = 0;
+    UndoWriter writer(buffer, &lastPointer);
+    writer.writeByte(quint8(event.type));
+    writer.writeUInt(quint64(qMax<qint64>(0, delta)));
+
+    switch (event.type) {
+    case InputEvent::MousePress:
+    case InputEvent::MouseMove:
+    case InputEvent::MouseRelease:
+        writer.writeReal(event.pos.x());
+        writer.writeReal(event.pos.y());
+        writer.writeUInt(quint32(event.button));
+        writer.writeUInt(quint32(event.buttons));
+        writer.writeUInt(quint32(event.modifiers) >> kModifierShift);
+        break;
+
+    case InputEvent::Wheel:
+        writer.writeReal(event.pos.x());
+        writer.writeReal(event.pos.y());
+        writer.writeInt(event.angleDelta.x());
+        writer.writeInt(event.angleDelta.y());
+        writer.writeInt(event.pixelDelta.x());
+        writer.writeInt(event.pixelDelta.y());
+        writer.writeUInt(quint32(event.buttons));
+        writer.writeUInt(quint32(event.modifiers) >> kModifierShift);
+        break;
+
+    case InputEvent::KeyPress: {
+        writer.writeUInt(quint32(event.key));
+        writer.writeUInt(quint32(event.modifiers) >> kModifierShift);
+        const QByteArray text = event.text.toUtf8();
+        writer.writeUInt(quint64(text.size()));
+        buffer->append(text);
+        break;
+    }
+
+    case InputEvent::Resize:
+        writer.writeUInt(quint64(qMax(0, event.size.width())));
+        writer.writeUInt(quint64(qMax(0, event.size.height())));
+        break;
+
+    case InputEvent::Command:
+        writer.writeUInt(quint64(event.command));
+        writer.writeInt(event.argument);
+        if (event.command == InputEvent::SetViewOrigin) {
+            writer.writeReal(event.pos.x());
+            writer.writeReal(event.pos.y());
+        }
+        break;
+    }
+}
+
+bool decode(const QByteArray &data, InputEvent *event, qint64 *delta)
+{
+    UndoReader reader(data);
+    const quint8 type = reader.readByte();
+    if (type > InputEvent::Command) return false;
+    event->type = InputEvent::Type(type);
+    *delta = qint64(reader.readUInt());
+
+    switch (event->type) {
+    case InputEvent::MousePress:
+    case InputEvent::MouseMove:
+    case InputEvent::MouseRelease: {
+        const qreal x = reader.readReal();
+        event->pos = QPointF(x, reader.readReal());
+        event->button = int(reader.readUInt());
+        event->buttons = int(reader.readUInt());
+        event->modifiers = int(reader.readUInt() << kModifierShift);
+        break;
+    }
+
+    case InputEvent::Wheel: {
+        const qreal x = reader.readReal();
+        event->pos = QPointF(x, reader.readReal());
+        const int angleX = int(reader.readInt());
+        event->angleDelta = QPoint(angleX, int(reader.readInt()));
+        const int pixelX = int(reader.readInt());
+        event->pixelDelta = QPoint(pixelX, int(reader.readInt()));
+        event->buttons = int(reader.readUInt());
+        event->modifiers = int(reader.readUInt() << kModifierShift);
+        break;
+    }
+
+    case InputEvent::KeyPress: {
+        event->key = int(reader.readUInt());
+        event->modifiers = int(reader.readUInt() << kModifierShift);
+        QByteArray text;
+        for (quint64 n = reader.readUInt(); n > 0 && !reader.atEnd(); --n) {
+            text.append(char(reader.readByte()));
+        }
+        event->text = QString::fromUtf8(text);
+        break;
+    }
+
+    case InputEvent::Resize: {
+        const int width = int(reader.readUInt());
+        event->size = QSize(width, int(reader.readUInt()));
+        break;
+    }
+
+    case InputEvent::Command:
+        event->command = int(reader.readUInt());
+        event->argument = reader.readInt();
+        if (event->command == InputEvent::SetViewOrigin) {
+            const qreal x = reader.readReal();
+            event->pos = QPointF(x, reader.readReal());
+        }
+        break;
+    }
+    return true;
+}
+
+// 读取帧长度，数据不完整时返回false
+bool readLength(const char *data, qint64 size, qint64 *pos, qint64 *length)
+{
+    quint64 value = 0;
+    int shift = 0;
+    while (*pos < size && shift < 64) {
+        const quint8 byte = quint8(data[(*pos)++]);
+        value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *length = qint64(value);
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+}
+
+InputEvent InputEvent::fromEvent(const QEvent *event)
+{
+    InputEvent result;
+    switch (event->type()) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::MouseMove:
+    case QEvent::MouseButtonRelease: {
+        const QMouseEvent *mouse = static_cast<const QMouseEvent *>(event);
+        result.type = event->type() == QEvent::MouseMove ? MouseMove
+                    : event->type() == QEvent::MouseButtonRelease ? MouseRelease : MousePress;
+        result.pos = mouse->position();
+        result.button = int(mouse->button());
+        result.buttons = int(mouse->buttons());
+        result.modifiers = int(mouse->modifiers());
+        break;
+    }
+
+    case QEvent::Wheel: {
+        const QWheelEvent *wheel = static_cast<const QWheelEvent *>(event);
+        result.type = Wheel;
+        result.pos = wheel->position();
+        result.angleDelta = wheel->angleDelta();
+        result.pixelDelta = wheel->pixelDelta();
+        result.buttons = int(wheel->buttons());
+        result.modifiers = int(wheel->modifiers());
+        break;
+    }
+
+    case QEvent::KeyPress: {
+        const QKeyEvent *key = static_cast<const QKeyEvent *>(event);
+        result.type = KeyPress;
+        result.key = key->key();
+        result.modifiers = int(key->modifiers());
+        result.text = key->text();
+        break;
+    }
+
+    case QEvent::Resize:
+        result.type = Resize;
+        result.size = static_cast<const QResizeEvent *>(event)->size();
+        break;
+
+    default:
+        break;
+    }
+    return result;
+}
+
+InputEvent InputEvent::fromCommand(CommandId command, qint64 argument)
+{
+    InputEvent result;
+    result.type = Command;
+    result.command = command;
+    result.argument = argument;
+    return result;
+}
+
+std::unique_ptr<QEvent> InputEvent::toEvent() const
+{
+    const Qt::KeyboardModifiers keyModifiers(modifiers);
+    switch (type) {
+    case MousePress:
+    case MouseMove:
+    case MouseRelease: {
+        const QEvent::Type eventType = type == MousePress ? QEvent::MouseButtonPress
+                                     : type == MouseMove ? QEvent::MouseMove : QEvent::MouseButtonRelease;
+        return std::make_unique<QMouseEvent>(eventType, pos, pos, Qt::MouseButton(button),
+                                             Qt::MouseButtons(buttons), keyModifiers);
+    }
+
+    case Wheel:
+        return std::make_unique<QWheelEvent>(pos, pos, pixelDelta, angleDelta, Qt::MouseButtons(buttons),
+                                             keyModifiers, Qt::NoScrollPhase, false);
+
+    case KeyPress:
+        return std::make_unique<QKeyEvent>(QEvent::KeyPress, key, keyModifiers, text);
+
+    default:
+        return nullptr;
+    }
+}
+
+QString InputEvent::name() const
+{
+    static const char *const typeNames[] = {
+        "MousePress", "MouseMove", "MouseRelease", "Wheel", "KeyPress", "Resize"
+    };
+    static const char *const commandNames[] = {
+        "SetShapeType", "SetEditMode", "SetColor", "SetLineWidth", "SetFilled", "SetFillColor",
+        "SetViewOrigin", "Undo", "Redo", "DeleteSelection", "SelectAll", "ClearSelection",
+        "MoveUp", "MoveDown", "MoveToTop", "MoveToBottom"
+    };
+    if (type != Command) {
+        return QString(typeNames[type]);
+    }
+    if (command >= 0 && command <= MoveToBottom) {
+        return QString(commandNames[command]);
+    }
+    return QString("Command%1").arg(command);
+}
+
+InputRecorder::InputRecorder()
+    : m_lastTime(0),
+      m_depth(0)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+    stop();
+}
+
+bool InputRecorder::start(const QString &filename, QString *errorString)
+{
+    stop();
+
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (errorString) *errorString = m_file.errorString();
+        return false;
+    }
+
+    m_buffer.clear();
+    m_buffer.append(kMagic, sizeof(kMagic));
+    quintptr lastPointer = 0;
+    UndoWriter(&m_buffer, &lastPointer).writeUInt(kVersion);
+    m_lastTime = 0;
+    m_clock.start();
+    return true;
+}
+
+void InputRecorder::stop()
+{
+    if (!m_file.isOpen()) return;
+
+    flush();
+    m_file.close();
+}
+
+bool InputRecorder::isRecording() const
+{
+    return m_file.isOpen();
+}
+
+void InputRecorder::record(InputEvent event)
+{
+    if (!isRecording()) return;
+
+    event.time = m_clock.nsecsElapsed() / 1000;
+    QByteArray frame;
+    encode(&frame, event, event.time - m_lastTime);
+    m_lastTime = event.time;
+
+    // 每个事件前写入长度，文件被截断时能识别出不完整的最后一个事件
+    quintptr lastPointer = 0;
+    UndoWriter(&m_buffer, &lastPointer).writeUInt(quint64(frame.size()));
+    m_buffer.append(frame);
+    if (m_buffer.size() >= kFlushSize) {
+        flush();
+    }
+}
+
+void InputRecorder::flush()
+{
+    if (!m_buffer.isEmpty()) {
+        m_file.write(m_buffer);
+        m_buffer.clear();
+    }
+    m_file.flush();
+}
+
+bool InputRecorder::read(const QString &filename, QList<InputEvent> *events, QString *errorString)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString) *errorString = file.errorString();
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    if (data.size() < qsizetype(sizeof(kMagic)) || std::memcmp(data.constData(), kMagic, sizeof(kMagic)) != 0) {
+        if (errorString) *errorString = "不是输入录制文件";
+        return false;
+    }
+
+    qint64 pos = sizeof(kMagic);
+    qint64 version = 0;
+    if (!readLength(data.constData(), data.size(), &pos, &version) || version != kVersion) {
+        if (errorString) *errorString = QString("不支持的录制文件版本：%1").arg(version);
+        return false;
+    }
+
+    qint64 time = 0;
+    qint64 length = 0;
+    while (readLength(data.constData(), data.size(), &pos, &length)) {
+        if (length <= 0 || pos + length > data.size()) break;
+
+        InputEvent event;
+        qint64 delta = 0;
+        if (!decode(QByteArray::fromRawData(data.constData() + pos, length), &event, &delta)) {
+            if (errorString) *errorString = QString("录制文件在偏移%1处损坏").arg(pos);
+            return false;
+        }
+        time += delta;
+        event.time = time;
+        events->append(event);
+        pos += length;
+    }
+    return true;
+}
@@ -0,0 +1,221 @@
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QPoint>
+#include <QPointF>
+#include <QSize>
+#include <QString>
+#include <memory>
+
+class QEvent;
+
+/**
+ * @file inputrecorder.h
+ * @brief 输入录制的头文件
+ *
+ * 这个文件定义了InputEvent结构体和InputRecorder类，把绘图区域收到的鼠标、键盘事件
+ * 和来自主窗口的命令连同时间戳写入紧凑的文件，之后可以按原来的顺序重放。
+ */
+
+/**
+ * @struct InputEvent
+ * @brief 录制的一个输入事件
+ *
+ * 鼠标和键盘事件保存重放所需的字段，可以与Qt事件相互转换；
+ * 命令对应DrawingArea的公有函数，由DrawingArea::replay()调用同一个函数。
+ */
+struct InputEvent {
+    /**
+     * @brief 事件类型
+     */
+    enum Type {
+        MousePress,     ///< 鼠标按下
+        MouseMove,      ///< 鼠标移动
+        MouseRelease,   ///< 鼠标释放
+        Wheel,          ///< 滚轮
+        KeyPress,       ///< 按键
+        Resize,         ///< 窗口大小改变
+        Command         ///< 命令
+    };
+
+    /**
+     * @brief 命令，参数见各项说明
+     */
+    enum CommandId {
+        SetShapeType,     ///< 设置图形类型，参数为Shape::ShapeType
+        SetEditMode,      ///< 设置编辑模式，参数为DrawingArea::EditMode
+        SetColor,         ///< 设置颜色，参数为ARGB
+        SetLineWidth,     ///< 设置线宽
+        SetFilled,        ///< 设置是否填充
+        SetFillColor,     ///< 设置填充颜色，参数为ARGB
+        SetViewOrigin,    ///< 设置视图原点，参数为pos
+        Undo,             ///< 撤销
+        Redo,             ///< 重做
+        DeleteSelection,  ///< 删除选中的图形
+        SelectAll,        ///< 全选
+        ClearSelection,   ///< 取消选择
+        MoveUp,           ///< 上移一层
+        MoveDown,         ///< 下移一层
+        MoveToTop,        ///< 移到最上层
+        MoveToBottom      ///< 移到最下层
+    };
+
+    Type type = MouseMove;    ///< 事件类型
+    qint64 time = 0;          ///< 相对于开始录制的时间（微秒）
+    QPointF pos;              ///< 鼠标位置（窗口坐标），SetViewOrigin命令的视图原点
+    int button = 0;           ///< 触发事件的鼠标按键
+    int buttons = 0;          ///< 按下的鼠标按键
+    int modifiers = 0;        ///< 键盘修饰键
+    QPoint angleDelta;        ///< 滚轮的角度
+    QPoint pixelDelta;        ///< 滚轮的像素距离
+    int key = 0;              ///< 按键
+    QString text;             ///< 按键产生的文本
+    QSize size;               ///< 窗口大小
+    int command = 0;          ///< 命令
+    qint64 argument = 0;      ///< 命令的参数
+
+    /**
+     * @brief 从Qt事件创建
+     * @param event 鼠标、滚轮、按键或大小改变事件
+     * @return 输入事件，其他类型的事件返回MouseMove类型的空事件
+     */
+    static InputEvent fromEvent(const QEvent *event);
+
+    /**
+     * @brief 创建命令
+     * @param command 命令
+     * @param argument 参数
+     */
+    static InputEvent fromCommand(CommandId command, qint64 argument = 0);
+
+    /**
+     * @brief 转换为Qt事件
+     * @return 鼠标、滚轮或按键事件，其他类型返回nullptr
+     */
+    std::unique_ptr<QEvent> toEvent() const;
+
+    /**
+     * @brief 获取事件类型的名称，用于报告
+     */
+    QString name() const;
+};
+
+/**
+ * @class InputRecorder
+ * @brief 输入事件的录制器
+ *
+ * 文件以8字节的魔数和版本号开头，之后依次是各个事件，整数和坐标使用与撤销记录
+ * 相同的变长编码（见UndoWriter），时间戳按与上一个事件的差值编码，
+ * 一次鼠标移动通常只占十个字节左右。事件先追加到内存缓冲区，积累到一定大小再写入文件。
+ *
+ * 处理一个事件时可能调用其他会被录制的函数（例如鼠标点击时取消选择），
+ * 用Scope标记录制范围，只有最外层的事件被录制，重放时由它重新引发内层的调用。
+ */
+class InputRecorder
+{
+public:
+    /**
+     * @class Scope
+     * @brief 在作用域内录制一个事件
+     *
+     * 未录制时只增减嵌套层数，不创建InputEvent。
+     */
+    class Scope
+    {
+    public:
+        /**
+         * @brief 录制Qt事件
+         */
+        Scope(InputRecorder *recorder, const QEvent *event)
+            : m_recorder(recorder)
+        {
+            if (m_recorder->m_depth++ == 0 && m_recorder->isRecording()) {
+                m_recorder->record(InputEvent::fromEvent(event));
+            }
+        }
+
+        /**
+         * @brief 录制命令
+         */
+        Scope(InputRecorder *recorder, InputEvent::CommandId command, qint64 argument = 0)
+            : m_recorder(recorder)
+        {
+            if (m_recorder->m_depth++ == 0 && m_recorder->isRecording()) {
+                m_recorder->record(InputEvent::fromCommand(command, argument));
+            }
+        }
+
+        ~Scope()
+        {
+            --m_recorder->m_depth;
+        }
+
+    private:
+        Q_DISABLE_COPY(Scope)
+
+        InputRecorder *m_recorder;   ///< 录制器
+    };
+
+    /**
+     * @brief InputRecorder类的构造函数
+     */
+    InputRecorder();
+
+    /**
+     * @brief InputRecorder类的析构函数，结束录制
+     */
+    ~InputRecorder();
+
+    /**
+     * @brief 开始录制
+     * @param filename 录制文件
+     * @param errorString 失败时的错误信息
+     * @return 成功返回true
+     */
+    bool start(const QString &filename, QString *errorString);
+
+    /**
+     * @brief 结束录制，把缓冲的事件写入文件
+     */
+    void stop();
+
+    /**
+     * @brief 判断是否正在录制
+     */
+    bool isRecording() const;
+
+    /**
+     * @brief 录制一个事件，时间戳取当前时间
+     * @param event 事件
+     */
+    void record(InputEvent event);
+
+    /**
+     * @brief 读取录制文件
+     * @param filename 录制文件
+     * @param events 读取的事件
+     * @param errorString 失败时的错误信息
+     * @return 成功返回true。文件末尾不完整的事件被忽略
+     */
+    static bool read(const QString &filename, QList<InputEvent> *events, QString *errorString);
+
+private:
+    Q_DISABLE_COPY(InputRecorder)
+
+    /**
+     * @brief 把缓冲区写入文件
+     */
+    void flush();
+
+    QFile m_file;             ///< 录制文件
+    QByteArray m_buffer;      ///< 未写入文件的事件
+    QElapsedTimer m_clock;    ///< 开始录制后的时间
+    qint64 m_lastTime;        ///< 上一个事件的时间戳
+    int m_depth;              ///< Scope的嵌套层数
+};
+
+#endif // INPUTRECORDER_H
@@ -0,0 +1,156 @@
+#include "instrumentation.h"
+#include <algorithm>
+
+namespace {
+// 百分位数统计最近这么多个样本，按每秒60帧约为4秒
+const int kHistory = 240;
+}
+
+QAtomicInteger<qint64> Instrumentation::s_allocations(0);
+
+double Instrumentation::Throughput::bytesPerSecond() const
+{
+    return nsecs > 0 ? bytes * 1e9 / nsecs : 0.0;
+}
+
+void Instrumentation::Samples::add(qint64 value)
+{
+    if (values.size() < kHistory) {
+        values.append(value);
+    } else {
+        values[next] = value;
+    }
+    next = (next + 1) % kHistory;
+}
+
+qint64 Instrumentation::Samples::last() const
+{
+    if (values.isEmpty()) return 0;
+    return values.at((next + kHistory - 1) % kHistory);
+}
+
+qint64 Instrumentation::Samples::percentile(double percentile) const
+{
+    if (values.isEmpty()) return 0;
+
+    // 每秒最多调用几次，复制后部分排序即可
+    QVector<qint64> sorted = values;
+    const int rank = qBound(0, int(percentile / 100.0 * sorted.size() + 0.5) - 1, int(sorted.size()) - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted.at(rank);
+}
+
+void Instrumentation::Samples::clear()
+{
+    values.clear();
+    next = 0;
+}
+
+Instrumentation::Instrumentation()
+{
+    reset();
+}
+
+void Instrumentation::beginFrame()
+{
+    m_frameAllocations = allocationCount();
+}
+
+void Instrumentation::endFrame(qint64 nsecs)
+{
+    m_current[Allocations].fetchAndAddRelaxed(allocationCount() - m_frameAllocations);
+
+    for (int i = 0; i < CounterCount; ++i) {
+        m_last[i] = m_current[i].fetchAndStoreRelaxed(0);
+        m_total[i] += m_last[i];
+    }
+    ++m_frameCount;
+    m_frameTimes.add(nsecs);
+}
+
+qint64 Instrumentation::lastFrame(Counter counter) const
+{
+    return m_last[counter];
+}
+
+qint64 Instrumentation::total(Counter counter) const
+{
+    return m_total[counter];
+}
+
+qint64 Instrumentation::frameCount() const
+{
+    return m_frameCount;
+}
+
+qint64 Instrumentation::lastFrameTime() const
+{
+    return m_frameTimes.last();
+}
+
+qint64 Instrumentation::frameTimePercentile(double percentile) const
+{
+    return m_frameTimes.percentile(percentile);
+}
+
+int Instrumentation::frameSampleCount() const
+{
+    return m_frameTimes.values.size();
+}
+
+void Instrumentation::recordInputLatency(qint64 nsecs)
+{
+    m_inputLatencies.add(nsecs);
+}
+
+qint64 Instrumentation::inputLatencyPercentile(double percentile) const
+{
+    return m_inputLatencies.percentile(percentile);
+}
+
+int Instrumentation::inputLatencySampleCount() const
+{
+    return m_inputLatencies.values.size();
+}
+
+void Instrumentation::recordLoad(qint64 bytes, qint64 nsecs)
+{
+    m_lastLoad.bytes = bytes;
+    m_lastLoad.nsecs = nsecs;
+}
+
+void Instrumentation::recordSave(qint64 bytes, qint64 nsecs)
+{
+    m_lastSave.bytes = bytes;
+    m_lastSave.nsecs = nsecs;
+}
+
+Instrumentation::Throughput Instrumentation::lastLoad() const
+{
+    return m_lastLoad;
+}
+
+Instrumentation::Throughput Instrumentation::lastSave() const
+{
+    return m_lastSave;
+}
+
+void Instrumentation::reset()
+{
+    for (int i = 0; i < CounterCount; ++i) {
+        m_current[i].storeRelaxed(0);
+        m_last[i] = 0;
+        m_total[i] = 0;
+    }
+    m_frameCount = 0;
+    m_frameAllocations = allocationCount();
+    m_frameTimes.clear();
+    m_inputLatencies.clear();
+    m_lastLoad = Throughput();
+    m_lastSave = Throughput();
+}
+
+qint64 Instrumentation::allocationCount()
+{
+    return s_allocations.loadRelaxed();
+}
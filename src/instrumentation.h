@@ -0,0 +1,280 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QVector>
+
+/**
+ * @file instrumentation.h
+ * @brief 性能计数器的头文件
+ *
+ * 这个文件定义了Instrumentation类以及配合使用的FrameScope和ScopedTimer，
+ * 用于统计每帧的绘制耗时和热点路径上的计数。
+ */
+
+/**
+ * @class Instrumentation
+ * @brief 按帧汇总的性能计数器
+ *
+ * 计数器在帧内累加，帧结束时转存为“上一帧”的值并计入总数，然后清零。
+ * add()只是一次原子加法，可以在绘制瓦片的工作线程中调用；
+ * 帧的开始和结束、帧时间的统计只在GUI线程中使用。
+ *
+ * 最近的帧时间和输入延迟保存在环形缓冲区中，用于计算滚动的百分位数。
+ * 文件读写的吞吐量在操作完成时记录，只保留最近一次。
+ *
+ * 内存分配次数来自全局的operator new（见allocationhooks.cpp），
+ * 只有链接了该文件的程序才会统计，否则始终为0。
+ */
+class Instrumentation
+{
+public:
+    /**
+     * @brief 计数器
+     */
+    enum Counter {
+        ShapesDrawn,      ///< 绘制的图形数
+        ShapesCulled,     ///< 空间索引给出但被边界剔除的图形数
+        TilesRendered,    ///< 重新绘制的瓦片数
+        TilesReused,      ///< 直接使用缓存的瓦片数
+        TileRenderTime,   ///< 绘制瓦片的累计耗时（纳秒，多个线程相加）
+        HitTests,         ///< 命中测试次数
+        HitCandidates,    ///< 命中测试的候选图形数
+        HitTestTime,      ///< 命中测试的累计耗时（纳秒）
+        PointerEvents,    ///< 收到的鼠标移动事件数
+        PointerUpdates,   ///< 合并后应用到文档的鼠标移动次数
+        Allocations,      ///< 内存分配次数
+        CounterCount
+    };
+
+    /**
+     * @brief 一次文件读写的吞吐量
+     */
+    struct Throughput {
+        qint64 bytes = 0;     ///< 文件大小
+        qint64 nsecs = 0;     ///< 耗时（纳秒）
+
+        /**
+         * @brief 获取每秒读写的字节数
+         * @return 字节数，没有记录时返回0
+         */
+        double bytesPerSecond() const;
+    };
+
+    /**
+     * @brief Instrumentation类的构造函数
+     */
+    Instrumentation();
+
+    /**
+     * @brief 累加当前帧的计数器
+     * @param counter 计数器
+     * @param value 增量
+     */
+    void add(Counter counter, qint64 value = 1)
+    {
+        m_current[counter].fetchAndAddRelaxed(value);
+    }
+
+    /**
+     * @brief 开始一帧，记录当前的内存分配次数
+     */
+    void beginFrame();
+
+    /**
+     * @brief 结束一帧
+     * @param nsecs 这一帧的耗时（纳秒）
+     */
+    void endFrame(qint64 nsecs);
+
+    /**
+     * @brief 获取计数器在上一帧中的值
+     * @param counter 计数器
+     * @return 值
+     *
+     * 帧外的计数（例如鼠标点击时的命中测试）计入下一帧。
+     */
+    qint64 lastFrame(Counter counter) const;
+
+    /**
+     * @brief 获取计数器自创建或重置以来的总数
+     * @param counter 计数器
+     * @return 总数，不包括未结束的帧
+     */
+    qint64 total(Counter counter) const;
+
+    /**
+     * @brief 获取已结束的帧数
+     */
+    qint64 frameCount() const;
+
+    /**
+     * @brief 获取上一帧的耗时
+     * @return 纳秒
+     */
+    qint64 lastFrameTime() const;
+
+    /**
+     * @brief 获取最近若干帧耗时的百分位数
+     * @param percentile 百分位，0到100
+     * @return 纳秒，没有记录时返回0
+     */
+    qint64 frameTimePercentile(double percentile) const;
+
+    /**
+     * @brief 获取参与百分位数统计的帧数
+     */
+    int frameSampleCount() const;
+
+    /**
+     * @brief 记录一次从输入到绘制完成的延迟
+     * @param nsecs 纳秒
+     */
+    void recordInputLatency(qint64 nsecs);
+
+    /**
+     * @brief 获取最近若干次输入延迟的百分位数
+     * @param percentile 百分位，0到100
+     * @return 纳秒，没有记录时返回0
+     */
+    qint64 inputLatencyPercentile(double percentile) const;
+
+    /**
+     * @brief 获取参与百分位数统计的输入延迟数
+     */
+    int inputLatencySampleCount() const;
+
+    /**
+     * @brief 记录一次文件读取
+     * @param bytes 文件大小
+     * @param nsecs 耗时（纳秒）
+     */
+    void recordLoad(qint64 bytes, qint64 nsecs);
+
+    /**
+     * @brief 记录一次文件写入
+     * @param bytes 文件大小
+     * @param nsecs 耗时（纳秒）
+     */
+    void recordSave(qint64 bytes, qint64 nsecs);
+
+    /**
+     * @brief 获取最近一次文件读取的吞吐量
+     */
+    Throughput lastLoad() const;
+
+    /**
+     * @brief 获取最近一次文件写入的吞吐量
+     */
+    Throughput lastSave() const;
+
+    /**
+     * @brief 清空所有计数和帧时间记录
+     */
+    void reset();
+
+    /**
+     * @brief 记录一次内存分配，由全局的operator new调用
+     */
+    static void countAllocation()
+    {
+        s_allocations.fetchAndAddRelaxed(1);
+    }
+
+    /**
+     * @brief 获取进程启动以来的内存分配次数
+     */
+    static qint64 allocationCount();
+
+private:
+    Q_DISABLE_COPY(Instrumentation)
+
+    /**
+     * @brief 保存最近若干个样本的环形缓冲区
+     */
+    struct Samples {
+        QVector<qint64> values;   ///< 样本
+        int next = 0;             ///< 下一个写入位置
+
+        void add(qint64 value);
+        qint64 last() const;
+        qint64 percentile(double percentile) const;
+        void clear();
+    };
+
+    QAtomicInteger<qint64> m_current[CounterCount];   ///< 当前帧的计数
+    qint64 m_last[CounterCount];                      ///< 上一帧的计数
+    qint64 m_total[CounterCount];                     ///< 总数
+    qint64 m_frameCount;                              ///< 已结束的帧数
+    qint64 m_frameAllocations;                        ///< 帧开始时的内存分配次数
+
+    Samples m_frameTimes;           ///< 最近的帧时间
+    Samples m_inputLatencies;       ///< 最近的输入延迟
+
+    Throughput m_lastLoad;          ///< 最近一次文件读取
+    Throughput m_lastSave;          ///< 最近一次文件写入
+
+    static QAtomicInteger<qint64> s_allocations;   ///< 进程的内存分配次数
+};
+
+/**
+ * @class FrameScope
+ * @brief 在作用域内统计一帧
+ *
+ * 构造时开始一帧，析构时以经过的时间结束这一帧。
+ */
+class FrameScope
+{
+public:
+    explicit FrameScope(Instrumentation *instrumentation)
+        : m_instrumentation(instrumentation)
+    {
+        m_instrumentation->beginFrame();
+        m_timer.start();
+    }
+
+    ~FrameScope()
+    {
+        m_instrumentation->endFrame(m_timer.nsecsElapsed());
+    }
+
+private:
+    Q_DISABLE_COPY(FrameScope)
+
+    Instrumentation *m_instrumentation;   ///< 计数器
+    QElapsedTimer m_timer;                ///< 帧计时
+};
+
+/**
+ * @class ScopedTimer
+ * @brief 把作用域内经过的时间累加到计数器
+ *
+ * 计数器为nullptr时不统计。
+ */
+class ScopedTimer
+{
+public:
+    ScopedTimer(Instrumentation *instrumentation, Instrumentation::Counter counter)
+        : m_instrumentation(instrumentation),
+          m_counter(counter)
+    {
+        m_timer.start();
+    }
+
+    ~ScopedTimer()
+    {
+        if (m_instrumentation) {
+            m_instrumentation->add(m_counter, m_timer.nsecsElapsed());
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(ScopedTimer)
+
+    Instrumentation *m_instrumentation;   ///< 计数器
+    Instrumentation::Counter m_counter;   ///< 累加的计数器
+    QElapsedTimer m_timer;                ///< 计时
+};
+
+#endif // INSTRUMENTATION_H
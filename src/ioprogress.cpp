@@ -0,0 +1,42 @@
+#include "ioprogress.h"
+
+IoProgress::IoProgress()
+    : m_total(0),
+      m_done(0),
+      m_canceled(0)
+{
+}
+
+void IoProgress::reset()
+{
+    m_total.storeRelaxed(0);
+    m_done.storeRelaxed(0);
+    m_canceled.storeRelaxed(0);
+}
+
+void IoProgress::setTotal(qint64 total)
+{
+    m_total.storeRelaxed(total);
+}
+
+void IoProgress::add(qint64 amount)
+{
+    m_done.fetchAndAddRelaxed(amount);
+}
+
+int IoProgress::percent() const
+{
+    const qint64 total = m_total.loadRelaxed();
+    if (total <= 0) return 0;
+    return int(qBound<qint64>(0, m_done.loadRelaxed() * 100 / total, 100));
+}
+
+void IoProgress::cancel()
+{
+    m_canceled.storeRelaxed(1);
+}
+
+bool IoProgress::isCanceled() const
+{
+    return m_canceled.loadRelaxed() != 0;
+}
@@ -0,0 +1,71 @@
+#ifndef IOPROGRESS_H
+#define IOPROGRESS_H
+
+#include <QAtomicInteger>
+
+/**
+ * @file ioprogress.h
+ * @brief 文件读写进度类的头文件
+ *
+ * 这个文件定义了IoProgress类，在后台线程读写文件时向GUI线程报告进度并接收取消请求。
+ */
+
+/**
+ * @class IoProgress
+ * @brief 线程安全的进度计数和取消标志
+ *
+ * 工作线程（可能有多个）调用add()累加已完成的工作量，并定期检查isCanceled()；
+ * GUI线程定时读取percent()显示进度，调用cancel()请求取消。
+ * 工作量的单位由读写的一方决定，例如字节数或图形数。
+ */
+class IoProgress
+{
+public:
+    /**
+     * @brief IoProgress类的构造函数
+     */
+    IoProgress();
+
+    /**
+     * @brief 重置进度和取消标志，开始新的任务前调用
+     */
+    void reset();
+
+    /**
+     * @brief 设置总工作量
+     * @param total 总工作量
+     */
+    void setTotal(qint64 total);
+
+    /**
+     * @brief 累加已完成的工作量
+     * @param amount 新完成的工作量
+     */
+    void add(qint64 amount);
+
+    /**
+     * @brief 获取完成的百分比
+     * @return 0到100之间的整数，总工作量未知时返回0
+     */
+    int percent() const;
+
+    /**
+     * @brief 请求取消任务
+     */
+    void cancel();
+
+    /**
+     * @brief 判断是否已请求取消
+     * @return 如果已请求取消，返回true
+     */
+    bool isCanceled() const;
+
+private:
+    Q_DISABLE_COPY(IoProgress)
+
+    QAtomicInteger<qint64> m_total;  ///< 总工作量
+    QAtomicInteger<qint64> m_done;   ///< 已完成的工作量
+    QAtomicInt m_canceled;           ///< 非0表示已请求取消
+};
+
+#endif // IOPROGRESS_H
@@ -0,0 +1,76 @@
+#ifndef LITTLEENDIAN_H
+#define LITTLEENDIAN_H
+
+#include <QtEndian>
+#include <cstring>
+
+/**
+ * @file littleendian.h
+ * @brief 小端字节序读写的头文件
+ *
+ * 二进制文档、修改日志和分页文档都按小端字节序保存整数和浮点数，
+ * 这个文件提供它们共用的读写函数。目标地址不要求对齐。
+ */
+
+/**
+ * @brief 写入16位无符号整数
+ */
+inline void putU16(char *dest, quint16 value) { qToLittleEndian(value, dest); }
+
+/**
+ * @brief 写入32位无符号整数
+ */
+inline void putU32(char *dest, quint32 value) { qToLittleEndian(value, dest); }
+
+/**
+ * @brief 写入64位无符号整数
+ */
+inline void putU64(char *dest, quint64 value) { qToLittleEndian(value, dest); }
+
+/**
+ * @brief 按IEEE 754的位模式写入双精度浮点数
+ */
+inline void putF64(char *dest, double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putU64(dest, bits);
+}
+
+/**
+ * @brief 读取16位无符号整数
+ */
+inline quint16 getU16(const uchar *src) { return qFromLittleEndian<quint16>(src); }
+
+/**
+ * @brief 读取32位无符号整数
+ */
+inline quint32 getU32(const uchar *src) { return qFromLittleEndian<quint32>(src); }
+
+/**
+ * @brief 读取64位无符号整数
+ */
+inline quint64 getU64(const uchar *src) { return qFromLittleEndian<quint64>(src); }
+
+/**
+ * @brief 读取双精度浮点数
+ */
+inline double getF64(const uchar *src)
+{
+    const quint64 bits = getU64(src);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief 获取补齐到8字节边界的大小
+ * @param size 字节数
+ * @return 不小于size的8的倍数
+ */
+inline qint64 paddedSize(qint64 size)
+{
+    return (size + 7) & ~qint64(7);
+}
+
+#endif // LITTLEENDIAN_H
@@ -1,6 +1,9 @@
 #include "mainwindow.h"
 
+#include "tracerecorder.h"
+
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QLocale>
 #include <QTranslator>
 
@@ -8,6 +11,22 @@ int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
 
+    // 跟踪文件由--trace参数或QT_GRAPHICS_EDITOR_TRACE环境变量指定，未指定时不记录
+    QCommandLineParser parser;
+    const QCommandLineOption traceOption("trace", "把编辑器的活动记录到Chrome Trace格式的文件", "file");
+    parser.addOption(traceOption);
+    parser.parse(a.arguments());
+    QString traceFile = parser.value(traceOption);
+    if (traceFile.isEmpty()) {
+        traceFile = qEnvironmentVariable("QT_GRAPHICS_EDITOR_TRACE");
+    }
+    if (!traceFile.isEmpty()) {
+        QString error;
+        if (!TraceRecorder::start(traceFile, &error)) {
+            qWarning().noquote() << "无法写入跟踪文件" << traceFile << "：" << error;
+        }
+    }
+
     QTranslator translator;
     const QStringList uiLanguages = QLocale::system().uiLanguages();
     for (const QString &locale : uiLanguages) {
@@ -19,5 +38,8 @@ int main(int argc, char *argv[])
     }
     MainWindow w;
     w.show();
-    return a.exec();
+    w.offerRecovery();
+    const int result = a.exec();
+    TraceRecorder::stop();
+    return result;
 }
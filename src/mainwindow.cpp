@@ -1,17 +1,29 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "shape.h"
+#include "binaryformat.h"
+#include "pageddocument.h"
+#include "documentio.h"
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QColorDialog>
 #include <QStatusBar>
+#include <QFileInfo>
+#include <QSignalBlocker>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
     ui(new Ui::MainWindow),
     m_drawingArea(nullptr),
     m_configDialog(nullptr),
-    m_currentFilePath()
+    m_currentFilePath(),
+    m_currentFileBinary(false),
+    m_fileProgressBar(nullptr),
+    m_pendingFileBinary(false),
+    m_pendingLoad(false),
+    m_fileCancelRequested(false),
+    m_autosave(nullptr),
+    m_frameTimeLabel(nullptr)
 {
     ui->setupUi(this);
 
@@ -22,6 +34,27 @@ MainWindow::MainWindow(QWidget *parent)
     // 创建配置对话框
     m_configDialog = new ConfigDialog(this);
 
+    // 后台文件操作的进度显示在状态栏右侧
+    m_fileProgressBar = new QProgressBar(this);
+    m_fileProgressBar->setRange(0, 100);
+    m_fileProgressBar->setMaximumWidth(200);
+    m_fileProgressBar->hide();
+    statusBar()->addPermanentWidget(m_fileProgressBar);
+    connect(m_drawingArea, &DrawingArea::fileOperationProgress, m_fileProgressBar, &QProgressBar::setValue);
+    connect(m_drawingArea, &DrawingArea::fileOperationFinished, this, &MainWindow::onFileOperationFinished);
+    connect(m_drawingArea, &DrawingArea::recordingStopped, this, &MainWindow::onRecordingStopped);
+
+    // 最近若干帧的绘制耗时显示在状态栏右侧，每秒刷新一次
+    m_frameTimeLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(m_frameTimeLabel);
+    m_frameTimeTimer.setInterval(1000);
+    connect(&m_frameTimeTimer, &QTimer::timeout, this, &MainWindow::updateFrameTimeLabel);
+    m_frameTimeTimer.start();
+
+    // 定期在后台把文档写入恢复文件
+    m_autosave = new Autosave(m_drawingArea, this);
+    connect(m_autosave, &Autosave::autosaved, this, &MainWindow::onAutosaved);
+
     // 设置工具栏和状态栏
     setupActions();
     //setupConnections();
@@ -36,6 +69,8 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // 先等待自动保存结束并删除恢复文件
+    delete m_autosave;
     delete ui;
     delete m_configDialog;
 }
@@ -68,6 +103,26 @@ void MainWindow::updateStatusBar()
         status = QString("已选择 %1 个图形").arg(selectedShapes.size());
     }
     statusBar()->showMessage(status);
+    updateFrameTimeLabel();
+}
+
+void MainWindow::updateFrameTimeLabel()
+{
+    const Instrumentation &instrumentation = m_drawingArea->instrumentation();
+    if (instrumentation.frameSampleCount() == 0) {
+        m_frameTimeLabel->clear();
+        return;
+    }
+    QString text = QString("帧时间 p50 %1 / p95 %2 / p99 %3 ms")
+            .arg(instrumentation.frameTimePercentile(50) / 1e6, 0, 'f', 1)
+            .arg(instrumentation.frameTimePercentile(95) / 1e6, 0, 'f', 1)
+            .arg(instrumentation.frameTimePercentile(99) / 1e6, 0, 'f', 1);
+    if (instrumentation.inputLatencySampleCount() > 0) {
+        text += QString("  输入延迟 p50 %1 / p95 %2 ms")
+                .arg(instrumentation.inputLatencyPercentile(50) / 1e6, 0, 'f', 1)
+                .arg(instrumentation.inputLatencyPercentile(95) / 1e6, 0, 'f', 1);
+    }
+    m_frameTimeLabel->setText(text);
 }
 
 void MainWindow::updateToolButtons()
@@ -115,8 +170,12 @@ void MainWindow::applyConfiguration()
     m_drawingArea->setCurrentFilled(m_configDialog->isFilled());
     m_drawingArea->setCurrentFillColor(m_configDialog->getFillColor());
 
-    // 设置最大撤销步数
-    m_drawingArea->setMaxUndoSteps(m_configDialog->getMaxUndoSteps());
+    // 设置撤销历史的内存上限
+    m_drawingArea->setUndoMemoryBudget(qint64(m_configDialog->getUndoMemoryLimit()) * 1024 * 1024);
+    m_drawingArea->setUndoSpillEnabled(m_configDialog->isUndoSpillEnabled());
+    m_drawingArea->setJournaledSaveEnabled(m_configDialog->isJournaledSaveEnabled());
+    m_autosave->setInterval(m_configDialog->getAutosaveInterval());
+    m_drawingArea->setPageCacheBudget(qint64(m_configDialog->getPageCacheLimit()) * 1024 * 1024);
 
     // 更新工具按钮的显示
     QString style = QString("background-color: %1").arg(m_configDialog->getColor().name());
@@ -135,19 +194,39 @@ void MainWindow::on_actionNew_triggered()
     if (QMessageBox::question(this, "新建", "是否要创建新的绘图？当前未保存的内容将丢失。") == QMessageBox::Yes) {
         m_drawingArea->clearAll();
         m_currentFilePath.clear();
+        m_currentFileBinary = false;
         setWindowTitle("Qt图形编辑器 - 未命名");
     }
 }
 
 void MainWindow::on_actionOpen_triggered()
 {
-    QString filename = QFileDialog::getOpenFileName(this, "打开文件", "", "图形文件 (*.txt);;所有文件 (*.*)");
+    QString filename = QFileDialog::getOpenFileName(this, "打开文件", "", "图形文件 (*.txt *.qgd *.qgp);;所有文件 (*.*)");
     if (!filename.isEmpty()) {
-        if (m_drawingArea->loadFromFile(filename)) {
-            m_currentFilePath = filename;
-            setWindowTitle(QString("Qt图形编辑器 - %1").arg(filename));
-            updateStatusBar();
+        // 分页文档只读取页目录，不需要后台线程
+        if (PagedDocument::isPagedFile(filename)) {
+            if (m_drawingArea->isFileOperationRunning()) {
+                statusBar()->showMessage("请等待当前的文件操作完成", 2000);
+            } else if (m_drawingArea->openPagedDocument(filename)) {
+                m_currentFilePath = filename;
+                m_currentFileBinary = true;
+                setWindowTitle(QString("Qt图形编辑器 - %1").arg(m_currentFilePath));
+                updateStatusBar();
+                updateUndoRedoActions();
+            }
+            return;
         }
+
+        // 按文件开头的魔数判断格式，不依赖扩展名
+        const bool binary = BinaryFormat::isBinaryFile(filename);
+        if (!m_drawingArea->startLoad(filename, binary)) {
+            statusBar()->showMessage("请等待当前的文件操作完成", 2000);
+            return;
+        }
+        m_pendingFilePath = filename;
+        m_pendingFileBinary = binary;
+        m_pendingLoad = true;
+        beginFileOperation("正在打开文件...");
     }
 }
 
@@ -156,21 +235,128 @@ void MainWindow::on_actionSave_triggered()
     if (m_currentFilePath.isEmpty()) {
         on_actionSave_As_triggered();
     } else {
-        if (m_drawingArea->saveToFile(m_currentFilePath)) {
-            statusBar()->showMessage("文件已保存", 2000);
-        }
+        saveDocument(m_currentFilePath, m_currentFileBinary);
     }
 }
 
 void MainWindow::on_actionSave_As_triggered()
 {
-    QString filename = QFileDialog::getSaveFileName(this, "保存文件", "", "图形文件 (*.txt);;所有文件 (*.*)");
+    QString filename = QFileDialog::getSaveFileName(this, "保存文件", "", "图形文件 (*.txt);;二进制图形文件 (*.qgd);;分页图形文件 (*.qgp);;所有文件 (*.*)");
     if (!filename.isEmpty()) {
-        if (m_drawingArea->saveToFile(filename)) {
+        saveDocument(filename, filename.endsWith(".qgd", Qt::CaseInsensitive));
+    }
+}
+
+void MainWindow::on_actionCancel_File_Operation_triggered()
+{
+    m_fileCancelRequested = true;
+    m_drawingArea->cancelFileOperation();
+}
+
+void MainWindow::saveDocument(const QString &filename, bool binary)
+{
+    // 分页文档只写回修改过的页，在GUI线程中直接完成
+    const bool paged = filename.endsWith(".qgp", Qt::CaseInsensitive);
+    if (m_drawingArea->isPagedDocument() && !paged) {
+        QMessageBox::warning(this, "错误", "分页文档只能保存为分页格式（*.qgp）");
+        return;
+    }
+    if (paged) {
+        if (m_drawingArea->isFileOperationRunning()) {
+            statusBar()->showMessage("请等待当前的文件操作完成", 2000);
+        } else if (m_drawingArea->saveToPagedFile(filename)) {
             m_currentFilePath = filename;
-            setWindowTitle(QString("Qt图形编辑器 - %1").arg(filename));
+            m_currentFileBinary = true;
+            setWindowTitle(QString("Qt图形编辑器 - %1").arg(m_currentFilePath));
             statusBar()->showMessage("文件已保存", 2000);
         }
+        return;
+    }
+
+    if (!m_drawingArea->startSave(filename, binary)) {
+        statusBar()->showMessage("请等待当前的文件操作完成", 2000);
+        return;
+    }
+    m_pendingFilePath = filename;
+    m_pendingFileBinary = binary;
+    m_pendingLoad = false;
+    beginFileOperation("正在保存文件...");
+}
+
+void MainWindow::beginFileOperation(const QString &message)
+{
+    m_fileCancelRequested = false;
+    m_fileProgressBar->setValue(0);
+    m_fileProgressBar->show();
+    ui->actionCancel_File_Operation->setEnabled(true);
+    statusBar()->showMessage(message);
+}
+
+void MainWindow::offerRecovery()
+{
+    const QStringList files = Autosave::recoverableFiles();
+    if (files.isEmpty()) return;
+
+    if (QMessageBox::question(this, "恢复", "程序上次没有正常退出，发现了自动保存的内容。是否恢复？") != QMessageBox::Yes) {
+        for (const QString &file : files) {
+            Autosave::removeRecoveryFile(file);
+        }
+        return;
+    }
+
+    // 只恢复最近的一份，其他的下次启动时再询问
+    if (!m_drawingArea->startLoad(files.first(), true)) return;
+    m_pendingFilePath.clear();
+    m_pendingFileBinary = false;
+    m_pendingLoad = true;
+    m_pendingRecoveryFile = files.first();
+    beginFileOperation("正在恢复自动保存的内容...");
+}
+
+void MainWindow::onAutosaved(bool success)
+{
+    if (!success) {
+        statusBar()->showMessage("自动保存失败", 2000);
+    }
+}
+
+void MainWindow::onFileOperationFinished(bool success, const QString &errorString)
+{
+    m_fileProgressBar->hide();
+    ui->actionCancel_File_Operation->setEnabled(false);
+
+    // 恢复的内容还没有保存到任何文件，标记为已修改，立即写入本程序自己的恢复文件
+    const QString recoveryFile = m_pendingRecoveryFile;
+    m_pendingRecoveryFile.clear();
+    if (success && !recoveryFile.isEmpty()) {
+        m_drawingArea->setModified(true);
+        m_autosave->autosaveNow();
+        Autosave::removeRecoveryFile(recoveryFile);
+    }
+
+    if (!success) {
+        if (m_fileCancelRequested) {
+            statusBar()->showMessage("操作已取消", 2000);
+        } else {
+            const QString title = m_pendingLoad ? "无法读取文件" : "保存文件失败";
+            QMessageBox::warning(this, "错误", QString("%1：%2").arg(title, errorString));
+            updateStatusBar();
+        }
+        return;
+    }
+
+    m_currentFilePath = m_pendingFilePath;
+    m_currentFileBinary = m_pendingFileBinary;
+    if (recoveryFile.isEmpty()) {
+        setWindowTitle(QString("Qt图形编辑器 - %1").arg(m_currentFilePath));
+    } else {
+        setWindowTitle("Qt图形编辑器 - 未命名（已恢复）");
+    }
+    if (m_pendingLoad) {
+        updateStatusBar();
+        updateUndoRedoActions();
+    } else {
+        statusBar()->showMessage("文件已保存", 2000);
     }
 }
 
@@ -306,14 +492,62 @@ void MainWindow::on_actionConfigure_triggered()
         m_configDialog->setFillColor(Qt::white); // 默认填充颜色
     }
 
-    // 设置当前的最大撤销步数
-    m_configDialog->setMaxUndoSteps(m_drawingArea->getMaxUndoSteps());
+    // 设置当前的撤销历史内存上限
+    m_configDialog->setUndoMemoryLimit(int(m_drawingArea->getUndoMemoryBudget() / (1024 * 1024)));
+    m_configDialog->setUndoSpillEnabled(m_drawingArea->isUndoSpillEnabled());
+    m_configDialog->setJournaledSaveEnabled(m_drawingArea->isJournaledSaveEnabled());
+    m_configDialog->setAutosaveInterval(m_autosave->interval());
+    m_configDialog->setPageCacheLimit(int(m_drawingArea->getPageCacheBudget() / (1024 * 1024)));
 
     if (m_configDialog->exec() == QDialog::Accepted) {
         applyConfiguration();
     }
 }
 
+void MainWindow::on_actionPerformance_Overlay_toggled(bool checked)
+{
+    m_drawingArea->setHudVisible(checked);
+}
+
+void MainWindow::on_actionRecord_Input_toggled(bool checked)
+{
+    if (!checked) {
+        m_drawingArea->stopRecording();
+        return;
+    }
+
+    QSignalBlocker blocker(ui->actionRecord_Input);
+    ui->actionRecord_Input->setChecked(false);
+    if (m_drawingArea->isPagedDocument()) {
+        QMessageBox::warning(this, "错误", "分页文档不支持录制输入");
+        return;
+    }
+    QString filename = QFileDialog::getSaveFileName(this, "录制输入", "", "输入录制文件 (*.qgr)");
+    if (filename.isEmpty()) return;
+    if (!filename.endsWith(".qgr", Qt::CaseInsensitive)) {
+        filename += ".qgr";
+    }
+
+    // 起始文档与录制文件同名，重放工具默认从这里打开
+    const QFileInfo info(filename);
+    const QString documentPath = info.dir().filePath(info.completeBaseName() + ".qgd");
+    QString error;
+    if (!DocumentIo::write(documentPath, true, m_drawingArea->snapshot(), &error, nullptr)
+        || !m_drawingArea->startRecording(filename, &error)) {
+        QMessageBox::warning(this, "错误", QString("无法开始录制：%1").arg(error));
+        return;
+    }
+    ui->actionRecord_Input->setChecked(true);
+    statusBar()->showMessage(QString("正在录制输入到 %1").arg(filename), 2000);
+}
+
+void MainWindow::onRecordingStopped()
+{
+    QSignalBlocker blocker(ui->actionRecord_Input);
+    ui->actionRecord_Input->setChecked(false);
+    statusBar()->showMessage("输入录制已结束", 2000);
+}
+
 // 工具按钮槽函数
 void MainWindow::on_ellipseToolButton_clicked()
 {
@@ -2,8 +2,12 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QProgressBar>
+#include <QLabel>
+#include <QTimer>
 #include "drawingarea.h"
 #include "configdialog.h"
+#include "autosave.h"
 
 
 
@@ -49,6 +53,13 @@ public:
      */
     ~MainWindow();
 
+    /**
+     * @brief 查找上次崩溃留下的自动保存内容并询问是否恢复
+     *
+     * 在主窗口显示后调用。恢复的内容作为未命名的文档打开。
+     */
+    void offerRecovery();
+
 private slots:
     // 文件操作
     /**
@@ -79,6 +90,30 @@ private slots:
      */
     void on_actionSave_As_triggered();
 
+    /**
+     * @brief 取消文件操作槽函数
+     *
+     * 取消正在后台进行的打开或保存。
+     */
+    void on_actionCancel_File_Operation_triggered();
+
+    /**
+     * @brief 后台文件操作结束槽函数
+     * @param success 是否成功
+     * @param errorString 失败时的错误信息
+     *
+     * 更新当前文件路径、窗口标题和状态栏。
+     */
+    void onFileOperationFinished(bool success, const QString &errorString);
+
+    /**
+     * @brief 自动保存结束槽函数
+     * @param success 是否成功
+     *
+     * 失败时在状态栏中提示。
+     */
+    void onAutosaved(bool success);
+
     /**
      * @brief 退出应用程序槽函数
      *
@@ -224,6 +259,32 @@ private slots:
      */
     void on_actionConfigure_triggered();
 
+    /**
+     * @brief 性能信息菜单项切换响应槽函数
+     * @param checked 是否显示
+     *
+     * 在绘图区域左上角显示或隐藏性能信息。
+     */
+    void on_actionPerformance_Overlay_toggled(bool checked);
+
+    /**
+     * @brief 录制输入菜单项切换响应槽函数
+     * @param checked 是否录制
+     *
+     * 开始时选择录制文件，并把当前文档保存为同名的.qgd文件，作为重放的起始文档。
+     */
+    void on_actionRecord_Input_toggled(bool checked);
+
+    /**
+     * @brief 输入录制结束时更新菜单项
+     */
+    void onRecordingStopped();
+
+    /**
+     * @brief 在状态栏中显示最近的帧时间百分位数
+     */
+    void updateFrameTimeLabel();
+
     // 工具按钮
     /**
      * @brief 椭圆工具按钮点击槽函数
@@ -312,6 +373,16 @@ private:
     DrawingArea *m_drawingArea;      ///< 绘图区域
     ConfigDialog *m_configDialog;    ///< 配置对话框
     QString m_currentFilePath;       ///< 当前文件路径
+    bool m_currentFileBinary;        ///< 当前文件是否为二进制格式
+    QProgressBar *m_fileProgressBar; ///< 状态栏中的文件操作进度条
+    QString m_pendingFilePath;       ///< 正在后台打开或保存的文件路径
+    bool m_pendingFileBinary;        ///< 正在后台打开或保存的文件是否为二进制格式
+    bool m_pendingLoad;              ///< 后台文件操作是否为打开
+    bool m_fileCancelRequested;      ///< 用户是否请求取消后台文件操作
+    Autosave *m_autosave;            ///< 自动保存
+    QString m_pendingRecoveryFile;   ///< 正在从中恢复的自动保存文件
+    QLabel *m_frameTimeLabel;        ///< 状态栏中的帧时间
+    QTimer m_frameTimeTimer;         ///< 定时刷新帧时间
 
     /**
      * @brief 设置动作
@@ -341,6 +412,21 @@ private:
      */
     void updateToolButtons();
 
+    /**
+     * @brief 在后台按指定格式保存文档
+     * @param filename 文件名
+     * @param binary 为true时使用二进制格式，否则使用文本格式
+     *
+     * 保存结束后在onFileOperationFinished()中更新当前文件路径。
+     */
+    void saveDocument(const QString &filename, bool binary);
+
+    /**
+     * @brief 显示后台文件操作的进度
+     * @param message 状态栏中显示的提示
+     */
+    void beginFileOperation(const QString &message);
+
     /**
      * @brief 应用配置
      *
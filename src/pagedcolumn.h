@@ -0,0 +1,176 @@
+#ifndef PAGEDCOLUMN_H
+#define PAGEDCOLUMN_H
+
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <QVector>
+#include <algorithm>
+#include <utility>
+
+/**
+ * @file pagedcolumn.h
+ * @brief 分页写时复制数组的头文件
+ *
+ * 这个文件定义了PagedColumn类模板，ShapeStore用它保存需要交给快照的列。
+ */
+
+/**
+ * @class PagedColumn
+ * @brief 按页隐式共享的数组
+ *
+ * 元素按固定大小分页存放，每一页各自隐式共享。复制整个数组只复制页指针，
+ * 之后修改某个元素时只复制它所在的一页，而不是整个数组。
+ * 这样文档可以在创建快照之后立即继续编辑，编辑的开销与文档大小无关。
+ *
+ * 元素类型需要可以默认构造和复制。
+ */
+template<typename T>
+class PagedColumn
+{
+public:
+    typedef T value_type;  ///< 元素类型
+
+    static const int PageShift = 10;               ///< 页大小的二进制位数
+    static const int PageSize = 1 << PageShift;    ///< 每页的元素数量
+    static const int PageMask = PageSize - 1;      ///< 取页内下标的掩码
+
+    PagedColumn() : m_size(0) {}
+
+    /**
+     * @brief 获取元素数量
+     */
+    int size() const { return m_size; }
+
+    /**
+     * @brief 判断数组是否为空
+     */
+    bool isEmpty() const { return m_size == 0; }
+
+    /**
+     * @brief 只读访问元素，不会复制页
+     */
+    const T &at(int i) const { return m_pages.at(i >> PageShift)->items[i & PageMask]; }
+
+    /**
+     * @brief 可写访问元素，所在的页与其他副本共享时先复制这一页
+     */
+    T &operator[](int i) { return page(i >> PageShift)[i & PageMask]; }
+
+    /**
+     * @brief 在末尾追加元素
+     */
+    void append(const T &value)
+    {
+        if ((m_size & PageMask) == 0) {
+            m_pages.append(QSharedDataPointer<Page>(new Page));
+        }
+        page(m_size >> PageShift)[m_size & PageMask] = value;
+        ++m_size;
+    }
+
+    /**
+     * @brief 在指定位置插入元素
+     *
+     * 之后的元素逐页后移一位，只有被移动的页会被复制。
+     */
+    void insert(int i, const T &value)
+    {
+        const T copy = value;
+        append(T());
+
+        const int lastPage = (m_size - 1) >> PageShift;
+        const int firstPage = i >> PageShift;
+        for (int p = lastPage; p > firstPage; --p) {
+            T *items = page(p);
+            const int end = p == lastPage ? (m_size - 1) & PageMask : PageMask;
+            std::move_backward(items, items + end, items + end + 1);
+            items[0] = m_pages.at(p - 1)->items[PageMask];
+        }
+
+        T *items = page(firstPage);
+        const int begin = i & PageMask;
+        const int end = firstPage == lastPage ? (m_size - 1) & PageMask : PageMask;
+        std::move_backward(items + begin, items + end, items + end + 1);
+        items[begin] = copy;
+    }
+
+    /**
+     * @brief 删除指定位置的元素
+     *
+     * 之后的元素逐页前移一位。
+     */
+    void removeAt(int i)
+    {
+        const int lastPage = (m_size - 1) >> PageShift;
+        int p = i >> PageShift;
+        T *items = page(p);
+        int end = p == lastPage ? ((m_size - 1) & PageMask) + 1 : PageSize;
+        std::move(items + (i & PageMask) + 1, items + end, items + (i & PageMask));
+
+        for (++p; p <= lastPage; ++p) {
+            T *next = page(p);
+            items[PageMask] = next[0];
+            end = p == lastPage ? ((m_size - 1) & PageMask) + 1 : PageSize;
+            std::move(next + 1, next + end, next);
+            items = next;
+        }
+        resize(m_size - 1);
+    }
+
+    /**
+     * @brief 改变元素数量，新增的元素为默认值
+     */
+    void resize(int size)
+    {
+        while (m_size < size) {
+            append(T());
+        }
+        m_size = size;
+        const int pages = (size + PageMask) >> PageShift;
+        while (m_pages.size() > pages) {
+            m_pages.removeLast();
+        }
+    }
+
+    /**
+     * @brief 为指定数量的元素预留页指针的空间
+     */
+    void reserve(int size) { m_pages.reserve((size + PageMask) >> PageShift); }
+
+    /**
+     * @brief 删除所有元素
+     */
+    void clear()
+    {
+        m_pages.clear();
+        m_size = 0;
+    }
+
+    /**
+     * @brief 与另一个数组交换内容
+     */
+    void swap(PagedColumn &other)
+    {
+        m_pages.swap(other.m_pages);
+        std::swap(m_size, other.m_size);
+    }
+
+private:
+    /**
+     * @struct Page
+     * @brief 一页元素
+     */
+    struct Page : public QSharedData {
+        T items[PageSize];
+    };
+
+    /**
+     * @brief 获取可写的页，与其他副本共享时先复制
+     */
+    T *page(int p) { return m_pages[p]->items; }
+
+    QVector<QSharedDataPointer<Page>> m_pages;  ///< 各页
+    int m_size;                                 ///< 元素数量
+};
+
+#endif // PAGEDCOLUMN_H
@@ -0,0 +1,766 @@
+#include "pageddocument.h"
+#include "littleendian.h"
+#include "shapefactory.h"
+#include "tracerecorder.h"
+#include <QMutexLocker>
+#include <QPainter>
+#include <QSaveFile>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+const char kMagic[8] = { '\x89', 'Q', 'G', 'P', '\r', '\n', '\x1a', '\n' };
+
+const int kHeaderSize = 64;
+const int kRecordSize = 56;
+const int kStyleRecordSize = 16;
+const int kDirectoryEntrySize = 56;
+
+// 新建文档时每页平均包含的图形数量
+const int kRecordsPerPage = 4096;
+
+// 网格边长的下限，图形很密集时也不会分出过多的页
+const double kMinCellSize = 256.0;
+
+// 默认的页缓存容量
+const qint64 kDefaultCacheBudget = 256 * 1024 * 1024;
+
+bool fail(QString *errorString, const QString &message)
+{
+    if (errorString) *errorString = message;
+    return false;
+}
+
+quint64 cellKey(qint32 cellX, qint32 cellY)
+{
+    return (quint64(quint32(cellX)) << 32) | quint32(cellY);
+}
+
+qint32 cellCoord(qreal value, double cellSize)
+{
+    return qint32(qBound(-2147483648.0, std::floor(value / cellSize), 2147483647.0));
+}
+
+// 与Shape::getStrokeBounds()相同的规则
+QRectF strokeBounds(const PagedDocument::Record &record, const QVector<ShapeStore::Style> &styles)
+{
+    const qreal margin = styles.at(int(record.styleIndex)).lineWidth / 2.0 + 1.0;
+    return record.rect.normalized().adjusted(-margin, -margin, margin, margin);
+}
+
+void applyRecord(Shape *shape, const PagedDocument::Record &record, const ShapeStore::Style &style)
+{
+    shape->setId(record.id);
+    shape->setBoundingRect(record.rect);
+    shape->setColor(QColor::fromRgba(style.color));
+    shape->setFillColor(QColor::fromRgba(style.fillColor));
+    shape->setLineWidth(style.lineWidth);
+    shape->setFilled(record.flags & ShapeStore::Filled);
+}
+
+bool zLess(const PagedDocument::Record &a, const PagedDocument::Record &b)
+{
+    return a.z < b.z;
+}
+
+/**
+ * 每种类型一个可以反复使用的图形，按记录绘制和测试时不必为每个记录创建Shape对象
+ */
+class ScratchShapes
+{
+public:
+    ~ScratchShapes() { qDeleteAll(m_shapes); }
+
+    Shape *get(const PagedDocument::Record &record, const QVector<ShapeStore::Style> &styles)
+    {
+        Shape *&shape = m_shapes[record.type];
+        if (!shape) {
+            shape = ShapeFactory::createShape(Shape::ShapeType(record.type));
+            if (!shape) return nullptr;
+        }
+        applyRecord(shape, record, styles.at(int(record.styleIndex)));
+        return shape;
+    }
+
+private:
+    QHash<int, Shape *> m_shapes;
+};
+}
+
+PagedDocument::PagedDocument()
+    : m_cellSize(kMinCellSize),
+      m_overlayBase(0),
+      m_garbageBytes(0)
+{
+    m_cache.setMaxCost(kDefaultCacheBudget);
+}
+
+PagedDocument::~PagedDocument()
+{
+}
+
+bool PagedDocument::isPagedFile(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray head = file.read(sizeof(kMagic));
+    return head.size() == int(sizeof(kMagic)) && std::memcmp(head.constData(), kMagic, sizeof(kMagic)) == 0;
+}
+
+bool PagedDocument::create(const QString &filename, const ShapeStore::Snapshot &snapshot, QString *errorString)
+{
+    const int count = snapshot.size();
+
+    // 按图形中心的分布选择网格边长
+    double cellSize = kMinCellSize;
+    if (count > 0) {
+        QPointF low = snapshot.records.at(0).rect.normalized().center();
+        QPointF high = low;
+        for (int row = 1; row < count; ++row) {
+            const QPointF center = snapshot.records.at(row).rect.normalized().center();
+            low = QPointF(qMin(low.x(), center.x()), qMin(low.y(), center.y()));
+            high = QPointF(qMax(high.x(), center.x()), qMax(high.y(), center.y()));
+        }
+        const double area = qMax(1.0, (high.x() - low.x()) * (high.y() - low.y()));
+        cellSize = qMax(kMinCellSize, std::sqrt(area * kRecordsPerPage / count));
+    }
+
+    // 按网格单元分组，层序号就是原来的行号
+    QVector<PageInfo> pages;
+    QVector<QVector<Record>> pageRecords;
+    QHash<quint64, int> pageOfCell;
+    for (int row = 0; row < count; ++row) {
+        const ShapeStore::Record &source = snapshot.records.at(row);
+        const QPointF center = source.rect.normalized().center();
+        const qint32 cellX = cellCoord(center.x(), cellSize);
+        const qint32 cellY = cellCoord(center.y(), cellSize);
+        auto it = pageOfCell.constFind(cellKey(cellX, cellY));
+        if (it == pageOfCell.constEnd()) {
+            PageInfo info;
+            info.cellX = cellX;
+            info.cellY = cellY;
+            it = pageOfCell.insert(cellKey(cellX, cellY), pages.size());
+            pages.append(info);
+            pageRecords.append(QVector<Record>());
+        }
+
+        Record record;
+        record.rect = source.rect;
+        record.z = row;
+        record.id = source.id;
+        record.styleIndex = source.styleIndex;
+        record.type = source.type;
+        record.flags = source.flags & ShapeStore::Filled;
+        pageRecords[it.value()].append(record);
+    }
+
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return fail(errorString, file.errorString());
+    }
+
+    // 文件头最后写入，先留出位置
+    const QByteArray header(kHeaderSize, '\0');
+    bool ok = file.write(header) == kHeaderSize;
+    for (int page = 0; ok && page < pages.size(); ++page) {
+        ok = writePage(&file, pageRecords.at(page), snapshot.styles, &pages[page]);
+        pageRecords[page] = QVector<Record>();
+    }
+    ok = ok && writeTail(&file, snapshot.styles, pages, cellSize, count);
+    if (!ok) {
+        const QString error = file.errorString();
+        file.cancelWriting();
+        return fail(errorString, error);
+    }
+    if (!file.commit()) {
+        return fail(errorString, file.errorString());
+    }
+    return true;
+}
+
+bool PagedDocument::open(const QString &filename, QString *errorString)
+{
+    close();
+
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return fail(errorString, m_file.errorString());
+    }
+
+    const qint64 size = m_file.size();
+    const QByteArray headerBytes = m_file.read(kHeaderSize);
+    const uchar *header = reinterpret_cast<const uchar *>(headerBytes.constData());
+    if (headerBytes.size() < kHeaderSize || std::memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+        m_file.close();
+        return fail(errorString, "不是有效的分页图形文件");
+    }
+    if (getU16(header + 8) != MajorVersion) {
+        m_file.close();
+        return fail(errorString, QString("不支持的文件版本 %1").arg(getU16(header + 8)));
+    }
+
+    const quint32 pageCount = getU32(header + 12);
+    const quint64 directoryOffset = getU64(header + 16);
+    const quint64 styleOffset = getU64(header + 24);
+    const quint32 styleCount = getU32(header + 32);
+    const double cellSize = getF64(header + 40);
+    const quint64 nextZ = getU64(header + 48);
+    if (directoryOffset > quint64(size) || pageCount > (quint64(size) - directoryOffset) / kDirectoryEntrySize
+        || styleOffset > quint64(size) || styleCount > (quint64(size) - styleOffset) / kStyleRecordSize
+        || !(cellSize > 0) || !std::isfinite(cellSize)) {
+        m_file.close();
+        return fail(errorString, "文件不完整");
+    }
+
+    QVector<ShapeStore::Style> styles(styleCount);
+    m_file.seek(qint64(styleOffset));
+    const QByteArray styleBytes = m_file.read(qint64(styleCount) * kStyleRecordSize);
+    const uchar *record = reinterpret_cast<const uchar *>(styleBytes.constData());
+    for (ShapeStore::Style &style : styles) {
+        style.color = getU32(record);
+        style.fillColor = getU32(record + 4);
+        style.lineWidth = int(getU32(record + 8));
+        record += kStyleRecordSize;
+    }
+
+    QVector<PageInfo> pages(pageCount);
+    m_file.seek(qint64(directoryOffset));
+    const QByteArray directory = m_file.read(qint64(pageCount) * kDirectoryEntrySize);
+    if (styleBytes.size() != qint64(styleCount) * kStyleRecordSize
+        || directory.size() != qint64(pageCount) * kDirectoryEntrySize) {
+        m_file.close();
+        return fail(errorString, m_file.errorString());
+    }
+
+    QHash<quint64, int> pageOfCell;
+    pageOfCell.reserve(int(pageCount));
+    const uchar *entry = reinterpret_cast<const uchar *>(directory.constData());
+    for (int page = 0; page < pages.size(); ++page, entry += kDirectoryEntrySize) {
+        PageInfo &info = pages[page];
+        info.cellX = qint32(getU32(entry));
+        info.cellY = qint32(getU32(entry + 4));
+        info.offset = qint64(getU64(entry + 8));
+        info.count = int(getU32(entry + 16));
+        info.bounds = QRectF(getF64(entry + 24), getF64(entry + 32), getF64(entry + 40), getF64(entry + 48));
+        if (info.offset < 0 || info.offset > size || info.count < 0
+            || info.count > (size - info.offset) / kRecordSize) {
+            m_file.close();
+            return fail(errorString, "文件不完整");
+        }
+        pageOfCell.insert(cellKey(info.cellX, info.cellY), page);
+    }
+
+    m_fileName = filename;
+    m_pages = pages;
+    m_pageOfCell = pageOfCell;
+    m_styles = styles;
+    m_cellSize = cellSize;
+    m_overlayBase = qint64(nextZ);
+    m_garbageBytes = qMax<qint64>(0, size - liveBytes(m_pages, m_styles.size()));
+    return true;
+}
+
+void PagedDocument::close()
+{
+    QMutexLocker locker(&m_mutex);
+    m_file.close();
+    m_cache.clear();
+    m_fileName.clear();
+    m_pages.clear();
+    m_pageOfCell.clear();
+    m_dirty.clear();
+    m_taken.clear();
+    m_styles.clear();
+    m_overlayPages.clear();
+    m_cellSize = kMinCellSize;
+    m_overlayBase = 0;
+    m_garbageBytes = 0;
+}
+
+bool PagedDocument::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+QString PagedDocument::fileName() const
+{
+    return m_fileName;
+}
+
+QRectF PagedDocument::bounds() const
+{
+    QRectF result;
+    for (const PageInfo &info : m_pages) {
+        if (info.count > 0) {
+            result = result.united(info.bounds);
+        }
+    }
+    return result;
+}
+
+bool PagedDocument::isModified() const
+{
+    return !m_dirty.isEmpty();
+}
+
+void PagedDocument::setCacheBudget(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(qsizetype(qMax<qint64>(0, bytes)));
+}
+
+qint64 PagedDocument::cacheBudget() const
+{
+    return m_cache.maxCost();
+}
+
+void PagedDocument::draw(QPainter *painter, const QRectF &rect,
+                         const QVector<QPair<qint64, Shape *>> &taken) const
+{
+    // 只在读取页时持有锁，多个瓦片可以同时绘制
+    QVector<Record> visible;
+    const QVector<int> pages = pagesIntersecting(rect);
+    for (int page : pages) {
+        QVector<Record> records;
+        {
+            QMutexLocker locker(&m_mutex);
+            records = loadPage(page, true);
+        }
+        for (const Record &record : std::as_const(records)) {
+            if (strokeBounds(record, m_styles).intersects(rect)) {
+                visible.append(record);
+            }
+        }
+    }
+
+    // 相邻的页在层次上交错，合并后按层序号从下到上绘制，取出的图形插在原来的位置
+    std::sort(visible.begin(), visible.end(), zLess);
+    QVector<QPair<qint64, Shape *>> ordered = taken;
+    std::sort(ordered.begin(), ordered.end(),
+              [](const QPair<qint64, Shape *> &a, const QPair<qint64, Shape *> &b) { return a.first < b.first; });
+    ScratchShapes scratch;
+    int next = 0;
+    for (const Record &record : std::as_const(visible)) {
+        for (; next < ordered.size() && ordered.at(next).first < record.z; ++next) {
+            ordered.at(next).second->draw(painter);
+        }
+        if (Shape *shape = scratch.get(record, m_styles)) {
+            shape->draw(painter);
+        }
+    }
+    for (; next < ordered.size(); ++next) {
+        ordered.at(next).second->draw(painter);
+    }
+}
+
+Shape *PagedDocument::shapeAt(const QPointF &pos, qint64 *z) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    Record hit;
+    hit.z = -1;
+    ScratchShapes scratch;
+    for (int page = 0; page < m_pages.size(); ++page) {
+        if (!m_pages.at(page).bounds.contains(pos)) continue;
+
+        const QVector<Record> records = loadPage(page, true);
+        for (const Record &record : records) {
+            if (record.z <= hit.z || !record.rect.normalized().contains(pos)) continue;
+            Shape *shape = scratch.get(record, m_styles);
+            if (shape && shape->contains(pos)) {
+                hit = record;
+            }
+        }
+    }
+    if (hit.z < 0) return nullptr;
+
+    Shape *shape = ShapeFactory::createShape(Shape::ShapeType(hit.type));
+    if (!shape) return nullptr;
+    applyRecord(shape, hit, m_styles.at(int(hit.styleIndex)));
+    if (z) *z = hit.z;
+    return shape;
+}
+
+bool PagedDocument::take(qint64 z, const QRectF &rect)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // 图形按边界矩形的中心归入网格单元，所在页的描边边界一定包含这个中心
+    const QPointF center = rect.normalized().center();
+    for (int page = 0; page < m_pages.size(); ++page) {
+        if (!m_pages.at(page).bounds.contains(center)) continue;
+
+        QVector<Record> records = loadPage(page, false);
+        for (int i = 0; i < records.size(); ++i) {
+            if (records.at(i).z != z) continue;
+
+            // 被修改的页移出缓存，保存之前一直保留在内存中
+            records.removeAt(i);
+            m_dirty.insert(page, records);
+            m_cache.remove(page);
+            m_taken.insert(z);
+            return true;
+        }
+    }
+    return false;
+}
+
+void PagedDocument::restore(const Shape *shape, qint64 z)
+{
+    ShapeStore::Style style;
+    style.color = shape->getColor().rgba();
+    style.fillColor = shape->getFillColor().rgba();
+    style.lineWidth = shape->getLineWidth();
+
+    Record record;
+    record.rect = shape->getBoundingRect();
+    record.z = z;
+    record.id = shape->getId();
+    record.type = quint8(shape->getType());
+    record.flags = shape->isFilled() ? quint8(ShapeStore::Filled) : quint8(0);
+
+    QMutexLocker locker(&m_mutex);
+    record.styleIndex = styleIndexOf(style);
+
+    // 取出后保存过时，文件中上次写入overlay的页里还有这个图形的记录，先按过滤后的内容固定下来
+    for (int page : std::as_const(m_overlayPages)) {
+        if (!m_dirty.contains(page)) {
+            m_dirty.insert(page, loadPage(page, false));
+            m_cache.remove(page);
+        }
+    }
+    m_taken.remove(z);
+
+    const QPointF center = record.rect.normalized().center();
+    const int page = pageOfCell(cellCoord(center.x(), m_cellSize), cellCoord(center.y(), m_cellSize));
+    QVector<Record> records = loadPage(page, false);
+    records.insert(std::upper_bound(records.begin(), records.end(), record, zLess), record);
+    m_dirty.insert(page, records);
+    m_cache.remove(page);
+
+    // 图形可能在取出后被移动过，页的边界要包含它，绘制和命中测试才能找到这一页
+    PageInfo &info = m_pages[page];
+    info.bounds = info.bounds.united(strokeBounds(record, m_styles));
+}
+
+bool PagedDocument::save(const ShapeStore::Snapshot &overlay, const QHash<int, qint64> &takenZ,
+                         QString *errorString)
+{
+    if (!isOpen()) {
+        return fail(errorString, "没有打开的分页文档");
+    }
+
+    // 旧页占用的空间超过有效数据时整个重写
+    if (m_garbageBytes > m_file.size() - m_garbageBytes) {
+        return saveAs(m_fileName, overlay, takenZ, errorString);
+    }
+
+    // 需要写入的页：被取出过图形的页、现在或上次保存时包含overlay图形的页
+    const QHash<int, QVector<Record>> overlayRecords = groupOverlay(overlay, takenZ);
+    QVector<int> pages = m_dirty.keys() + m_overlayPages + overlayRecords.keys();
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadWrite) || !file.seek(file.size())) {
+        return fail(errorString, file.errorString());
+    }
+
+    // 新的页追加在文件末尾，文件头改写之前旧的页目录仍然有效
+    QVector<PageInfo> infos = m_pages;
+    for (int page : std::as_const(pages)) {
+        QVector<Record> records;
+        {
+            QMutexLocker locker(&m_mutex);
+            records = loadPage(page, false);
+        }
+        records += overlayRecords.value(page);
+        std::sort(records.begin(), records.end(), zLess);
+        if (!writePage(&file, records, m_styles, &infos[page])) {
+            return fail(errorString, file.errorString());
+        }
+    }
+    if (!writeTail(&file, m_styles, infos, m_cellSize, m_overlayBase + overlay.size()) || !file.flush()) {
+        return fail(errorString, file.errorString());
+    }
+
+    const qint64 size = file.size();
+    {
+        QMutexLocker locker(&m_mutex);
+        for (int page : std::as_const(pages)) {
+            m_cache.remove(page);
+        }
+        m_pages = infos;
+        m_dirty.clear();
+    }
+    m_overlayPages = overlayRecords.keys();
+    m_garbageBytes = qMax<qint64>(0, size - liveBytes(m_pages, m_styles.size()));
+    return true;
+}
+
+bool PagedDocument::saveAs(const QString &filename, const ShapeStore::Snapshot &overlay,
+                           const QHash<int, qint64> &takenZ, QString *errorString)
+{
+    if (!isOpen()) {
+        return fail(errorString, "没有打开的分页文档");
+    }
+
+    const QHash<int, QVector<Record>> overlayRecords = groupOverlay(overlay, takenZ);
+
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return fail(errorString, file.errorString());
+    }
+
+    // 逐页读取和写入，内存中同时只有一页
+    const QByteArray header(kHeaderSize, '\0');
+    bool ok = file.write(header) == kHeaderSize;
+    QVector<PageInfo> infos = m_pages;
+    for (int page = 0; ok && page < infos.size(); ++page) {
+        QVector<Record> records;
+        {
+            QMutexLocker locker(&m_mutex);
+            records = loadPage(page, false);
+        }
+        records += overlayRecords.value(page);
+        std::sort(records.begin(), records.end(), zLess);
+        ok = writePage(&file, records, m_styles, &infos[page]);
+    }
+    ok = ok && writeTail(&file, m_styles, infos, m_cellSize, m_overlayBase + overlay.size());
+    if (!ok) {
+        const QString error = file.errorString();
+        file.cancelWriting();
+        return fail(errorString, error);
+    }
+
+    // 打开的文件在某些平台上不能被替换，提交前先关闭
+    QMutexLocker locker(&m_mutex);
+    m_file.close();
+    if (!file.commit()) {
+        m_file.open(QIODevice::ReadOnly);
+        return fail(errorString, file.errorString());
+    }
+
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        const QString error = m_file.errorString();
+        locker.unlock();
+        close();
+        return fail(errorString, error);
+    }
+    m_cache.clear();
+    m_dirty.clear();
+    m_pages = infos;
+    m_fileName = filename;
+    m_overlayPages = overlayRecords.keys();
+    m_garbageBytes = 0;
+    return true;
+}
+
+QVector<PagedDocument::Record> PagedDocument::loadPage(int page, bool cache) const
+{
+    const auto dirty = m_dirty.constFind(page);
+    if (dirty != m_dirty.constEnd()) {
+        return dirty.value();
+    }
+    if (const QVector<Record> *cached = m_cache.object(page)) {
+        return *cached;
+    }
+
+    QVector<Record> records;
+    const PageInfo &info = m_pages.at(page);
+    if (info.offset == 0 || info.count == 0) {
+        return records;
+    }
+
+    // 缓存未命中时从文件读取，是绘制时卡顿的常见原因
+    TraceScope trace("PagedDocument::loadPage", "io");
+
+    // 只映射这一页，解码后立即解除映射，不在内存中留下文件的其他部分
+    const qint64 size = qint64(info.count) * kRecordSize;
+    QByteArray bytes;
+    uchar *mapped = m_file.map(info.offset, size);
+    const uchar *data = mapped;
+    if (!data) {
+        if (!m_file.seek(info.offset)) return records;
+        bytes = m_file.read(size);
+        if (bytes.size() != size) return records;
+        data = reinterpret_cast<const uchar *>(bytes.constData());
+    }
+
+    records.reserve(info.count);
+    for (int i = 0; i < info.count; ++i, data += kRecordSize) {
+        Record record;
+        record.z = qint64(getU64(data + 16));
+        record.styleIndex = getU32(data + 4);
+        // overlay图形由Document持有，损坏的样式下标直接跳过
+        if (record.z >= m_overlayBase || m_taken.contains(record.z) || record.styleIndex >= quint32(m_styles.size())) continue;
+
+        record.type = data[0];
+        record.flags = data[1];
+        record.id = int(getU32(data + 8));
+        record.rect = QRectF(getF64(data + 24), getF64(data + 32), getF64(data + 40), getF64(data + 48));
+        records.append(record);
+    }
+    if (mapped) {
+        m_file.unmap(mapped);
+    }
+
+    if (cache) {
+        m_cache.insert(page, new QVector<Record>(records), qMax<qsizetype>(1, records.size() * qsizetype(sizeof(Record))));
+    }
+    return records;
+}
+
+QVector<int> PagedDocument::pagesIntersecting(const QRectF &rect) const
+{
+    // 页目录只有每页一项，线性扫描的开销与图形数量无关
+    QVector<int> pages;
+    for (int page = 0; page < m_pages.size(); ++page) {
+        const PageInfo &info = m_pages.at(page);
+        if ((info.count > 0 || m_dirty.contains(page)) && info.bounds.intersects(rect)) {
+            pages.append(page);
+        }
+    }
+    return pages;
+}
+
+int PagedDocument::pageOfCell(qint32 cellX, qint32 cellY)
+{
+    const auto it = m_pageOfCell.constFind(cellKey(cellX, cellY));
+    if (it != m_pageOfCell.constEnd()) {
+        return it.value();
+    }
+
+    PageInfo info;
+    info.cellX = cellX;
+    info.cellY = cellY;
+    m_pages.append(info);
+    m_pageOfCell.insert(cellKey(cellX, cellY), m_pages.size() - 1);
+    return m_pages.size() - 1;
+}
+
+QHash<int, QVector<PagedDocument::Record>> PagedDocument::groupOverlay(const ShapeStore::Snapshot &overlay,
+                                                                      const QHash<int, qint64> &takenZ)
+{
+    // overlay使用自己的样式表，先映射到文档的样式表
+    QVector<quint32> styleMap;
+    styleMap.reserve(overlay.styles.size());
+    for (const ShapeStore::Style &style : overlay.styles) {
+        styleMap.append(styleIndexOf(style));
+    }
+
+    // 取出的图形保留原来的层序号，其他overlay图形在文档原有图形之上，层序号按行号依次排列
+    QHash<int, QVector<Record>> groups;
+    for (int row = 0; row < overlay.size(); ++row) {
+        const ShapeStore::Record &source = overlay.records.at(row);
+        Record record;
+        record.rect = source.rect;
+        record.z = takenZ.value(row, m_overlayBase + row);
+        record.id = source.id;
+        record.styleIndex = styleMap.at(int(source.styleIndex));
+        record.type = source.type;
+        record.flags = source.flags & ShapeStore::Filled;
+
+        const QPointF center = source.rect.normalized().center();
+        groups[pageOfCell(cellCoord(center.x(), m_cellSize), cellCoord(center.y(), m_cellSize))].append(record);
+    }
+    return groups;
+}
+
+quint32 PagedDocument::styleIndexOf(const ShapeStore::Style &style)
+{
+    const int index = m_styles.indexOf(style);
+    if (index >= 0) {
+        return quint32(index);
+    }
+    m_styles.append(style);
+    return quint32(m_styles.size() - 1);
+}
+
+bool PagedDocument::writePage(QIODevice *device, const QVector<Record> &records,
+                              const QVector<ShapeStore::Style> &styles, PageInfo *info)
+{
+    info->offset = 0;
+    info->count = records.size();
+    info->bounds = QRectF();
+    if (records.isEmpty()) return true;
+
+    QByteArray bytes(records.size() * kRecordSize, '\0');
+    char *out = bytes.data();
+    for (const Record &record : records) {
+        out[0] = char(record.type);
+        out[1] = char(record.flags);
+        putU32(out + 4, record.styleIndex);
+        putU32(out + 8, quint32(record.id));
+        putU64(out + 16, quint64(record.z));
+        putF64(out + 24, record.rect.x());
+        putF64(out + 32, record.rect.y());
+        putF64(out + 40, record.rect.width());
+        putF64(out + 48, record.rect.height());
+        info->bounds = info->bounds.united(strokeBounds(record, styles));
+        out += kRecordSize;
+    }
+
+    info->offset = device->pos();
+    return device->write(bytes) == bytes.size();
+}
+
+bool PagedDocument::writeTail(QIODevice *device, const QVector<ShapeStore::Style> &styles,
+                              const QVector<PageInfo> &pages, double cellSize, qint64 nextZ)
+{
+    const qint64 styleOffset = device->pos();
+    QByteArray bytes(styles.size() * kStyleRecordSize, '\0');
+    char *out = bytes.data();
+    for (const ShapeStore::Style &style : styles) {
+        putU32(out, style.color);
+        putU32(out + 4, style.fillColor);
+        putU32(out + 8, quint32(style.lineWidth));
+        out += kStyleRecordSize;
+    }
+    if (device->write(bytes) != bytes.size()) return false;
+
+    const qint64 directoryOffset = device->pos();
+    quint64 shapeCount = 0;
+    bytes.fill('\0', pages.size() * kDirectoryEntrySize);
+    out = bytes.data();
+    for (const PageInfo &info : pages) {
+        putU32(out, quint32(info.cellX));
+        putU32(out + 4, quint32(info.cellY));
+        putU64(out + 8, quint64(info.offset));
+        putU32(out + 16, quint32(info.count));
+        putF64(out + 24, info.bounds.x());
+        putF64(out + 32, info.bounds.y());
+        putF64(out + 40, info.bounds.width());
+        putF64(out + 48, info.bounds.height());
+        shapeCount += quint64(info.count);
+        out += kDirectoryEntrySize;
+    }
+    if (device->write(bytes) != bytes.size()) return false;
+
+    // 文件头放在最后写入，之前的内容全部写完后新的页目录才生效
+    char header[kHeaderSize] = {};
+    std::memcpy(header, kMagic, sizeof(kMagic));
+    putU16(header + 8, MajorVersion);
+    putU16(header + 10, MinorVersion);
+    putU32(header + 12, quint32(pages.size()));
+    putU64(header + 16, quint64(directoryOffset));
+    putU64(header + 24, quint64(styleOffset));
+    putU32(header + 32, quint32(styles.size()));
+    putF64(header + 40, cellSize);
+    putU64(header + 48, quint64(nextZ));
+    putU64(header + 56, shapeCount);
+    return device->seek(0) && device->write(header, kHeaderSize) == kHeaderSize;
+}
+
+qint64 PagedDocument::liveBytes(const QVector<PageInfo> &pages, int styleCount)
+{
+    qint64 bytes = kHeaderSize + qint64(styleCount) * kStyleRecordSize + qint64(pages.size()) * kDirectoryEntrySize;
+    for (const PageInfo &info : pages) {
+        bytes += qint64(info.count) * kRecordSize;
+    }
+    return bytes;
+}
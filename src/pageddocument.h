@@ -0,0 +1,316 @@
+#ifndef PAGEDDOCUMENT_H
+#define PAGEDDOCUMENT_H
+
+#include <QCache>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QRectF>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include "shapestore.h"
+
+class QPainter;
+class Shape;
+
+/**
+ * @file pageddocument.h
+ * @brief 分页文档的头文件
+ *
+ * 这个文件定义了PagedDocument类，按空间分页存放超出内存容量的文档，只把需要的页读入内存。
+ *
+ * 文件结构（所有整数均为小端序）：
+ * - 文件头（64字节）：8字节魔数、主版本号、次版本号、页数、页目录位置、样式表位置、样式数量、
+ *   网格边长、下一个层序号、图形总数
+ * - 若干页，每页是同一个网格单元中的图形记录，按层序号从小到大排列。
+ *   图形记录（56字节）包含类型、标志位、样式表下标、ID、层序号和边界矩形
+ * - 样式表，每条记录为线条颜色、填充颜色和线宽（16字节）
+ * - 页目录，每页一条（56字节）：网格单元坐标、页的位置、记录数量和页中图形的描边边界
+ *
+ * 保存时只把变化的页追加到文件末尾，随后写入新的样式表和页目录，最后改写文件头。
+ * 写入中途失败时文件头仍然指向旧的页目录，文件保持上次保存时的内容。
+ */
+
+/**
+ * @class PagedDocument
+ * @brief 按空间分页、按需读取的文档
+ *
+ * 平面按固定边长划分为网格，每个图形按边界矩形的中心归入一个网格单元，同一单元的图形构成一页。
+ * 打开文档时只读取页目录和样式表，每页的图形记录在第一次被绘制或点击时才从文件中映射读取，
+ * 读取的页按最近最少使用的顺序保存在容量有限的缓存中，内存占用与文档大小无关。
+ *
+ * 分页文档中的图形不创建Shape对象，直接按记录绘制。用户选择其中的图形时只得到一个副本（见shapeAt()），
+ * 开始编辑时图形才从所在的页中取出（见take()），成为普通的Shape对象交给Document编辑，
+ * 仍然按原来的层序号与页中的图形一起绘制；所在的页标记为已修改，在保存之前一直保留在内存中。
+ * 保存时Document中的图形（见ShapeStore）按所在的网格单元与各页合并写入文件，
+ * 取出的图形保留原来的层序号，其他图形的层序号排在文档原有的图形之后。
+ *
+ * draw()可以在多个工作线程中同时调用，其他函数只能在GUI线程中调用。
+ */
+class PagedDocument
+{
+public:
+    static const quint16 MajorVersion = 1;  ///< 主版本号
+    static const quint16 MinorVersion = 0;  ///< 次版本号
+
+    /**
+     * @struct Record
+     * @brief 页中的一个图形
+     */
+    struct Record {
+        QRectF rect;             ///< 边界矩形（未归一化，与Shape::getBoundingRect()相同）
+        qint64 z = 0;            ///< 层序号，越大越靠上
+        int id = 0;              ///< 图形ID
+        quint32 styleIndex = 0;  ///< 样式表下标
+        quint8 type = 0;         ///< 图形类型
+        quint8 flags = 0;        ///< 标志位，见ShapeStore::Flag
+    };
+
+    /**
+     * @brief PagedDocument类的构造函数
+     */
+    PagedDocument();
+
+    /**
+     * @brief PagedDocument类的析构函数
+     *
+     * 未保存的修改被丢弃。
+     */
+    ~PagedDocument();
+
+    /**
+     * @brief 判断文件是否是分页文档
+     * @param filename 文件名
+     * @return 如果文件以分页文档的魔数开头，返回true
+     */
+    static bool isPagedFile(const QString &filename);
+
+    /**
+     * @brief 把快照中的所有图形写入新的分页文档
+     * @param filename 文件名
+     * @param snapshot 文档快照
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @return 写入成功返回true
+     *
+     * 网格边长按图形的分布选择，使每页平均包含约4096个图形。
+     */
+    static bool create(const QString &filename, const ShapeStore::Snapshot &snapshot,
+                       QString *errorString = nullptr);
+
+    /**
+     * @brief 打开分页文档
+     * @param filename 文件名
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @return 打开成功返回true，失败时保持关闭状态
+     *
+     * 只读取文件头、样式表和页目录。
+     */
+    bool open(const QString &filename, QString *errorString = nullptr);
+
+    /**
+     * @brief 关闭文档，丢弃未保存的修改和缓存的页
+     */
+    void close();
+
+    /**
+     * @brief 判断文档是否已打开
+     * @return 如果已打开，返回true
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief 获取文档的文件名
+     * @return 文件名，未打开时为空
+     */
+    QString fileName() const;
+
+    /**
+     * @brief 获取文档中所有图形的描边边界
+     * @return 各页边界的并集
+     */
+    QRectF bounds() const;
+
+    /**
+     * @brief 判断是否有图形被取出而还没有保存
+     * @return 如果有已修改的页，返回true
+     */
+    bool isModified() const;
+
+    /**
+     * @brief 设置页缓存的容量
+     * @param bytes 字节数，超出时丢弃最久没有使用的页
+     *
+     * 已修改的页不计入容量，保存之前一直保留。
+     */
+    void setCacheBudget(qint64 bytes);
+
+    /**
+     * @brief 获取页缓存的容量
+     * @return 字节数
+     */
+    qint64 cacheBudget() const;
+
+    /**
+     * @brief 绘制与矩形区域相交的图形
+     * @param painter 绘图工具
+     * @param rect 矩形区域
+     * @param taken 已取出的图形及其层序号，与页中的图形按层序号合并绘制
+     *
+     * 按层序号从下到上绘制，缺少的页从文件中读取。可以在工作线程中调用。
+     */
+    void draw(QPainter *painter, const QRectF &rect,
+              const QVector<QPair<qint64, Shape *>> &taken = QVector<QPair<qint64, Shape *>>()) const;
+
+    /**
+     * @brief 获取包含指定点的最上层图形的副本
+     * @param pos 位置
+     * @param z 返回图形的层序号，可以为nullptr
+     * @return 新创建的图形，由调用者负责释放；如果没有，返回nullptr
+     *
+     * 不修改文档，图形仍然留在页中。
+     */
+    Shape *shapeAt(const QPointF &pos, qint64 *z = nullptr) const;
+
+    /**
+     * @brief 从页中取出图形
+     * @param z 图形的层序号，见shapeAt()
+     * @param rect 图形的边界矩形，用于查找所在的页
+     * @return 找到并取出时返回true
+     *
+     * 所在的页标记为已修改。之后读取页时跳过这个层序号，保存后文件中同一图形的新记录也不会再读入。
+     */
+    bool take(qint64 z, const QRectF &rect);
+
+    /**
+     * @brief 把取出的图形放回页中，用于撤销take()
+     * @param shape 图形，按它现在的数据生成记录
+     * @param z 取出时的层序号
+     */
+    void restore(const Shape *shape, qint64 z);
+
+    /**
+     * @brief 把修改写回文件
+     * @param overlay Document中的图形，与各页合并写入
+     * @param takenZ overlay中已取出的图形原来的层序号，按行号索引
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @return 写入成功返回true
+     *
+     * 只追加已修改的页和包含overlay中图形的页。文件中被替换的旧页超过有效数据的大小时，
+     * 改为整个文件重写，相当于压缩文件。
+     */
+    bool save(const ShapeStore::Snapshot &overlay, const QHash<int, qint64> &takenZ,
+              QString *errorString = nullptr);
+
+    /**
+     * @brief 把文档完整写入另一个文件，之后编辑的是新文件
+     * @param filename 文件名，可以与当前文件相同
+     * @param overlay Document中的图形，与各页合并写入
+     * @param takenZ overlay中已取出的图形原来的层序号，按行号索引
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @return 写入成功返回true，失败时仍然编辑原来的文件
+     *
+     * 逐页读取和写入，不会把整个文档读入内存。
+     */
+    bool saveAs(const QString &filename, const ShapeStore::Snapshot &overlay,
+                const QHash<int, qint64> &takenZ, QString *errorString = nullptr);
+
+private:
+    /**
+     * @struct PageInfo
+     * @brief 页目录中的一项
+     */
+    struct PageInfo {
+        qint32 cellX = 0;   ///< 网格单元的横坐标
+        qint32 cellY = 0;   ///< 网格单元的纵坐标
+        qint64 offset = 0;  ///< 页在文件中的位置，0表示页还没有写入文件
+        int count = 0;      ///< 文件中的记录数量
+        QRectF bounds;      ///< 文件中各图形的描边边界
+    };
+
+    /**
+     * @brief 获取一页的图形记录，调用时需持有m_mutex
+     * @param page 页号
+     * @param cache 为true时把读取的页放入缓存
+     * @return 按层序号排列的记录，不含overlay中的图形（层序号不小于m_overlayBase或在m_taken中）
+     */
+    QVector<Record> loadPage(int page, bool cache) const;
+
+    /**
+     * @brief 获取与矩形区域相交的页
+     * @param rect 矩形区域
+     * @return 页号
+     */
+    QVector<int> pagesIntersecting(const QRectF &rect) const;
+
+    /**
+     * @brief 获取网格单元对应的页，没有时创建一个空页
+     * @param cellX 网格单元的横坐标
+     * @param cellY 网格单元的纵坐标
+     * @return 页号
+     */
+    int pageOfCell(qint32 cellX, qint32 cellY);
+
+    /**
+     * @brief 把overlay中的图形按网格单元分组，并转换为记录
+     * @param overlay Document中的图形
+     * @param takenZ overlay中已取出的图形原来的层序号，按行号索引
+     * @return 页号到记录的映射，必要时创建新的页
+     */
+    QHash<int, QVector<Record>> groupOverlay(const ShapeStore::Snapshot &overlay, const QHash<int, qint64> &takenZ);
+
+    /**
+     * @brief 在样式表中查找样式，没有时追加
+     * @param style 样式
+     * @return 样式表下标
+     */
+    quint32 styleIndexOf(const ShapeStore::Style &style);
+
+    /**
+     * @brief 在设备的当前位置写入一页
+     * @param device 输出设备
+     * @param records 按层序号排列的记录
+     * @param styles 样式表，用于计算描边边界
+     * @param info 写入后更新页的位置、记录数量和边界
+     * @return 写入成功返回true
+     */
+    static bool writePage(QIODevice *device, const QVector<Record> &records,
+                          const QVector<ShapeStore::Style> &styles, PageInfo *info);
+
+    /**
+     * @brief 在设备的当前位置写入样式表和页目录，然后改写文件头
+     * @param device 输出设备，所有页都已写入
+     * @param styles 样式表
+     * @param pages 页目录
+     * @param cellSize 网格边长
+     * @param nextZ 下一个层序号
+     * @return 写入成功返回true
+     */
+    static bool writeTail(QIODevice *device, const QVector<ShapeStore::Style> &styles,
+                          const QVector<PageInfo> &pages, double cellSize, qint64 nextZ);
+
+    /**
+     * @brief 计算文件中有效数据的字节数
+     * @param pages 页目录
+     * @param styleCount 样式数量
+     * @return 文件头、各页、样式表和页目录的总长度
+     */
+    static qint64 liveBytes(const QVector<PageInfo> &pages, int styleCount);
+
+    mutable QMutex m_mutex;                         ///< 保护m_file和m_cache，draw()可能在多个线程中同时读取
+    mutable QFile m_file;                           ///< 打开的文档文件
+    mutable QCache<int, QVector<Record>> m_cache;   ///< 最近使用的页，按字节数计算容量
+    QString m_fileName;                             ///< 文档的文件名
+    QVector<PageInfo> m_pages;                      ///< 页目录
+    QHash<quint64, int> m_pageOfCell;               ///< 网格单元到页号的映射
+    QHash<int, QVector<Record>> m_dirty;            ///< 已修改的页，保存之前一直保留
+    QSet<qint64> m_taken;                           ///< 已取出的图形的层序号，读取页时跳过
+    QVector<ShapeStore::Style> m_styles;            ///< 样式表
+    QVector<int> m_overlayPages;                    ///< 上次保存时包含overlay图形的页
+    double m_cellSize;                              ///< 网格边长
+    qint64 m_overlayBase;                           ///< 打开时的下一个层序号，overlay图形的层序号从这里开始
+    qint64 m_garbageBytes;                          ///< 文件中已被替换的旧页的字节数
+};
+
+#endif // PAGEDDOCUMENT_H
@@ -17,6 +17,29 @@ Rectangle::~Rectangle()
 {
 }
 
+void *Rectangle::operator new(size_t size)
+{
+    if (size != sizeof(Rectangle)) {
+        return ::operator new(size);
+    }
+    return pool().allocate();
+}
+
+void Rectangle::operator delete(void *ptr, size_t size)
+{
+    if (size != sizeof(Rectangle)) {
+        ::operator delete(ptr);
+        return;
+    }
+    pool().deallocate(ptr);
+}
+
+ShapePool &Rectangle::pool()
+{
+    static ShapePool pool(sizeof(Rectangle));
+    return pool;
+}
+
 void Rectangle::draw(QPainter *painter)
 {
     painter->save();
@@ -98,7 +121,8 @@ void Rectangle::load(const QString &data)
 
 bool Rectangle::contains(const QPointF &point) const
 {
-    return createPath().contains(point);
+    // 矩形直接比较边界，无需构造路径
+    return m_boundingRect.normalized().contains(point);
 }
 
 QPainterPath Rectangle::createPath() const
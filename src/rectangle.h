@@ -2,6 +2,7 @@
 #define RECTANGLE_H
 
 #include "shape.h"
+#include "shapepool.h"
 
 /**
  * @file rectangle.h
@@ -76,6 +77,28 @@ public:
      */
     bool contains(const QPointF &point) const override;
 
+    /**
+     * @brief 从矩形内存池分配对象
+     * @param size 对象大小
+     * @return 内存地址
+     *
+     * 派生类的对象大小不同，此时改用全局分配。
+     */
+    static void *operator new(size_t size);
+
+    /**
+     * @brief 把对象归还给矩形内存池
+     * @param ptr 内存地址
+     * @param size 对象大小
+     */
+    static void operator delete(void *ptr, size_t size);
+
+    /**
+     * @brief 获取矩形对象使用的内存池
+     * @return 内存池
+     */
+    static ShapePool &pool();
+
 private:
     /**
      * @brief 创建矩形的路径
@@ -1,15 +1,42 @@
 #include "shape.h"
 
-int Shape::s_nextId = 1;
+QAtomicInt Shape::s_nextId = 1;
+
+namespace {
+// IdBatch每次预留的ID数量
+const int kIdBlockSize = 1024;
+
+// 当前线程最内层的IdBatch
+thread_local Shape::IdBatch *t_idBatch = nullptr;
+}
+
+Shape::IdBatch::IdBatch()
+    : m_outer(t_idBatch),
+      m_next(0),
+      m_end(0),
+      m_maxId(0),
+      m_hasMaxId(false)
+{
+    t_idBatch = this;
+}
+
+Shape::IdBatch::~IdBatch()
+{
+    t_idBatch = m_outer;
+    if (m_hasMaxId) {
+        Shape::reserveIdsThrough(m_maxId);
+    }
+}
 
 Shape::Shape()
-    : m_id(s_nextId++),
+    : m_id(nextId()),
       m_type(Ellipse),
       m_color(Qt::black),
       m_lineWidth(2),
       m_boundingRect(),
       m_selected(false),
       m_filled(false),
+      m_storeHandle(0xffffffffu),
       m_fillColor(Qt::white)
 {
 }
@@ -73,6 +100,35 @@ int Shape::getId() const
 void Shape::setId(int id)
 {
     m_id = id;
+
+    if (IdBatch *batch = t_idBatch) {
+        batch->m_maxId = batch->m_hasMaxId ? qMax(batch->m_maxId, id) : id;
+        batch->m_hasMaxId = true;
+        return;
+    }
+    reserveIdsThrough(id);
+}
+
+int Shape::nextId()
+{
+    IdBatch *batch = t_idBatch;
+    if (!batch) {
+        return s_nextId.fetchAndAddRelaxed(1);
+    }
+
+    if (batch->m_next == batch->m_end) {
+        batch->m_next = s_nextId.fetchAndAddRelaxed(kIdBlockSize);
+        batch->m_end = batch->m_next + kIdBlockSize;
+    }
+    return batch->m_next++;
+}
+
+void Shape::reserveIdsThrough(int id)
+{
+    int next = s_nextId.loadRelaxed();
+    while (next <= id && !s_nextId.testAndSetRelaxed(next, id + 1)) {
+        next = s_nextId.loadRelaxed();
+    }
 }
 
 Shape::ShapeType Shape::getType() const
@@ -115,6 +171,13 @@ void Shape::setBoundingRect(const QRectF &rect)
     m_boundingRect = rect;
 }
 
+QRectF Shape::getStrokeBounds() const
+{
+    // 向外扩展半个线宽，再留出1像素给抗锯齿
+    qreal margin = m_lineWidth / 2.0 + 1.0;
+    return m_boundingRect.normalized().adjusted(-margin, -margin, margin, margin);
+}
+
 bool Shape::isSelected() const
 {
     return m_selected;
@@ -5,6 +5,7 @@
 #include <QColor>
 #include <QRectF>
 #include <QString>
+#include <QAtomicInt>
 
 /**
  * @file shape.h
@@ -117,9 +118,40 @@ public:
     /**
      * @brief 设置图形ID
      * @param id 新的ID
+     *
+     * 之后新建的图形会分配更大的ID，不会与从文件读入的ID重复。
+     * 当前线程中有IdBatch时，推迟到IdBatch析构时一次登记。
      */
     void setId(int id);
 
+    /**
+     * @class IdBatch
+     * @brief 在当前线程中批量分配和登记图形ID
+     *
+     * 存在期间，当前线程新建的图形从一次预留的一段ID中取号，setId()只记下最大的ID，
+     * 析构时一次性保证之后新建的图形ID更大。并行加载文件时每段使用一个IdBatch，
+     * 各线程不必为每个图形修改同一个原子变量。预留而没有用到的ID被丢弃。
+     *
+     * 只在创建它的线程中起作用，可以嵌套。
+     */
+    class IdBatch
+    {
+    public:
+        IdBatch();
+        ~IdBatch();
+
+    private:
+        Q_DISABLE_COPY(IdBatch)
+
+        IdBatch *m_outer;  ///< 外层的IdBatch
+        int m_next;        ///< 预留的ID中下一个可用的ID
+        int m_end;         ///< 预留的ID的结尾
+        int m_maxId;       ///< setId()设置过的最大ID
+        bool m_hasMaxId;   ///< 是否调用过setId()
+
+        friend class Shape;
+    };
+
     /**
      * @brief 获取图形类型
      * @return 图形类型
@@ -168,6 +200,15 @@ public:
      */
     void setBoundingRect(const QRectF &rect);
 
+    /**
+     * @brief 获取包含描边的边界矩形
+     * @return 按线宽向外扩展后的边界矩形
+     *
+     * 描边以边界矩形为中心线绘制，会超出边界矩形半个线宽，
+     * 重绘和区域查询需要使用这个矩形才能覆盖图形实际绘制的像素。
+     */
+    QRectF getStrokeBounds() const;
+
     /**
      * @brief 判断图形是否被选中
      * @return 如果图形被选中，返回true，否则返回false
@@ -205,6 +246,16 @@ public:
     void setFillColor(const QColor &color);
 
 protected:
+    /**
+     * @brief 为新图形分配ID
+     */
+    static int nextId();
+
+    /**
+     * @brief 保证之后分配的ID大于id
+     */
+    static void reserveIdsThrough(int id);
+
     int m_id;              ///< 图形的唯一标识符
     ShapeType m_type;      ///< 图形类型
     QColor m_color;        ///< 图形颜色
@@ -212,9 +263,12 @@ protected:
     QRectF m_boundingRect; ///< 图形的边界矩形
     bool m_selected;       ///< 图形是否被选中
     bool m_filled;         ///< 图形是否填充
+    quint32 m_storeHandle; ///< ShapeStore分配的句柄，只由ShapeStore读写，放在对齐的空隙中不增加对象大小
     QColor m_fillColor;    ///< 图形填充颜色
 
-    static int s_nextId;   ///< 静态变量，用于生成唯一ID
+    static QAtomicInt s_nextId; ///< 静态变量，用于生成唯一ID，文件可能在多个线程中并行加载
+
+    friend class ShapeStore;
 };
 
 #endif // SHAPE_H
\ No newline at end of file
@@ -48,4 +48,10 @@ Shape *ShapeFactory::createShape(const QString &typeStr, const QRectF &rect)
     }
 
     return shape;
+}
+
+void ShapeFactory::releaseUnusedMemory()
+{
+    Ellipse::pool().releaseUnused();
+    Rectangle::pool().releaseUnused();
 }
\ No newline at end of file
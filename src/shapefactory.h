@@ -42,6 +42,14 @@ public:
      * @return 创建的图形对象指针，如果类型不支持，返回nullptr
      */
     static Shape *createShape(const QString &typeStr, const QRectF &rect);
+
+    /**
+     * @brief 归还空闲的图形内存
+     *
+     * 图形对象从各类型的内存池中分配，slab中的图形全部释放时slab已经归还给系统，
+     * 这里再归还各内存池备用的空slab，通常在清空文档后调用。
+     */
+    static void releaseUnusedMemory();
 };
 
 #endif // SHAPEFACTORY_H
\ No newline at end of file
@@ -0,0 +1,257 @@
+#include "shapepool.h"
+#include <QAtomicInt>
+#include <QMutexLocker>
+#include <new>
+
+namespace {
+// slab的大小，也是它的对齐，对象地址按它向下取整就得到slab的头部
+const size_t kSlabSize = 256 * 1024;
+
+// 使用线程缓存的内存池数量上限，每种图形类型一个内存池
+const int kMaxCachedPools = 8;
+
+// 已创建的内存池数量，用于分配线程缓存的下标
+QAtomicInt g_poolCount;
+
+size_t alignedSize(size_t size)
+{
+    const size_t alignment = alignof(std::max_align_t);
+    if (size < sizeof(void *)) size = sizeof(void *);
+    return (size + alignment - 1) / alignment * alignment;
+}
+}
+
+ShapePool::ShapePool(size_t objectSize)
+    : m_objectSize(alignedSize(objectSize)),
+      m_headerSize(alignedSize(sizeof(Slab))),
+      m_cacheIndex(-1),
+      m_available(nullptr),
+      m_spare(nullptr),
+      m_liveCount(0)
+{
+    const int index = g_poolCount.fetchAndAddRelaxed(1);
+    if (index < kMaxCachedPools) {
+        m_cacheIndex = index;
+    }
+}
+
+ShapePool::~ShapePool()
+{
+    for (Slab *slab : std::as_const(m_slabs)) {
+        ::operator delete(slab, std::align_val_t(kSlabSize));
+    }
+}
+
+void *ShapePool::allocate()
+{
+    ThreadCache *cache = threadCache();
+    if (!cache) {
+        QMutexLocker locker(&m_mutex);
+        return take();
+    }
+
+    if (!cache->head) {
+        QMutexLocker locker(&m_mutex);
+        refill(cache, kThreadCacheCapacity / 2);
+    }
+    FreeNode *node = cache->head;
+    cache->head = node->next;
+    --cache->count;
+    return node;
+}
+
+void ShapePool::deallocate(void *ptr)
+{
+    if (!ptr) return;
+
+    ThreadCache *cache = threadCache();
+    if (!cache) {
+        QMutexLocker locker(&m_mutex);
+        give(ptr);
+        return;
+    }
+
+    FreeNode *node = static_cast<FreeNode *>(ptr);
+    node->next = cache->head;
+    cache->head = node;
+    if (++cache->count > kThreadCacheCapacity) {
+        QMutexLocker locker(&m_mutex);
+        drain(cache, kThreadCacheCapacity / 2);
+    }
+}
+
+bool ShapePool::releaseUnused()
+{
+    ThreadCache *cache = threadCache();
+    QMutexLocker locker(&m_mutex);
+
+    const int slabs = m_slabs.size();
+    if (cache) {
+        drain(cache, cache->count);
+    }
+    if (m_spare) {
+        freeSlab(m_spare);
+        m_spare = nullptr;
+    }
+    return m_slabs.size() < slabs;
+}
+
+int ShapePool::liveCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_liveCount;
+}
+
+int ShapePool::slabCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_slabs.size();
+}
+
+qint64 ShapePool::reservedBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return qint64(m_slabs.size()) * qint64(kSlabSize);
+}
+
+ShapePool::ThreadCache::~ThreadCache()
+{
+    if (pool && count > 0) {
+        QMutexLocker locker(&pool->m_mutex);
+        pool->drain(this, count);
+    }
+}
+
+ShapePool::ThreadCache *ShapePool::threadCache()
+{
+    if (m_cacheIndex < 0) return nullptr;
+
+    thread_local ThreadCache caches[kMaxCachedPools];
+    ThreadCache *cache = &caches[m_cacheIndex];
+    cache->pool = this;
+    return cache;
+}
+
+void ShapePool::refill(ThreadCache *cache, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        FreeNode *node = static_cast<FreeNode *>(take());
+        node->next = cache->head;
+        cache->head = node;
+    }
+    cache->count += count;
+}
+
+void ShapePool::drain(ThreadCache *cache, int count)
+{
+    for (int i = 0; i < count && cache->head; ++i) {
+        FreeNode *node = cache->head;
+        cache->head = node->next;
+        --cache->count;
+        give(node);
+    }
+}
+
+void *ShapePool::take()
+{
+    Slab *slab = m_available;
+    if (!slab) {
+        if (m_spare) {
+            slab = m_spare;
+            m_spare = nullptr;
+        } else {
+            slab = addSlab();
+        }
+        link(slab);
+    }
+
+    void *ptr;
+    if (slab->freeList) {
+        ptr = slab->freeList;
+        slab->freeList = slab->freeList->next;
+    } else {
+        ptr = slab->cursor;
+        slab->cursor += m_objectSize;
+    }
+    ++slab->used;
+    ++m_liveCount;
+
+    // 已经没有空闲对象的slab移出链表，释放对象时再加回来
+    const char *end = reinterpret_cast<const char *>(slab) + kSlabSize;
+    if (!slab->freeList && slab->cursor + m_objectSize > end) {
+        unlink(slab);
+    }
+    return ptr;
+}
+
+void ShapePool::give(void *ptr)
+{
+    Slab *slab = slabOf(ptr);
+    FreeNode *node = static_cast<FreeNode *>(ptr);
+    node->next = slab->freeList;
+    slab->freeList = node;
+    --slab->used;
+    --m_liveCount;
+
+    if (slab->used > 0) {
+        if (!slab->linked) link(slab);
+        return;
+    }
+
+    // slab中的对象全部释放，保留一个备用，其余立即归还给系统
+    if (slab->linked) unlink(slab);
+    if (m_spare) {
+        freeSlab(slab);
+    } else {
+        slab->freeList = nullptr;
+        slab->cursor = reinterpret_cast<char *>(slab) + m_headerSize;
+        m_spare = slab;
+    }
+}
+
+ShapePool::Slab *ShapePool::slabOf(void *ptr)
+{
+    return reinterpret_cast<Slab *>(reinterpret_cast<quintptr>(ptr) & ~quintptr(kSlabSize - 1));
+}
+
+void ShapePool::link(Slab *slab)
+{
+    slab->prev = nullptr;
+    slab->next = m_available;
+    if (m_available) m_available->prev = slab;
+    m_available = slab;
+    slab->linked = true;
+}
+
+void ShapePool::unlink(Slab *slab)
+{
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        m_available = slab->next;
+    }
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->prev = nullptr;
+    slab->next = nullptr;
+    slab->linked = false;
+}
+
+ShapePool::Slab *ShapePool::addSlab()
+{
+    void *memory = ::operator new(kSlabSize, std::align_val_t(kSlabSize));
+    Slab *slab = static_cast<Slab *>(memory);
+    slab->prev = nullptr;
+    slab->next = nullptr;
+    slab->linked = false;
+    slab->freeList = nullptr;
+    slab->cursor = static_cast<char *>(memory) + m_headerSize;
+    slab->used = 0;
+    m_slabs.append(slab);
+    return slab;
+}
+
+void ShapePool::freeSlab(Slab *slab)
+{
+    m_slabs.removeOne(slab);
+    ::operator delete(slab, std::align_val_t(kSlabSize));
+}
@@ -0,0 +1,185 @@
+#ifndef SHAPEPOOL_H
+#define SHAPEPOOL_H
+
+#include <QList>
+#include <QMutex>
+#include <cstddef>
+
+/**
+ * @file shapepool.h
+ * @brief 图形内存池类的头文件
+ *
+ * 这个文件定义了ShapePool类，为同一类型的图形对象提供固定大小的内存块。
+ * 内存按slab批量向系统申请，释放的对象进入空闲链表供后续复用。
+ */
+
+/**
+ * @class ShapePool
+ * @brief 固定大小对象的slab内存池
+ *
+ * 每种图形类型使用一个独立的内存池（见Ellipse::operator new和Rectangle::operator new），
+ * 因此ShapeFactory创建的图形和普通的delete释放都会经过内存池，调用者无需改变写法。
+ *
+ * 内存按固定大小、按自身大小对齐的slab向系统申请，对象地址向下取整就是所在slab的头部。
+ * 每个slab有自己的空闲链表和存活计数，对象释放后回到所在的slab；
+ * slab中的对象全部释放后立即归还给系统（保留一个空slab备用，避免反复申请），
+ * 所以清空文档时旧文档的slab会被归还，即使新文档的图形已经分配。
+ *
+ * 每个线程有一个小的缓存，分配和释放先在缓存中进行，不需要加锁；
+ * 缓存空了或满了时才加锁，与slab一次交换半个缓存的对象。
+ * 在多个线程中并行创建图形（例如并行解析文件）或一次释放整个文档时，
+ * 不会在每个对象上争用互斥锁。线程缓存中的对象仍计入所在slab的存活计数，
+ * 每个线程最多缓存kThreadCacheCapacity个对象。
+ *
+ * 内存池必须比使用它的线程活得更久，各类型的内存池都是静态对象。
+ */
+class ShapePool
+{
+public:
+    /**
+     * @brief ShapePool类的构造函数
+     * @param objectSize 对象大小（字节）
+     */
+    explicit ShapePool(size_t objectSize);
+
+    /**
+     * @brief ShapePool类的析构函数
+     *
+     * 归还所有slab。
+     */
+    ~ShapePool();
+
+    /**
+     * @brief 分配一个对象的内存
+     * @return 内存地址
+     */
+    void *allocate();
+
+    /**
+     * @brief 释放一个对象的内存
+     * @param ptr 由allocate()返回的内存地址
+     */
+    void deallocate(void *ptr);
+
+    /**
+     * @brief 归还当前线程缓存的对象和备用的空slab
+     * @return 如果有slab被归还，返回true
+     *
+     * 其他slab在其中的对象全部释放时已经自动归还，通常在清空文档后调用。
+     */
+    bool releaseUnused();
+
+    /**
+     * @brief 获取存活的对象数量
+     * @return 已分配且尚未归还给slab的对象数量，包括各线程缓存中的对象
+     */
+    int liveCount() const;
+
+    /**
+     * @brief 获取已申请的slab数量
+     * @return slab数量
+     */
+    int slabCount() const;
+
+    /**
+     * @brief 获取已申请的内存总量
+     * @return 所有slab的字节数之和
+     */
+    qint64 reservedBytes() const;
+
+    static const int kThreadCacheCapacity = 64;  ///< 每个线程为一个内存池最多缓存的对象数量
+
+private:
+    Q_DISABLE_COPY(ShapePool)
+
+    /**
+     * @brief 空闲链表的节点，复用已释放对象的内存
+     */
+    struct FreeNode {
+        FreeNode *next;
+    };
+
+    /**
+     * @brief slab的头部，位于slab内存的开头
+     */
+    struct Slab {
+        Slab *prev;           ///< 有空闲对象的slab链表中的前一个
+        Slab *next;           ///< 有空闲对象的slab链表中的后一个
+        bool linked;          ///< 是否在有空闲对象的slab链表中
+        FreeNode *freeList;   ///< 已释放的对象
+        char *cursor;         ///< 尚未切分的起始位置
+        int used;             ///< 已分配出去的对象数量
+    };
+
+    /**
+     * @brief 一个线程为一个内存池缓存的对象
+     */
+    struct ThreadCache {
+        ShapePool *pool = nullptr;  ///< 所属的内存池
+        FreeNode *head = nullptr;   ///< 缓存的对象
+        int count = 0;              ///< 缓存的对象数量
+
+        /**
+         * @brief 线程结束时把缓存的对象还给内存池
+         */
+        ~ThreadCache();
+    };
+
+    /**
+     * @brief 获取当前线程为这个内存池使用的缓存
+     * @return 缓存，内存池数量超过上限时返回nullptr（直接加锁分配和释放）
+     */
+    ThreadCache *threadCache();
+
+    /**
+     * @brief 从slab中取出count个对象放入缓存，调用前需持有锁
+     */
+    void refill(ThreadCache *cache, int count);
+
+    /**
+     * @brief 把缓存中的count个对象还给所在的slab，调用前需持有锁
+     */
+    void drain(ThreadCache *cache, int count);
+
+    /**
+     * @brief 从slab中取出一个对象，调用前需持有锁
+     */
+    void *take();
+
+    /**
+     * @brief 把一个对象还给所在的slab，slab变空时归还给系统，调用前需持有锁
+     */
+    void give(void *ptr);
+
+    /**
+     * @brief 获取对象所在的slab
+     */
+    static Slab *slabOf(void *ptr);
+
+    /**
+     * @brief 把slab加入或移出有空闲对象的slab链表
+     */
+    void link(Slab *slab);
+    void unlink(Slab *slab);
+
+    /**
+     * @brief 申请一个新的slab
+     */
+    Slab *addSlab();
+
+    /**
+     * @brief 归还一个slab
+     */
+    void freeSlab(Slab *slab);
+
+    mutable QMutex m_mutex;     ///< 保护以下所有成员
+    size_t m_objectSize;        ///< 对齐后的对象大小
+    size_t m_headerSize;        ///< 对齐后的slab头部大小
+    int m_cacheIndex;           ///< 线程缓存的下标，-1表示不使用线程缓存
+    QList<Slab *> m_slabs;      ///< 已申请的slab
+    Slab *m_available;          ///< 有空闲对象的slab链表
+    Slab *m_spare;              ///< 备用的空slab，不在m_available中
+    int m_liveCount;            ///< 存活的对象数量
+};
+
+#endif // SHAPEPOOL_H
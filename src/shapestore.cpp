@@ -0,0 +1,629 @@
+#include "shapestore.h"
+#include <QHashFunctions>
+#include <QSet>
+#include <algorithm>
+#include <utility>
+
+const ShapeStore::Handle ShapeStore::InvalidHandle;
+
+namespace {
+// 记录的变化类型
+const quint8 kPlaced = 0x1;    // 新增或图层位置改变
+const quint8 kModified = 0x2;  // 属性改变
+
+// 在rows指定的最终位置插入默认值，rows严格递增
+template<typename Column>
+void spliceColumn(Column &column, const QVector<int> &rows)
+{
+    typedef typename Column::value_type T;
+    Column result;
+    result.reserve(column.size() + rows.size());
+    int next = 0;
+    int source = 0;
+    const int total = column.size() + rows.size();
+    for (int row = 0; row < total; ++row) {
+        if (next < rows.size() && rows.at(next) == row) {
+            result.append(T());
+            ++next;
+        } else {
+            result.append(column.at(source++));
+        }
+    }
+    column.swap(result);
+}
+
+// 删除removed中标记的行，first之前的行保持不动
+template<typename Column>
+void compactColumn(Column &column, const QVector<bool> &removed, int first)
+{
+    int out = first;
+    for (int row = first; row < column.size(); ++row) {
+        if (!removed.at(row)) {
+            column[out++] = column.at(row);
+        }
+    }
+    column.resize(out);
+}
+}
+
+ShapeStore::ShapeStore()
+    : m_firstStaleRow(0),
+      m_trackChanges(false),
+      m_changesLost(false),
+      m_revision(0)
+{
+}
+
+int ShapeStore::size() const
+{
+    return m_shapes.size();
+}
+
+bool ShapeStore::isEmpty() const
+{
+    return m_shapes.isEmpty();
+}
+
+const QList<Shape *> &ShapeStore::shapes() const
+{
+    return m_shapes;
+}
+
+Shape *ShapeStore::at(int row) const
+{
+    return m_shapes.at(row);
+}
+
+int ShapeStore::indexOf(const Shape *shape) const
+{
+    return rowOf(shape);
+}
+
+bool ShapeStore::contains(const Shape *shape) const
+{
+    return rowOf(shape) >= 0;
+}
+
+ShapeStore::Handle ShapeStore::handleOf(const Shape *shape) const
+{
+    return rowOf(shape) >= 0 ? shape->m_storeHandle : InvalidHandle;
+}
+
+Shape *ShapeStore::shape(Handle handle) const
+{
+    if (handle >= Handle(m_rowOfHandle.size())) return nullptr;
+    int row = rowOfHandle(handle);
+    return row >= 0 ? m_shapes.at(row) : nullptr;
+}
+
+void ShapeStore::append(Shape *shape)
+{
+    insert(m_shapes.size(), shape);
+}
+
+void ShapeStore::insert(int row, Shape *shape)
+{
+    if (!shape || contains(shape)) return;
+
+    if (row < 0 || row > m_shapes.size()) {
+        row = m_shapes.size();
+    }
+
+    const Handle handle = allocateHandle(shape);
+    insertRow(row);
+    m_shapes[row] = shape;
+    m_handles[row] = handle;
+    m_rowOfHandle[handle] = row;
+    writeRow(row, shape);
+    invalidateRowsFrom(row + 1);
+    markChanged(handle, kPlaced);
+}
+
+void ShapeStore::insertShapes(const QVector<int> &rows, const QList<Shape *> &shapes)
+{
+    refreshRows();
+
+    // 过滤无效和重复的图形
+    QVector<int> targetRows;
+    QList<Shape *> targetShapes;
+    QSet<const Shape *> seen;
+    targetRows.reserve(rows.size());
+    targetShapes.reserve(shapes.size());
+    for (int i = 0; i < rows.size() && i < shapes.size(); ++i) {
+        Shape *shape = shapes.at(i);
+        if (!shape || contains(shape) || seen.contains(shape)) continue;
+        seen.insert(shape);
+        targetRows.append(rows.at(i));
+        targetShapes.append(shape);
+    }
+    if (targetRows.isEmpty()) return;
+
+    // 保证行号严格递增且不超出插入后的末尾
+    const int count = targetRows.size();
+    const int total = m_shapes.size() + count;
+    for (int i = 0; i < count; ++i) {
+        int minRow = i == 0 ? 0 : targetRows.at(i - 1) + 1;
+        int maxRow = total - (count - i);
+        targetRows[i] = qBound(minRow, targetRows.at(i), maxRow);
+    }
+
+    spliceColumn(m_shapes, targetRows);
+    spliceColumn(m_handles, targetRows);
+    spliceColumn(m_left, targetRows);
+    spliceColumn(m_top, targetRows);
+    spliceColumn(m_right, targetRows);
+    spliceColumn(m_bottom, targetRows);
+    spliceColumn(m_types, targetRows);
+    spliceColumn(m_flags, targetRows);
+    spliceColumn(m_records, targetRows);
+
+    for (int i = 0; i < targetRows.size(); ++i) {
+        const int row = targetRows.at(i);
+        Shape *shape = targetShapes.at(i);
+
+        const Handle handle = allocateHandle(shape);
+        m_shapes[row] = shape;
+        m_handles[row] = handle;
+        writeRow(row, shape);
+        markChanged(handle, kPlaced);
+    }
+    invalidateRowsFrom(targetRows.first());
+}
+
+int ShapeStore::removeShapes(const QList<Shape *> &shapes)
+{
+    refreshRows();
+    QVector<bool> removed(m_shapes.size(), false);
+    int first = m_shapes.size();
+    int count = 0;
+    for (const Shape *shape : shapes) {
+        int row = indexOf(shape);
+        if (row < 0 || removed.at(row)) continue;
+
+        removed[row] = true;
+        first = qMin(first, row);
+        ++count;
+        markRemoved(row);
+
+        Handle handle = m_handles.at(row);
+        m_rowOfHandle[handle] = -1;
+        m_freeHandles.append(handle);
+    }
+    if (count == 0) return 0;
+
+    compactColumn(m_shapes, removed, first);
+    compactColumn(m_handles, removed, first);
+    compactColumn(m_left, removed, first);
+    compactColumn(m_top, removed, first);
+    compactColumn(m_right, removed, first);
+    compactColumn(m_bottom, removed, first);
+    compactColumn(m_types, removed, first);
+    compactColumn(m_flags, removed, first);
+    compactColumn(m_records, removed, first);
+    invalidateRowsFrom(first);
+    return count;
+}
+
+Shape *ShapeStore::takeAt(int row)
+{
+    Shape *shape = m_shapes.at(row);
+    Handle handle = m_handles.at(row);
+
+    markRemoved(row);
+    removeRow(row);
+    m_rowOfHandle[handle] = -1;
+    m_freeHandles.append(handle);
+    invalidateRowsFrom(row);
+    return shape;
+}
+
+bool ShapeStore::remove(const Shape *shape)
+{
+    refreshRows();
+    int row = indexOf(shape);
+    if (row < 0) return false;
+    takeAt(row);
+    return true;
+}
+
+void ShapeStore::move(int from, int to)
+{
+    if (from == to) return;
+
+    Shape *shape = m_shapes.at(from);
+    Handle handle = m_handles.at(from);
+    removeRow(from);
+    insertRow(to);
+    m_shapes[to] = shape;
+    m_handles[to] = handle;
+    writeRow(to, shape);
+    m_rowOfHandle[handle] = to;
+    invalidateRowsFrom(qMin(from, to));
+    markChanged(handle, kPlaced);
+}
+
+void ShapeStore::swap(int a, int b)
+{
+    if (a == b) return;
+
+    m_shapes.swapItemsAt(a, b);
+    std::swap(m_handles[a], m_handles[b]);
+    std::swap(m_left[a], m_left[b]);
+    std::swap(m_top[a], m_top[b]);
+    std::swap(m_right[a], m_right[b]);
+    std::swap(m_bottom[a], m_bottom[b]);
+    std::swap(m_types[a], m_types[b]);
+    std::swap(m_flags[a], m_flags[b]);
+    std::swap(m_records[a], m_records[b]);
+    m_rowOfHandle[m_handles[a]] = a;
+    m_rowOfHandle[m_handles[b]] = b;
+    markChanged(m_handles.at(a), kPlaced);
+    markChanged(m_handles.at(b), kPlaced);
+}
+
+void ShapeStore::clear()
+{
+    m_shapes.clear();
+    m_handles.clear();
+    m_left.clear();
+    m_top.clear();
+    m_right.clear();
+    m_bottom.clear();
+    m_types.clear();
+    m_flags.clear();
+    m_records.clear();
+    m_styles.clear();
+    m_styleLookup.clear();
+    m_rowOfHandle.clear();
+    m_firstStaleRow = 0;
+    m_freeHandles.clear();
+    ++m_revision;
+
+    // 句柄全部作废，之后的变化只能通过完整保存描述
+    if (m_trackChanges) {
+        m_changesLost = true;
+        m_changeOfHandle.clear();
+        m_changedHandles.clear();
+        m_removedIds.clear();
+    }
+}
+
+void ShapeStore::reserve(int count)
+{
+    m_shapes.reserve(count);
+    m_handles.reserve(count);
+    m_left.reserve(count);
+    m_top.reserve(count);
+    m_right.reserve(count);
+    m_bottom.reserve(count);
+    m_types.reserve(count);
+    m_flags.reserve(count);
+    m_records.reserve(count);
+    m_rowOfHandle.reserve(count);
+}
+
+void ShapeStore::sync(const Shape *shape)
+{
+    refreshRows();
+    int row = indexOf(shape);
+    if (row < 0) return;
+
+    // 只改变选中状态时不算作文档的变化
+    if (writeRow(row, shape)) {
+        markChanged(m_handles.at(row), kModified);
+    }
+}
+
+void ShapeStore::drawRows(QPainter *painter, const QVector<int> &rows) const
+{
+    painter->save();
+
+    // 相邻的图形经常使用同一个样式，样式不变时不重新设置画笔和画刷
+    quint32 currentStyle = 0xffffffffu;
+    bool currentFilled = false;
+    for (int row : rows) {
+        const quint8 type = m_types.at(row);
+        const quint8 flags = m_flags.at(row);
+        if ((flags & Selected) || (type != Shape::Rectangle && type != Shape::Ellipse)) {
+            // 选中的图形还要绘制控制点，其他类型没有对应的列，由图形对象绘制（会恢复画笔和画刷）
+            m_shapes.at(row)->draw(painter);
+            continue;
+        }
+
+        const Record &record = m_records.at(row);
+        const bool filled = flags & Filled;
+        if (record.styleIndex != currentStyle || filled != currentFilled) {
+            const Style &style = m_styles.at(record.styleIndex);
+            painter->setPen(QPen(QColor::fromRgba(style.color), style.lineWidth));
+            if (filled) {
+                painter->setBrush(QColor::fromRgba(style.fillColor));
+            } else {
+                painter->setBrush(Qt::NoBrush);
+            }
+            currentStyle = record.styleIndex;
+            currentFilled = filled;
+        }
+
+        // 与Rectangle::draw()和Ellipse::draw()相同，使用未归一化的边界矩形
+        if (type == Shape::Ellipse) {
+            painter->drawEllipse(record.rect);
+        } else {
+            painter->drawRect(record.rect);
+        }
+    }
+
+    painter->restore();
+}
+
+QRectF ShapeStore::boundsAt(int row) const
+{
+    // 使用记录中的qreal矩形，边界列是float，只适合做粗略的筛选
+    return m_records.at(row).rect.normalized();
+}
+
+QRectF ShapeStore::strokeBoundsAt(int row) const
+{
+    // 与Shape::getStrokeBounds()一致：向外扩展半个线宽，再留出1像素给抗锯齿
+    qreal margin = m_styles.at(m_records.at(row).styleIndex).lineWidth / 2.0 + 1.0;
+    return boundsAt(row).adjusted(-margin, -margin, margin, margin);
+}
+
+Shape::ShapeType ShapeStore::typeAt(int row) const
+{
+    return static_cast<Shape::ShapeType>(m_types.at(row));
+}
+
+quint8 ShapeStore::flagsAt(int row) const
+{
+    return m_flags.at(row);
+}
+
+const ShapeStore::Style &ShapeStore::styleAt(int row) const
+{
+    return m_styles.at(m_records.at(row).styleIndex);
+}
+
+quint32 ShapeStore::styleIndexAt(int row) const
+{
+    return m_records.at(row).styleIndex;
+}
+
+const QVector<ShapeStore::Style> &ShapeStore::styles() const
+{
+    return m_styles;
+}
+
+ShapeStore::Snapshot ShapeStore::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.records = m_records;
+    snapshot.styles = m_styles;
+    return snapshot;
+}
+
+quint64 ShapeStore::revision() const
+{
+    return m_revision;
+}
+
+void ShapeStore::setChangeTracking(bool enabled)
+{
+    m_trackChanges = enabled;
+    m_changesLost = false;
+    m_changeOfHandle.clear();
+    m_changedHandles.clear();
+    m_removedIds.clear();
+}
+
+bool ShapeStore::isChangeTracking() const
+{
+    return m_trackChanges;
+}
+
+ShapeStore::Changes ShapeStore::takeChanges()
+{
+    Changes changes;
+    changes.rewrite = m_changesLost;
+    changes.removedIds.swap(m_removedIds);
+    refreshRows();
+
+    for (Handle handle : std::as_const(m_changedHandles)) {
+        // 同一个句柄可能出现多次，取出后清除标记即可去重
+        const quint8 change = m_changeOfHandle.at(handle);
+        if (change == 0) continue;
+        m_changeOfHandle[handle] = 0;
+
+        const int row = rowOfHandle(handle);
+        if (row < 0) continue;
+        if (change & kPlaced) {
+            changes.placedRows.append(row);
+        } else {
+            changes.modifiedRows.append(row);
+        }
+    }
+    m_changedHandles.clear();
+    m_changesLost = false;
+
+    std::sort(changes.placedRows.begin(), changes.placedRows.end());
+    std::sort(changes.modifiedRows.begin(), changes.modifiedRows.end());
+    return changes;
+}
+
+const float *ShapeStore::lefts() const
+{
+    return m_left.constData();
+}
+
+const float *ShapeStore::tops() const
+{
+    return m_top.constData();
+}
+
+const float *ShapeStore::rights() const
+{
+    return m_right.constData();
+}
+
+const float *ShapeStore::bottoms() const
+{
+    return m_bottom.constData();
+}
+
+const quint8 *ShapeStore::types() const
+{
+    return m_types.constData();
+}
+
+bool ShapeStore::writeRow(int row, const Shape *shape)
+{
+    const QRectF rect = shape->getBoundingRect();
+    QRectF bounds = rect.normalized();
+    m_left[row] = float(bounds.left());
+    m_top[row] = float(bounds.top());
+    m_right[row] = float(bounds.right());
+    m_bottom[row] = float(bounds.bottom());
+    m_types[row] = quint8(shape->getType());
+    m_flags[row] = quint8((shape->isFilled() ? Filled : 0) | (shape->isSelected() ? Selected : 0));
+
+    // 记录没有变化时不写入，避免复制与快照共享的页
+    Record record;
+    record.rect = rect;
+    record.id = shape->getId();
+    record.styleIndex = styleIndex(shape);
+    record.type = m_types.at(row);
+    record.flags = m_flags.at(row) & Filled;
+
+    const Record &current = m_records.at(row);
+    if (current.rect == record.rect && current.id == record.id && current.styleIndex == record.styleIndex
+        && current.type == record.type && current.flags == record.flags) {
+        return false;
+    }
+    m_records[row] = record;
+    return true;
+}
+
+void ShapeStore::insertRow(int row)
+{
+    m_shapes.insert(row, nullptr);
+    m_handles.insert(row, InvalidHandle);
+    m_left.insert(row, 0.0f);
+    m_top.insert(row, 0.0f);
+    m_right.insert(row, 0.0f);
+    m_bottom.insert(row, 0.0f);
+    m_types.insert(row, 0);
+    m_flags.insert(row, 0);
+    m_records.insert(row, Record());
+}
+
+void ShapeStore::removeRow(int row)
+{
+    m_shapes.removeAt(row);
+    m_handles.removeAt(row);
+    m_left.removeAt(row);
+    m_top.removeAt(row);
+    m_right.removeAt(row);
+    m_bottom.removeAt(row);
+    m_types.removeAt(row);
+    m_flags.removeAt(row);
+    m_records.removeAt(row);
+}
+
+int ShapeStore::rowOf(const Shape *shape) const
+{
+    // 图形可能带着其他存储或已清空的存储分配的句柄，只有该行正是这个图形时才属于这个存储
+    if (!shape || shape->m_storeHandle >= Handle(m_rowOfHandle.size())) return -1;
+    const int row = rowOfHandle(shape->m_storeHandle);
+    return row >= 0 && m_shapes.at(row) == shape ? row : -1;
+}
+
+ShapeStore::Handle ShapeStore::allocateHandle(Shape *shape)
+{
+    // 优先重用已释放的句柄
+    Handle handle;
+    if (!m_freeHandles.isEmpty()) {
+        handle = m_freeHandles.takeLast();
+    } else {
+        handle = Handle(m_rowOfHandle.size());
+        m_rowOfHandle.append(-1);
+    }
+    shape->m_storeHandle = handle;
+    return handle;
+}
+
+void ShapeStore::invalidateRowsFrom(int row)
+{
+    m_firstStaleRow = qMin(m_firstStaleRow, row);
+}
+
+void ShapeStore::refreshRows()
+{
+    for (int i = m_firstStaleRow; i < m_handles.size(); ++i) {
+        m_rowOfHandle[m_handles.at(i)] = i;
+    }
+    m_firstStaleRow = m_handles.size();
+}
+
+int ShapeStore::rowOfHandle(Handle handle) const
+{
+    // 该行仍是这个句柄时映射一定正确，不必刷新
+    int row = m_rowOfHandle.at(handle);
+    if (row >= 0 && row < m_handles.size() && m_handles.at(row) == handle) {
+        return row;
+    }
+
+    // 映射过期时只读地查找过期的部分，不写入映射，多个线程可以同时查询
+    for (int i = m_firstStaleRow; i < m_handles.size(); ++i) {
+        if (m_handles.at(i) == handle) return i;
+    }
+    return -1;
+}
+
+quint32 ShapeStore::styleIndex(const Shape *shape)
+{
+    Style style;
+    style.color = shape->getColor().rgba();
+    style.fillColor = shape->getFillColor().rgba();
+    style.lineWidth = shape->getLineWidth();
+
+    auto it = m_styleLookup.constFind(style);
+    if (it != m_styleLookup.constEnd()) {
+        return it.value();
+    }
+
+    quint32 index = quint32(m_styles.size());
+    m_styles.append(style);
+    m_styleLookup.insert(style, index);
+    return index;
+}
+
+void ShapeStore::markChanged(Handle handle, quint8 change)
+{
+    ++m_revision;
+    if (!m_trackChanges) return;
+
+    if (handle >= Handle(m_changeOfHandle.size())) {
+        m_changeOfHandle.resize(m_rowOfHandle.size());
+    }
+    if (m_changeOfHandle.at(handle) == 0) {
+        m_changedHandles.append(handle);
+    }
+    m_changeOfHandle[handle] |= change;
+}
+
+void ShapeStore::markRemoved(int row)
+{
+    ++m_revision;
+    if (!m_trackChanges) return;
+
+    // 句柄之后可能被新图形重用，清除旧图形的标记
+    const Handle handle = m_handles.at(row);
+    if (handle < Handle(m_changeOfHandle.size())) {
+        m_changeOfHandle[handle] = 0;
+    }
+    m_removedIds.append(m_records.at(row).id);
+}
+
+size_t qHash(const ShapeStore::Style &style, size_t seed)
+{
+    return qHashMulti(seed, style.color, style.fillColor, style.lineWidth);
+}
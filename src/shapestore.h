@@ -0,0 +1,484 @@
+#ifndef SHAPESTORE_H
+#define SHAPESTORE_H
+
+#include <QHash>
+#include <QList>
+#include <QRectF>
+#include <QVector>
+#include <QColor>
+#include "shape.h"
+#include "pagedcolumn.h"
+
+/**
+ * @file shapestore.h
+ * @brief 图形存储类的头文件
+ *
+ * 这个文件定义了ShapeStore类，按图层顺序保存文档中的图形，
+ * 并把遍历时频繁访问的数据（边界、类型、标志、样式）放在连续的并行数组中。
+ */
+
+/**
+ * @class ShapeStore
+ * @brief 结构数组形式的图形存储
+ *
+ * 每个图形占据一行，行号就是图层顺序（0为最底层）。每行的数据分列存放：
+ * 边界矩形的四条边、图形类型和标志位各自是一个连续数组，
+ * 线性扫描时只会读取需要的列，不必跳转到分散在堆上的Shape对象。
+ *
+ * Shape对象仍然是对外接口使用的图形表示：撤销历史、选择和交互都持有Shape指针，
+ * 修改Shape对象的属性后需要调用sync()刷新对应行的数据。所以这些列是Shape对象之外的附加数据，
+ * 每个图形另外占用约82字节（图形指针8、句柄4、边界16、类型和标志2、记录48、句柄映射4），
+ * 存储不减少总内存。它减少的是频繁遍历时读取的数据：剔除和点击测试只读取边界和类型列，
+ * 瓦片由drawRows()按记录和共享的样式表绘制，每个图形读取约75字节的连续数据，
+ * 不再访问约100字节、分散在堆上的Shape对象和它的虚函数表。
+ *
+ * 每个图形还分配了一个稳定的句柄，图层顺序改变时句柄保持不变。句柄保存在Shape对象中
+ * （一个图形同时只属于一个存储），查询时用该行的图形校验，不需要图形到句柄的哈希表。句柄到行号的映射
+ * 延迟更新：插入、移动和移除只记下第一个可能过期的行，查询时先用该行的句柄校验，
+ * 不一致时在过期的部分中查找。查询不写入映射，可以在工作线程中并行调用；
+ * 过期的部分由refreshRows()在GUI线程中一次性刷新，连续的编辑不会每次都遍历其后的所有行。
+ *
+ * 保存所需的数据另外放在一个分页写时复制的列中（见PagedColumn），快照与存储共享这些页，
+ * 快照存在期间修改文档只复制被修改的那一页。
+ *
+ * 存储不拥有图形对象，图形的创建和释放由调用者负责。
+ */
+class ShapeStore
+{
+public:
+    typedef quint32 Handle;                       ///< 图形句柄类型
+    static const Handle InvalidHandle = 0xffffffffu; ///< 无效句柄
+
+    /**
+     * @enum Flag
+     * @brief 行标志位
+     */
+    enum Flag {
+        Filled = 0x1,   ///< 图形填充
+        Selected = 0x2  ///< 图形处于选中状态
+    };
+
+    /**
+     * @struct Style
+     * @brief 样式表中的一项
+     *
+     * 相同样式的图形共享样式表中的同一项。
+     */
+    struct Style {
+        QRgb color;      ///< 线条颜色
+        QRgb fillColor;  ///< 填充颜色
+        int lineWidth;   ///< 线宽
+
+        bool operator==(const Style &other) const
+        {
+            return color == other.color && fillColor == other.fillColor
+                    && lineWidth == other.lineWidth;
+        }
+    };
+
+    /**
+     * @struct Record
+     * @brief 保存一个图形所需的数据
+     */
+    struct Record {
+        QRectF rect;             ///< 边界矩形（未归一化，与Shape::getBoundingRect()相同）
+        int id = 0;              ///< 图形ID
+        quint32 styleIndex = 0;  ///< 样式表下标
+        quint8 type = 0;         ///< 图形类型
+        quint8 flags = 0;        ///< 标志位，不含选中状态
+    };
+
+    /**
+     * @struct Snapshot
+     * @brief 文档在某一时刻的只读副本
+     *
+     * 记录按页与图形存储隐式共享，创建快照只复制页指针。之后修改存储时，
+     * 被修改的页才复制一份，快照中的数据保持不变，可以交给其他线程读取（例如后台保存）。
+     */
+    struct Snapshot {
+        PagedColumn<Record> records;  ///< 按图层顺序排列的记录
+        QVector<Style> styles;        ///< 样式表
+
+        /**
+         * @brief 获取图形数量
+         */
+        int size() const { return records.size(); }
+    };
+
+    /**
+     * @struct Changes
+     * @brief 自上次取出以来文档发生的变化
+     *
+     * 行号对应取出变化时的文档，与同时创建的快照一致。
+     * 移除的图形只记录ID，新增和图层位置改变的图形、属性改变的图形记录所在的行。
+     */
+    struct Changes {
+        bool rewrite = false;       ///< 为true时变化无法逐项列出（例如存储被清空过），只能完整保存
+        QVector<int> removedIds;    ///< 被移除的图形ID
+        QVector<int> placedRows;    ///< 新增或图层位置改变的图形所在的行，从小到大排列
+        QVector<int> modifiedRows;  ///< 只有属性改变的图形所在的行，从小到大排列
+
+        /**
+         * @brief 判断是否没有任何变化
+         */
+        bool isEmpty() const
+        {
+            return !rewrite && removedIds.isEmpty() && placedRows.isEmpty() && modifiedRows.isEmpty();
+        }
+    };
+
+    /**
+     * @brief ShapeStore类的构造函数
+     */
+    ShapeStore();
+
+    /**
+     * @brief 获取图形数量
+     * @return 图形数量
+     */
+    int size() const;
+
+    /**
+     * @brief 判断存储是否为空
+     * @return 如果没有图形，返回true
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief 获取按图层顺序排列的图形列表
+     * @return 图形列表，从下到上排列
+     */
+    const QList<Shape *> &shapes() const;
+
+    /**
+     * @brief 获取指定行的图形
+     * @param row 行号
+     * @return 图形
+     */
+    Shape *at(int row) const;
+
+    /**
+     * @brief 获取图形所在的行号
+     * @param shape 图形
+     * @return 行号，如果图形不在存储中，返回-1
+     */
+    int indexOf(const Shape *shape) const;
+
+    /**
+     * @brief 判断图形是否在存储中
+     * @param shape 图形
+     * @return 如果图形在存储中，返回true
+     */
+    bool contains(const Shape *shape) const;
+
+    /**
+     * @brief 获取图形的句柄
+     * @param shape 图形
+     * @return 句柄，如果图形不在存储中，返回InvalidHandle
+     */
+    Handle handleOf(const Shape *shape) const;
+
+    /**
+     * @brief 通过句柄获取图形
+     * @param handle 句柄
+     * @return 图形，如果句柄无效，返回nullptr
+     */
+    Shape *shape(Handle handle) const;
+
+    /**
+     * @brief 在最上层添加图形
+     * @param shape 图形
+     */
+    void append(Shape *shape);
+
+    /**
+     * @brief 在指定行插入图形
+     * @param row 行号，超出范围时添加到最上层
+     * @param shape 图形
+     */
+    void insert(int row, Shape *shape);
+
+    /**
+     * @brief 移除指定行的图形
+     * @param row 行号
+     * @return 被移除的图形
+     */
+    Shape *takeAt(int row);
+
+    /**
+     * @brief 移除图形
+     * @param shape 图形
+     * @return 如果图形在存储中并被移除，返回true
+     */
+    bool remove(const Shape *shape);
+
+    /**
+     * @brief 一次插入多个图形
+     * @param rows 插入后各图形所在的行号，必须严格递增
+     * @param shapes 图形，与rows一一对应
+     *
+     * 所有列只移动一次，比逐个调用insert()快得多。
+     * 超出范围的行号会被限制为追加到末尾。
+     */
+    void insertShapes(const QVector<int> &rows, const QList<Shape *> &shapes);
+
+    /**
+     * @brief 一次移除多个图形
+     * @param shapes 图形，不在存储中的图形会被忽略
+     * @return 实际移除的图形数量
+     *
+     * 剩余图形保持原有顺序，所有列只压缩一次。
+     */
+    int removeShapes(const QList<Shape *> &shapes);
+
+    /**
+     * @brief 把图形从一行移动到另一行
+     * @param from 原行号
+     * @param to 目标行号
+     */
+    void move(int from, int to);
+
+    /**
+     * @brief 交换两行
+     * @param a 行号
+     * @param b 行号
+     */
+    void swap(int a, int b);
+
+    /**
+     * @brief 清空存储
+     *
+     * 不释放图形对象。
+     */
+    void clear();
+
+    /**
+     * @brief 预留空间
+     * @param count 预计的图形数量
+     */
+    void reserve(int count);
+
+    /**
+     * @brief 用图形对象的当前属性刷新对应行
+     * @param shape 图形，如果不在存储中则忽略
+     */
+    void sync(const Shape *shape);
+
+    /**
+     * @brief 按顺序绘制指定的行
+     * @param painter 绘图工具
+     * @param rows 行号，按绘制顺序排列
+     *
+     * 矩形和椭圆直接按记录和样式表绘制，结果与Shape::draw()相同，不访问图形对象；
+     * 选中的图形和其他类型的图形仍调用Shape::draw()。只读取存储，可以在多个线程中同时调用。
+     */
+    void drawRows(QPainter *painter, const QVector<int> &rows) const;
+
+    /**
+     * @brief 获取指定行的边界矩形
+     * @param row 行号
+     * @return 规范化的边界矩形，与Shape::getBoundingRect().normalized()相同
+     */
+    QRectF boundsAt(int row) const;
+
+    /**
+     * @brief 获取指定行包含描边的边界矩形
+     * @param row 行号
+     * @return 与Shape::getStrokeBounds()相同规则扩展后的矩形
+     */
+    QRectF strokeBoundsAt(int row) const;
+
+    /**
+     * @brief 获取指定行的图形类型
+     * @param row 行号
+     * @return 图形类型
+     */
+    Shape::ShapeType typeAt(int row) const;
+
+    /**
+     * @brief 获取指定行的标志位
+     * @param row 行号
+     * @return Flag的组合
+     */
+    quint8 flagsAt(int row) const;
+
+    /**
+     * @brief 获取指定行的样式
+     * @param row 行号
+     * @return 样式
+     */
+    const Style &styleAt(int row) const;
+
+    /**
+     * @brief 获取指定行的样式表下标
+     * @param row 行号
+     * @return styles()中的下标
+     */
+    quint32 styleIndexAt(int row) const;
+
+    /**
+     * @brief 获取样式表
+     * @return 去重后的样式，可能包含已经没有图形使用的样式
+     */
+    const QVector<Style> &styles() const;
+
+    /**
+     * @brief 刷新过期的句柄到行号的映射
+     *
+     * 查询函数都是只读的，映射过期时要在过期的行中逐个查找。
+     * 在多个线程并行查询之前（例如并行绘制瓦片）调用一次，之后的查询都只需一次校验。
+     * 会查询图形所在行的修改函数也会先调用它。
+     */
+    void refreshRows();
+
+    /**
+     * @brief 创建当前文档的快照
+     * @return 快照，只复制页指针，不复制记录
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * @brief 获取文档的修订号
+     * @return 每次图形被添加、移除、改变图层或属性时递增，只改变选中状态时不变
+     */
+    quint64 revision() const;
+
+    /**
+     * @brief 设置是否记录文档的变化
+     * @param enabled 为true时开始记录，为false时停止记录并丢弃已记录的变化
+     *
+     * 记录的开销与变化的图形数量成正比，不记录时没有额外开销。
+     */
+    void setChangeTracking(bool enabled);
+
+    /**
+     * @brief 判断是否正在记录文档的变化
+     * @return 如果正在记录，返回true
+     */
+    bool isChangeTracking() const;
+
+    /**
+     * @brief 取出自上次取出以来的变化，并重新开始记录
+     * @return 变化，开销与变化的图形数量成正比
+     */
+    Changes takeChanges();
+
+    /**
+     * @brief 获取各行左边界的连续数组
+     */
+    const float *lefts() const;
+
+    /**
+     * @brief 获取各行上边界的连续数组
+     */
+    const float *tops() const;
+
+    /**
+     * @brief 获取各行右边界的连续数组
+     */
+    const float *rights() const;
+
+    /**
+     * @brief 获取各行下边界的连续数组
+     */
+    const float *bottoms() const;
+
+    /**
+     * @brief 获取各行图形类型的连续数组
+     */
+    const quint8 *types() const;
+
+private:
+    /**
+     * @brief 把图形对象的属性写入指定行
+     * @return 保存用的记录是否改变
+     */
+    bool writeRow(int row, const Shape *shape);
+
+    /**
+     * @brief 在指定位置插入一个空行
+     */
+    void insertRow(int row);
+
+    /**
+     * @brief 删除指定行
+     */
+    void removeRow(int row);
+
+    /**
+     * @brief 记录从指定行开始句柄到行号的映射可能已经过期
+     */
+    void invalidateRowsFrom(int row);
+
+    /**
+     * @brief 获取图形所在的行号
+     * @return 行号，图形不在这个存储中时返回-1
+     */
+    int rowOf(const Shape *shape) const;
+
+    /**
+     * @brief 为新图形分配句柄
+     */
+    Handle allocateHandle(Shape *shape);
+
+    /**
+     * @brief 获取句柄所在的行号
+     * @return 行号，句柄空闲时返回-1
+     *
+     * 映射过期时在过期的行中查找，不修改映射。
+     */
+    int rowOfHandle(Handle handle) const;
+
+    /**
+     * @brief 查找或登记样式，返回样式表下标
+     */
+    quint32 styleIndex(const Shape *shape);
+
+    /**
+     * @brief 记录句柄对应的图形发生的变化，并递增修订号
+     */
+    void markChanged(Handle handle, quint8 change);
+
+    /**
+     * @brief 记录指定行的图形即将被移除，并递增修订号
+     */
+    void markRemoved(int row);
+
+    // 按行排列的并行数组
+    QList<Shape *> m_shapes;          ///< 图形对象
+    QVector<Handle> m_handles;        ///< 每行的句柄
+    QVector<float> m_left;            ///< 左边界
+    QVector<float> m_top;             ///< 上边界
+    QVector<float> m_right;           ///< 右边界
+    QVector<float> m_bottom;          ///< 下边界
+    QVector<quint8> m_types;          ///< 图形类型
+    QVector<quint8> m_flags;          ///< 标志位，包含选中状态
+    PagedColumn<Record> m_records;    ///< 保存用的记录，与快照按页共享，也提供绘制用的矩形和样式表下标
+
+    // 样式表
+    QVector<Style> m_styles;              ///< 去重后的样式
+    QHash<Style, quint32> m_styleLookup;  ///< 样式到下标的映射
+
+    // 句柄
+    QVector<int> m_rowOfHandle;                    ///< 句柄到行号的映射，-1表示空闲，可能过期
+    int m_firstStaleRow;                           ///< 从这一行开始m_rowOfHandle可能过期
+    QVector<Handle> m_freeHandles;                 ///< 可重用的句柄
+
+    // 变化记录
+    bool m_trackChanges;                 ///< 是否记录变化
+    bool m_changesLost;                  ///< 是否发生过无法逐项记录的变化
+    QVector<quint8> m_changeOfHandle;    ///< 每个句柄记录的变化，0表示没有变化
+    QVector<Handle> m_changedHandles;    ///< 记录过变化的句柄，可能重复
+    QVector<int> m_removedIds;           ///< 被移除的图形ID
+    quint64 m_revision;                  ///< 文档的修订号
+};
+
+/**
+ * @brief 计算样式的哈希值
+ * @param style 样式
+ * @param seed 哈希种子
+ * @return 哈希值
+ */
+size_t qHash(const ShapeStore::Style &style, size_t seed = 0);
+
+#endif // SHAPESTORE_H
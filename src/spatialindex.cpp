@@ -0,0 +1,220 @@
+#include "spatialindex.h"
+#include <QSet>
+#include <cmath>
+
+namespace {
+// 单个图形最多登记的网格单元数，超过则登记到更粗的一层
+const int kMaxCellsPerShape = 256;
+
+// 相邻两层单元边长之比的对数，每层单元的边长是下一层的16倍
+const int kLevelShift = 4;
+
+// 网格层数。单元编号限制在±1e9以内，最粗一层的范围不超过8×8个单元，
+// 任何图形都能登记到某一层中
+const int kLevelCount = 8;
+
+// 将坐标换算为单元编号，限制范围以避免异常坐标导致整数溢出
+int toCell(qreal coord, qreal cellSize)
+{
+    qreal cell = std::floor(coord / cellSize);
+    if (!(cell > -1e9)) return -1000000000; // 同时处理NaN
+    if (cell > 1e9) return 1000000000;
+    return static_cast<int>(cell);
+}
+}
+
+SpatialIndex::SpatialIndex(qreal cellSize)
+    : m_cellSize(cellSize > 0 ? cellSize : 128.0),
+      m_cells(kLevelCount)
+{
+}
+
+void SpatialIndex::insert(Shape *shape, const QRectF &bounds)
+{
+    if (!shape) return;
+
+    if (m_entries.contains(shape)) {
+        update(shape, bounds);
+        return;
+    }
+
+    CellRange range = entryRange(bounds);
+    m_entries.insert(shape, range);
+    link(shape, range);
+}
+
+void SpatialIndex::remove(Shape *shape)
+{
+    auto it = m_entries.find(shape);
+    if (it == m_entries.end()) return;
+
+    unlink(shape, it.value());
+    m_entries.erase(it);
+}
+
+void SpatialIndex::update(Shape *shape, const QRectF &bounds)
+{
+    auto it = m_entries.find(shape);
+    if (it == m_entries.end()) {
+        insert(shape, bounds);
+        return;
+    }
+
+    CellRange range = entryRange(bounds);
+    if (range == it.value()) {
+        return; // 覆盖的单元没有变化
+    }
+
+    unlink(shape, it.value());
+    it.value() = range;
+    link(shape, range);
+}
+
+void SpatialIndex::clear()
+{
+    for (auto &cells : m_cells) {
+        cells.clear();
+    }
+    m_entries.clear();
+}
+
+bool SpatialIndex::contains(Shape *shape) const
+{
+    return m_entries.contains(shape);
+}
+
+int SpatialIndex::size() const
+{
+    return m_entries.size();
+}
+
+QList<Shape *> SpatialIndex::query(const QPointF &point) const
+{
+    CellRange cell;
+    cell.left = cell.right = toCell(point.x(), m_cellSize);
+    cell.top = cell.bottom = toCell(point.y(), m_cellSize);
+
+    // 每个图形只登记在一层中，单个单元内的图形也不会重复，直接拼接即可
+    QList<Shape *> result;
+    for (int level = 0; level < kLevelCount; ++level) {
+        if (m_cells.at(level).isEmpty()) continue;
+        const CellRange r = coarsen(cell, level);
+        auto it = m_cells.at(level).constFind(cellKey(r.left, r.top));
+        if (it != m_cells.at(level).constEnd()) {
+            result.append(it.value());
+        }
+    }
+    return result;
+}
+
+QList<Shape *> SpatialIndex::query(const QRectF &rect) const
+{
+    const CellRange range = cellRange(rect);
+    QList<Shape *> result;
+
+    if (isLarge(range)) {
+        // 查询区域覆盖的单元太多，直接遍历所有图形更快
+        for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+            const CellRange &r = it.value();
+            const CellRange q = coarsen(range, r.level);
+            if (r.left <= q.right && r.right >= q.left && r.top <= q.bottom && r.bottom >= q.top) {
+                result.append(it.key());
+            }
+        }
+        return result;
+    }
+
+    // 每个图形只登记在一层中，只需在同一层内去重
+    QSet<Shape *> seen;
+    for (int level = 0; level < kLevelCount; ++level) {
+        const QHash<quint64, QList<Shape *>> &cells = m_cells.at(level);
+        if (cells.isEmpty()) continue;
+
+        const CellRange q = coarsen(range, level);
+        seen.clear();
+        for (int y = q.top; y <= q.bottom; ++y) {
+            for (int x = q.left; x <= q.right; ++x) {
+                auto cell = cells.constFind(cellKey(x, y));
+                if (cell == cells.constEnd()) continue;
+                for (Shape *shape : cell.value()) {
+                    if (!seen.contains(shape)) {
+                        seen.insert(shape);
+                        result.append(shape);
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+SpatialIndex::CellRange SpatialIndex::cellRange(const QRectF &rect) const
+{
+    QRectF r = rect.normalized();
+    CellRange range;
+    range.left = toCell(r.left(), m_cellSize);
+    range.top = toCell(r.top(), m_cellSize);
+    range.right = toCell(r.right(), m_cellSize);
+    range.bottom = toCell(r.bottom(), m_cellSize);
+    return range;
+}
+
+SpatialIndex::CellRange SpatialIndex::entryRange(const QRectF &rect) const
+{
+    const CellRange fine = cellRange(rect);
+    CellRange range = fine;
+    while (isLarge(range) && range.level + 1 < kLevelCount) {
+        range = coarsen(fine, range.level + 1);
+    }
+    return range;
+}
+
+SpatialIndex::CellRange SpatialIndex::coarsen(const CellRange &range, int level)
+{
+    // 算术右移即向下取整的除法，负的单元编号也能正确换算
+    const int shift = kLevelShift * level;
+    CellRange result;
+    result.left = int(qint64(range.left) >> shift);
+    result.top = int(qint64(range.top) >> shift);
+    result.right = int(qint64(range.right) >> shift);
+    result.bottom = int(qint64(range.bottom) >> shift);
+    result.level = level;
+    return result;
+}
+
+bool SpatialIndex::isLarge(const CellRange &range)
+{
+    qint64 columns = qint64(range.right) - range.left + 1;
+    qint64 rows = qint64(range.bottom) - range.top + 1;
+    return columns * rows > kMaxCellsPerShape;
+}
+
+quint64 SpatialIndex::cellKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
+
+void SpatialIndex::link(Shape *shape, const CellRange &range)
+{
+    QHash<quint64, QList<Shape *>> &cells = m_cells[range.level];
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+            cells[cellKey(x, y)].append(shape);
+        }
+    }
+}
+
+void SpatialIndex::unlink(Shape *shape, const CellRange &range)
+{
+    QHash<quint64, QList<Shape *>> &cells = m_cells[range.level];
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+            auto cell = cells.find(cellKey(x, y));
+            if (cell == cells.end()) continue;
+            cell.value().removeOne(shape);
+            if (cell.value().isEmpty()) {
+                cells.erase(cell);
+            }
+        }
+    }
+}
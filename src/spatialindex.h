@@ -0,0 +1,166 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+class Shape;
+
+/**
+ * @file spatialindex.h
+ * @brief 空间索引类的头文件
+ *
+ * 这个文件定义了SpatialIndex类，使用均匀网格加速图形的空间查询。
+ * 点击选择、区域查询等操作只需检查少量候选图形，而不必遍历全部图形。
+ */
+
+/**
+ * @class SpatialIndex
+ * @brief 均匀网格空间索引
+ *
+ * 将平面划分为固定大小的网格单元，每个图形按其边界矩形登记到覆盖的单元中。
+ * 网格分为多层，每层单元的边长是下一层的16倍，图形登记在覆盖单元数不超过上限的最细一层，
+ * 这样大图形也只登记到少量单元中，查询时依次检查各层对应的单元。
+ * 索引只负责返回候选图形，不保证候选图形真正包含查询点，也不关心图层顺序，
+ * 精确判断和排序由调用者完成。
+ */
+class SpatialIndex
+{
+public:
+    /**
+     * @brief SpatialIndex类的构造函数
+     * @param cellSize 网格单元的边长（像素）
+     */
+    explicit SpatialIndex(qreal cellSize = 128.0);
+
+    /**
+     * @brief 插入图形
+     * @param shape 图形
+     * @param bounds 图形的边界矩形
+     *
+     * 如果图形已在索引中，等同于update。
+     */
+    void insert(Shape *shape, const QRectF &bounds);
+
+    /**
+     * @brief 从索引中移除图形
+     * @param shape 图形
+     */
+    void remove(Shape *shape);
+
+    /**
+     * @brief 更新图形的边界矩形
+     * @param shape 图形
+     * @param bounds 新的边界矩形
+     *
+     * 覆盖的网格单元没有变化时不做任何修改。
+     */
+    void update(Shape *shape, const QRectF &bounds);
+
+    /**
+     * @brief 清空索引
+     */
+    void clear();
+
+    /**
+     * @brief 判断图形是否在索引中
+     * @param shape 图形
+     * @return 如果图形在索引中，返回true，否则返回false
+     */
+    bool contains(Shape *shape) const;
+
+    /**
+     * @brief 获取索引中的图形数量
+     * @return 图形数量
+     */
+    int size() const;
+
+    /**
+     * @brief 查询可能包含指定点的图形
+     * @param point 查询点
+     * @return 候选图形列表（无重复，无序）
+     */
+    QList<Shape *> query(const QPointF &point) const;
+
+    /**
+     * @brief 查询可能与指定矩形相交的图形
+     * @param rect 查询矩形
+     * @return 候选图形列表（无重复，无序）
+     */
+    QList<Shape *> query(const QRectF &rect) const;
+
+private:
+    /**
+     * @struct CellRange
+     * @brief 图形覆盖的网格单元范围（闭区间）
+     */
+    struct CellRange {
+        int left;       ///< 最左侧单元列号
+        int top;        ///< 最上方单元行号
+        int right;      ///< 最右侧单元列号
+        int bottom;     ///< 最下方单元行号
+        int level = 0;  ///< 所在的网格层，0为最细的一层
+
+        bool operator==(const CellRange &other) const
+        {
+            return left == other.left && top == other.top
+                    && right == other.right && bottom == other.bottom && level == other.level;
+        }
+    };
+
+    /**
+     * @brief 计算矩形在最细一层覆盖的网格单元范围
+     * @param rect 矩形
+     * @return 单元范围
+     */
+    CellRange cellRange(const QRectF &rect) const;
+
+    /**
+     * @brief 计算图形登记的网格层和单元范围
+     * @param rect 图形的边界矩形
+     * @return 覆盖单元数不超过上限的最细一层中的单元范围
+     */
+    CellRange entryRange(const QRectF &rect) const;
+
+    /**
+     * @brief 把最细一层的单元范围换算到指定层
+     * @param range 最细一层的单元范围
+     * @param level 目标层
+     * @return 目标层中的单元范围
+     */
+    static CellRange coarsen(const CellRange &range, int level);
+
+    /**
+     * @brief 判断单元范围是否过大，需要登记到更粗的一层
+     * @param range 单元范围
+     * @return 如果过大，返回true
+     */
+    static bool isLarge(const CellRange &range);
+
+    /**
+     * @brief 计算网格单元的键值
+     * @param x 单元列号
+     * @param y 单元行号
+     * @return 键值
+     */
+    static quint64 cellKey(int x, int y);
+
+    /**
+     * @brief 将图形登记到单元范围
+     */
+    void link(Shape *shape, const CellRange &range);
+
+    /**
+     * @brief 将图形从单元范围中注销
+     */
+    void unlink(Shape *shape, const CellRange &range);
+
+    qreal m_cellSize;                          ///< 最细一层的网格单元边长
+    QVector<QHash<quint64, QList<Shape *>>> m_cells;  ///< 各层网格单元到图形列表的映射
+    QHash<Shape *, CellRange> m_entries;       ///< 图形到所在层和覆盖单元范围的映射
+};
+
+#endif // SPATIALINDEX_H
@@ -0,0 +1,397 @@
+#include "textformat.h"
+#include "shapefactory.h"
+#include "ioprogress.h"
+#include "tracerecorder.h"
+#include <QFile>
+#include <QPair>
+#include <QThread>
+#include <QtConcurrent>
+#include <charconv>
+#include <cstring>
+
+namespace {
+// 小于该大小的数据不值得分段，每段至少这么大
+const qint64 kMinChunkSize = 1 << 20;
+
+// 每个线程分到的段数，段多一些可以平衡各行长度不同造成的负载差异
+const int kChunksPerThread = 4;
+
+// 一行中的字段数
+const int kFieldCount = 10;
+
+// 保存时每段包含的图形数
+const int kShapesPerChunk = 16384;
+
+// 一行的最大长度：类型、ID、4个浮点数、2个颜色、线宽、填充标志、分隔符和换行符
+const int kMaxLineLength = 160;
+
+// 解析时每隔这么多行报告一次进度并检查是否取消
+const int kLinesPerProgressStep = 4096;
+
+struct Field {
+    const char *begin;
+    const char *end;
+
+    bool operator==(const char *text) const
+    {
+        const size_t length = std::strlen(text);
+        return size_t(end - begin) == length && std::memcmp(begin, text, length) == 0;
+    }
+};
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+Field trimmed(Field field)
+{
+    while (field.begin < field.end && isSpace(*field.begin)) ++field.begin;
+    while (field.end > field.begin && isSpace(field.end[-1])) --field.end;
+    return field;
+}
+
+// 与QString::toInt()和toDouble()一致：整个字段都必须是数字，否则结果为0
+template <typename T>
+T toNumber(Field field)
+{
+    field = trimmed(field);
+    if (field.begin < field.end && *field.begin == '+') ++field.begin;
+
+    T value = 0;
+    const std::from_chars_result result = std::from_chars(field.begin, field.end, value);
+    if (result.ec != std::errc() || result.ptr != field.end) {
+        return 0;
+    }
+    return value;
+}
+
+int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+QColor toColor(Field field)
+{
+    // Shape::save()写出的都是"#rrggbb"
+    if (field.end - field.begin == 7 && *field.begin == '#') {
+        QRgb rgb = 0;
+        const char *p = field.begin + 1;
+        for (; p < field.end; ++p) {
+            const int digit = hexDigit(*p);
+            if (digit < 0) break;
+            rgb = (rgb << 4) | QRgb(digit);
+        }
+        if (p == field.end) {
+            return QColor::fromRgb(rgb);
+        }
+    }
+
+    // 颜色名称等其他写法
+    return QColor(QString::fromLatin1(field.begin, int(field.end - field.begin)));
+}
+
+char *appendText(char *out, const char *text)
+{
+    const size_t length = std::strlen(text);
+    std::memcpy(out, text, length);
+    return out + length;
+}
+
+char *appendInt(char *out, int value)
+{
+    return std::to_chars(out, out + 16, value).ptr;
+}
+
+// QString::arg(double)默认使用'g'格式和6位有效数字，与printf的"%.6g"相同
+char *appendReal(char *out, double value)
+{
+    return std::to_chars(out, out + 32, value, std::chars_format::general, 6).ptr;
+}
+
+// 与QColor::name(QColor::HexRgb)相同，小写的"#rrggbb"
+char *appendColor(char *out, QRgb rgb)
+{
+    static const char digits[] = "0123456789abcdef";
+    *out++ = '#';
+    for (int shift = 20; shift >= 0; shift -= 4) {
+        *out++ = digits[(rgb >> shift) & 0xf];
+    }
+    return out;
+}
+
+// 格式化一行，与Shape::save()加上换行符相同；没有文本格式的类型返回nullptr
+char *appendLine(char *out, Shape::ShapeType type, int id, const QRectF &rect,
+                 QRgb color, int lineWidth, bool filled, QRgb fillColor)
+{
+    switch (type) {
+    case Shape::Ellipse:
+        out = appendText(out, "ellipse,");
+        break;
+    case Shape::Rectangle:
+        out = appendText(out, "rectangle,");
+        break;
+    default:
+        return nullptr;
+    }
+
+    out = appendInt(out, id);
+    *out++ = ',';
+    out = appendReal(out, rect.x());
+    *out++ = ',';
+    out = appendReal(out, rect.y());
+    *out++ = ',';
+    out = appendReal(out, rect.width());
+    *out++ = ',';
+    out = appendReal(out, rect.height());
+    *out++ = ',';
+    out = appendColor(out, color);
+    *out++ = ',';
+    out = appendInt(out, lineWidth);
+    *out++ = ',';
+    out = appendText(out, filled ? "true," : "false,");
+    out = appendColor(out, fillColor);
+    *out++ = '\n';
+    return out;
+}
+
+bool canceled(const IoProgress *progress)
+{
+    return progress && progress->isCanceled();
+}
+}
+
+bool TextFormat::read(const QString &filename, QList<Shape *> *shapes, QString *errorString,
+                      IoProgress *progress)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString) *errorString = file.errorString();
+        return false;
+    }
+
+    // 映射失败时（例如某些网络文件系统）退回到一次性读入
+    const qint64 size = file.size();
+    if (progress) progress->setTotal(size);
+    QList<Shape *> loaded;
+    if (uchar *data = file.map(0, size)) {
+        loaded = parse(reinterpret_cast<const char *>(data), size, progress);
+        file.unmap(data);
+    } else {
+        const QByteArray bytes = file.readAll();
+        loaded = parse(bytes.constData(), bytes.size(), progress);
+    }
+
+    if (canceled(progress)) {
+        qDeleteAll(loaded);
+        if (errorString) *errorString = "操作已取消";
+        return false;
+    }
+    shapes->append(loaded);
+    return true;
+}
+
+QList<Shape *> TextFormat::parse(const char *data, qint64 size, IoProgress *progress)
+{
+    // 跳过UTF-8的BOM
+    if (size >= 3 && std::memcmp(data, "\xef\xbb\xbf", 3) == 0) {
+        data += 3;
+        size -= 3;
+    }
+
+    const char *end = data + size;
+    const int chunkCount = int(qBound<qint64>(1, size / kMinChunkSize,
+                                              QThread::idealThreadCount() * kChunksPerThread));
+    if (chunkCount <= 1) {
+        return parseRange(data, end, progress);
+    }
+
+    // 分段的边界移到下一个换行符之后，每一行完整地落在某一段中
+    QList<QPair<const char *, const char *>> ranges;
+    const char *begin = data;
+    for (int i = 1; i < chunkCount && begin < end; ++i) {
+        const char *target = qMax(begin, data + size * i / chunkCount);
+        const char *newline = static_cast<const char *>(std::memchr(target, '\n', size_t(end - target)));
+        const char *cut = newline ? newline + 1 : end;
+        ranges.append(qMakePair(begin, cut));
+        begin = cut;
+    }
+    if (begin < end) {
+        ranges.append(qMakePair(begin, end));
+    }
+
+    const QList<QList<Shape *>> parts = QtConcurrent::blockingMapped<QList<QList<Shape *>>>(
+                ranges, [progress](const QPair<const char *, const char *> &range) {
+                    TraceScope trace("TextFormat::parseRange", "worker");
+                    return parseRange(range.first, range.second, progress);
+                });
+
+    QList<Shape *> shapes;
+    qsizetype total = 0;
+    for (const QList<Shape *> &part : parts) {
+        total += part.size();
+    }
+    shapes.reserve(total);
+    for (const QList<Shape *> &part : parts) {
+        shapes.append(part);
+    }
+    return shapes;
+}
+
+QList<Shape *> TextFormat::parseRange(const char *begin, const char *end, IoProgress *progress)
+{
+    // 每段一次预留和登记ID，各线程不必为每个图形修改同一个原子变量
+    Shape::IdBatch ids;
+    QList<Shape *> shapes;
+    const char *reported = begin;
+    int lines = 0;
+    while (begin < end) {
+        const char *newline = static_cast<const char *>(std::memchr(begin, '\n', size_t(end - begin)));
+        const char *lineEnd = newline ? newline : end;
+        if (Shape *shape = parseLine(begin, lineEnd)) {
+            shapes.append(shape);
+        }
+        begin = lineEnd + 1;
+
+        if (progress && ++lines == kLinesPerProgressStep) {
+            lines = 0;
+            progress->add(begin - reported);
+            reported = begin;
+            if (progress->isCanceled()) break;
+        }
+    }
+    if (progress) progress->add(qMin(begin, end) - reported);
+    return shapes;
+}
+
+bool TextFormat::write(QIODevice *device, const ShapeStore::Snapshot &snapshot, QString *errorString,
+                       IoProgress *progress)
+{
+    QList<QPair<int, int>> ranges;
+    for (int first = 0; first < snapshot.size(); first += kShapesPerChunk) {
+        ranges.append(qMakePair(first, qMin(first + kShapesPerChunk, snapshot.size())));
+    }
+
+    // 格式化和写入各占一半进度
+    if (progress) progress->setTotal(qint64(snapshot.size()) * 2);
+
+    // 每段格式化到独立的缓冲区，然后按顺序整块写入。同时最多格式化与线程数相同的段，
+    // 写入最早的一段时后面的段继续格式化，写完的缓冲区立即释放，不必等所有段格式化完
+    const int window = qMax(1, QThread::idealThreadCount());
+    QList<QFuture<QByteArray>> pending;
+    int next = 0;
+    bool ok = true;
+    for (int i = 0; i < ranges.size() && ok; ++i) {
+        for (; next < ranges.size() && next - i < window; ++next) {
+            const QPair<int, int> range = ranges.at(next);
+            pending.append(QtConcurrent::run([&snapshot, progress, range]() {
+                if (canceled(progress)) return QByteArray();
+                TraceScope trace("TextFormat::formatRange", "worker");
+                const QByteArray buffer = formatRange(snapshot, range.first, range.second);
+                if (progress) progress->add(range.second - range.first);
+                return buffer;
+            }));
+        }
+
+        const QByteArray buffer = pending.takeFirst().result();
+        if (canceled(progress)) {
+            if (errorString) *errorString = "操作已取消";
+            ok = false;
+        } else if (device->write(buffer) != buffer.size()) {
+            if (errorString) *errorString = device->errorString();
+            ok = false;
+        } else if (progress) {
+            progress->add(ranges.at(i).second - ranges.at(i).first);
+        }
+    }
+
+    // 出错时还在格式化的段仍引用快照和进度，等它们结束后才能返回
+    for (QFuture<QByteArray> &future : pending) {
+        future.waitForFinished();
+    }
+    return ok;
+}
+
+void TextFormat::appendShape(QByteArray *buffer, const Shape *shape)
+{
+    const qsizetype start = buffer->size();
+    buffer->resize(start + kMaxLineLength);
+    char *out = appendLine(buffer->data() + start, shape->getType(), shape->getId(),
+                           shape->getBoundingRect(), shape->getColor().rgba(),
+                           shape->getLineWidth(), shape->isFilled(), shape->getFillColor().rgba());
+    if (out) {
+        buffer->resize(out - buffer->constData());
+        return;
+    }
+
+    // 没有快速路径的图形类型使用它自己的格式
+    buffer->resize(start);
+    buffer->append(shape->save().toUtf8());
+    buffer->append('\n');
+}
+
+QByteArray TextFormat::formatRange(const ShapeStore::Snapshot &snapshot, int first, int last)
+{
+    QByteArray buffer;
+    buffer.resize((last - first) * kMaxLineLength);
+    char *out = buffer.data();
+    for (int row = first; row < last; ++row) {
+        const ShapeStore::Record &record = snapshot.records.at(row);
+        const ShapeStore::Style &style = snapshot.styles.at(record.styleIndex);
+        char *next = appendLine(out, Shape::ShapeType(record.type), record.id, record.rect, style.color,
+                                style.lineWidth, record.flags & ShapeStore::Filled, style.fillColor);
+        // 快照中没有图形对象，没有文本格式的类型无法保存
+        if (next) out = next;
+    }
+    buffer.resize(out - buffer.constData());
+    return buffer;
+}
+
+Shape *TextFormat::parseLine(const char *begin, const char *end)
+{
+    const Field line = trimmed(Field{begin, end});
+    if (line.begin == line.end) {
+        return nullptr;
+    }
+
+    // 格式: type,id,x,y,width,height,color,lineWidth,filled,fillColor
+    Field fields[kFieldCount];
+    int count = 0;
+    const char *p = line.begin;
+    while (true) {
+        const char *comma = static_cast<const char *>(std::memchr(p, ',', size_t(line.end - p)));
+        const char *fieldEnd = comma ? comma : line.end;
+        if (count < kFieldCount) {
+            fields[count] = Field{p, fieldEnd};
+        }
+        ++count;
+        if (!comma) break;
+        p = comma + 1;
+    }
+
+    Shape *shape = nullptr;
+    if (fields[0] == "ellipse") {
+        shape = ShapeFactory::createShape(Shape::Ellipse);
+    } else if (fields[0] == "rectangle") {
+        shape = ShapeFactory::createShape(Shape::Rectangle);
+    } else {
+        return nullptr;
+    }
+
+    // 字段数不对时与Shape::load()一样保留默认属性
+    if (count != kFieldCount) {
+        return shape;
+    }
+
+    shape->setId(toNumber<int>(fields[1]));
+    shape->setBoundingRect(QRectF(toNumber<double>(fields[2]), toNumber<double>(fields[3]),
+                                  toNumber<double>(fields[4]), toNumber<double>(fields[5])));
+    shape->setColor(toColor(fields[6]));
+    shape->setLineWidth(toNumber<int>(fields[7]));
+    shape->setFilled(fields[8] == "true");
+    shape->setFillColor(toColor(fields[9]));
+    return shape;
+}
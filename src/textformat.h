@@ -0,0 +1,100 @@
+#ifndef TEXTFORMAT_H
+#define TEXTFORMAT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include "shapestore.h"
+
+class QIODevice;
+class IoProgress;
+class Shape;
+
+/**
+ * @file textformat.h
+ * @brief 文本文档格式的头文件
+ *
+ * 这个文件定义了TextFormat类，直接在原始字节上解析和生成文本格式的文档。
+ * 每行一个图形，格式见Rectangle::save()和Ellipse::save()。
+ */
+
+/**
+ * @class TextFormat
+ * @brief 文本文档的读写
+ *
+ * 解析不经过QString：文件映射到内存后按换行符切分成若干段，各段在线程池中并行解析，
+ * 数字用std::from_chars转换，"#rrggbb"形式的颜色直接解码，其他颜色名称才交给QColor。
+ * 各段的结果按文件中的顺序合并，图层顺序与逐行读取时相同。
+ *
+ * 读写都可以在后台线程中进行，通过IoProgress报告进度和响应取消。
+ *
+ * 保存时快照中的图形同样分段并行格式化到各自的字节缓冲区，数字用std::to_chars生成，
+ * 格式化与按顺序写入同时进行，任何时候只保留与线程数相当的几段缓冲区。
+ * 浮点数按"%.6g"格式化，与QString::arg(double)的默认格式相同，输出与Shape::save()逐字节一致。
+ */
+class TextFormat
+{
+public:
+    /**
+     * @brief 从文件读取所有图形
+     * @param filename 文件名
+     * @param shapes 读取的图形按图层顺序追加到这里，由调用者负责释放
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @param progress 进度（按字节计），可以为nullptr
+     * @return 文件能够打开且未被取消时返回true，无法识别的行被忽略
+     */
+    static bool read(const QString &filename, QList<Shape *> *shapes, QString *errorString = nullptr,
+                     IoProgress *progress = nullptr);
+
+    /**
+     * @brief 解析内存中的文档数据
+     * @param data 文档数据
+     * @param size 数据长度
+     * @param progress 进度（按字节计），可以为nullptr；取消后返回已解析的部分
+     * @return 按图层顺序排列的图形，由调用者负责释放
+     *
+     * 数据较大时分段并行解析。
+     */
+    static QList<Shape *> parse(const char *data, qint64 size, IoProgress *progress = nullptr);
+
+    /**
+     * @brief 解析一行
+     * @param begin 行的开头
+     * @param end 行的结尾（不含换行符）
+     * @return 图形，无法识别的行返回nullptr
+     */
+    static Shape *parseLine(const char *begin, const char *end);
+
+    /**
+     * @brief 把快照中的图形写入设备，每行一个图形
+     * @param device 已打开的输出设备
+     * @param snapshot 文档快照
+     * @param errorString 失败时的错误信息，可以为nullptr
+     * @param progress 进度（按图形计），可以为nullptr
+     * @return 写入成功且未被取消时返回true
+     */
+    static bool write(QIODevice *device, const ShapeStore::Snapshot &snapshot,
+                      QString *errorString = nullptr, IoProgress *progress = nullptr);
+
+    /**
+     * @brief 把一个图形格式化为一行并追加到缓冲区
+     * @param buffer 缓冲区
+     * @param shape 图形
+     *
+     * 追加的内容与shape->save()加上换行符相同。
+     */
+    static void appendShape(QByteArray *buffer, const Shape *shape);
+
+private:
+    /**
+     * @brief 在当前线程中依次解析[begin, end)中的所有行
+     */
+    static QList<Shape *> parseRange(const char *begin, const char *end, IoProgress *progress);
+
+    /**
+     * @brief 在当前线程中格式化快照中[first, last)范围内的图形
+     */
+    static QByteArray formatRange(const ShapeStore::Snapshot &snapshot, int first, int last);
+};
+
+#endif // TEXTFORMAT_H
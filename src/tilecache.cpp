@@ -0,0 +1,122 @@
+#include "tilecache.h"
+#include <cmath>
+
+namespace {
+// 像素坐标换算为瓦片坐标，负坐标向下取整；限制范围以避免异常坐标导致整数溢出
+int toTile(qreal coord)
+{
+    qreal tile = std::floor(coord / TileCache::TileSize);
+    if (!(tile > -1e8)) return -100000000; // 同时处理NaN
+    if (tile > 1e8) return 100000000;
+    return static_cast<int>(tile);
+}
+}
+
+TileCache::TileCache()
+    : m_devicePixelRatio(1.0)
+{
+}
+
+QList<QPoint> TileCache::tilesIn(const QRect &rect)
+{
+    QList<QPoint> tiles;
+    if (rect.isEmpty()) return tiles;
+
+    const int left = toTile(rect.left());
+    const int top = toTile(rect.top());
+    const int right = toTile(rect.right());
+    const int bottom = toTile(rect.bottom());
+    tiles.reserve((right - left + 1) * (bottom - top + 1));
+    for (int y = top; y <= bottom; ++y) {
+        for (int x = left; x <= right; ++x) {
+            tiles.append(QPoint(x, y));
+        }
+    }
+    return tiles;
+}
+
+QRect TileCache::tileRect(const QPoint &tile)
+{
+    return QRect(tile.x() * TileSize, tile.y() * TileSize, TileSize, TileSize);
+}
+
+bool TileCache::contains(const QPoint &tile) const
+{
+    return m_tiles.contains(tileKey(tile));
+}
+
+QImage TileCache::tile(const QPoint &tile) const
+{
+    return m_tiles.value(tileKey(tile));
+}
+
+void TileCache::insert(const QPoint &tile, const QImage &image)
+{
+    m_tiles.insert(tileKey(tile), image);
+}
+
+void TileCache::invalidate(const QRectF &rect)
+{
+    if (rect.isNull() || m_tiles.isEmpty()) return;
+
+    QRectF r = rect.normalized();
+    const int left = toTile(r.left());
+    const int top = toTile(r.top());
+    const int right = toTile(r.right());
+    const int bottom = toTile(r.bottom());
+
+    // 失效区域比缓存的瓦片还多时，直接遍历缓存
+    if (qint64(right - left + 1) * (bottom - top + 1) > m_tiles.size()) {
+        for (auto it = m_tiles.begin(); it != m_tiles.end();) {
+            const int x = qint32(quint32(it.key() >> 32));
+            const int y = qint32(quint32(it.key()));
+            if (x >= left && x <= right && y >= top && y <= bottom) {
+                it = m_tiles.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return;
+    }
+
+    for (int y = top; y <= bottom; ++y) {
+        for (int x = left; x <= right; ++x) {
+            m_tiles.remove(tileKey(QPoint(x, y)));
+        }
+    }
+}
+
+void TileCache::invalidateAll()
+{
+    m_tiles.clear();
+}
+
+void TileCache::trim(const QRect &rect)
+{
+    for (auto it = m_tiles.begin(); it != m_tiles.end();) {
+        const QPoint tile(qint32(quint32(it.key() >> 32)), qint32(quint32(it.key())));
+        if (!tileRect(tile).intersects(rect)) {
+            it = m_tiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void TileCache::setDevicePixelRatio(qreal ratio)
+{
+    if (!qFuzzyCompare(ratio, m_devicePixelRatio)) {
+        m_devicePixelRatio = ratio;
+        invalidateAll();
+    }
+}
+
+qreal TileCache::devicePixelRatio() const
+{
+    return m_devicePixelRatio;
+}
+
+quint64 TileCache::tileKey(const QPoint &tile)
+{
+    return (quint64(quint32(tile.x())) << 32) | quint32(tile.y());
+}
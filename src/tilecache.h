@@ -0,0 +1,114 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QPoint>
+#include <QRect>
+#include <QRectF>
+
+/**
+ * @file tilecache.h
+ * @brief 瓦片缓存类的头文件
+ *
+ * 这个文件定义了TileCache类，将静态场景按固定大小的瓦片缓存为图像。
+ * 绘图区域重绘时直接复制缓存的瓦片，只有内容发生变化的瓦片才需要重新绘制。
+ */
+
+/**
+ * @class TileCache
+ * @brief 静态场景的瓦片缓存
+ *
+ * 平面按TileSize划分为瓦片，瓦片坐标(x, y)对应的区域为
+ * QRect(x * TileSize, y * TileSize, TileSize, TileSize)。
+ * 缓存只负责存储和失效管理，瓦片的绘制由调用者完成。
+ * 缓存中存在的瓦片都是有效的，失效的瓦片会被直接移除。
+ */
+class TileCache
+{
+public:
+    static const int TileSize = 256; ///< 瓦片边长（逻辑像素）
+
+    /**
+     * @brief TileCache类的构造函数
+     */
+    TileCache();
+
+    /**
+     * @brief 获取与矩形区域相交的瓦片坐标
+     * @param rect 矩形区域
+     * @return 瓦片坐标列表，按行优先排列
+     */
+    static QList<QPoint> tilesIn(const QRect &rect);
+
+    /**
+     * @brief 获取瓦片覆盖的区域
+     * @param tile 瓦片坐标
+     * @return 瓦片的矩形区域
+     */
+    static QRect tileRect(const QPoint &tile);
+
+    /**
+     * @brief 判断瓦片是否已缓存
+     * @param tile 瓦片坐标
+     * @return 如果瓦片有效，返回true
+     */
+    bool contains(const QPoint &tile) const;
+
+    /**
+     * @brief 获取缓存的瓦片图像
+     * @param tile 瓦片坐标
+     * @return 瓦片图像，如果未缓存，返回空图像
+     */
+    QImage tile(const QPoint &tile) const;
+
+    /**
+     * @brief 存入绘制好的瓦片
+     * @param tile 瓦片坐标
+     * @param image 瓦片图像
+     */
+    void insert(const QPoint &tile, const QImage &image);
+
+    /**
+     * @brief 使与矩形区域相交的瓦片失效
+     * @param rect 内容发生变化的区域
+     */
+    void invalidate(const QRectF &rect);
+
+    /**
+     * @brief 使所有瓦片失效
+     */
+    void invalidateAll();
+
+    /**
+     * @brief 移除与指定区域不相交的瓦片
+     * @param rect 需要保留的区域，通常是窗口区域
+     */
+    void trim(const QRect &rect);
+
+    /**
+     * @brief 设置瓦片图像的设备像素比
+     * @param ratio 设备像素比
+     *
+     * 像素比变化时所有瓦片都会失效。
+     */
+    void setDevicePixelRatio(qreal ratio);
+
+    /**
+     * @brief 获取瓦片图像的设备像素比
+     * @return 设备像素比
+     */
+    qreal devicePixelRatio() const;
+
+private:
+    /**
+     * @brief 计算瓦片坐标的键值
+     */
+    static quint64 tileKey(const QPoint &tile);
+
+    QHash<quint64, QImage> m_tiles;  ///< 有效瓦片
+    qreal m_devicePixelRatio;        ///< 瓦片图像的设备像素比
+};
+
+#endif // TILECACHE_H
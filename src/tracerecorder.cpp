@@ -0,0 +1,120 @@
+#include "tracerecorder.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <cstdio>
+
+namespace {
+/**
+ * @brief 正在记录的跟踪文件
+ */
+struct TraceState {
+    QMutex mutex;
+    QFile file;
+    QElapsedTimer clock;      ///< 时间戳相对于开始记录的时刻
+    qint64 pid = 0;
+    int session = 0;          ///< 每次开始记录加1，线程名在每个文件中各写一次
+    int nextThreadId = 0;
+    bool firstEvent = true;
+};
+
+TraceState &traceState()
+{
+    static TraceState state;
+    return state;
+}
+
+/**
+ * @brief 当前线程在跟踪文件中的编号
+ */
+struct ThreadInfo {
+    int id = 0;
+    int session = 0;          ///< 已写入线程名的记录次数
+};
+thread_local ThreadInfo t_thread;
+
+// 写入一行，调用前已加锁
+void writeLine(TraceState &state, const QByteArray &line)
+{
+    if (!state.firstEvent) state.file.write(",\n");
+    state.file.write(line);
+    state.firstEvent = false;
+}
+}
+
+QAtomicInt TraceRecorder::s_enabled(0);
+
+bool TraceRecorder::start(const QString &filename, QString *errorString)
+{
+    stop();
+
+    TraceState &state = traceState();
+    QMutexLocker locker(&state.mutex);
+    state.file.setFileName(filename);
+    if (!state.file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (errorString) *errorString = state.file.errorString();
+        return false;
+    }
+    state.file.write("[\n");
+    state.firstEvent = true;
+    state.pid = QCoreApplication::applicationPid();
+    ++state.session;
+    state.clock.start();
+    s_enabled.storeRelaxed(1);
+    return true;
+}
+
+void TraceRecorder::stop()
+{
+    TraceState &state = traceState();
+    QMutexLocker locker(&state.mutex);
+    s_enabled.storeRelaxed(0);
+    if (state.file.isOpen()) {
+        state.file.write("\n]\n");
+        state.file.close();
+    }
+}
+
+void TraceRecorder::begin(const char *name, const char *category)
+{
+    write('B', name, category);
+}
+
+void TraceRecorder::end(const char *name, const char *category)
+{
+    write('E', name, category);
+}
+
+void TraceRecorder::write(char phase, const char *name, const char *category)
+{
+    TraceState &state = traceState();
+    QMutexLocker locker(&state.mutex);
+    // 加锁前可能已经结束记录
+    if (!state.file.isOpen()) return;
+
+    if (t_thread.session != state.session) {
+        t_thread.session = state.session;
+        if (t_thread.id == 0) t_thread.id = ++state.nextThreadId;
+
+        const QThread *thread = QThread::currentThread();
+        QString threadName = thread->objectName();
+        if (threadName.isEmpty()) {
+            const bool mainThread = QCoreApplication::instance()
+                                    && thread == QCoreApplication::instance()->thread();
+            threadName = mainThread ? QString("主线程") : QString("工作线程 %1").arg(t_thread.id);
+        }
+        writeLine(state, QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%1,\"tid\":%2,"
+                                 "\"args\":{\"name\":\"%3\"}}")
+                  .arg(state.pid).arg(t_thread.id).arg(threadName).toUtf8());
+    }
+
+    char line[256];
+    const int length = std::snprintf(line, sizeof(line),
+                                     "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+                                     "\"pid\":%lld,\"tid\":%d}",
+                                     name, category, phase, state.clock.nsecsElapsed() / 1000.0,
+                                     static_cast<long long>(state.pid), t_thread.id);
+    writeLine(state, QByteArray(line, qMin(length, int(sizeof(line)) - 1)));
+}
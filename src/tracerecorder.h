@@ -0,0 +1,103 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QAtomicInt>
+#include <QString>
+
+/**
+ * @file tracerecorder.h
+ * @brief 跟踪记录器的头文件
+ *
+ * 这个文件定义了TraceRecorder类和TraceScope类，把编辑器的活动写入
+ * Chrome Trace Event格式的JSON文件，可以离线用Perfetto或about:tracing打开。
+ */
+
+/**
+ * @class TraceRecorder
+ * @brief 把开始/结束事件写入跟踪文件
+ *
+ * 文件使用JSON数组格式，每个事件一行。程序异常退出时文件缺少结尾的“]”，
+ * Perfetto和about:tracing仍然可以打开。
+ *
+ * 未启动时isEnabled()只是一次原子读取，TraceScope不做其他工作。
+ * 启动后可以在任意线程中记录事件，写入时加锁；每个线程第一次记录时写入线程名。
+ */
+class TraceRecorder
+{
+public:
+    /**
+     * @brief 开始记录
+     * @param filename 跟踪文件
+     * @param errorString 失败时的错误信息
+     * @return 成功返回true
+     *
+     * 已经在记录时先结束之前的文件。
+     */
+    static bool start(const QString &filename, QString *errorString);
+
+    /**
+     * @brief 结束记录并关闭文件
+     */
+    static void stop();
+
+    /**
+     * @brief 判断是否正在记录
+     */
+    static bool isEnabled()
+    {
+        return s_enabled.loadRelaxed() != 0;
+    }
+
+    /**
+     * @brief 记录一个事件的开始
+     * @param name 事件名，必须是不含引号和反斜杠的字符串常量
+     * @param category 分类，要求同上
+     */
+    static void begin(const char *name, const char *category);
+
+    /**
+     * @brief 记录一个事件的结束
+     * @param name 事件名
+     * @param category 分类
+     */
+    static void end(const char *name, const char *category);
+
+private:
+    /**
+     * @brief 写入一个事件
+     * @param phase 事件类型，B表示开始，E表示结束
+     */
+    static void write(char phase, const char *name, const char *category);
+
+    static QAtomicInt s_enabled;   ///< 是否正在记录
+};
+
+/**
+ * @class TraceScope
+ * @brief 在作用域内记录一个事件
+ *
+ * 构造时记录开始，析构时记录结束。未启动记录时什么也不做。
+ */
+class TraceScope
+{
+public:
+    TraceScope(const char *name, const char *category)
+        : m_name(TraceRecorder::isEnabled() ? name : nullptr),
+          m_category(category)
+    {
+        if (m_name) TraceRecorder::begin(m_name, m_category);
+    }
+
+    ~TraceScope()
+    {
+        if (m_name) TraceRecorder::end(m_name, m_category);
+    }
+
+private:
+    Q_DISABLE_COPY(TraceScope)
+
+    const char *m_name;       ///< 事件名，未记录时为nullptr
+    const char *m_category;   ///< 分类
+};
+
+#endif // TRACERECORDER_H
@@ -0,0 +1,139 @@
+#include "undobuffer.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+quint64 zigzag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+qint64 unzigzag(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+// 小于该值的整数可以用double精确表示，按整数编码
+const qreal kMaxExactInteger = 4503599627370496.0; // 2^52
+}
+
+UndoWriter::UndoWriter(QByteArray *buffer, quintptr *lastPointer)
+    : m_buffer(buffer),
+      m_lastPointer(lastPointer)
+{
+}
+
+void UndoWriter::writeByte(quint8 value)
+{
+    m_buffer->append(char(value));
+}
+
+void UndoWriter::writeUInt(quint64 value)
+{
+    while (value >= 0x80) {
+        m_buffer->append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    m_buffer->append(char(value));
+}
+
+void UndoWriter::writeInt(qint64 value)
+{
+    writeUInt(zigzag(value));
+}
+
+void UndoWriter::writeReal(qreal value)
+{
+    // 最低位为0表示后面是整数值，为1表示后面是8字节的原始浮点数
+    if (std::floor(value) == value && std::fabs(value) < kMaxExactInteger) {
+        writeUInt(zigzag(qint64(value)) << 1);
+        return;
+    }
+
+    writeUInt(1);
+    char raw[sizeof(qreal)];
+    std::memcpy(raw, &value, sizeof(raw));
+    m_buffer->append(raw, int(sizeof(raw)));
+}
+
+void UndoWriter::writeColor(const QColor &color)
+{
+    QRgb rgba = color.rgba();
+    for (int i = 0; i < 4; ++i) {
+        writeByte(quint8(rgba >> (i * 8)));
+    }
+}
+
+void UndoWriter::writePointer(const void *pointer)
+{
+    // 同一批图形多从同一个内存池slab中分配，相邻记录的指针差值很小
+    quintptr value = quintptr(pointer);
+    writeInt(qint64(value - *m_lastPointer));
+    *m_lastPointer = value;
+}
+
+UndoReader::UndoReader(const QByteArray &buffer)
+    : m_buffer(buffer),
+      m_pos(0),
+      m_lastPointer(0)
+{
+}
+
+bool UndoReader::atEnd() const
+{
+    return m_pos >= m_buffer.size();
+}
+
+quint8 UndoReader::readByte()
+{
+    if (atEnd()) return 0;
+    return quint8(m_buffer.at(m_pos++));
+}
+
+quint64 UndoReader::readUInt()
+{
+    quint64 value = 0;
+    int shift = 0;
+    while (!atEnd() && shift < 64) {
+        quint8 byte = quint8(m_buffer.at(m_pos++));
+        value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+        shift += 7;
+    }
+    return value;
+}
+
+qint64 UndoReader::readInt()
+{
+    return unzigzag(readUInt());
+}
+
+qreal UndoReader::readReal()
+{
+    quint64 tag = readUInt();
+    if (!(tag & 1)) {
+        return qreal(unzigzag(tag >> 1));
+    }
+
+    qreal value = 0;
+    if (m_pos + int(sizeof(qreal)) <= m_buffer.size()) {
+        std::memcpy(&value, m_buffer.constData() + m_pos, sizeof(qreal));
+        m_pos += int(sizeof(qreal));
+    }
+    return value;
+}
+
+QColor UndoReader::readColor()
+{
+    QRgb rgba = 0;
+    for (int i = 0; i < 4; ++i) {
+        rgba |= QRgb(readByte()) << (i * 8);
+    }
+    return QColor::fromRgba(rgba);
+}
+
+void *UndoReader::readPointer()
+{
+    m_lastPointer += quintptr(readInt());
+    return reinterpret_cast<void *>(m_lastPointer);
+}
@@ -0,0 +1,132 @@
+#ifndef UNDOBUFFER_H
+#define UNDOBUFFER_H
+
+#include <QByteArray>
+#include <QColor>
+
+/**
+ * @file undobuffer.h
+ * @brief 撤销记录编码类的头文件
+ *
+ * 这个文件定义了UndoWriter和UndoReader类，把撤销记录紧凑地写入字节缓冲区并读回。
+ * 整数使用变长编码，整数值的坐标只占1到3个字节，图形指针按与上一个指针的差值编码。
+ */
+
+/**
+ * @class UndoWriter
+ * @brief 撤销记录的写入器
+ *
+ * 向字节缓冲区追加数据。指针差值的基准保存在调用者提供的变量中，
+ * 这样同一个缓冲区可以分多次追加记录。
+ */
+class UndoWriter
+{
+public:
+    /**
+     * @brief UndoWriter类的构造函数
+     * @param buffer 目标缓冲区
+     * @param lastPointer 上一个写入的指针，写入新指针后会被更新
+     */
+    UndoWriter(QByteArray *buffer, quintptr *lastPointer);
+
+    /**
+     * @brief 写入一个字节
+     * @param value 字节
+     */
+    void writeByte(quint8 value);
+
+    /**
+     * @brief 写入无符号整数（变长编码）
+     * @param value 整数
+     */
+    void writeUInt(quint64 value);
+
+    /**
+     * @brief 写入有符号整数（zigzag变长编码）
+     * @param value 整数
+     */
+    void writeInt(qint64 value);
+
+    /**
+     * @brief 写入浮点数
+     * @param value 浮点数
+     *
+     * 整数值写成变长整数，其他值写入完整的8字节。
+     */
+    void writeReal(qreal value);
+
+    /**
+     * @brief 写入颜色（4字节ARGB）
+     * @param color 颜色
+     */
+    void writeColor(const QColor &color);
+
+    /**
+     * @brief 写入指针，按与上一个指针的差值编码
+     * @param pointer 指针
+     */
+    void writePointer(const void *pointer);
+
+private:
+    QByteArray *m_buffer;     ///< 目标缓冲区
+    quintptr *m_lastPointer;  ///< 指针差值的基准
+};
+
+/**
+ * @class UndoReader
+ * @brief 撤销记录的读取器
+ *
+ * 按写入的顺序从字节缓冲区读取数据。
+ */
+class UndoReader
+{
+public:
+    /**
+     * @brief UndoReader类的构造函数
+     * @param buffer 源缓冲区，读取期间必须保持有效
+     */
+    explicit UndoReader(const QByteArray &buffer);
+
+    /**
+     * @brief 判断是否已读到末尾
+     * @return 如果没有更多数据，返回true
+     */
+    bool atEnd() const;
+
+    /**
+     * @brief 读取一个字节
+     */
+    quint8 readByte();
+
+    /**
+     * @brief 读取无符号整数
+     */
+    quint64 readUInt();
+
+    /**
+     * @brief 读取有符号整数
+     */
+    qint64 readInt();
+
+    /**
+     * @brief 读取浮点数
+     */
+    qreal readReal();
+
+    /**
+     * @brief 读取颜色
+     */
+    QColor readColor();
+
+    /**
+     * @brief 读取指针
+     */
+    void *readPointer();
+
+private:
+    const QByteArray &m_buffer;  ///< 源缓冲区
+    int m_pos;                   ///< 读取位置
+    quintptr m_lastPointer;      ///< 指针差值的基准
+};
+
+#endif // UNDOBUFFER_H
@@ -0,0 +1,332 @@
+#include "undohistory.h"
+#include <QTemporaryDir>
+
+namespace {
+// 默认内存预算
+const qint64 kDefaultBudget = 64 * 1024 * 1024;
+
+// 被删除的图形由事务持有，按每个图形的近似大小（包括列表中的指针）计入预算
+const qint64 kHeldShapeBytes = 128;
+
+qint64 heldBytes(const QVector<Shape *> &shapes)
+{
+    return qint64(shapes.size()) * kHeldShapeBytes;
+}
+
+// 环形缓冲区的初始容量
+const int kInitialCapacity = 16;
+}
+
+UndoHistory::UndoHistory()
+    : m_head(0),
+      m_count(0),
+      m_usage(0),
+      m_budget(kDefaultBudget),
+      m_spillEnabled(false),
+      m_spilledHeld(0),
+      m_pushCount(0),
+      m_evictedCount(0)
+{
+}
+
+UndoHistory::~UndoHistory()
+{
+    closeSpillFile();
+}
+
+void UndoHistory::setReleaseHandler(const ReleaseHandler &handler)
+{
+    m_releaseHandler = handler;
+}
+
+void UndoHistory::setMemoryBudget(qint64 bytes)
+{
+    if (bytes <= 0 || bytes == m_budget) return;
+
+    m_budget = bytes;
+    enforceBudget();
+}
+
+qint64 UndoHistory::memoryBudget() const
+{
+    return m_budget;
+}
+
+void UndoHistory::setSpillEnabled(bool enabled)
+{
+    // 关闭溢出时已经写入磁盘的历史仍然保留，撤销时照常读回
+    m_spillEnabled = enabled;
+}
+
+bool UndoHistory::isSpillEnabled() const
+{
+    return m_spillEnabled;
+}
+
+qint64 UndoHistory::memoryUsage() const
+{
+    return m_usage + m_spilledHeld;
+}
+
+qint64 UndoHistory::spilledBytes() const
+{
+    if (m_spilled.isEmpty()) return 0;
+    const SpillEntry &last = m_spilled.last();
+    return last.offset + last.size;
+}
+
+qint64 UndoHistory::pushCount() const
+{
+    return m_pushCount;
+}
+
+qint64 UndoHistory::evictedCount() const
+{
+    return m_evictedCount;
+}
+
+int UndoHistory::undoCount() const
+{
+    return m_count + m_spilled.size();
+}
+
+int UndoHistory::redoCount() const
+{
+    return m_redo.size();
+}
+
+bool UndoHistory::canUndo() const
+{
+    return undoCount() > 0;
+}
+
+bool UndoHistory::canRedo() const
+{
+    return !m_redo.isEmpty();
+}
+
+void UndoHistory::push(const UndoTransaction &transaction)
+{
+    ++m_pushCount;
+    pushBack(transaction);
+    clearRedo();
+    enforceBudget();
+}
+
+UndoTransaction UndoHistory::undo()
+{
+    if (m_count == 0) {
+        // 读回磁盘上最新的一批事务，占满预算的一半，给之后的新操作留出空间
+        while (!m_spilled.isEmpty() && (m_count == 0 || m_usage < m_budget / 2)) {
+            UndoTransaction transaction;
+            if (unspill(&transaction)) {
+                pushFront(transaction);
+            }
+        }
+        if (m_spilled.isEmpty()) {
+            closeSpillFile();
+        }
+    }
+    if (m_count == 0) return UndoTransaction();
+
+    UndoTransaction transaction = takeBack();
+    m_redo.append(transaction);
+    return transaction;
+}
+
+UndoTransaction UndoHistory::redo()
+{
+    if (m_redo.isEmpty()) return UndoTransaction();
+
+    UndoTransaction transaction = m_redo.takeLast();
+    pushBack(transaction);
+    enforceBudget();
+    return transaction;
+}
+
+void UndoHistory::clearRedo()
+{
+    for (const UndoTransaction &transaction : std::as_const(m_redo)) {
+        if (m_releaseHandler) m_releaseHandler(transaction, true);
+    }
+    m_redo.clear();
+}
+
+void UndoHistory::clear()
+{
+    clearRedo();
+
+    while (m_count > 0) {
+        UndoTransaction transaction = takeFront();
+        if (m_releaseHandler) m_releaseHandler(transaction, false);
+    }
+    releaseSpilled();
+
+    m_ring.clear();
+    m_head = 0;
+    m_usage = 0;
+}
+
+qint64 UndoHistory::costOf(const UndoTransaction &transaction)
+{
+    return qint64(sizeof(UndoTransaction)) + transaction.data.size()
+           + heldBytes(transaction.deletedShapes);
+}
+
+void UndoHistory::pushBack(const UndoTransaction &transaction)
+{
+    if (m_count == m_ring.size()) grow();
+
+    m_ring[(m_head + m_count) % m_ring.size()] = transaction;
+    ++m_count;
+    m_usage += costOf(transaction);
+}
+
+void UndoHistory::pushFront(const UndoTransaction &transaction)
+{
+    if (m_count == m_ring.size()) grow();
+
+    m_head = (m_head + m_ring.size() - 1) % m_ring.size();
+    m_ring[m_head] = transaction;
+    ++m_count;
+    m_usage += costOf(transaction);
+}
+
+UndoTransaction UndoHistory::takeFront()
+{
+    UndoTransaction transaction;
+    std::swap(transaction, m_ring[m_head]);
+    m_head = (m_head + 1) % m_ring.size();
+    --m_count;
+    m_usage -= costOf(transaction);
+    return transaction;
+}
+
+UndoTransaction UndoHistory::takeBack()
+{
+    UndoTransaction transaction;
+    std::swap(transaction, m_ring[(m_head + m_count - 1) % m_ring.size()]);
+    --m_count;
+    m_usage -= costOf(transaction);
+    return transaction;
+}
+
+void UndoHistory::grow()
+{
+    QVector<UndoTransaction> ring(qMax(kInitialCapacity, m_ring.size() * 2));
+    for (int i = 0; i < m_count; ++i) {
+        std::swap(ring[i], m_ring[(m_head + i) % m_ring.size()]);
+    }
+    m_ring.swap(ring);
+    m_head = 0;
+}
+
+void UndoHistory::enforceBudget()
+{
+    // 至少保留最新的一个事务，即使它本身超过预算。
+    // 写入磁盘的事务持有的图形仍在内存中，同样计入预算
+    while (m_count > 1 && m_usage + m_spilledHeld > m_budget) {
+        UndoTransaction transaction = takeFront();
+        ++m_evictedCount;
+        if (m_spillEnabled && spill(transaction)) {
+            continue;
+        }
+
+        // 丢弃历史时，磁盘上更早的历史也不再可达
+        releaseSpilled();
+        if (m_releaseHandler) m_releaseHandler(transaction, false);
+    }
+
+    // 只剩最新的一个事务时仍超出预算，丢弃磁盘上最早的历史
+    while (!m_spilled.isEmpty() && m_usage + m_spilledHeld > m_budget) {
+        releaseOldestSpilled();
+    }
+}
+
+bool UndoHistory::spill(const UndoTransaction &transaction)
+{
+    if (!m_spillFile.isOpen()) {
+        m_spillDir.reset(new QTemporaryDir());
+        if (!m_spillDir->isValid()) {
+            m_spillDir.reset();
+            return false;
+        }
+        m_spillFile.setFileName(m_spillDir->filePath("undo.journal"));
+        if (!m_spillFile.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+            m_spillDir.reset();
+            return false;
+        }
+    }
+
+    SpillEntry entry;
+    entry.offset = spilledBytes();
+    entry.size = int(transaction.data.size());
+    entry.count = transaction.count;
+    entry.deletedShapes = transaction.deletedShapes;
+
+    if (!m_spillFile.seek(entry.offset)
+        || m_spillFile.write(transaction.data) != transaction.data.size()) {
+        return false;
+    }
+    m_spilled.append(entry);
+    m_spilledHeld += heldBytes(entry.deletedShapes);
+    return true;
+}
+
+bool UndoHistory::unspill(UndoTransaction *transaction)
+{
+    const SpillEntry &entry = m_spilled.last();
+
+    *transaction = UndoTransaction();
+    if (m_spillFile.seek(entry.offset)) {
+        transaction->data = m_spillFile.read(entry.size);
+    }
+    if (transaction->data.size() != entry.size) {
+        // 日志文件损坏时放弃这一步，避免按不完整的数据修改文档。更早的历史依赖这一步，
+        // 也一起放弃；这些事务持有的图形按内存中的列表释放
+        *transaction = UndoTransaction();
+        releaseSpilled();
+        return false;
+    }
+    transaction->count = entry.count;
+    transaction->deletedShapes = entry.deletedShapes;
+
+    // 日志按栈的方式使用，读回后截断文件
+    m_spillFile.resize(entry.offset);
+    m_spilledHeld -= heldBytes(entry.deletedShapes);
+    m_spilled.removeLast();
+    return true;
+}
+
+void UndoHistory::releaseOldestSpilled()
+{
+    // 日志开头的记录不再读取，文件在历史全部读回或丢弃时才删除
+    UndoTransaction transaction;
+    transaction.deletedShapes = m_spilled.takeFirst().deletedShapes;
+    m_spilledHeld -= heldBytes(transaction.deletedShapes);
+    if (m_spilled.isEmpty()) {
+        closeSpillFile();
+    }
+    if (m_releaseHandler) m_releaseHandler(transaction, false);
+}
+
+void UndoHistory::releaseSpilled()
+{
+    // 从新到旧释放，只需要内存中被删除的图形列表
+    for (int i = m_spilled.size() - 1; i >= 0; --i) {
+        UndoTransaction transaction;
+        transaction.deletedShapes = m_spilled.at(i).deletedShapes;
+        if (m_releaseHandler) m_releaseHandler(transaction, false);
+    }
+    closeSpillFile();
+}
+
+void UndoHistory::closeSpillFile()
+{
+    if (m_spillFile.isOpen()) {
+        m_spillFile.close();
+    }
+    m_spillDir.reset();
+    m_spilled.clear();
+    m_spilledHeld = 0;
+}
@@ -0,0 +1,277 @@
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QVector>
+#include <functional>
+#include <memory>
+
+class QTemporaryDir;
+class Shape;
+
+/**
+ * @file undohistory.h
+ * @brief 撤销历史类的头文件
+ *
+ * 这个文件定义了UndoTransaction结构体和UndoHistory类。
+ * 撤销历史的大小按占用的内存字节数限制，而不是按步数限制。
+ */
+
+/**
+ * @struct UndoTransaction
+ * @brief 撤销事务
+ *
+ * 撤销栈中的一项。一次用户操作涉及的所有图形操作记录在同一个事务中，
+ * 撤销和重做时作为整体处理，只占用一个撤销步数。
+ * 操作按执行顺序编码在紧凑的字节缓冲区中（见UndoWriter）。
+ */
+struct UndoTransaction {
+    QByteArray data;          ///< 编码后的操作
+    int count = 0;            ///< 操作数量
+    QVector<Shape *> deletedShapes;  ///< 删除操作涉及的图形，由事务持有
+    quintptr lastShape = 0;   ///< 最后写入的图形指针，用于差值编码
+};
+
+/**
+ * @class UndoHistory
+ * @brief 按内存预算限制的撤销/重做历史
+ *
+ * 撤销栈保存在环形缓冲区中，最早的事务在队头，移除最早的事务是O(1)的。
+ * 压入新事务后，如果撤销栈占用的内存超过预算，就从队头依次移除最早的事务：
+ * 未启用溢出时直接丢弃（通过释放回调释放事务持有的图形），
+ * 启用溢出时把编码后的数据追加到临时目录中的日志文件，撤销到更早的历史时再按需读回。
+ *
+ * 溢出的事务只把记录本身写入磁盘，其中被删除的图形和它们的列表仍保留在内存中，
+ * 这样读回后的图形指针依然有效，读回失败或丢弃时也能按列表释放这些图形，不必读回记录。
+ * 溢出的事务的记录不计入内存预算，但它们持有的图形仍然计入；
+ * 内存中只剩最新的一个事务仍超出预算时，从最早的一步开始丢弃磁盘上的历史。
+ */
+class UndoHistory
+{
+public:
+    /**
+     * @brief 事务被丢弃时的回调
+     *
+     * 第一个参数是事务，第二个参数表示事务是否处于已撤销状态（来自重做栈）。
+     * 丢弃溢出到磁盘的事务时不读回记录，事务中只有deletedShapes，data为空。
+     */
+    typedef std::function<void(const UndoTransaction &, bool)> ReleaseHandler;
+
+    /**
+     * @brief UndoHistory类的构造函数
+     */
+    UndoHistory();
+
+    /**
+     * @brief UndoHistory类的析构函数
+     *
+     * 不调用释放回调，所有者需要在析构前调用clear()。
+     */
+    ~UndoHistory();
+
+    /**
+     * @brief 设置事务被丢弃时的回调
+     * @param handler 回调函数
+     */
+    void setReleaseHandler(const ReleaseHandler &handler);
+
+    /**
+     * @brief 设置撤销栈的内存预算
+     * @param bytes 字节数，至少保留最新的一个事务
+     */
+    void setMemoryBudget(qint64 bytes);
+
+    /**
+     * @brief 获取撤销栈的内存预算
+     * @return 字节数
+     */
+    qint64 memoryBudget() const;
+
+    /**
+     * @brief 设置是否把超出预算的历史写入磁盘
+     * @param enabled 为true时写入临时文件，否则直接丢弃
+     */
+    void setSpillEnabled(bool enabled);
+
+    /**
+     * @brief 判断是否把超出预算的历史写入磁盘
+     * @return 如果启用，返回true
+     */
+    bool isSpillEnabled() const;
+
+    /**
+     * @brief 获取撤销历史占用的内存字节数
+     * @return 内存中的撤销栈和溢出的事务持有的图形占用的字节数之和
+     */
+    qint64 memoryUsage() const;
+
+    /**
+     * @brief 获取写入磁盘的字节数
+     * @return 字节数
+     */
+    qint64 spilledBytes() const;
+
+    /**
+     * @brief 获取压入的事务总数
+     * @return 自创建以来调用push()的次数
+     */
+    qint64 pushCount() const;
+
+    /**
+     * @brief 获取因超出预算而移出内存的事务总数
+     * @return 写入磁盘和直接丢弃的事务数之和
+     */
+    qint64 evictedCount() const;
+
+    /**
+     * @brief 获取可撤销的步数（包括磁盘上的历史）
+     * @return 步数
+     */
+    int undoCount() const;
+
+    /**
+     * @brief 获取可重做的步数
+     * @return 步数
+     */
+    int redoCount() const;
+
+    /**
+     * @brief 判断是否可以撤销
+     */
+    bool canUndo() const;
+
+    /**
+     * @brief 判断是否可以重做
+     */
+    bool canRedo() const;
+
+    /**
+     * @brief 压入新事务
+     * @param transaction 事务
+     *
+     * 清空重做栈，然后按内存预算移除最早的事务。
+     */
+    void push(const UndoTransaction &transaction);
+
+    /**
+     * @brief 把最新的事务从撤销栈移到重做栈
+     * @return 被撤销的事务，调用前需确认canUndo()
+     *
+     * 内存中的撤销栈为空时，从磁盘读回最近溢出的一批事务。
+     */
+    UndoTransaction undo();
+
+    /**
+     * @brief 把最近撤销的事务从重做栈移回撤销栈
+     * @return 被重做的事务，调用前需确认canRedo()
+     */
+    UndoTransaction redo();
+
+    /**
+     * @brief 清空重做栈
+     */
+    void clearRedo();
+
+    /**
+     * @brief 清空全部历史，包括磁盘上的部分
+     */
+    void clear();
+
+private:
+    Q_DISABLE_COPY(UndoHistory)
+
+    /**
+     * @brief 溢出到磁盘的事务在日志文件中的位置
+     */
+    struct SpillEntry {
+        qint64 offset;        ///< 数据在日志文件中的偏移
+        int size;             ///< 数据长度
+        int count;            ///< 操作数量
+        QVector<Shape *> deletedShapes;  ///< 删除操作涉及的图形，仍在内存中
+    };
+
+    /**
+     * @brief 估算事务在内存中占用的字节数
+     */
+    static qint64 costOf(const UndoTransaction &transaction);
+
+    /**
+     * @brief 在环形缓冲区的队尾追加事务
+     */
+    void pushBack(const UndoTransaction &transaction);
+
+    /**
+     * @brief 在环形缓冲区的队头插入事务（用于读回溢出的历史）
+     */
+    void pushFront(const UndoTransaction &transaction);
+
+    /**
+     * @brief 移除并返回队头的事务
+     */
+    UndoTransaction takeFront();
+
+    /**
+     * @brief 移除并返回队尾的事务
+     */
+    UndoTransaction takeBack();
+
+    /**
+     * @brief 扩大环形缓冲区的容量
+     */
+    void grow();
+
+    /**
+     * @brief 移除最早的事务直到满足内存预算
+     */
+    void enforceBudget();
+
+    /**
+     * @brief 把事务追加到磁盘日志
+     * @return 写入成功返回true
+     */
+    bool spill(const UndoTransaction &transaction);
+
+    /**
+     * @brief 读回并移除磁盘日志中最新的事务
+     * @param transaction 读回的事务
+     * @return 读回成功返回true；日志损坏时这个事务和更早的历史都被释放，返回false
+     */
+    bool unspill(UndoTransaction *transaction);
+
+    /**
+     * @brief 释放磁盘日志中最早的事务
+     */
+    void releaseOldestSpilled();
+
+    /**
+     * @brief 释放磁盘日志中的所有事务，然后关闭并删除日志
+     */
+    void releaseSpilled();
+
+    /**
+     * @brief 关闭并删除磁盘日志
+     */
+    void closeSpillFile();
+
+    QVector<UndoTransaction> m_ring;        ///< 撤销栈的环形缓冲区
+    int m_head;                             ///< 最早事务在缓冲区中的位置
+    int m_count;                            ///< 内存中的撤销事务数量
+    qint64 m_usage;                         ///< 内存中的撤销事务占用的字节数
+    qint64 m_budget;                        ///< 内存预算
+    QList<UndoTransaction> m_redo;          ///< 重做栈
+
+    bool m_spillEnabled;                    ///< 是否写入磁盘
+    std::unique_ptr<QTemporaryDir> m_spillDir;  ///< 日志文件所在的临时目录
+    QFile m_spillFile;                      ///< 日志文件
+    QVector<SpillEntry> m_spilled;          ///< 磁盘上的事务，从旧到新排列
+    qint64 m_spilledHeld;                   ///< 磁盘上的事务持有的图形占用的字节数
+
+    ReleaseHandler m_releaseHandler;        ///< 事务被丢弃时的回调
+
+    qint64 m_pushCount;                     ///< 压入的事务总数
+    qint64 m_evictedCount;                  ///< 移出内存的事务总数
+};
+
+#endif // UNDOHISTORY_H
@@ -0,0 +1,127 @@
+#include "undooperation.h"
+#include "undobuffer.h"
+#include "shape.h"
+
+void UndoOperation::encode(UndoTransaction &transaction, const UndoOperation &op)
+{
+    UndoWriter writer(&transaction.data, &transaction.lastShape);
+    writer.writeByte(quint8(op.type));
+    writer.writePointer(op.shape);
+
+    switch (op.type) {
+    case AddShape:
+    case DeleteShape:
+        writer.writeInt(op.oldIndex);
+        break;
+    case LayerChange:
+        writer.writeInt(op.oldIndex);
+        writer.writeInt(op.newIndex);
+        break;
+    case TakeShape:
+        writer.writeInt(op.oldIndex);
+        writer.writeInt(op.z);
+        break;
+    case RaiseShape:
+        writer.writeInt(op.z);
+        break;
+    case MoveShape:
+        writer.writeReal(op.offset.x());
+        writer.writeReal(op.offset.y());
+        break;
+    case ResizeShape:
+        for (const QRectF &rect : {op.oldRect, op.newRect}) {
+            writer.writeReal(rect.x());
+            writer.writeReal(rect.y());
+            writer.writeReal(rect.width());
+            writer.writeReal(rect.height());
+        }
+        break;
+    case ModifyShape:
+        for (const Style &style : {op.oldStyle, op.newStyle}) {
+            writer.writeColor(style.color);
+            writer.writeColor(style.fillColor);
+            // 填充标志放在线宽的最低位
+            writer.writeUInt((quint64(qMax(0, style.lineWidth)) << 1) | (style.filled ? 1 : 0));
+        }
+        break;
+    }
+    if (op.type == DeleteShape) {
+        transaction.deletedShapes.append(op.shape);
+    }
+    ++transaction.count;
+}
+
+QList<UndoOperation> UndoOperation::decode(const UndoTransaction &transaction)
+{
+    QList<UndoOperation> operations;
+    operations.reserve(transaction.count);
+
+    UndoReader reader(transaction.data);
+    for (int i = 0; i < transaction.count && !reader.atEnd(); ++i) {
+        UndoOperation op;
+        op.type = Type(reader.readByte());
+        op.shape = static_cast<Shape *>(reader.readPointer());
+
+        switch (op.type) {
+        case AddShape:
+        case DeleteShape:
+            op.oldIndex = int(reader.readInt());
+            break;
+        case LayerChange:
+            op.oldIndex = int(reader.readInt());
+            op.newIndex = int(reader.readInt());
+            break;
+        case TakeShape:
+            op.oldIndex = int(reader.readInt());
+            op.z = reader.readInt();
+            break;
+        case RaiseShape:
+            op.z = reader.readInt();
+            break;
+        case MoveShape: {
+            qreal dx = reader.readReal();
+            qreal dy = reader.readReal();
+            op.offset = QPointF(dx, dy);
+            break;
+        }
+        case ResizeShape:
+            for (QRectF *rect : {&op.oldRect, &op.newRect}) {
+                qreal x = reader.readReal();
+                qreal y = reader.readReal();
+                qreal width = reader.readReal();
+                qreal height = reader.readReal();
+                *rect = QRectF(x, y, width, height);
+            }
+            break;
+        case ModifyShape:
+            for (Style *style : {&op.oldStyle, &op.newStyle}) {
+                style->color = reader.readColor();
+                style->fillColor = reader.readColor();
+                quint64 packed = reader.readUInt();
+                style->lineWidth = int(packed >> 1);
+                style->filled = packed & 1;
+            }
+            break;
+        }
+        operations.append(op);
+    }
+    return operations;
+}
+
+UndoOperation::Style UndoOperation::styleOf(const Shape *shape)
+{
+    Style style;
+    style.color = shape->getColor();
+    style.lineWidth = shape->getLineWidth();
+    style.filled = shape->isFilled();
+    style.fillColor = shape->getFillColor();
+    return style;
+}
+
+void UndoOperation::applyStyle(Shape *shape, const Style &style)
+{
+    shape->setColor(style.color);
+    shape->setLineWidth(style.lineWidth);
+    shape->setFilled(style.filled);
+    shape->setFillColor(style.fillColor);
+}
@@ -0,0 +1,96 @@
+#ifndef UNDOOPERATION_H
+#define UNDOOPERATION_H
+
+#include <QColor>
+#include <QList>
+#include <QPointF>
+#include <QRectF>
+#include "undohistory.h"
+
+class Shape;
+
+/**
+ * @file undooperation.h
+ * @brief 撤销操作的头文件
+ *
+ * 这个文件定义了UndoOperation结构体，以及操作在撤销事务中的编码和解码。
+ */
+
+/**
+ * @struct UndoOperation
+ * @brief 撤销/重做系统中的一个图形操作
+ *
+ * 只记录操作改变的字段：移动记录平移量，调整大小记录新旧矩形，修改记录新旧样式，
+ * 从分页文档中取出图形记录层序号。
+ * 操作按执行顺序编码在撤销事务的字节缓冲区中（见UndoWriter），撤销时再解码。
+ */
+struct UndoOperation {
+    /**
+     * @enum Type
+     * @brief 操作类型枚举
+     */
+    enum Type {
+        AddShape,      ///< 添加图形操作
+        DeleteShape,   ///< 删除图形操作
+        ModifyShape,   ///< 修改图形操作
+        MoveShape,     ///< 移动图形操作
+        ResizeShape,   ///< 调整图形大小操作
+        LayerChange,   ///< 图层变更操作
+        TakeShape,     ///< 从分页文档中取出图形操作
+        RaiseShape     ///< 取出的图形离开分页图层、按存储中的顺序绘制的操作
+    };
+
+    /**
+     * @struct Style
+     * @brief 图形样式结构体
+     *
+     * 用于记录修改操作前后的图形样式。
+     */
+    struct Style {
+        QColor color;          ///< 线条颜色
+        int lineWidth = 0;     ///< 线宽
+        bool filled = false;   ///< 是否填充
+        QColor fillColor;      ///< 填充颜色
+    };
+
+    Type type = AddShape;           ///< 操作类型
+    Shape *shape = nullptr;         ///< 操作涉及的图形
+    int oldIndex = -1;              ///< 添加、删除和图层操作前的索引
+    int newIndex = -1;              ///< 图层操作后的索引
+    qint64 z = -1;                  ///< 取出的图形在分页文档中的层序号
+    QPointF offset;                 ///< 移动的平移量
+    QRectF oldRect;                 ///< 调整大小前的矩形
+    QRectF newRect;                 ///< 调整大小后的矩形
+    Style oldStyle;                 ///< 修改前的样式
+    Style newStyle;                 ///< 修改后的样式
+
+    /**
+     * @brief 把操作编码后追加到事务中
+     * @param transaction 事务
+     * @param op 操作
+     */
+    static void encode(UndoTransaction &transaction, const UndoOperation &op);
+
+    /**
+     * @brief 解码事务中的所有操作
+     * @param transaction 事务
+     * @return 按执行顺序排列的操作
+     */
+    static QList<UndoOperation> decode(const UndoTransaction &transaction);
+
+    /**
+     * @brief 获取图形的样式
+     * @param shape 图形
+     * @return 样式
+     */
+    static Style styleOf(const Shape *shape);
+
+    /**
+     * @brief 设置图形的样式
+     * @param shape 图形
+     * @param style 样式
+     */
+    static void applyStyle(Shape *shape, const Style &style);
+};
+
+#endif // UNDOOPERATION_H
@@ -0,0 +1,14 @@
+# 链接绘图区域库和核心库，供编辑器和输入重放工具使用
+QT += widgets
+
+WIDGETS_LIB_DIR = $$OUT_PWD/../widgets
+win32:CONFIG(release, debug|release): WIDGETS_LIB_DIR = $$WIDGETS_LIB_DIR/release
+else:win32:CONFIG(debug, debug|release): WIDGETS_LIB_DIR = $$WIDGETS_LIB_DIR/debug
+
+# 静态库按依赖顺序链接，绘图区域库在核心库之前
+LIBS += -L$$WIDGETS_LIB_DIR -lqt_graphics_widgets
+
+win32:!win32-g++: PRE_TARGETDEPS += $$WIDGETS_LIB_DIR/qt_graphics_widgets.lib
+else: PRE_TARGETDEPS += $$WIDGETS_LIB_DIR/libqt_graphics_widgets.a
+
+include(../core/core.pri)
@@ -0,0 +1,15 @@
+QT       += core gui concurrent widgets
+
+TEMPLATE = lib
+CONFIG += staticlib c++17
+
+# 编辑器的绘图区域，编辑器和输入重放工具都链接它
+TARGET = qt_graphics_widgets
+
+include(../core/core.pri)
+
+SOURCES += \
+    ../src/drawingarea.cpp
+
+HEADERS += \
+    ../src/drawingarea.h